@@ -5,10 +5,12 @@ Main server class kết hợp NetworkManager và các handlers
 
 from database import init_db
 from tcp_server.network_bridge import NetworkManager, MessageTypeC2S, MessageTypeS2C
+from tcp_server.metrics_exporter import MetricsServer
 from handlers import AuthHandler, GameHandler, MatchmakingHandler, StatsHandler
+from services.game_service import init_game_store
 from ml.model_loader import load_model
 import time
-from config import SERVER_PORT
+from config import SERVER_PORT, LISTEN_BACKLOG, METRICS_PORT
 
 
 class ChessGameServer:
@@ -28,6 +30,7 @@ class ChessGameServer:
         
         # Initialize network manager
         self.network = NetworkManager()
+        self.metrics_server = None
         
         # Load ML model
         self.model = load_model()
@@ -78,12 +81,20 @@ class ChessGameServer:
     
     def start(self):
         """Start the server"""
-        if self.network.start(port=self.port):
+        # Before any game can end, so no finished game is stored twice
+        init_game_store()
+        if self.network.start(port=self.port, backlog=LISTEN_BACKLOG):
+            if METRICS_PORT:
+                self.metrics_server = MetricsServer(self.network, METRICS_PORT)
+                self.metrics_server.start()
             return True
         return False
     
     def stop(self):
         """Stop the server"""
+        if self.metrics_server:
+            self.metrics_server.stop()
+            self.metrics_server = None
         self.network.stop()
     
     def run_forever(self, poll_timeout_ms=100):
@@ -15,6 +15,20 @@ if env_path.exists():
 # Server configuration
 SERVER_HOST = os.getenv('SERVER_HOST', '0.0.0.0')
 SERVER_PORT = int(os.getenv('SERVER_PORT', '8765'))
+SERVER_SHARDS = int(os.getenv('SERVER_SHARDS', '1'))  # Reactors sharing the port, one thread each
+LISTEN_BACKLOG = int(os.getenv('LISTEN_BACKLOG', '0'))  # Pending connections per listener, 0: SOMAXCONN
+NATIVE_MOVE_RELAY = os.getenv('NATIVE_MOVE_RELAY', 'true').lower() == 'true'  # C layer forwards moves to the opponent
+IDLE_TIMEOUT_MS = int(os.getenv('IDLE_TIMEOUT_MS', '0'))  # Disconnect clients silent this long, 0: never (clients send no pings yet)
+HEARTBEAT_MS = int(os.getenv('HEARTBEAT_MS', '0'))  # Heartbeat event after this much silence, 0: none
+METRICS_PORT = int(os.getenv('METRICS_PORT', '0'))  # Prometheus /metrics on this port, 0: off
+
+# AI engine pool: warm engines shared by the games, threads and hash per engine
+ENGINE_POOL_SIZE = int(os.getenv('ENGINE_POOL_SIZE', '0'))  # 0: one engine per core
+ENGINE_THREADS = int(os.getenv('ENGINE_THREADS', '1'))
+ENGINE_HASH_MB = int(os.getenv('ENGINE_HASH_MB', '16'))
+
+# Finished games for history and stats, an append-only file indexed in memory
+GAME_STORE_PATH = os.getenv('GAME_STORE_PATH', str(Path(__file__).parent / 'games.store'))
 
 # Database configuration
 MONGODB_URI = os.getenv('MONGODB_URI', 'mongodb://localhost:27017/')
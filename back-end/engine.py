@@ -6,6 +6,8 @@ import random
 from sys import platform
 import numpy as np
 import pickle
+from collections import OrderedDict
+from config import ENGINE_POOL_SIZE, ENGINE_THREADS, ENGINE_HASH_MB
 from minimax.search import search
 from ml.filter import filter_good_moves
 import time
@@ -13,18 +15,40 @@ import time
 
 class Engine:
 
+    # Games whose moves are kept for their engines, least recently used go first
+    MAX_GAME_HANDLES = 256
+    # Depth of the searches of the AI, and whether a game's engine thinks on
+    # the player's time about the reply it expects
+    SEARCH_DEPTH = 15
+    PONDER = True
+
     def __init__(self):
-        # Try to load Stockfish, but don't fail if it's not available
-        self.stockfish = None
+        # Prefer the in-process library (make lib), it avoids the UCI pipe
+        # round-trips: a pool of warm engines the games take turns on, a game
+        # getting back the engine with its own hash table when it is free
+        self.pool = None
         try:
-            if platform == 'linux' or platform == 'linux2':
-                self.stockfish = Stockfish('./stockfish/stockfish_14_x64')
-            elif platform == 'darwin':
-                self.stockfish = Stockfish()
-            print("Stockfish engine loaded successfully")
+            from native_engine import EnginePool
+            self.pool = EnginePool(ENGINE_POOL_SIZE, ENGINE_THREADS, ENGINE_HASH_MB)
+            print("Stockfish library loaded successfully")
         except Exception as e:
-            print(f"Warning: Could not load Stockfish: {e}")
-            print("The engine will work without Stockfish.")
+            print(f"Warning: Could not load libstockfish.so: {e}")
+
+        # game_id -> NativeGame, the game's moves as the engine searches them
+        self.game_handles = OrderedDict()
+
+        # Otherwise try to load Stockfish, but don't fail if it's not available
+        self.stockfish = None
+        if self.pool is None:
+            try:
+                if platform == 'linux' or platform == 'linux2':
+                    self.stockfish = Stockfish('./stockfish/stockfish_14_x64')
+                elif platform == 'darwin':
+                    self.stockfish = Stockfish()
+                print("Stockfish engine loaded successfully")
+            except Exception as e:
+                print(f"Warning: Could not load Stockfish: {e}")
+                print("The engine will work without Stockfish.")
 
         # Try to load ML model, but don't fail if it's not available
         self.classifier = None
@@ -36,13 +60,91 @@ class Engine:
             print(f"Warning: Could not load ML classifier: {e}")
             print("The engine will work without ML filtering.")
 
-    def get_stockfish_best_move(self, board):
+    def _game_handle(self, game_id, board):
+        """
+        The NativeGame of game_id brought up to date with board: only the moves
+        played since the last search are applied, a board that went another
+        way (takeback, new game) starts a new handle
+        """
+        from native_engine import NativeGame
+        root = board.root().fen()
+        moves = [m.uci() for m in board.move_stack]
+        game = self.game_handles.get(game_id)
+
+        if game is None or game.root != root or game.moves != moves[:len(game.moves)]:
+            game = NativeGame(root, board.chess960)
+            self.game_handles[game_id] = game
+            if len(self.game_handles) > self.MAX_GAME_HANDLES:
+                oldest_id, _ = self.game_handles.popitem(last=False)
+                self.pool.forget(oldest_id)
+        self.game_handles.move_to_end(game_id)
+
+        for move in moves[len(game.moves):]:
+            game.push(move)
+        return game
+
+    def end_game(self, game_id):
+        """Stop pondering for game_id and drop its moves"""
+        if self.pool is not None:
+            self.pool.forget(game_id)
+        game = self.game_handles.pop(game_id, None)
+        if game is not None:
+            game.close()
+
+    def get_stockfish_best_move(self, board, game_id=None):
+        if self.pool is not None:
+            with self.pool.engine(game_id) as engine:
+                if game_id is None:
+                    return engine.get_best_move(board.fen(), depth=self.SEARCH_DEPTH)
+                return self._game_best_move(engine, game_id, board)
         if self.stockfish is None:
             print("Stockfish not available, using minimax instead")
             return self.get_minimax_best_move(board, with_ml=False)
         self.stockfish.set_fen_position(board.fen())
         return self.stockfish.get_best_move()
 
+    def _game_best_move(self, engine, game_id, board):
+        """
+        Best move from the pool's engine for the game. The engine then ponders
+        on the reply it expects: when the player makes it and the engine was
+        not taken by another game meanwhile, the answer is ready at once.
+        """
+        result = None
+
+        if engine.pondering:
+            game = self.game_handles[game_id]
+            if [m.uci() for m in board.move_stack] == game.moves:
+                result = engine.ponderhit()
+            else:
+                engine.stop_ponder()
+                game.pop()  # The predicted reply
+
+        game = self._game_handle(game_id, board)
+        if result is None:
+            result = engine.search_game(game, depth=self.SEARCH_DEPTH)
+
+        move = result['bestmove']
+        if move == '0000':
+            return None
+
+        if self.PONDER and result['ponder']:
+            game.push(move)
+            game.push(result['ponder'])
+            engine.ponder_game(game, depth=self.SEARCH_DEPTH)
+        return move
+
+    def analyse_game(self, board, depth=12, threads=0, callback=None):
+        """
+        Per-move report of the game that led to board: best move, scores and
+        judgement of each move, see NativeStockfish.analyse_game()
+        """
+        if self.pool is None:
+            raise RuntimeError("Game analysis needs libstockfish.so")
+        moves = " ".join(m.uci() for m in board.move_stack)
+        game = f"fen {board.root().fen()} moves {moves}"
+        with self.pool.engine() as engine:
+            return engine.analyse_game(game, depth=depth, threads=threads, callback=callback)
+
     def get_random_move(self, board):
         legal_moves = [str(move) for move in board.legal_moves]
         return random.choice(legal_moves)
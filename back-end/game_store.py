@@ -0,0 +1,190 @@
+"""
+Game Store - finished games in the native append-only store of libchess_server.so
+This module wraps tcp_server/game_store.h with ctypes. History pages and
+win/loss/draw counts are answered from the store's in-memory user index and
+its mapping of the file, so they cost no database query.
+Build the library with `make` in tcp_server.
+"""
+
+import calendar
+import ctypes
+from datetime import datetime
+from pathlib import Path
+from typing import Optional, Dict, Any, List, Tuple
+
+
+STORE_ID_MAX = 64
+STORE_NAME_MAX = 64
+STORE_MAX_MOVES = 2048
+STORE_FLAG_AI_GAME = 0x01
+
+RESULTS = ('white_win', 'black_win', 'draw')
+STORE_RESULT_UNKNOWN = 3
+
+
+class GameRecord(ctypes.Structure):
+    """GameRecord: a stored game without its moves"""
+    _fields_ = [
+        ("offset", ctypes.c_uint64),
+        ("start_time", ctypes.c_uint64),
+        ("end_time", ctypes.c_uint64),
+        ("result", ctypes.c_uint8),
+        ("flags", ctypes.c_uint8),
+        ("move_count", ctypes.c_uint16),
+        ("status", ctypes.c_char * 16),
+        ("game_id", ctypes.c_char * STORE_ID_MAX),
+        ("white_id", ctypes.c_char * STORE_ID_MAX),
+        ("black_id", ctypes.c_char * STORE_ID_MAX),
+        ("white_name", ctypes.c_char * STORE_NAME_MAX),
+        ("black_name", ctypes.c_char * STORE_NAME_MAX)
+    ]
+
+
+class GameStoreStats(ctypes.Structure):
+    """GameStoreStats: one user's aggregates"""
+    _fields_ = [
+        ("games", ctypes.c_uint32),
+        ("wins", ctypes.c_uint32),
+        ("losses", ctypes.c_uint32),
+        ("draws", ctypes.c_uint32)
+    ]
+
+
+def _default_library_path() -> str:
+    return str(Path(__file__).parent / "tcp_server" / "libchess_server.so")
+
+
+def _timestamp(value: Optional[datetime]) -> int:
+    return calendar.timegm(value.utctimetuple()) if value else 0
+
+
+def _datetime(seconds: int) -> Optional[datetime]:
+    return datetime.utcfromtimestamp(seconds) if seconds else None
+
+
+def _text(value: bytes) -> str:
+    return value.decode('utf-8', 'replace')
+
+
+class GameStore:
+    """
+    The process's game store (the native side keeps one). Times are naive
+    UTC datetimes as in the games collection; user ids are compared as
+    strings. Thread safe.
+    """
+
+    def __init__(self, path: str, library_path: str = None):
+        if library_path is None:
+            library_path = _default_library_path()
+
+        self.lib = ctypes.CDLL(library_path)
+        self.lib.game_store_open.argtypes = [ctypes.c_char_p]
+        self.lib.game_store_open.restype = ctypes.c_int
+        self.lib.game_store_close.argtypes = []
+        self.lib.game_store_close.restype = None
+        self.lib.game_store_append.argtypes = [
+            ctypes.POINTER(GameRecord), ctypes.POINTER(ctypes.c_uint16),
+            ctypes.POINTER(ctypes.c_uint32), ctypes.c_uint16
+        ]
+        self.lib.game_store_append.restype = ctypes.c_int64
+        self.lib.game_store_history.argtypes = [
+            ctypes.c_char_p, ctypes.c_uint32, ctypes.POINTER(GameRecord), ctypes.c_int
+        ]
+        self.lib.game_store_history.restype = ctypes.c_int
+        self.lib.game_store_stats.argtypes = [ctypes.c_char_p, ctypes.POINTER(GameStoreStats)]
+        self.lib.game_store_stats.restype = ctypes.c_int
+        self.lib.game_store_moves.argtypes = [
+            ctypes.c_uint64, ctypes.POINTER(ctypes.c_uint16), ctypes.POINTER(ctypes.c_uint32),
+            ctypes.c_int, ctypes.POINTER(ctypes.c_int)
+        ]
+        self.lib.game_store_moves.restype = ctypes.c_int
+        self.lib.game_store_count.argtypes = []
+        self.lib.game_store_count.restype = ctypes.c_int64
+        self.lib.move_from_uci.argtypes = [ctypes.c_char_p]
+        self.lib.move_from_uci.restype = ctypes.c_uint16
+        self.lib.move_to_uci.argtypes = [ctypes.c_uint16, ctypes.c_char_p]
+        self.lib.move_to_uci.restype = ctypes.c_int
+
+        rc = self.lib.game_store_open(str(path).encode('utf-8'))
+        if rc < 0:
+            raise OSError(f"Could not open game store {path}")
+        self.created = rc == 1
+
+    def close(self):
+        self.lib.game_store_close()
+
+    def append(self, game: Dict[str, Any]) -> bool:
+        """
+        Store a finished game, given as its games collection document. An
+        optional 'clocks' list holds the mover's remaining ms per move.
+        """
+        moves = game.get('moves') or []
+        if len(moves) > STORE_MAX_MOVES:
+            return False
+        result = game.get('result')
+
+        record = GameRecord(
+            start_time=_timestamp(game.get('start_time')),
+            end_time=_timestamp(game.get('end_time')),
+            result=RESULTS.index(result) if result in RESULTS else STORE_RESULT_UNKNOWN,
+            flags=STORE_FLAG_AI_GAME if game.get('is_ai_game') else 0,
+            move_count=len(moves),
+            status=str(game.get('status', '')).encode('utf-8')[:15],
+            game_id=str(game.get('game_id', '')).encode('utf-8')[:STORE_ID_MAX - 1],
+            white_id=str(game.get('white_player_id', '')).encode('utf-8')[:STORE_ID_MAX - 1],
+            black_id=str(game.get('black_player_id', '')).encode('utf-8')[:STORE_ID_MAX - 1],
+            white_name=str(game.get('white_username', '')).encode('utf-8')[:STORE_NAME_MAX - 1],
+            black_name=str(game.get('black_username', '')).encode('utf-8')[:STORE_NAME_MAX - 1]
+        )
+        encoded = (ctypes.c_uint16 * max(len(moves), 1))(
+            *[self.lib.move_from_uci(m.encode('utf-8')) for m in moves]
+        )
+        clocks = game.get('clocks') or []
+        clock_array = (ctypes.c_uint32 * len(moves))(*clocks) if len(clocks) == len(moves) and moves else None
+        return self.lib.game_store_append(ctypes.byref(record), encoded, clock_array, len(moves)) >= 0
+
+    def history(self, user_id, skip: int = 0, limit: int = 10) -> List[Dict[str, Any]]:
+        """A user's games, newest first, as dicts shaped like the games collection's"""
+        records = (GameRecord * max(limit, 1))()
+        count = self.lib.game_store_history(str(user_id).encode('utf-8'), skip, records, limit)
+        games = []
+        for record in records[:max(count, 0)]:
+            games.append({
+                'game_id': _text(record.game_id),
+                'white_player_id': _text(record.white_id),
+                'black_player_id': _text(record.black_id),
+                'white_username': _text(record.white_name),
+                'black_username': _text(record.black_name),
+                'status': _text(record.status),
+                'result': RESULTS[record.result] if record.result < len(RESULTS) else 'ongoing',
+                'start_time': _datetime(record.start_time),
+                'end_time': _datetime(record.end_time),
+                'is_ai_game': bool(record.flags & STORE_FLAG_AI_GAME),
+                'moves_count': record.move_count,
+                'offset': record.offset
+            })
+        return games
+
+    def stats(self, user_id) -> Dict[str, int]:
+        """A user's games, wins, losses and draws"""
+        stats = GameStoreStats()
+        self.lib.game_store_stats(str(user_id).encode('utf-8'), ctypes.byref(stats))
+        return {'games': stats.games, 'wins': stats.wins, 'losses': stats.losses, 'draws': stats.draws}
+
+    def moves(self, offset: int) -> Tuple[List[str], Optional[List[int]]]:
+        """The UCI moves of a stored game, and its clocks if they were recorded"""
+        moves = (ctypes.c_uint16 * STORE_MAX_MOVES)()
+        clocks = (ctypes.c_uint32 * STORE_MAX_MOVES)()
+        recorded = ctypes.c_int(0)
+        count = self.lib.game_store_moves(offset, moves, clocks, STORE_MAX_MOVES, ctypes.byref(recorded))
+        if count < 0:
+            return [], None
+        uci = ctypes.create_string_buffer(6)
+        out = []
+        for m in moves[:count]:
+            self.lib.move_to_uci(m, uci)
+            out.append(uci.value.decode('ascii'))
+        return out, list(clocks[:count]) if recorded.value else None
+
+    def __len__(self) -> int:
+        return max(self.lib.game_store_count(), 0)
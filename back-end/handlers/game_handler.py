@@ -60,7 +60,7 @@ class GameHandler:
                 'game_id': game_id,
                 'fen': validation['fen'],
                 'last_move': move,
-                'turn': 'black' if 'w' in validation['fen'] else 'white',
+                'turn': 'black' if validation['fen'].split()[1] == 'b' else 'white',
                 'in_check': validation.get('in_check', False),
                 'game_over': validation['game_over']
             }
@@ -196,7 +196,7 @@ class GameHandler:
                         'game_id': game_id,
                         'fen': validation['fen'],
                         'last_move': ai_move_uci,
-                        'turn': 'black' if 'w' in validation['fen'] else 'white',
+                        'turn': 'black' if validation['fen'].split()[1] == 'b' else 'white',
                         'in_check': validation.get('in_check', False),
                         'game_over': validation['game_over']
                     })
@@ -55,7 +55,7 @@ class StatsHandler:
         
         if user_id:
             # Get game history from database
-            history = get_user_game_history(user_id, limit=20)
+            history = get_user_game_history(user_id, limit=20, offset=int(data.get('offset', 0)))
             
             # Send history response (0x1301 - HISTORY_RESPONSE)
             self.network.send_to_client(client_fd, self.MessageTypeS2C.HISTORY_RESPONSE, {
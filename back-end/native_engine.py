@@ -0,0 +1,1014 @@
+"""
+Native Engine - in-process Stockfish through libstockfish.so
+This module wraps the C API of sf_14_src/src/c_api.h with ctypes, so a search
+costs a function call instead of UCI text over a pipe to a subprocess.
+Build the library with `make lib ARCH=x86-64-modern` in sf_14_src/src.
+"""
+
+import ctypes
+import json
+import os
+import threading
+import time
+from collections import deque
+from contextlib import contextmanager
+from pathlib import Path
+from typing import Optional, Dict, Any, Callable, List
+
+
+SF_OK = 0
+SF_ERR_ARG = -1
+SF_ERR_NO_NET = -2
+SF_ERR_FULL = -3
+
+
+class SearchLimits(ctypes.Structure):
+    """sf_limits: zero fields are unset, times in milliseconds"""
+    _fields_ = [
+        ("depth", ctypes.c_int),
+        ("nodes", ctypes.c_int64),
+        ("movetime", ctypes.c_int),
+        ("wtime", ctypes.c_int),
+        ("btime", ctypes.c_int),
+        ("winc", ctypes.c_int),
+        ("binc", ctypes.c_int),
+        ("movestogo", ctypes.c_int)
+    ]
+
+
+class SearchResult(ctypes.Structure):
+    """sf_result: outcome of one search, from the side to move's view"""
+    _fields_ = [
+        ("bestmove", ctypes.c_char * 6),
+        ("ponder", ctypes.c_char * 6),
+        ("score_cp", ctypes.c_int),
+        ("mate", ctypes.c_int),
+        ("depth", ctypes.c_int),
+        ("seldepth", ctypes.c_int),
+        ("nodes", ctypes.c_uint64),
+        ("time_ms", ctypes.c_int64)
+    ]
+
+
+SEARCH_CALLBACK = ctypes.CFUNCTYPE(None, ctypes.POINTER(SearchResult), ctypes.c_void_p)
+
+
+class SearchInfo(ctypes.Structure):
+    """sf_info: one PV line of the search progress, moves as 16 bit integers"""
+    _fields_ = [
+        ("depth", ctypes.c_int),
+        ("seldepth", ctypes.c_int),
+        ("multipv", ctypes.c_int),
+        ("score_cp", ctypes.c_int),
+        ("mate", ctypes.c_int),
+        ("bound", ctypes.c_int),
+        ("wdl", ctypes.c_int * 3),
+        ("nodes", ctypes.c_uint64),
+        ("tbhits", ctypes.c_uint64),
+        ("hashfull", ctypes.c_int),
+        ("time_ms", ctypes.c_int64),
+        ("pv_length", ctypes.c_int),
+        ("pv", ctypes.POINTER(ctypes.c_uint16))
+    ]
+
+
+INFO_CALLBACK = ctypes.CFUNCTYPE(None, ctypes.POINTER(SearchInfo), ctypes.c_void_p)
+
+
+class MoveCheck(ctypes.Structure):
+    """sf_move_check: outcome of sf_validate_move()"""
+    _fields_ = [
+        ("legal", ctypes.c_int),
+        ("check", ctypes.c_int),
+        ("status", ctypes.c_int),
+        ("fen", ctypes.c_char * 128)
+    ]
+
+
+# sf_move_check.status values
+GAME_STATUS = ('ongoing', 'checkmate', 'stalemate', 'repetition', 'fifty_moves', 'dead_position')
+
+
+class PlyReport(ctypes.Structure):
+    """sf_ply_report: one move of sf_analyse_game(), scores for the mover"""
+    _fields_ = [
+        ("ply", ctypes.c_int),
+        ("move", ctypes.c_char * 6),
+        ("best", ctypes.c_char * 6),
+        ("score_cp", ctypes.c_int),
+        ("score_mate", ctypes.c_int),
+        ("played_cp", ctypes.c_int),
+        ("played_mate", ctypes.c_int),
+        ("cp_loss", ctypes.c_int),
+        ("loss", ctypes.c_int),
+        ("judgement", ctypes.c_int),
+        ("depth", ctypes.c_int),
+        ("nodes", ctypes.c_uint64)
+    ]
+
+
+PLY_CALLBACK = ctypes.CFUNCTYPE(None, ctypes.POINTER(PlyReport), ctypes.c_void_p)
+
+# sf_ply_report.judgement values
+JUDGEMENTS = ('good', 'inaccuracy', 'mistake', 'blunder')
+
+_SQUARES = [f + r for r in "12345678" for f in "abcdefgh"]
+_BOUNDS = (None, 'lowerbound', 'upperbound')
+
+
+def _move_to_uci(m: int, chess960: bool = False) -> str:
+    """Decode a 16 bit Stockfish move, a table lookup instead of a C call"""
+    to, frm, kind = m & 63, (m >> 6) & 63, m >> 14
+    if kind == 3 and not chess960:
+        # Castling is stored as king takes rook, UCI wants the king's target
+        to = (frm & ~7) | (6 if to > frm else 2)
+    s = _SQUARES[frm] + _SQUARES[to]
+    return s + "nbrq"[(m >> 12) & 3] if kind == 1 else s
+
+
+def _info_to_dict(i: SearchInfo, chess960: bool = False) -> Dict[str, Any]:
+    return {
+        'depth': i.depth,
+        'seldepth': i.seldepth,
+        'multipv': i.multipv,
+        'score_cp': None if i.mate else i.score_cp,
+        'mate': i.mate or None,
+        'bound': _BOUNDS[i.bound],
+        'wdl': tuple(i.wdl),
+        'nodes': i.nodes,
+        'hashfull': i.hashfull,
+        'time_ms': i.time_ms,
+        'pv': [_move_to_uci(i.pv[k], chess960) for k in range(i.pv_length)]
+    }
+
+
+def _result_to_dict(r: SearchResult) -> Dict[str, Any]:
+    return {
+        'bestmove': r.bestmove.decode('ascii'),
+        'ponder': r.ponder.decode('ascii') or None,
+        'score_cp': None if r.mate else r.score_cp,
+        'mate': r.mate or None,
+        'depth': r.depth,
+        'seldepth': r.seldepth,
+        'nodes': r.nodes,
+        'time_ms': r.time_ms
+    }
+
+
+def _default_library_path() -> str:
+    return str(Path(__file__).parent / "stockfish" / "sf_14_src" / "src" / "libstockfish.so")
+
+
+class SharedHash:
+    """
+    One hash table for up to 32 engines (one per game), so that games reuse
+    each other's search results while each engine ages only its own entries.
+    Pass it as NativeStockfish(shared_hash=...); hash_mb is ignored then.
+    With a name the table is a shared memory segment that the engines of other
+    server processes on the host can use too; the first one creates it.
+    """
+
+    def __init__(self, size_mb: int, library_path: str = None, name: str = None):
+        if library_path is None:
+            library_path = _default_library_path()
+
+        self.lib = ctypes.CDLL(library_path)
+        self.lib.sf_tt_new.argtypes = [ctypes.c_int]
+        self.lib.sf_tt_new.restype = ctypes.c_void_p
+        self.lib.sf_tt_open.argtypes = [ctypes.c_char_p, ctypes.c_int]
+        self.lib.sf_tt_open.restype = ctypes.c_void_p
+        self.lib.sf_tt_free.argtypes = [ctypes.c_void_p]
+        self.lib.sf_tt_free.restype = None
+
+        if name:
+            self.tt = self.lib.sf_tt_open(name.encode(), size_mb)
+            if not self.tt:
+                raise ValueError(f"Could not open shared hash {name}")
+        else:
+            self.tt = self.lib.sf_tt_new(size_mb)
+            if not self.tt:
+                raise ValueError(f"Invalid hash size: {size_mb}")
+
+    def close(self):
+        """Engines still attached keep the table alive"""
+        if self.tt:
+            self.lib.sf_tt_free(self.tt)
+            self.tt = None
+
+    def __del__(self):
+        try:
+            self.close()
+        except Exception:
+            pass
+
+
+class MoveValidator:
+    """
+    Move legality and game state checks in native code, for validating every
+    incoming move on the server. No engine is created; instances are cheap and
+    thread safe.
+    """
+
+    def __init__(self, library_path: str = None):
+        if library_path is None:
+            library_path = _default_library_path()
+
+        self.lib = ctypes.CDLL(library_path)
+        self.lib.sf_validate_move.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
+                                              ctypes.c_int, ctypes.POINTER(MoveCheck)]
+        self.lib.sf_validate_move.restype = ctypes.c_int
+
+    def validate(self, fen: str, move: str, history: Optional[List[str]] = None,
+                 chess960: bool = False) -> Dict[str, Any]:
+        """
+        Check a UCI move in 'fen' after the moves of 'history', which are only
+        needed to detect repetitions. Returns {'legal': False} for an illegal
+        move, else the FEN after it, 'in_check' and the game 'status'.
+        """
+        out = MoveCheck()
+        moves = " ".join(history).encode('utf-8') if history else None
+        rc = self.lib.sf_validate_move(fen.encode('utf-8'), moves, move.encode('utf-8'),
+                                       int(chess960), ctypes.byref(out))
+        if rc != SF_OK:
+            raise ValueError(f"Invalid FEN or history: {fen}")
+
+        if not out.legal:
+            return {'legal': False}
+
+        return {
+            'legal': True,
+            'fen': out.fen.decode('ascii'),
+            'in_check': bool(out.check),
+            'status': GAME_STATUS[out.status]
+        }
+
+
+class NativeGame:
+    """
+    A game kept in native code: moves are applied one at a time instead of
+    setting up a FEN for every search, and searches from it (see
+    NativeStockfish.search_game) see the repetitions of the game. Not thread
+    safe, and it must not change while a search from it runs.
+    """
+
+    def __init__(self, fen: Optional[str] = None, chess960: bool = False, library_path: str = None):
+        if library_path is None:
+            library_path = _default_library_path()
+
+        self.lib = ctypes.CDLL(library_path)
+        self.lib.sf_game_new.argtypes = [ctypes.c_char_p, ctypes.c_int]
+        self.lib.sf_game_new.restype = ctypes.c_void_p
+        self.lib.sf_game_free.argtypes = [ctypes.c_void_p]
+        self.lib.sf_game_free.restype = None
+        self.lib.sf_game_push.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.POINTER(MoveCheck)]
+        self.lib.sf_game_push.restype = ctypes.c_int
+        self.lib.sf_game_pop.argtypes = [ctypes.c_void_p]
+        self.lib.sf_game_pop.restype = ctypes.c_int
+        self.lib.sf_game_fen.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+        self.lib.sf_game_fen.restype = ctypes.c_int
+
+        self.game = self.lib.sf_game_new(fen.encode('utf-8') if fen else None, int(chess960))
+        if not self.game:
+            raise ValueError(f"Invalid FEN: {fen}")
+
+        self.root = fen
+        self.chess960 = chess960
+        self.moves: List[str] = []
+
+    def push(self, move: str) -> Dict[str, Any]:
+        """Play a UCI move if legal, the result is as MoveValidator.validate()"""
+        out = MoveCheck()
+        self.lib.sf_game_push(self.game, move.encode('utf-8'), ctypes.byref(out))
+
+        if not out.legal:
+            return {'legal': False}
+
+        self.moves.append(move)
+        return {
+            'legal': True,
+            'fen': out.fen.decode('ascii'),
+            'in_check': bool(out.check),
+            'status': GAME_STATUS[out.status]
+        }
+
+    def pop(self) -> Optional[str]:
+        """Take back the last move and return it, None at the start"""
+        if self.lib.sf_game_pop(self.game) != SF_OK:
+            return None
+        return self.moves.pop()
+
+    def fen(self) -> str:
+        buf = ctypes.create_string_buffer(128)
+        self.lib.sf_game_fen(self.game, buf, len(buf))
+        return buf.value.decode('ascii')
+
+    def close(self):
+        if self.game:
+            self.lib.sf_game_free(self.game)
+            self.game = None
+
+    def __del__(self):
+        try:
+            self.close()
+        except Exception:
+            pass
+
+
+class NativeStockfish:
+    """
+    One engine instance inside libstockfish.so. Instances are independent and
+    can search concurrently; each one serializes its own searches.
+    """
+
+    def __init__(self, library_path: str = None, threads: int = 1, hash_mb: int = 16,
+                 options: Optional[Dict[str, Any]] = None, shared_hash: Optional[SharedHash] = None):
+        if library_path is None:
+            library_path = _default_library_path()
+
+        if not os.path.exists(library_path):
+            raise FileNotFoundError(f"Shared library not found: {library_path}")
+
+        self.lib = ctypes.CDLL(library_path)
+        self._setup_function_signatures()
+
+        self.lib.sf_init(library_path.encode('utf-8'))
+        self.engine = self.lib.sf_engine_new()
+
+        self._lock = threading.Lock()
+        self._done = threading.Event()
+        self._result: Optional[Dict[str, Any]] = None
+        self.pondering = False
+        # Keep a reference, the C side calls it from an engine thread
+        self._callback = SEARCH_CALLBACK(self._on_result)
+        self._info_callback = None
+        self._chess960 = False
+
+        if shared_hash is not None:
+            rc = self.lib.sf_engine_set_tt(self.engine, shared_hash.tt)
+            if rc == SF_ERR_FULL:
+                raise RuntimeError("Shared hash table has no free slot")
+        else:
+            self.set_option("Hash", hash_mb)
+
+        self.set_option("Threads", threads)
+        for name, value in (options or {}).items():
+            self.set_option(name, value)
+
+    def _setup_function_signatures(self):
+        """Define C function signatures for type safety"""
+        self.lib.sf_init.argtypes = [ctypes.c_char_p]
+        self.lib.sf_init.restype = ctypes.c_int
+
+        self.lib.sf_engine_set_tt.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+        self.lib.sf_engine_set_tt.restype = ctypes.c_int
+
+        self.lib.sf_engine_new.argtypes = []
+        self.lib.sf_engine_new.restype = ctypes.c_void_p
+        self.lib.sf_engine_free.argtypes = [ctypes.c_void_p]
+        self.lib.sf_engine_free.restype = None
+
+        self.lib.sf_set_option.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+        self.lib.sf_set_option.restype = ctypes.c_int
+
+        self.lib.sf_search.argtypes = [
+            ctypes.c_void_p,                 # engine
+            ctypes.c_char_p,                 # fen
+            ctypes.POINTER(SearchLimits),    # limits
+            SEARCH_CALLBACK,                 # callback
+            ctypes.c_void_p                  # user
+        ]
+        self.lib.sf_search.restype = ctypes.c_int
+
+        self.lib.sf_search_game.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.POINTER(SearchLimits),
+                                            SEARCH_CALLBACK, ctypes.c_void_p]
+        self.lib.sf_search_game.restype = ctypes.c_int
+        self.lib.sf_ponder_game.argtypes = self.lib.sf_search_game.argtypes
+        self.lib.sf_ponder_game.restype = ctypes.c_int
+
+        for name in ("sf_save_tt", "sf_load_tt"):
+            getattr(self.lib, name).argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+            getattr(self.lib, name).restype = ctypes.c_int
+
+        self.lib.sf_stats.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+        self.lib.sf_stats.restype = ctypes.c_int
+
+        self.lib.sf_evaluate_game.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p,
+                                              ctypes.POINTER(ctypes.c_int), ctypes.c_int]
+        self.lib.sf_evaluate_game.restype = ctypes.c_int
+
+        self.lib.sf_analyse_game.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.POINTER(SearchLimits),
+                                             ctypes.c_int, PLY_CALLBACK, ctypes.c_void_p]
+        self.lib.sf_analyse_game.restype = ctypes.c_int
+
+        self.lib.sf_set_info_callback.argtypes = [ctypes.c_void_p, INFO_CALLBACK, ctypes.c_void_p]
+        self.lib.sf_set_info_callback.restype = ctypes.c_int
+
+        for name in ("sf_stop", "sf_wait", "sf_new_game", "sf_reset_stats", "sf_ponderhit"):
+            getattr(self.lib, name).argtypes = [ctypes.c_void_p]
+            getattr(self.lib, name).restype = None
+
+    def _on_result(self, result_ptr, _user):
+        self._result = _result_to_dict(result_ptr.contents)
+        self._done.set()
+
+    def set_info_callback(self, callback: Optional[Callable[[Dict[str, Any]], None]]):
+        """
+        Stream the progress of the following searches to callback, one dict per
+        PV line (depth, score, wdl, pv as a list of UCI moves...), on an engine
+        thread. Cheap enough for live evaluation bars; None turns it off.
+        """
+        if callback is None:
+            self._info_callback = None
+            self.lib.sf_set_info_callback(self.engine, INFO_CALLBACK(), None)
+            return
+
+        def on_info(info_ptr, _user):
+            callback(_info_to_dict(info_ptr.contents, self._chess960))
+
+        self._info_callback = INFO_CALLBACK(on_info)
+        self.lib.sf_set_info_callback(self.engine, self._info_callback, None)
+
+    def set_option(self, name: str, value: Any):
+        """Same names and values as UCI setoption"""
+        if isinstance(value, bool):
+            value = 'true' if value else 'false'
+        rc = self.lib.sf_set_option(self.engine, name.encode('utf-8'), str(value).encode('utf-8'))
+        if rc != SF_OK:
+            raise ValueError(f"Unknown Stockfish option: {name}")
+        if name == "UCI_Chess960":
+            self._chess960 = str(value) == 'true'
+
+    def search(self, fen: str, depth: int = 0, movetime: int = 0, nodes: int = 0,
+               wtime: int = 0, btime: int = 0, winc: int = 0, binc: int = 0,
+               movestogo: int = 0) -> Dict[str, Any]:
+        """Run one blocking search and return the result as a dict"""
+        limits = SearchLimits(depth, nodes, movetime, wtime, btime, winc, binc, movestogo)
+        start = lambda: self.lib.sf_search(self.engine, fen.encode('utf-8'), ctypes.byref(limits),
+                                           self._callback, None)
+        return self._run(start, f"Invalid FEN: {fen}")
+
+    def search_game(self, game: NativeGame, depth: int = 0, movetime: int = 0, nodes: int = 0,
+                    wtime: int = 0, btime: int = 0, winc: int = 0, binc: int = 0,
+                    movestogo: int = 0) -> Dict[str, Any]:
+        """As search(), from the current position of game, with its history"""
+        limits = SearchLimits(depth, nodes, movetime, wtime, btime, winc, binc, movestogo)
+        start = lambda: self.lib.sf_search_game(self.engine, game.game, ctypes.byref(limits),
+                                                self._callback, None)
+        return self._run(start, "Closed game")
+
+    def ponder_game(self, game: NativeGame, depth: int = 0, movetime: int = 0, nodes: int = 0,
+                    wtime: int = 0, btime: int = 0, winc: int = 0, binc: int = 0,
+                    movestogo: int = 0) -> bool:
+        """
+        Think on the opponent's time: game ends with the reply the last search
+        predicted, the limits are those of the coming move. Returns at once;
+        ponderhit() or stop_ponder() must follow, and game must not change
+        until then. The search gives way to every other search of the process.
+        """
+        limits = SearchLimits(depth, nodes, movetime, wtime, btime, winc, binc, movestogo)
+        with self._lock:
+            self._end_ponder()
+            self._done.clear()
+            rc = self.lib.sf_ponder_game(self.engine, game.game, ctypes.byref(limits),
+                                         self._callback, None)
+            self.pondering = rc == SF_OK
+            return self.pondering
+
+    def ponderhit(self) -> Dict[str, Any]:
+        """The predicted reply was played: the result of the ponder search"""
+        with self._lock:
+            if not self.pondering:
+                raise RuntimeError("Not pondering")
+            self.lib.sf_ponderhit(self.engine)
+            self._done.wait()
+            self.lib.sf_wait(self.engine)
+            self.pondering = False
+            return self._result
+
+    def stop_ponder(self):
+        """Another reply was played: drop the ponder search"""
+        with self._lock:
+            self._end_ponder()
+
+    def _end_ponder(self):
+        if self.pondering:
+            self.lib.sf_stop(self.engine)
+            self._done.wait()
+            self.lib.sf_wait(self.engine)
+            self.pondering = False
+
+    def _run(self, start: Callable[[], int], error: str) -> Dict[str, Any]:
+        with self._lock:
+            self._end_ponder()
+            self._done.clear()
+            rc = start()
+            if rc == SF_ERR_NO_NET:
+                # Same fallback the UCI binary leaves to the user: classical eval
+                print("Warning: NNUE network not found, using classical evaluation")
+                self.set_option("Use NNUE", False)
+                rc = start()
+            if rc != SF_OK:
+                raise ValueError(error)
+
+            self._done.wait()
+            self.lib.sf_wait(self.engine)
+            return self._result
+
+    def get_best_move(self, fen: str, depth: int = 15) -> Optional[str]:
+        """Best move in UCI notation, None when the side to move has no move"""
+        move = self.search(fen, depth=depth)['bestmove']
+        return None if move == '0000' else move
+
+    def get_best_move_game(self, game: NativeGame, depth: int = 15) -> Optional[str]:
+        move = self.search_game(game, depth=depth)['bestmove']
+        return None if move == '0000' else move
+
+    def evaluate_game(self, fen: str, moves: List[str]) -> List[int]:
+        """
+        Static NNUE evaluation of fen and of the position after each move, in
+        centipawns for the side to move: one call for a whole post-game report
+        """
+        scores = (ctypes.c_int * (len(moves) + 1))()
+        n = self.lib.sf_evaluate_game(self.engine, fen.encode('utf-8'), " ".join(moves).encode('utf-8'),
+                                      scores, len(scores))
+        if n == SF_ERR_NO_NET:
+            raise RuntimeError("evaluate_game needs the NNUE network")
+        if n < 0:
+            raise ValueError(f"Invalid FEN or illegal move: {fen} {moves}")
+        return list(scores[:n])
+
+    def analyse_game(self, game: str, depth: int = 12, movetime: int = 0, nodes: int = 0,
+                     threads: int = 0, callback: Optional[Callable[[Dict[str, Any]], None]] = None
+                     ) -> List[Dict[str, Any]]:
+        """
+        Report on every move of a finished game, PGN or UCI moves, optionally
+        after "fen <fen> moves": the best move, both scores for the mover, the
+        centipawns and expected score (per mille) lost, and a judgement from
+        'good' to 'blunder'. The positions are searched last first on 'threads'
+        engines sharing one hash table, 0 for one per core. callback gets each
+        move as it is done, on an engine thread; the list is in game order.
+        """
+        plies = []
+
+        def on_ply(ptr, _user):
+            r = ptr.contents
+            ply = {
+                'ply': r.ply,
+                'move': r.move.decode('ascii'),
+                'best': r.best.decode('ascii'),
+                'score_cp': None if r.score_mate else r.score_cp,
+                'score_mate': r.score_mate or None,
+                'played_cp': None if r.played_mate else r.played_cp,
+                'played_mate': r.played_mate or None,
+                'cp_loss': r.cp_loss,
+                'loss': r.loss,
+                'judgement': JUDGEMENTS[r.judgement],
+                'depth': r.depth,
+                'nodes': r.nodes
+            }
+            plies.append(ply)
+            if callback:
+                callback(ply)
+
+        limits = SearchLimits(depth, nodes, movetime, 0, 0, 0, 0, 0)
+        n = self.lib.sf_analyse_game(self.engine, game.encode('utf-8'), ctypes.byref(limits),
+                                     threads or os.cpu_count() or 1, PLY_CALLBACK(on_ply), None)
+        if n == SF_ERR_NO_NET:
+            raise RuntimeError("NNUE network not found")
+        if n < 0:
+            raise ValueError(f"Invalid game: {game}")
+        return sorted(plies, key=lambda p: p['ply'])
+
+    def save_hash(self, path: str) -> bool:
+        """Snapshot the hash table to a file, for a warm start later"""
+        return self.lib.sf_save_tt(self.engine, path.encode('utf-8')) == SF_OK
+
+    def load_hash(self, path: str) -> bool:
+        """Replace the hash table with a snapshot from save_hash()"""
+        return self.lib.sf_load_tt(self.engine, path.encode('utf-8')) == SF_OK
+
+    def stats(self) -> Dict[str, Any]:
+        """
+        Counters of the engine's threads since the last reset_stats(): TT and
+        table hits, NNUE refreshes, qsearch nodes, cutoffs per move picker
+        stage and idle time, as the UCI 'stats json' command prints them
+        """
+        buf = ctypes.create_string_buffer(4096)
+        if self.lib.sf_stats(self.engine, buf, len(buf)) != SF_OK:
+            raise RuntimeError("Engine statistics do not fit the buffer")
+        return json.loads(buf.value.decode('ascii'))
+
+    def reset_stats(self):
+        self.lib.sf_reset_stats(self.engine)
+
+    def stop(self):
+        self.lib.sf_stop(self.engine)
+
+    def new_game(self):
+        self.lib.sf_new_game(self.engine)
+
+    def close(self):
+        if self.engine:
+            self.lib.sf_stop(self.engine)
+            self.lib.sf_engine_free(self.engine)
+            self.engine = None
+
+    def __del__(self):
+        try:
+            self.close()
+        except Exception:
+            pass
+
+
+class _PoolWorker:
+    """An engine of the pool and whose games it has been thinking about"""
+
+    def __init__(self, engine: NativeStockfish):
+        self.engine = engine
+        self.key = None          # Game of the last search, its hash is warm
+        self.busy = False
+        self.checked = time.monotonic()
+
+
+class EnginePool:
+    """
+    A fixed number of warm engines that the games take turns on, instead of
+    one engine for everything or a cold one per game. A game gets the engine
+    it used last when it is free, so its hash table and its ponder search
+    carry over; otherwise the engine idle the longest, pondering ones last.
+    With every engine busy the callers queue. A background check runs a
+    depth 1 search on idle engines and replaces those that fail or hang.
+    """
+
+    HEALTH_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+    SAMPLES = 1024  # Latency samples kept for the percentiles
+
+    def __init__(self, size: int = 0, threads: int = 1, hash_mb: int = 16,
+                 options: Optional[Dict[str, Any]] = None, library_path: str = None,
+                 health_interval: float = 30.0, health_timeout: float = 5.0):
+        self._make = lambda: NativeStockfish(library_path, threads, hash_mb, options)
+        size = size or max(1, (os.cpu_count() or 1) // max(1, threads))
+
+        self._cond = threading.Condition()
+        self._workers = [_PoolWorker(self._make()) for _ in range(size)]
+        self._idle: List[_PoolWorker] = list(self._workers)  # Least recently used first
+        self._by_engine = {id(w.engine): w for w in self._workers}
+        self._closed = False
+
+        self._waiting = 0
+        self._counters = dict(acquired=0, warm=0, stolen_ponders=0, timeouts=0, replaced=0, max_queued=0)
+        self._wait_ms = deque(maxlen=self.SAMPLES)
+        self._busy_ms = deque(maxlen=self.SAMPLES)
+        self._taken: Dict[int, float] = {}
+
+        self._health_interval = health_interval
+        self._health_timeout = health_timeout
+        self._checker = None
+        if health_interval > 0:
+            self._checker = threading.Thread(target=self._health_loop, daemon=True)
+            self._checker.start()
+
+    def acquire(self, key: Any = None, timeout: Optional[float] = None) -> NativeStockfish:
+        """
+        An engine for the game 'key', for its caller alone until release().
+        Raises TimeoutError when none got free within timeout seconds.
+        """
+        start = time.monotonic()
+
+        with self._cond:
+            self._waiting += 1
+            self._counters['max_queued'] = max(self._counters['max_queued'], self._waiting)
+            try:
+                while not self._idle:
+                    if self._closed:
+                        raise RuntimeError("Engine pool is closed")
+                    left = None if timeout is None else start + timeout - time.monotonic()
+                    if left is not None and left <= 0:
+                        self._counters['timeouts'] += 1
+                        raise TimeoutError("No engine got free in time")
+                    self._cond.wait(left)
+            finally:
+                self._waiting -= 1
+
+            worker = self._pick(key)
+            self._idle.remove(worker)
+            worker.busy = True
+            self._counters['acquired'] += 1
+            self._counters['warm'] += key is not None and worker.key == key
+            now = time.monotonic()
+            self._wait_ms.append((now - start) * 1000)
+            self._taken[id(worker.engine)] = now
+
+        # Outside the lock, stopping a search takes a while
+        if worker.key != key:
+            if worker.engine.pondering:
+                self._counters['stolen_ponders'] += 1
+            worker.engine.stop_ponder()
+            worker.engine.new_game()
+            worker.key = key
+        return worker.engine
+
+    def _pick(self, key: Any) -> _PoolWorker:
+        for w in self._idle:
+            if key is not None and w.key == key:
+                return w
+        for w in self._idle:
+            if not w.engine.pondering:
+                return w
+        return self._idle[0]
+
+    def release(self, engine: NativeStockfish, healthy: bool = True):
+        """
+        Give the engine back; it may go on pondering for its game. An engine
+        left unhealthy, by an unexpected error, is replaced by a new one.
+        """
+        with self._cond:
+            worker = self._by_engine[id(engine)]
+            self._busy_ms.append((time.monotonic() - self._taken.pop(id(engine))) * 1000)
+        if not healthy:
+            self._replace(worker)
+        with self._cond:
+            worker.busy = False
+            self._idle.append(worker)
+            self._cond.notify()
+
+    @contextmanager
+    def engine(self, key: Any = None, timeout: Optional[float] = None):
+        """with pool.engine(game_id) as engine: ... acquires and releases"""
+        engine = self.acquire(key, timeout)
+        healthy = True
+        try:
+            yield engine
+        except ValueError:
+            raise  # A bad FEN or move, the engine is fine
+        except Exception:
+            healthy = False
+            raise
+        finally:
+            self.release(engine, healthy)
+
+    def search(self, fen: str, key: Any = None, timeout: Optional[float] = None, **limits) -> Dict[str, Any]:
+        """NativeStockfish.search() on a pooled engine"""
+        with self.engine(key, timeout) as engine:
+            return engine.search(fen, **limits)
+
+    def forget(self, key: Any):
+        """The game 'key' ended: its engine stops pondering for it"""
+        with self._cond:
+            workers = [w for w in self._idle if w.key == key]
+            for w in workers:
+                self._idle.remove(w)
+                w.busy = True
+        for w in workers:
+            w.engine.stop_ponder()
+            with self._cond:
+                w.key = None
+                w.busy = False
+                self._idle.insert(0, w)
+                self._cond.notify()
+
+    def _replace(self, worker: _PoolWorker):
+        """
+        Give a busy worker a new engine. Called without the lock: making an
+        engine loads the net and allocates the hash.
+        """
+        # The old engine may still be searching, stop it and let it go
+        old = worker.engine
+        old.stop()
+        engine = self._make()
+        with self._cond:
+            del self._by_engine[id(old)]
+            worker.engine = engine
+            worker.key = None
+            worker.checked = time.monotonic()
+            self._by_engine[id(engine)] = worker
+            self._counters['replaced'] += 1
+            closed = self._closed
+        if closed:
+            engine.close()  # close() went before the swap
+
+    def _health_loop(self):
+        while True:
+            time.sleep(self._health_interval)
+
+            with self._cond:
+                if self._closed:
+                    return
+                due = [w for w in self._idle
+                       if not w.engine.pondering and time.monotonic() - w.checked >= self._health_interval]
+                for w in due:
+                    self._idle.remove(w)
+                    w.busy = True
+
+            for w in due:
+                if not self._probe(w.engine):
+                    self._replace(w)
+                with self._cond:
+                    w.checked = time.monotonic()
+                    w.busy = False
+                    self._idle.insert(0, w)
+                    self._cond.notify()
+
+    def _probe(self, engine: NativeStockfish) -> bool:
+        result = {}
+
+        def run():
+            try:
+                result['move'] = engine.search(self.HEALTH_FEN, depth=1)['bestmove']
+            except Exception:
+                pass
+
+        t = threading.Thread(target=run, daemon=True)
+        t.start()
+        t.join(self._health_timeout)
+        return not t.is_alive() and result.get('move', '0000') != '0000'
+
+    def metrics(self) -> Dict[str, Any]:
+        """
+        Queue depth, counters and latencies in milliseconds: 'wait' is the time
+        to get an engine, 'busy' how long callers kept it
+        """
+        def summary(samples):
+            s = sorted(samples)
+            if not s:
+                return {'count': 0}
+            return {'count': len(s), 'avg': sum(s) / len(s), 'p50': s[len(s) // 2],
+                    'p95': s[min(len(s) - 1, len(s) * 95 // 100)], 'max': s[-1]}
+
+        with self._cond:
+            return dict(self._counters,
+                        size=len(self._workers),
+                        idle=len(self._idle),
+                        pondering=sum(w.engine.pondering for w in self._idle),
+                        queued=self._waiting,
+                        wait_ms=summary(self._wait_ms),
+                        busy_ms=summary(self._busy_ms))
+
+    def close(self):
+        with self._cond:
+            self._closed = True
+            self._cond.notify_all()
+            workers = list(self._workers)
+        for w in workers:
+            w.engine.close()
+
+
+class NativeScheduler:
+    """
+    Many searches at once, one per core, for serving many AI games: each job
+    gets a single threaded engine of its own instead of all threads going to
+    one search. Jobs start by priority, then by earliest deadline, and a
+    deadline also caps the search time including the time spent queued.
+    With cpu_budget (cores for all searches of the process), clock based jobs
+    think less while the queue is long instead of every game waiting longer.
+    """
+
+    def __init__(self, library_path: str = None, workers: int = 0, hash_mb: int = 16,
+                 options: Optional[Dict[str, Any]] = None, cpu_budget: int = 0,
+                 preempt_priority: Optional[int] = None):
+        if library_path is None:
+            library_path = _default_library_path()
+
+        if not os.path.exists(library_path):
+            raise FileNotFoundError(f"Shared library not found: {library_path}")
+
+        self.lib = ctypes.CDLL(library_path)
+        self._setup_function_signatures()
+
+        self.lib.sf_init(library_path.encode('utf-8'))
+        self.scheduler = self.lib.sf_scheduler_new(workers)
+
+        # Job id -> callback; the C side only carries the id through 'user'
+        self._lock = threading.Lock()
+        self._jobs: Dict[int, Callable[[Dict[str, Any]], None]] = {}
+        self._native: Dict[int, int] = {}  # Job id -> the scheduler's id, to cancel by
+        self._next_id = 1
+        self._callback = SEARCH_CALLBACK(self._on_result)
+
+        self.set_option("Hash", hash_mb)
+        self.set_option("CPU Budget", cpu_budget)
+        for name, value in (options or {}).items():
+            self.set_option(name, value)
+        if preempt_priority is not None:
+            self.set_preempt_priority(preempt_priority)
+
+    def _setup_function_signatures(self):
+        """Define C function signatures for type safety"""
+        self.lib.sf_init.argtypes = [ctypes.c_char_p]
+        self.lib.sf_init.restype = ctypes.c_int
+
+        self.lib.sf_scheduler_new.argtypes = [ctypes.c_int]
+        self.lib.sf_scheduler_new.restype = ctypes.c_void_p
+        self.lib.sf_scheduler_free.argtypes = [ctypes.c_void_p]
+        self.lib.sf_scheduler_free.restype = None
+
+        self.lib.sf_scheduler_set_option.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+        self.lib.sf_scheduler_set_option.restype = ctypes.c_int
+
+        self.lib.sf_scheduler_submit.argtypes = [
+            ctypes.c_void_p,                 # scheduler
+            ctypes.c_char_p,                 # fen
+            ctypes.POINTER(SearchLimits),    # limits
+            ctypes.c_int,                    # priority
+            ctypes.c_int,                    # deadline_ms
+            SEARCH_CALLBACK,                 # callback
+            ctypes.c_void_p                  # user
+        ]
+        self.lib.sf_scheduler_submit.restype = ctypes.c_int64
+
+        self.lib.sf_scheduler_cancel.argtypes = [ctypes.c_void_p, ctypes.c_int64]
+        self.lib.sf_scheduler_cancel.restype = ctypes.c_int
+        self.lib.sf_scheduler_set_preempt_priority.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self.lib.sf_scheduler_set_preempt_priority.restype = None
+
+        self.lib.sf_scheduler_pending.argtypes = [ctypes.c_void_p]
+        self.lib.sf_scheduler_pending.restype = ctypes.c_int
+
+    def _on_result(self, result_ptr, user):
+        with self._lock:
+            callback = self._jobs.pop(user, None)
+            self._native.pop(user, None)
+        if callback:
+            callback(_result_to_dict(result_ptr.contents))
+
+    def set_option(self, name: str, value: Any):
+        """Applies to every worker, after the running searches end"""
+        if isinstance(value, bool):
+            value = 'true' if value else 'false'
+        rc = self.lib.sf_scheduler_set_option(self.scheduler, name.encode('utf-8'),
+                                              str(value).encode('utf-8'))
+        if rc != SF_OK:
+            raise ValueError(f"Unknown Stockfish option: {name}")
+
+    def submit(self, fen: str, callback: Callable[[Dict[str, Any]], None],
+               priority: int = 0, deadline_ms: int = 0, depth: int = 0,
+               movetime: int = 0, nodes: int = 0, wtime: int = 0, btime: int = 0,
+               winc: int = 0, binc: int = 0, movestogo: int = 0) -> int:
+        """
+        Queue a search and return its job id at once. The callback gets the
+        result dict on an engine thread, so it should hand the work off and
+        return.
+        """
+        limits = SearchLimits(depth, nodes, movetime, wtime, btime, winc, binc, movestogo)
+
+        with self._lock:
+            job_id = self._next_id
+            self._next_id += 1
+            self._jobs[job_id] = callback
+
+        rc = self.lib.sf_scheduler_submit(self.scheduler, fen.encode('utf-8'), ctypes.byref(limits),
+                                          priority, deadline_ms, self._callback, job_id)
+        if rc == SF_ERR_NO_NET:
+            print("Warning: NNUE network not found, using classical evaluation")
+            self.set_option("Use NNUE", False)
+            rc = self.lib.sf_scheduler_submit(self.scheduler, fen.encode('utf-8'), ctypes.byref(limits),
+                                              priority, deadline_ms, self._callback, job_id)
+        if rc < 0:
+            with self._lock:
+                self._jobs.pop(job_id, None)
+            raise ValueError(f"Invalid FEN: {fen}")
+
+        with self._lock:
+            if job_id in self._jobs:  # Unless it is already done
+                self._native[job_id] = rc
+        return job_id
+
+    def cancel(self, job_id: int) -> bool:
+        """
+        Drop a queued job, its callback then never runs, or stop a running one,
+        which calls back with the best move so far. False if it already ended.
+        """
+        with self._lock:
+            native = self._native.get(job_id)
+        if native is None:
+            return False
+
+        rc = self.lib.sf_scheduler_cancel(self.scheduler, native)
+        if rc == 1:
+            with self._lock:
+                self._jobs.pop(job_id, None)
+                self._native.pop(job_id, None)
+        return rc >= 0
+
+    def set_preempt_priority(self, priority: Optional[int]):
+        """
+        With every engine busy, jobs of at least this priority suspend the
+        lowest priority running job instead of waiting; None turns it off.
+        """
+        self.lib.sf_scheduler_set_preempt_priority(
+            self.scheduler, 2**31 - 1 if priority is None else priority)
+
+    def pending(self) -> int:
+        """Jobs still waiting for a free engine"""
+        return self.lib.sf_scheduler_pending(self.scheduler)
+
+    def close(self):
+        if self.scheduler:
+            self.lib.sf_scheduler_free(self.scheduler)
+            self.scheduler = None
+
+    def __del__(self):
+        try:
+            self.close()
+        except Exception:
+            pass
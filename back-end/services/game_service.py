@@ -2,12 +2,37 @@
 Game Service
 Xử lý business logic liên quan đến Game
 """
+from collections import OrderedDict
 from datetime import datetime
 from database import get_db_connection
 from models.game import Game
 from bson import ObjectId
 import chess
 
+# Moves are validated natively by libstockfish.so when it is built (make lib),
+# python-chess is the fallback
+try:
+    from native_engine import MoveValidator
+    _native_validator = MoveValidator()
+except Exception:
+    _native_validator = None
+
+# Finished games also go to the native game store (tcp_server/game_store.c),
+# which answers history pages and W/L/D counts without a query
+try:
+    from config import GAME_STORE_PATH
+    from game_store import GameStore
+    _game_store = GameStore(GAME_STORE_PATH)
+except Exception:
+    _game_store = None
+_game_store_filled = False
+
+# History pages and stats per user_id, dropped when one of their games ends.
+# Least recently used users go first, and each keeps its newest pages only.
+USER_CACHE_SIZE = 4096
+USER_CACHE_PAGES = 4
+_user_cache = OrderedDict()
+
 
 def create_game(game_id, white_player_id, black_player_id, 
                 white_username, black_username, time_control=None,
@@ -81,7 +106,7 @@ def get_game(game_id):
         return None
 
 
-def update_game_state(game_id, move, fen):
+def update_game_state(game_id, move, fen, clock_ms=None):
     """
     Cập nhật trạng thái game sau một nước đi
     
@@ -89,6 +114,7 @@ def update_game_state(game_id, move, fen):
         game_id (str): ID của game
         move (str): Nước đi (UCI format)
         fen (str): FEN string mới
+        clock_ms (int): Thời gian còn lại của người vừa đi (ms), nếu có đồng hồ
         
     Returns:
         dict: {'success': bool, 'message': str}
@@ -97,10 +123,14 @@ def update_game_state(game_id, move, fen):
         db = get_db_connection()
         games_collection = db[Game.get_collection_name()]
         
+        pushed = {'moves': move}
+        if clock_ms is not None:
+            pushed['clocks'] = int(clock_ms)
+        
         result = games_collection.update_one(
             {'game_id': game_id},
             {
-                '$push': {'moves': move},
+                '$push': pushed,
                 '$set': {'fen': fen}
             }
         )
@@ -150,6 +180,14 @@ def end_game(game_id, result, status='completed'):
                 if status != 'draw':
                     update_player_elo(game, result)
             
+            # Lưu vào game store, xoá cache của hai người chơi
+            if game:
+                store = _get_game_store()
+                if store is not None:
+                    store.append(game)
+                _user_cache.pop(str(game['white_player_id']), None)
+                _user_cache.pop(str(game['black_player_id']), None)
+            
             return {'success': True, 'message': 'Game ended successfully'}
         else:
             return {'success': False, 'message': 'Game not found'}
@@ -213,65 +251,115 @@ def update_player_elo(game, result):
         pass
 
 
-def get_user_game_history(user_id, limit=10):
+def init_game_store():
+    """
+    Fill a just created game store from the games collection. Run at
+    server start, before any game can end; until then history and stats
+    are read from the database.
+    """
+    global _game_store_filled
+    if _game_store is None or _game_store_filled:
+        return
+    if _game_store.created:
+        db = get_db_connection()
+        games_collection = db[Game.get_collection_name()]
+        for game_doc in games_collection.find({'status': {'$ne': 'active'}}).sort('end_time', 1):
+            _game_store.append(game_doc)
+    _game_store_filled = True
+
+
+def _get_game_store():
+    """The game store once init_game_store() ran, else None"""
+    return _game_store if _game_store_filled else None
+
+
+def _user_entry(user_id):
+    """The cache entry of a user, made most recently used"""
+    key = str(user_id)
+    entry = _user_cache.get(key)
+    if entry is None:
+        entry = _user_cache[key] = {'stats': None, 'history': OrderedDict()}
+        if len(_user_cache) > USER_CACHE_SIZE:
+            _user_cache.popitem(last=False)
+    else:
+        _user_cache.move_to_end(key)
+    return entry
+
+
+def _history_entry(game_doc, user_id, moves_count):
+    # Determine if user won, lost or drew
+    game_result = game_doc['result']
+    user_is_white = str(game_doc['white_player_id']) == str(user_id)
+    
+    # Convert result to user perspective
+    if game_result == 'white_win':
+        user_result = 'win' if user_is_white else 'loss'
+    elif game_result == 'black_win':
+        user_result = 'win' if not user_is_white else 'loss'
+    elif game_result == 'draw':
+        user_result = 'draw'
+    else:
+        user_result = 'in_progress'
+    
+    # Convert the start time to string, the games have no created_at
+    created_at = game_doc.get('start_time')
+    created_at_str = created_at.strftime('%Y-%m-%d %H:%M:%S') if created_at else 'N/A'
+    
+    return {
+        'game_id': game_doc['game_id'],
+        'opponent': game_doc['black_username'] if user_is_white else game_doc['white_username'],
+        'result': game_result,  # Original result
+        'user_result': user_result,  # User's perspective
+        'my_color': 'white' if user_is_white else 'black',
+        'date': game_doc['end_time'].strftime('%Y-%m-%d %H:%M') if game_doc.get('end_time') else 'N/A',
+        'created_at': created_at_str,
+        'moves_count': moves_count,
+        'is_ai_game': game_doc.get('is_ai_game', False),
+        'white_username': game_doc['white_username'],
+        'black_username': game_doc['black_username']
+    }
+
+
+def get_user_game_history(user_id, limit=10, offset=0):
     """
     Lấy lịch sử game của user
     
     Args:
         user_id: ID của user
         limit (int): Số lượng game tối đa
+        offset (int): Bỏ qua bao nhiêu game mới nhất (phân trang)
         
     Returns:
         list: Danh sách games
     """
+    pages = _user_entry(user_id)['history']
+    if (limit, offset) in pages:
+        return pages[(limit, offset)]
+    
     try:
-        db = get_db_connection()
-        games_collection = db[Game.get_collection_name()]
-        
-        games = games_collection.find(
-            {
-                '$or': [
-                    {'white_player_id': user_id},
-                    {'black_player_id': user_id}
-                ],
-                'status': {'$ne': 'active'}
-            }
-        ).sort('end_time', -1).limit(limit)
-        
-        result = []
-        for game_doc in games:
-            # Determine if user won, lost or drew
-            game_result = game_doc['result']
-            user_is_white = game_doc['white_player_id'] == user_id
-            
-            # Convert result to user perspective
-            if game_result == 'white_win':
-                user_result = 'win' if user_is_white else 'loss'
-            elif game_result == 'black_win':
-                user_result = 'win' if not user_is_white else 'loss'
-            elif game_result == 'draw':
-                user_result = 'draw'
-            else:
-                user_result = 'in_progress'
+        store = _get_game_store()
+        if store is not None:
+            result = [_history_entry(game, user_id, game['moves_count'])
+                      for game in store.history(user_id, offset, limit)]
+        else:
+            db = get_db_connection()
+            games_collection = db[Game.get_collection_name()]
             
-            # Convert created_at datetime to string
-            created_at = game_doc.get('created_at', game_doc.get('end_time'))
-            created_at_str = created_at.strftime('%Y-%m-%d %H:%M:%S') if created_at else 'N/A'
+            games = games_collection.find(
+                {
+                    '$or': [
+                        {'white_player_id': user_id},
+                        {'black_player_id': user_id}
+                    ],
+                    'status': {'$ne': 'active'}
+                }
+            ).sort('end_time', -1).skip(offset).limit(limit)
             
-            result.append({
-                'game_id': game_doc['game_id'],
-                'opponent': game_doc['black_username'] if user_is_white else game_doc['white_username'],
-                'result': game_result,  # Original result
-                'user_result': user_result,  # User's perspective
-                'my_color': 'white' if user_is_white else 'black',
-                'date': game_doc['end_time'].strftime('%Y-%m-%d %H:%M') if game_doc.get('end_time') else 'N/A',
-                'created_at': created_at_str,
-                'moves_count': len(game_doc['moves']),
-                'is_ai_game': game_doc.get('is_ai_game', False),
-                'white_username': game_doc['white_username'],
-                'black_username': game_doc['black_username']
-            })
+            result = [_history_entry(game_doc, user_id, len(game_doc['moves'])) for game_doc in games]
         
+        pages[(limit, offset)] = result
+        if len(pages) > USER_CACHE_PAGES:
+            pages.popitem(last=False)
         return result
     
     except Exception as e:
@@ -288,6 +376,10 @@ def get_user_stats(user_id):
     Returns:
         dict: Thống kê
     """
+    cache = _user_entry(user_id)
+    if cache['stats'] is not None:
+        return cache['stats']
+    
     try:
         db = get_db_connection()
         games_collection = db[Game.get_collection_name()]
@@ -298,31 +390,37 @@ def get_user_stats(user_id):
             return None
         
         # Đếm số trận thắng, thua, hòa
-        wins = games_collection.count_documents({
-            '$or': [
-                {'white_player_id': user_id, 'result': 'white_win'},
-                {'black_player_id': user_id, 'result': 'black_win'}
-            ]
-        })
-        
-        losses = games_collection.count_documents({
-            '$or': [
-                {'white_player_id': user_id, 'result': 'black_win'},
-                {'black_player_id': user_id, 'result': 'white_win'}
-            ]
-        })
-        
-        draws = games_collection.count_documents({
-            '$or': [
-                {'white_player_id': user_id, 'result': 'draw'},
-                {'black_player_id': user_id, 'result': 'draw'}
-            ]
-        })
+        store = _get_game_store()
+        if store is not None:
+            counts = store.stats(user_id)
+            wins, losses, draws = counts['wins'], counts['losses'], counts['draws']
+        else:
+            wins = games_collection.count_documents({
+                '$or': [
+                    {'white_player_id': user_id, 'result': 'white_win'},
+                    {'black_player_id': user_id, 'result': 'black_win'}
+                ]
+            })
+            
+            losses = games_collection.count_documents({
+                '$or': [
+                    {'white_player_id': user_id, 'result': 'black_win'},
+                    {'black_player_id': user_id, 'result': 'white_win'}
+                ]
+            })
+            
+            draws = games_collection.count_documents({
+                '$or': [
+                    {'white_player_id': user_id, 'result': 'draw'},
+                    {'black_player_id': user_id, 'result': 'draw'}
+                ]
+            })
         
         total_games = wins + losses + draws
         win_rate = (wins / total_games * 100) if total_games > 0 else 0
         
-        return {
+        # ELO cũng chỉ đổi khi một ván kết thúc
+        cache['stats'] = {
             'user_id': str(user['_id']),
             'username': user['username'],
             'fullname': user['fullname'],
@@ -333,6 +431,7 @@ def get_user_stats(user_id):
             'total_games': total_games,
             'win_rate': round(win_rate, 2)
         }
+        return cache['stats']
     
     except Exception as e:
         return None
@@ -354,6 +453,9 @@ def validate_move(game_id, move):
         if not game:
             return {'valid': False, 'reason': 'Game not found'}
         
+        if _native_validator is not None:
+            return _validate_move_native(game['fen'], move)
+
         board = chess.Board(game['fen'])
         
         try:
@@ -394,6 +496,39 @@ def validate_move(game_id, move):
         return {'valid': False, 'reason': str(e)}
 
 
+def _validate_move_native(fen, move):
+    """
+    validate_move() through the native validator, with the same result. As
+    with python-chess, only checkmate, stalemate and dead positions end the
+    game; repetitions and the fifty move rule are left to a draw claim.
+    """
+    try:
+        check = _native_validator.validate(fen, move)
+    except ValueError as e:
+        return {'valid': False, 'reason': str(e)}
+
+    if not check['legal']:
+        return {'valid': False, 'reason': 'Illegal move'}
+
+    status = check['status']
+    game_over = status in ('checkmate', 'stalemate', 'dead_position')
+    result = 'ongoing'
+
+    if status == 'checkmate':
+        # The side to move after the move is the one checkmated
+        result = 'black_win' if check['fen'].split()[1] == 'w' else 'white_win'
+    elif game_over:
+        result = 'draw'
+
+    return {
+        'valid': True,
+        'fen': check['fen'],
+        'game_over': game_over,
+        'result': result,
+        'in_check': check['in_check']
+    }
+
+
 def get_game_pgn(game_id):
     """
     Tạo PGN string cho game
@@ -0,0 +1,424 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include "analysis.h"
+#include "movegen.h"
+#include "uci.h"
+
+namespace Stockfish::Analysis {
+
+namespace {
+
+  const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+  // Expected score losses, per mille, from which a move is an inaccuracy, a
+  // mistake or a blunder: 10, 20 and 30 percent, as most game reports use
+  constexpr int JudgementLoss[JUDGEMENT_NB] = { 0, 100, 200, 300 };
+
+  // The per-engine options an analysis engine takes over from the caller's,
+  // the others are either process-wide or not used by a fixed depth search
+  const char* Inherited[] = { "UCI_Chess960", "SyzygyProbeDepth", "Syzygy50MoveRule", "SyzygyProbeLimit" };
+
+  struct Result {
+    bool done = false;
+    Move best = MOVE_NONE;
+    Value score = VALUE_ZERO;
+    Depth depth = 0;
+    uint64_t nodes = 0;
+  };
+
+  int expected_score(Value v, int ply) {
+    return (1000 + UCI::win_rate(v, ply) - UCI::win_rate(-v, ply)) / 2;
+  }
+
+  int centipawns(Value v) {
+    return std::clamp(100 * v / PawnValueEg, -1000, 1000);
+  }
+
+  // skip_pgn_noise() drops what PGN movetext has besides the moves: tags but
+  // the FEN one, comments, variations, move numbers, NAGs and the result
+
+  std::string skip_pgn_noise(const std::string& text, std::string& fen) {
+
+    std::string out;
+    int variation = 0;
+
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char c = text[i];
+
+        if (c == '{')
+            i = std::min(text.find('}', i), text.size());
+        else if (c == ';')
+            i = std::min(text.find('\n', i), text.size());
+        else if (c == '(')
+            ++variation;
+        else if (c == ')')
+            variation = std::max(variation - 1, 0);
+        else if (c == '[')
+        {
+            size_t end = std::min(text.find(']', i), text.size());
+            std::string tag = text.substr(i + 1, end - i - 1);
+            size_t q = tag.find('"');
+
+            if (tag.compare(0, 4, "FEN ") == 0 && q != std::string::npos)
+                fen = tag.substr(q + 1, tag.rfind('"') - q - 1);
+            i = end;
+        }
+        else if (!variation)
+            out += c;
+    }
+
+    std::istringstream is(out);
+    std::string token;
+    out.clear();
+
+    while (is >> token)
+    {
+        // Move numbers may stick to their move: "12.e4" or "12...e5"
+        size_t dot = token.find_last_of('.');
+        if (dot != std::string::npos && isdigit(token[0]))
+            token.erase(0, dot + 1);
+
+        if (   token.empty() || token[0] == '$' || token == "*"
+            || token == "1-0" || token == "0-1" || token == "1/2-1/2")
+            continue;
+
+        out += token + " ";
+    }
+
+    return out;
+  }
+
+} // namespace
+
+
+/// Analysis::from_san() converts a move in Standard Algebraic Notation, with
+/// or without capture, check and annotation marks, to the legal move it names
+/// in 'pos'. Returns MOVE_NONE when there is none or more than one.
+
+Move from_san(const Position& pos, std::string san) {
+
+  while (!san.empty() && std::string("+#!?").find(san.back()) != std::string::npos)
+      san.pop_back();
+
+  if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0")
+  {
+      bool kingSide = san.size() == 3;
+      for (const auto& m : MoveList<LEGAL>(pos))
+          if (type_of(m) == CASTLING && (to_sq(m) > from_sq(m)) == kingSide)
+              return m;
+      return MOVE_NONE;
+  }
+
+  PieceType pt = PAWN, promotion = NO_PIECE_TYPE;
+  size_t p = std::string("PNBRQK").find(san.empty() ? ' ' : san[0]);
+  if (p != std::string::npos)
+  {
+      pt = PieceType(PAWN + p);
+      san.erase(0, 1);
+  }
+
+  // "e8=Q" or "e8Q"
+  size_t promo = san.size() > 2 ? std::string("NBRQ").find(san.back()) : std::string::npos;
+  if (promo != std::string::npos)
+  {
+      promotion = PieceType(KNIGHT + promo);
+      san.pop_back();
+      if (san.back() == '=')
+          san.pop_back();
+  }
+
+  if (   san.size() < 2
+      || san[san.size() - 2] < 'a' || san[san.size() - 2] > 'h'
+      || san.back() < '1' || san.back() > '8')
+      return MOVE_NONE;
+
+  Square to = make_square(File(san[san.size() - 2] - 'a'), Rank(san.back() - '1'));
+  int file = -1, rank = -1;
+
+  for (char c : san.substr(0, san.size() - 2))
+      if (c >= 'a' && c <= 'h')
+          file = c - 'a';
+      else if (c >= '1' && c <= '8')
+          rank = c - '1';
+      else if (c != 'x')
+          return MOVE_NONE;
+
+  Move found = MOVE_NONE;
+
+  for (const auto& m : MoveList<LEGAL>(pos))
+      if (   type_of(m) != CASTLING
+          && to_sq(m) == to
+          && type_of(pos.moved_piece(m)) == pt
+          && (type_of(m) == PROMOTION ? promotion_type(m) == promotion : promotion == NO_PIECE_TYPE)
+          && (file < 0 || file_of(from_sq(m)) == file)
+          && (rank < 0 || rank_of(from_sq(m)) == rank))
+      {
+          if (found != MOVE_NONE)
+              return MOVE_NONE;
+          found = m;
+      }
+
+  return found;
+}
+
+
+/// Analysis::split_game() splits a game, PGN with moves in SAN or a list of
+/// moves in UCI notation optionally after "fen <fen> moves", into its start
+/// position, which it returns, and its moves for read_moves().
+
+std::string split_game(const std::string& text, std::string& movetext) {
+
+  std::istringstream is(text);
+  std::string token, fen = StartFEN;
+
+  if (is >> token && token == "fen")
+  {
+      fen.clear();
+      while (is >> token && token != "moves")
+          fen += token + " ";
+      std::getline(is, movetext);
+  }
+  else if (token == "startpos")
+  {
+      is >> token; // "moves"
+      std::getline(is, movetext);
+  }
+  else
+      movetext = skip_pgn_noise(text, fen);
+
+  return fen;
+}
+
+
+/// Analysis::read_moves() converts the moves of split_game(), in SAN or UCI
+/// notation, playing them from 'fen' on thread 'th', which must not be
+/// searching. Returns false at the first move that is not legal.
+
+bool read_moves(const std::string& fen, const std::string& movetext, bool chess960, Thread* th,
+                std::vector<Move>& moves) {
+
+  StateListPtr states(new StateList(1));
+  Position pos;
+  pos.set(fen, chess960, &states->back(), th);
+
+  std::istringstream is(movetext);
+  std::string token;
+  moves.clear();
+
+  while (is >> token)
+  {
+      std::string san = token;
+      Move m = UCI::to_move(pos, token);
+
+      if (m == MOVE_NONE && (m = from_san(pos, san)) == MOVE_NONE)
+          return false;
+
+      moves.push_back(m);
+      states->emplace_back();
+      pos.do_move(m, states->back());
+  }
+
+  return true;
+}
+
+
+/// Analysis::analyse() searches the positions of the game with 'limits' on
+/// 'threads' engines of one thread each, the last position first, and calls
+/// 'onPly' for a move as soon as the positions before and after it are done,
+/// on an engine thread but never for two moves at once. Without a depth,
+/// nodes or time limit the searches go to depth 12. The shared hash table is
+/// as big as the "Hash" of 'engine', which must not be searching.
+
+Summary analyse(Engine& engine, const std::string& fen, const std::vector<Move>& moves,
+                const Search::LimitsType& limits, size_t threads, const Callback& onPly) {
+
+  TimePoint start = now();
+  int n = int(moves.size());
+  bool chess960 = engine.options["UCI_Chess960"];
+  std::vector<Result> results(n + 1);
+  std::vector<Ply> plies(n);
+  std::vector<int> gamePly(n + 1);
+  Color us;
+  Summary summary;
+
+  // Final positions are known without a search, the game may end in mate
+  {
+      StateListPtr states(new StateList(1));
+      Position pos;
+      pos.set(fen, chess960, &states->back(), engine.threads.main());
+      us = pos.side_to_move();
+
+      for (int i = 0; i <= n; ++i)
+      {
+          gamePly[i] = pos.game_ply();
+          if (!MoveList<LEGAL>(pos).size())
+          {
+              results[i].done = true;
+              results[i].score = pos.checkers() ? -VALUE_MATE : VALUE_DRAW;
+          }
+          if (i < n)
+          {
+              states->emplace_back();
+              pos.do_move(moves[i], states->back());
+          }
+      }
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  int next = n;
+  size_t running = 0;
+
+  auto finish = [&](int i) { // Under the mutex
+
+      for (int k = std::max(i - 1, 0); k <= std::min(i, n - 1); ++k)
+      {
+          if (!results[k].done || !results[k + 1].done)
+              continue;
+
+          Ply& p = plies[k];
+          p.ply  = k;
+          p.move = moves[k];
+          p.best = results[k].best;
+          p.score = results[k].score;
+          p.played = p.move == p.best ? p.score : -results[k + 1].score;
+          p.cpLoss = std::max(centipawns(p.score) - centipawns(p.played), 0);
+          p.loss = std::max(expected_score(p.score, gamePly[k]) - expected_score(p.played, gamePly[k]), 0);
+          p.judgement = BLUNDER;
+          while (p.judgement > GOOD && p.loss < JudgementLoss[p.judgement])
+              p.judgement = Judgement(p.judgement - 1);
+          p.depth = results[k].depth;
+          p.nodes = results[k].nodes;
+
+          if (onPly)
+              onPly(p);
+      }
+  };
+
+  size_t count = std::clamp(threads, size_t(1), size_t(TranspositionTable::MaxTenants));
+  auto table = std::make_shared<SharedTT>(size_t(engine.options["Hash"]), count);
+  std::vector<std::unique_ptr<Engine>> engines;
+  std::vector<int> current(count, -1); // Position searched, -1 when idle
+
+  for (size_t w = 0; w < count; ++w)
+  {
+      engines.emplace_back(new Engine());
+      Engine& e = *engines.back();
+
+      for (const char* name : Inherited)
+          e.options[name] = std::string(engine.options[name]);
+
+      e.options["Book Depth"] = std::string("0"); // Every position gets a real search
+      e.tt.attach(table);
+      e.uciOutput = false;
+      e.onSearchFinished = [&, w](const Thread& best) {
+
+          const Search::RootMove& rm = best.rootMoves[0];
+          std::lock_guard<std::mutex> lk(mutex);
+          Result& r = results[current[w]];
+
+          r.done  = true;
+          r.best  = rm.pv[0];
+          r.score = rm.score;
+          r.depth = best.completedDepth;
+          r.nodes = engines[w]->threads.nodes_searched();
+          summary.nodes += r.nodes;
+
+          finish(current[w]);
+          current[w] = -1;
+          --running;
+          cv.notify_one();
+      };
+  }
+
+  std::unique_lock<std::mutex> lk(mutex);
+
+  while (true)
+  {
+      while (next >= 0 && results[next].done)
+          --next;
+
+      if (next < 0 && !running)
+          break;
+
+      if (next < 0 || running == count)
+      {
+          cv.wait(lk);
+          continue;
+      }
+
+      size_t w = size_t(std::find(current.begin(), current.end(), -1) - current.begin());
+      int i = current[w] = next--;
+      ++running;
+      lk.unlock();
+
+      Engine& e = *engines[w];
+      StateListPtr states(new StateList(1));
+      Position pos;
+      pos.set(fen, chess960, &states->back(), e.threads.main());
+
+      for (int k = 0; k < i; ++k)
+      {
+          states->emplace_back();
+          pos.do_move(moves[k], states->back());
+      }
+
+      Search::LimitsType lim = limits;
+      lim.startTime = now();
+      lim.infinite = 0;
+      if (!lim.depth && !lim.nodes && !lim.movetime && !lim.use_time_management())
+          lim.depth = 12;
+
+      // The callback released the worker, its thread may still be leaving
+      e.threads.main()->wait_for_search_finished();
+      e.threads.start_thinking(pos, states, lim);
+      lk.lock();
+  }
+
+  lk.unlock();
+
+  for (auto& e : engines)
+      e->threads.main()->wait_for_search_finished();
+
+  int moveCount[COLOR_NB] = {};
+
+  for (const Ply& p : plies)
+  {
+      Color c = (p.ply & 1) ? ~us : us;
+      summary.cpLoss[c] += p.cpLoss;
+      summary.count[c][p.judgement]++;
+      moveCount[c]++;
+  }
+
+  for (Color c : { WHITE, BLACK })
+      summary.cpLoss[c] /= std::max(moveCount[c], 1);
+
+  summary.plies = n;
+  summary.time = now() - start;
+  return summary;
+}
+
+} // namespace Stockfish::Analysis
@@ -0,0 +1,69 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANALYSIS_H_INCLUDED
+#define ANALYSIS_H_INCLUDED
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+
+namespace Stockfish::Analysis {
+
+/// A game analysis searches every position of a finished game, from the last
+/// one back to the first, on single threaded engines that share one hash
+/// table: the searches of the later positions are mostly done when an earlier
+/// one needs them, so they run much shallower than on their own. Each move
+/// gets the score of the best move and of the move played, and how much it
+/// lost as expected score, judged like the usual game reports.
+
+enum Judgement { GOOD, INACCURACY, MISTAKE, BLUNDER, JUDGEMENT_NB };
+
+struct Ply {
+  int ply;             // 0 for the first move of the game
+  Move move, best;     // The move played and the engine's choice
+  Value score, played; // Both for the side to move
+  int cpLoss;          // Centipawns, scores capped at 10 pawns
+  int loss;            // Expected score, per mille
+  Judgement judgement;
+  Depth depth;
+  uint64_t nodes;
+};
+
+struct Summary {
+  int plies = 0;
+  uint64_t nodes = 0;
+  TimePoint time = 0;
+  int cpLoss[COLOR_NB] = {};  // Average per move
+  int count[COLOR_NB][JUDGEMENT_NB] = {};
+};
+
+typedef std::function<void(const Ply& ply)> Callback;
+
+std::string split_game(const std::string& text, std::string& movetext);
+bool read_moves(const std::string& fen, const std::string& movetext, bool chess960, Thread* th,
+                std::vector<Move>& moves);
+Move from_san(const Position& pos, std::string san);
+Summary analyse(Engine& engine, const std::string& fen, const std::vector<Move>& moves,
+                const Search::LimitsType& limits, size_t threads, const Callback& onPly);
+
+} // namespace Stockfish::Analysis
+
+#endif // #ifndef ANALYSIS_H_INCLUDED
@@ -17,10 +17,12 @@
 */
 
 #include <cassert>
+#include <mutex>
 #include <vector>
 #include <bitset>
 
 #include "bitboard.h"
+#include "misc.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -66,35 +68,48 @@ namespace {
     Result result;
   };
 
+  void build() {
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<KPKPosition> db(MAX_INDEX);
+    unsigned idx, repeat = 1;
+
+    // Initialize db with known win / draw positions
+    for (idx = 0; idx < MAX_INDEX; ++idx)
+        db[idx] = KPKPosition(idx);
+
+    // Iterate through the positions until none of the unknown positions can be
+    // changed to either wins or draws (15 cycles needed).
+    while (repeat)
+        for (repeat = idx = 0; idx < MAX_INDEX; ++idx)
+            repeat |= (db[idx] == UNKNOWN && db[idx].classify(db) != UNKNOWN);
+
+    // Fill the bitbase with the decisive results
+    for (idx = 0; idx < MAX_INDEX; ++idx)
+        if (db[idx] == WIN)
+            KPKBitbase.set(idx);
+
+    Startup::lazy("bitbases", std::chrono::steady_clock::now() - start);
+  }
+
 } // namespace
 
 bool Bitbases::probe(Square wksq, Square wpsq, Square bksq, Color stm) {
 
   assert(file_of(wpsq) <= FILE_D);
 
+  init();
   return KPKBitbase[index(stm, bksq, wksq, wpsq)];
 }
 
 
-void Bitbases::init() {
-
-  std::vector<KPKPosition> db(MAX_INDEX);
-  unsigned idx, repeat = 1;
+/// Bitbases::init() builds the KPK bitbase, once. It takes some 10 ms, so it
+/// is left to the first probe rather than done at startup.
 
-  // Initialize db with known win / draw positions
-  for (idx = 0; idx < MAX_INDEX; ++idx)
-      db[idx] = KPKPosition(idx);
-
-  // Iterate through the positions until none of the unknown positions can be
-  // changed to either wins or draws (15 cycles needed).
-  while (repeat)
-      for (repeat = idx = 0; idx < MAX_INDEX; ++idx)
-          repeat |= (db[idx] == UNKNOWN && db[idx].classify(db) != UNKNOWN);
+void Bitbases::init() {
 
-  // Fill the bitbase with the decisive results
-  for (idx = 0; idx < MAX_INDEX; ++idx)
-      if (db[idx] == WIN)
-          KPKBitbase.set(idx);
+  static std::once_flag built;
+  std::call_once(built, build);
 }
 
 namespace {
@@ -19,6 +19,7 @@
 #ifndef BITBOARD_H_INCLUDED
 #define BITBOARD_H_INCLUDED
 
+#include <array>
 #include <string>
 
 #include "types.h"
@@ -83,16 +84,20 @@ extern Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
 
 /// Magic holds all magic bitboards relevant data for a single square
 struct Magic {
-  Bitboard  mask;
-  Bitboard  magic;
-  Bitboard* attacks;
-  unsigned  shift;
+  Bitboard        mask;
+  Bitboard        magic;
+  const Bitboard* attacks;
+  unsigned        shift;
 
   // Compute the attack's index using the 'magic bitboards' approach
   unsigned index(Bitboard occupied) const {
 
-    if (HasPext)
-        return unsigned(pext(occupied, mask));
+    return HasPext ? unsigned(pext(occupied, mask)) : magic_index(occupied);
+  }
+
+  // The index without PEXT, usable in the constant expressions that build the
+  // attack tables
+  constexpr unsigned magic_index(Bitboard occupied) const {
 
     if (Is64Bit)
         return unsigned(((occupied & mask) * magic) >> shift);
@@ -103,8 +108,8 @@ struct Magic {
   }
 };
 
-extern Magic RookMagics[SQUARE_NB];
-extern Magic BishopMagics[SQUARE_NB];
+extern const std::array<Magic, SQUARE_NB> RookMagics;
+extern const std::array<Magic, SQUARE_NB> BishopMagics;
 
 inline Bitboard square_bb(Square s) {
   assert(is_ok(s));
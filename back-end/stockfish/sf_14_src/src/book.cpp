@@ -0,0 +1,300 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "book.h"
+#include "movegen.h"
+#include "uci.h"
+
+namespace Stockfish::Book {
+
+namespace {
+
+  constexpr size_t EntrySize = 16;
+
+  const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+  // The mapped book, replaced only by init() while no engine is searching
+  const unsigned char* Data = nullptr;
+  size_t Count = 0;
+
+#ifndef _WIN32
+  size_t MappedSize = 0;
+#else
+  std::vector<unsigned char> Buffer;
+#endif
+
+  uint64_t read_be(const unsigned char* p, int bytes) {
+
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i)
+        v = v << 8 | p[i];
+    return v;
+  }
+
+  void write_be(std::ostream& os, uint64_t v, int bytes) {
+
+    for (int i = bytes - 1; i >= 0; --i)
+        os.put(char(v >> (8 * i)));
+  }
+
+  // to_polyglot() encodes a move as Polyglot does: to square in bits 0-5, from
+  // square in bits 6-11 and promotion piece (knight = 1 ... queen = 4) above.
+  // Castling is king takes own rook in both, so no special case for it.
+
+  uint16_t to_polyglot(Move m) {
+
+    uint16_t pm = uint16_t(int(to_sq(m)) | int(from_sq(m)) << 6);
+
+    if (type_of(m) == PROMOTION)
+        pm |= uint16_t(promotion_type(m) - KNIGHT + 1) << 12;
+
+    return pm;
+  }
+
+  // from_polyglot() finds the legal move a book move stands for, or MOVE_NONE.
+  // This also filters out the entries of other positions with the same key.
+
+  Move from_polyglot(const Position& pos, uint16_t pm) {
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+        if (to_polyglot(m) == pm)
+            return m;
+
+    return MOVE_NONE;
+  }
+
+  void unmap() {
+
+#ifndef _WIN32
+    if (Data)
+        munmap(const_cast<unsigned char*>(Data), MappedSize);
+    MappedSize = 0;
+#else
+    Buffer.clear();
+#endif
+    Data = nullptr;
+    Count = 0;
+  }
+
+} // namespace
+
+
+/// Book::init() maps the book file, replacing the previous one. An empty path
+/// or "<empty>" just closes the book.
+
+void init(const std::string& path) {
+
+  unmap();
+
+  if (path.empty() || path == "<empty>")
+      return;
+
+#ifndef _WIN32
+  struct stat statbuf;
+  int fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd != -1 && fstat(fd, &statbuf) == 0 && statbuf.st_size >= off_t(EntrySize))
+  {
+      void* base = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+      if (base != MAP_FAILED)
+      {
+          Data = static_cast<const unsigned char*>(base);
+          MappedSize = size_t(statbuf.st_size);
+          Count = MappedSize / EntrySize;
+      }
+  }
+
+  if (fd != -1)
+      ::close(fd);
+#else
+  std::ifstream file(path, std::ios::binary);
+  Buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  Data = Buffer.data();
+  Count = Buffer.size() / EntrySize;
+#endif
+
+  if (!Count)
+  {
+      unmap();
+      sync_cout << "info string Could not open book " << path << sync_endl;
+  }
+}
+
+
+/// Book::probe() returns a book move for the position, or MOVE_NONE. With
+/// variety 0 it is always the move with the highest weight, otherwise the
+/// moves with at least (100 - variety)% of that weight are picked at random,
+/// in proportion to their weights.
+
+Move probe(const Position& pos, int variety) {
+
+  if (!Count)
+      return MOVE_NONE;
+
+  const Key key = pos.key();
+
+  // Binary search for the first entry of the position
+  size_t lo = 0, hi = Count;
+  while (lo < hi)
+  {
+      size_t mid = (lo + hi) / 2;
+      if (read_be(Data + mid * EntrySize, 8) < key)
+          lo = mid + 1;
+      else
+          hi = mid;
+  }
+
+  std::vector<std::pair<Move, int>> moves;
+  int maxWeight = 0;
+
+  for (size_t i = lo; i < Count && read_be(Data + i * EntrySize, 8) == key; ++i)
+  {
+      const unsigned char* e = Data + i * EntrySize;
+      Move m = from_polyglot(pos, uint16_t(read_be(e + 8, 2)));
+      int weight = int(read_be(e + 10, 2));
+
+      if (m != MOVE_NONE && weight > 0)
+      {
+          moves.emplace_back(m, weight);
+          maxWeight = std::max(maxWeight, weight);
+      }
+  }
+
+  if (moves.empty())
+      return MOVE_NONE;
+
+  // Keep the candidates, biggest first so that variety 0 takes the best
+  const int threshold = maxWeight * (100 - std::clamp(variety, 0, 100)) / 100;
+  auto end = std::remove_if(moves.begin(), moves.end(),
+                            [&](const auto& mw) { return mw.second < std::max(threshold, 1); });
+  moves.erase(end, moves.end());
+  std::stable_sort(moves.begin(), moves.end(),
+                   [](const auto& a, const auto& b) { return a.second > b.second; });
+
+  if (!variety)
+      return moves[0].first;
+
+  thread_local PRNG rng(now()); // Same games every time would be no variety
+
+  int total = 0;
+  for (const auto& mw : moves)
+      total += mw.second;
+
+  int r = int(rng.rand<uint64_t>() % uint64_t(total));
+  for (const auto& mw : moves)
+      if ((r -= mw.second) < 0)
+          return mw.first;
+
+  return moves[0].first;
+}
+
+
+/// Book::make() builds a book from a text file with one game per line, as UCI
+/// moves from the start position ("e2e4 e7e5 g1f3 ..."). A line may instead
+/// start with "fen <fen> moves". The first 'plies' moves of every game are
+/// counted, and a move's weight is how often it was played in the position.
+/// The positions are set up on thread 'th', which must not be searching.
+/// Returns false if a file could not be opened.
+
+bool make(const std::string& gamesFile, const std::string& bookFile, int plies, Thread* th) {
+
+  std::ifstream in(gamesFile);
+  if (!in.is_open())
+      return false;
+
+  std::map<std::pair<Key, uint16_t>, uint64_t> counts;
+  std::string line, token;
+  size_t games = 0;
+
+  while (std::getline(in, line))
+  {
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+          continue;
+
+      std::istringstream is(line);
+      std::string fen = StartFEN;
+      StateListPtr states(new StateList(1));
+      Position pos;
+
+      if (is >> token && token == "fen")
+      {
+          fen.clear();
+          while (is >> token && token != "moves")
+              fen += token + " ";
+      }
+      else
+          is.seekg(0);
+
+      pos.set(fen, false, &states->back(), th);
+
+      for (int ply = 0; ply < plies && is >> token; ++ply)
+      {
+          Move m = UCI::to_move(pos, token);
+          if (m == MOVE_NONE)
+              break;
+
+          ++counts[{pos.key(), to_polyglot(m)}];
+          states->emplace_back();
+          pos.do_move(m, states->back());
+      }
+
+      ++games;
+  }
+
+  uint64_t maxCount = 1;
+  for (const auto& c : counts)
+      maxCount = std::max(maxCount, c.second);
+
+  std::ofstream out(bookFile, std::ios::binary);
+  if (!out.is_open())
+      return false;
+
+  // std::map already sorts by key, Polyglot weights are 16 bit
+  for (const auto& c : counts)
+  {
+      uint64_t weight = std::max(c.second * 0xFFFF / std::max(maxCount, uint64_t(0xFFFF)), uint64_t(1));
+
+      write_be(out, c.first.first, 8);
+      write_be(out, c.first.second, 2);
+      write_be(out, weight, 2);
+      write_be(out, 0, 4);
+  }
+
+  sync_cout << "info string Book " << bookFile << ": " << counts.size()
+            << " entries from " << games << " games" << sync_endl;
+
+  return bool(out);
+}
+
+} // namespace Stockfish::Book
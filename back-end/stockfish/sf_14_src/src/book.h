@@ -0,0 +1,40 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include <string>
+
+#include "position.h"
+
+namespace Stockfish::Book {
+
+/// An opening book is a Polyglot file: 16 byte big-endian entries (key, move,
+/// weight, learn) sorted by key, with moves in Polyglot encoding. Keys are our
+/// own Zobrist keys, Position::key(), instead of the Polyglot ones, so books
+/// are made with the 'makebook' command rather than taken from elsewhere. The
+/// book is memory mapped and shared by all engines in the process.
+
+void init(const std::string& path);
+Move probe(const Position& pos, int variety);
+bool make(const std::string& gamesFile, const std::string& bookFile, int plies, Thread* th);
+
+} // namespace Stockfish::Book
+
+#endif // #ifndef BOOK_H_INCLUDED
@@ -0,0 +1,824 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analysis.h"
+#include "bitboard.h"
+#include "c_api.h"
+#include "endgame.h"
+#include "engine.h"
+#include "evaluate.h"
+#include "movegen.h"
+#include "position.h"
+#include "psqt.h"
+#include "scheduler.h"
+#include "uci.h"
+
+using namespace Stockfish;
+
+struct sf_engine {
+
+  Engine engine;
+  sf_callback cb = nullptr;
+  void* user = nullptr;
+  sf_info_callback infoCb = nullptr;
+  void* infoUser = nullptr;
+};
+
+struct sf_tt {
+
+  std::shared_ptr<SharedTT> table;
+};
+
+struct sf_scheduler {
+
+  explicit sf_scheduler(size_t workers) : scheduler(workers) {}
+
+  Scheduler scheduler;
+};
+
+struct sf_game {
+
+  std::deque<StateInfo> states; // The root's, then one per move: pos.state() is the last
+  std::vector<Move> moves;
+  Position pos;
+};
+
+namespace {
+
+  const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+  std::once_flag InitFlag;
+  std::mutex NetMutex;
+
+  // fen_is_sane() rejects what Position::set() cannot cope with: it trusts the
+  // GUI, so a missing king or an overfull rank would crash the search.
+
+  bool fen_is_sane(const std::string& fen) {
+
+    std::istringstream ss(fen);
+    std::string board, side, castling = "-", ep = "-";
+    int squares = 0, ranks = 1, kings[COLOR_NB] = {}, pieces[COLOR_NB] = {}, pawns[COLOR_NB] = {};
+
+    if (!(ss >> board >> side) || (side != "w" && side != "b"))
+        return false;
+
+    ss >> castling >> ep;
+
+    for (char c : board)
+    {
+        if (c == '/')
+        {
+            if (squares != 8 * ranks++)
+                return false;
+        }
+        else if (c >= '1' && c <= '8')
+            squares += c - '0';
+        else if (std::strchr("PNBRQKpnbrqk", c))
+        {
+            Color col = islower(c) ? BLACK : WHITE;
+            int rank = 7 - squares / 8;
+
+            ++pieces[col];
+            kings[col] += (toupper(c) == 'K');
+            pawns[col] += (toupper(c) == 'P');
+
+            if (toupper(c) == 'P' && (rank == RANK_1 || rank == RANK_8))
+                return false;
+
+            ++squares;
+        }
+        else
+            return false;
+
+        if (squares > 8 * ranks)
+            return false;
+    }
+
+    return   ranks == 8 && squares == 64
+          && kings[WHITE] == 1 && kings[BLACK] == 1
+          && pieces[WHITE] <= 16 && pieces[BLACK] <= 16
+          && pawns[WHITE] <= 8 && pawns[BLACK] <= 8
+          && castling.find_first_not_of("KQkqABCDEFGHabcdefgh-") == std::string::npos
+          && (ep == "-" || (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' && (ep[1] == '3' || ep[1] == '6')));
+  }
+
+  // copy_move() writes a move in UCI notation into a fixed size result field,
+  // using "0000" for no move as UCI does
+
+  void copy_move(char (&dst)[6], Move m, bool chess960) {
+
+    std::string s = m == MOVE_NONE ? "0000" : UCI::move(m, chess960);
+    std::strncpy(dst, s.c_str(), sizeof(dst) - 1);
+    dst[sizeof(dst) - 1] = '\0';
+  }
+
+  // in_check_after_move() tells whether the side that just moved left its
+  // king in check, which Position::set() accepts but the search cannot handle
+
+  bool in_check_after_move(const Position& pos) {
+
+    return pos.attackers_to(pos.square<KING>(~pos.side_to_move())) & pos.pieces(pos.side_to_move());
+  }
+
+  // check_position() runs the checks sf_search() and sf_scheduler_submit()
+  // share: a sane FEN, the side that just moved not left in check and, with
+  // NNUE on, the network loaded
+
+  int check_position(UCI::OptionsMap& options, const char* fen) {
+
+    if (!fen || !fen_is_sane(fen))
+        return SF_ERR_ARG;
+
+    if (Eval::useNNUE && Eval::eval_file_loaded != std::string(options["EvalFile"]))
+        return SF_ERR_NO_NET;
+
+    StateInfo st;
+    Position pos;
+    pos.set(fen, options["UCI_Chess960"], &st, nullptr);
+
+    return in_check_after_move(pos) ? SF_ERR_ARG : SF_OK;
+  }
+
+  // load_network() loads the network with the first engine, it is shared
+
+  void load_network(UCI::OptionsMap& options) {
+
+    std::lock_guard<std::mutex> lk(NetMutex);
+    if (Eval::eval_file_loaded == "None")
+        Eval::NNUE::init(options);
+  }
+
+  Search::LimitsType to_limits(const sf_limits* limits) {
+
+    Search::LimitsType lim;
+
+    if (limits)
+    {
+        lim.depth         = limits->depth;
+        lim.nodes         = limits->nodes;
+        lim.movetime      = limits->movetime;
+        lim.time[WHITE]   = limits->wtime;
+        lim.time[BLACK]   = limits->btime;
+        lim.inc[WHITE]    = limits->winc;
+        lim.inc[BLACK]    = limits->binc;
+        lim.movestogo     = limits->movestogo;
+    }
+
+    return lim;
+  }
+
+  // split_score() converts a Value to centipawns or, for a mate score, to mate
+  // in N moves, as UCI::value() does
+
+  void split_score(Value v, int& cp, int& mate) {
+
+    if (abs(v) < VALUE_MATE_IN_MAX_PLY)
+        cp = v * 100 / PawnValueEg;
+    else
+        mate = (v > 0 ? VALUE_MATE - v + 1 : -VALUE_MATE - v) / 2;
+  }
+
+  // report() converts the best thread of a finished search into an sf_result
+  // and hands it to the callback
+
+  void report(Engine& engine, const Thread& best, sf_callback cb, void* user) {
+
+    const Search::RootMove& rm = best.rootMoves[0];
+    bool chess960 = best.rootPos.is_chess960();
+    sf_result r = {};
+
+    copy_move(r.bestmove, rm.pv[0], chess960);
+    if (rm.pv.size() > 1)
+        copy_move(r.ponder, rm.pv[1], chess960);
+
+    // Without a move the game is over (checkmate or stalemate), no score then
+    if (rm.pv[0] != MOVE_NONE)
+        split_score(rm.score, r.score_cp, r.mate);
+
+    r.depth    = best.completedDepth;
+    r.seldepth = rm.selDepth;
+    r.nodes    = engine.threads.nodes_searched();
+    r.time_ms  = now() - engine.limits.startTime;
+
+    if (cb)
+        cb(&r, user);
+  }
+
+  // setup_thread() is the thread the positions of sf_validate_move() and of
+  // the game handles are set up with, do_move() counts its nodes there. They
+  // never search, so one idle engine serves every caller at once. It lives
+  // until the process exits.
+
+  Thread* setup_thread() {
+
+    static Engine* engine = [] {
+        Engine* e = new Engine();
+        e->options["Hash"] = std::string("1");
+        return e;
+    }();
+
+    return engine->threads.main();
+  }
+
+  // dead_position() tells whether neither side can ever mate: no pawns, rooks
+  // or queens, and at most one minor piece or only bishops on one color
+
+  bool dead_position(const Position& pos) {
+
+    if (pos.pieces(PAWN, ROOK) || pos.pieces(QUEEN))
+        return false;
+
+    Bitboard minors = pos.pieces(KNIGHT, BISHOP);
+
+    return   !more_than_one(minors)
+          || (!pos.pieces(KNIGHT) && (!(minors & DarkSquares) || !(minors & ~DarkSquares)));
+  }
+
+  // fill_move_check() describes the position after a legal move
+
+  void fill_move_check(Position& pos, sf_move_check* out) {
+
+    out->legal  = 1;
+    out->check  = bool(pos.checkers());
+    out->status = !MoveList<LEGAL>(pos).size()  ? (pos.checkers() ? SF_CHECKMATE : SF_STALEMATE)
+                : dead_position(pos)            ? SF_DEAD_POSITION
+                : pos.state()->repetition < 0   ? SF_REPETITION
+                : pos.rule50_count() >= 100     ? SF_FIFTY_MOVES
+                                                : SF_ONGOING;
+
+    std::string f = pos.fen();
+    std::strncpy(out->fen, f.c_str(), sizeof(out->fen) - 1);
+  }
+
+  // report_info() converts one PV line into an sf_info, the moves go in a
+  // buffer on the stack that lives as long as the callback
+
+  void report_info(const Search::Iteration& it, sf_info_callback cb, void* user) {
+
+    uint16_t pv[MAX_PLY];
+    sf_info info = {};
+
+    info.depth     = it.depth;
+    info.seldepth  = it.selDepth;
+    info.multipv   = it.multiPV;
+    info.bound     = it.bound == BOUND_LOWER ? 1 : it.bound == BOUND_UPPER ? 2 : 0;
+    info.nodes     = it.nodes;
+    info.tbhits    = it.tbHits;
+    info.hashfull  = it.hashfull;
+    info.time_ms   = it.time;
+    info.pv_length = int(std::min(it.pvLength, size_t(MAX_PLY)));
+    info.pv        = pv;
+
+    split_score(it.score, info.score_cp, info.mate);
+    std::copy(it.wdl, it.wdl + 3, info.wdl);
+
+    for (int i = 0; i < info.pv_length; ++i)
+        pv[i] = uint16_t(it.pv[i]);
+
+    cb(&info, user);
+  }
+
+  // search_game() starts sf_search_game() and sf_ponder_game()
+
+  int search_game(sf_engine* e, sf_game* g, const sf_limits* limits,
+                  sf_callback cb, void* user, bool ponder) {
+
+    if (!e || !g)
+        return SF_ERR_ARG;
+
+    Engine& engine = e->engine;
+
+    if (Eval::useNNUE && Eval::eval_file_loaded != std::string(engine.options["EvalFile"]))
+        return SF_ERR_NO_NET;
+
+    // The search gets its own copy of the current state, whose 'previous' chain
+    // runs through the game's states: repetitions and accumulators are reused
+    StateListPtr states(new StateList(1, *g->pos.state()));
+
+    Search::LimitsType lim = to_limits(limits);
+    lim.startTime = now();
+
+    engine.threads.main()->wait_for_search_finished();
+    e->cb = cb;
+    e->user = user;
+
+    engine.threads.start_thinking(g->pos, states, lim, ponder);
+    return SF_OK;
+  }
+
+} // namespace
+
+
+extern "C" {
+
+int sf_init(const char* path) {
+
+  std::call_once(InitFlag, [path]() {
+
+      std::string argv0 = path ? path : "libstockfish.so";
+      char* argv[] = { &argv0[0], nullptr };
+
+      CommandLine::init(1, argv);
+      PSQT::init();
+      Bitboards::init();
+      Position::init();
+      Endgames::init();
+      Search::init();
+  });
+
+  return SF_OK;
+}
+
+sf_engine* sf_engine_new() {
+
+  sf_init(nullptr);
+
+  sf_engine* e = new sf_engine();
+  e->engine.uciOutput = false;
+  e->engine.onSearchFinished = [e](const Thread& best) { report(e->engine, best, e->cb, e->user); };
+
+  load_network(e->engine.options);
+
+  return e;
+}
+
+void sf_engine_free(sf_engine* e) {
+
+  delete e;
+}
+
+int sf_set_option(sf_engine* e, const char* name, const char* value) {
+
+  if (!e || !name || !e->engine.options.count(name))
+      return SF_ERR_ARG;
+
+  e->engine.options[name] = std::string(value ? value : "");
+  return SF_OK;
+}
+
+int sf_search(sf_engine* e, const char* fen, const sf_limits* limits,
+              sf_callback cb, void* user) {
+
+  if (!e)
+      return SF_ERR_ARG;
+
+  Engine& engine = e->engine;
+
+  if (int err = check_position(engine.options, fen))
+      return err;
+
+  StateListPtr states(new StateList(1));
+  Position pos;
+  pos.set(fen, engine.options["UCI_Chess960"], &states->back(), engine.threads.main());
+
+  Search::LimitsType lim = to_limits(limits);
+  lim.startTime = now();
+
+  // The callback of the previous search may still be running
+  engine.threads.main()->wait_for_search_finished();
+  e->cb = cb;
+  e->user = user;
+
+  engine.threads.start_thinking(pos, states, lim);
+  return SF_OK;
+}
+
+int sf_set_info_callback(sf_engine* e, sf_info_callback cb, void* user) {
+
+  if (!e)
+      return SF_ERR_ARG;
+
+  e->engine.threads.main()->wait_for_search_finished();
+  e->infoCb = cb;
+  e->infoUser = user;
+
+  if (cb)
+      e->engine.onIteration = [e](const Search::Iteration& it) { report_info(it, e->infoCb, e->infoUser); };
+  else
+      e->engine.onIteration = nullptr;
+
+  return SF_OK;
+}
+
+int sf_move_to_uci(uint16_t move, int chess960, char* out) {
+
+  if (!out)
+      return SF_ERR_ARG;
+
+  char buf[6];
+  copy_move(buf, Move(move), chess960);
+  std::memcpy(out, buf, sizeof(buf));
+  return SF_OK;
+}
+
+int sf_evaluate_game(sf_engine* e, const char* fen, const char* moves, int* scores, int max_scores) {
+
+  if (!e || !scores)
+      return SF_ERR_ARG;
+
+  Engine& engine = e->engine;
+
+  if (int err = check_position(engine.options, fen))
+      return err;
+
+  if (!Eval::useNNUE)
+      return SF_ERR_NO_NET;
+
+  // do_move() counts nodes on the position's thread, so keep off a running search
+  engine.threads.main()->wait_for_search_finished();
+
+  StateInfo st;
+  Position pos;
+  pos.set(fen, engine.options["UCI_Chess960"], &st, engine.threads.main());
+
+  std::vector<Move> game;
+  std::deque<StateInfo> states;
+  std::istringstream is(moves ? moves : "");
+  std::string token;
+  bool legal = true;
+
+  // The moves are checked by playing them once, the evaluation replays them
+  while (legal && is >> token)
+  {
+      Move m = UCI::to_move(pos, token);
+      if ((legal = m != MOVE_NONE))
+      {
+          game.push_back(m);
+          states.emplace_back();
+          pos.do_move(m, states.back());
+      }
+  }
+
+  for (auto it = game.rbegin(); it != game.rend(); ++it)
+      pos.undo_move(*it);
+
+  if (!legal)
+      return SF_ERR_ARG;
+
+  std::vector<Value> values(game.size() + 1);
+  Eval::NNUE::evaluate(pos, game.data(), game.size(), values.data());
+
+  int n = std::min(int(values.size()), max_scores);
+  for (int i = 0; i < n; ++i)
+      scores[i] = values[i] * 100 / PawnValueEg;
+
+  return n;
+}
+
+int sf_analyse_game(sf_engine* e, const char* game, const sf_limits* limits, int threads,
+                    sf_ply_callback cb, void* user) {
+
+  if (!e || !game)
+      return SF_ERR_ARG;
+
+  Engine& engine = e->engine;
+  bool chess960 = engine.options["UCI_Chess960"];
+  std::string movetext, fen = Analysis::split_game(game, movetext);
+  std::vector<Move> moves;
+
+  if (int err = check_position(engine.options, fen.c_str()))
+      return err;
+
+  engine.threads.main()->wait_for_search_finished();
+
+  if (!Analysis::read_moves(fen, movetext, chess960, engine.threads.main(), moves))
+      return SF_ERR_ARG;
+
+  Analysis::analyse(engine, fen, moves, to_limits(limits), size_t(std::max(threads, 1)),
+                    [&](const Analysis::Ply& p) {
+
+      sf_ply_report r = {};
+      r.ply = p.ply;
+      copy_move(r.move, p.move, chess960);
+      copy_move(r.best, p.best, chess960);
+      split_score(p.score, r.score_cp, r.score_mate);
+      split_score(p.played, r.played_cp, r.played_mate);
+      r.cp_loss   = p.cpLoss;
+      r.loss      = p.loss;
+      r.judgement = p.judgement;
+      r.depth     = p.depth;
+      r.nodes     = p.nodes;
+
+      if (cb)
+          cb(&r, user);
+  });
+
+  return int(moves.size());
+}
+
+int sf_validate_move(const char* fen, const char* moves, const char* move, int chess960,
+                     sf_move_check* out) {
+
+  if (!fen || !move || !out || !fen_is_sane(fen))
+      return SF_ERR_ARG;
+
+  sf_init(nullptr);
+  *out = {};
+
+  std::deque<StateInfo> states(1);
+  Position pos;
+  pos.set(fen, chess960, &states.back(), setup_thread());
+
+  if (in_check_after_move(pos))
+      return SF_ERR_ARG;
+
+  std::istringstream is(moves ? moves : "");
+  std::string token = move;
+  Move m;
+
+  // The moves already played, then the one to check, with the repetition info
+  // of the positions kept by the chain of states
+  for (std::string played; is >> played; )
+  {
+      if ((m = UCI::to_move(pos, played)) == MOVE_NONE)
+          return SF_ERR_ARG;
+
+      states.emplace_back();
+      pos.do_move(m, states.back());
+  }
+
+  if ((m = UCI::to_move(pos, token)) == MOVE_NONE)
+      return SF_OK;
+
+  states.emplace_back();
+  pos.do_move(m, states.back());
+  fill_move_check(pos, out);
+
+  return SF_OK;
+}
+
+sf_game* sf_game_new(const char* fen, int chess960) {
+
+  if (!fen)
+      fen = StartFEN;
+
+  if (!fen_is_sane(fen))
+      return nullptr;
+
+  sf_init(nullptr);
+
+  sf_game* g = new sf_game();
+  g->states.emplace_back();
+  g->pos.set(fen, chess960, &g->states.back(), setup_thread());
+
+  if (in_check_after_move(g->pos))
+  {
+      delete g;
+      return nullptr;
+  }
+
+  return g;
+}
+
+void sf_game_free(sf_game* g) {
+
+  delete g;
+}
+
+int sf_game_push(sf_game* g, const char* move, sf_move_check* out) {
+
+  if (!g || !move || !out)
+      return SF_ERR_ARG;
+
+  *out = {};
+
+  std::string token = move;
+  Move m = UCI::to_move(g->pos, token);
+  if (m == MOVE_NONE)
+      return SF_OK;
+
+  // A deque never moves its elements on push_back(), so the 'previous'
+  // pointers of the states stay valid as the game grows
+  g->states.emplace_back();
+  g->moves.push_back(m);
+  g->pos.do_move(m, g->states.back());
+  fill_move_check(g->pos, out);
+
+  return SF_OK;
+}
+
+int sf_game_pop(sf_game* g) {
+
+  if (!g || g->moves.empty())
+      return SF_ERR_ARG;
+
+  g->pos.undo_move(g->moves.back());
+  g->moves.pop_back();
+  g->states.pop_back();
+
+  return SF_OK;
+}
+
+int sf_game_fen(const sf_game* g, char* out, int size) {
+
+  if (!g || !out || size < 1)
+      return SF_ERR_ARG;
+
+  std::string f = g->pos.fen();
+  std::strncpy(out, f.c_str(), size_t(size) - 1);
+  out[size - 1] = '\0';
+
+  return SF_OK;
+}
+
+int sf_search_game(sf_engine* e, sf_game* g, const sf_limits* limits,
+                   sf_callback cb, void* user) {
+
+  return search_game(e, g, limits, cb, user, false);
+}
+
+int sf_ponder_game(sf_engine* e, sf_game* g, const sf_limits* limits,
+                   sf_callback cb, void* user) {
+
+  return search_game(e, g, limits, cb, user, true);
+}
+
+void sf_ponderhit(sf_engine* e) {
+
+  if (e)
+      e->engine.threads.main()->ponderhit();
+}
+
+void sf_stop(sf_engine* e) {
+
+  if (e)
+      e->engine.threads.stop = true;
+}
+
+void sf_wait(sf_engine* e) {
+
+  if (e)
+      e->engine.threads.main()->wait_for_search_finished();
+}
+
+void sf_new_game(sf_engine* e) {
+
+  if (e)
+      Search::clear(e->engine);
+}
+
+int sf_save_tt(sf_engine* e, const char* path) {
+
+  if (!e || !path)
+      return SF_ERR_ARG;
+
+  e->engine.threads.main()->wait_for_search_finished();
+
+  return e->engine.tt.save(path) ? SF_OK : SF_ERR_ARG;
+}
+
+int sf_load_tt(sf_engine* e, const char* path) {
+
+  if (!e || !path)
+      return SF_ERR_ARG;
+
+  e->engine.threads.main()->wait_for_search_finished();
+
+  return e->engine.tt.load(path) ? SF_OK : SF_ERR_ARG;
+}
+
+int sf_stats(sf_engine* e, char* out, int size) {
+
+  if (!e || !out || size < 1)
+      return SF_ERR_ARG;
+
+  e->engine.threads.main()->wait_for_search_finished();
+
+  std::string s = e->engine.threads.stats(true);
+  if (s.size() >= size_t(size))
+      return SF_ERR_ARG;
+
+  std::strcpy(out, s.c_str());
+  return SF_OK;
+}
+
+void sf_reset_stats(sf_engine* e) {
+
+  if (e)
+      e->engine.threads.reset_stats();
+}
+
+sf_tt* sf_tt_new(int mb) {
+
+  if (mb < 1)
+      return nullptr;
+
+  sf_init(nullptr);
+
+  return new sf_tt{ std::make_shared<SharedTT>(size_t(mb), std::thread::hardware_concurrency()) };
+}
+
+sf_tt* sf_tt_open(const char* name, int mb) {
+
+  if (!name || !*name || mb < 1)
+      return nullptr;
+
+  sf_init(nullptr);
+
+  auto table = SharedTT::open(name, size_t(mb));
+
+  return table ? new sf_tt{ table } : nullptr;
+}
+
+void sf_tt_free(sf_tt* tt) {
+
+  delete tt;
+}
+
+int sf_engine_set_tt(sf_engine* e, sf_tt* tt) {
+
+  if (!e || !tt)
+      return SF_ERR_ARG;
+
+  e->engine.threads.main()->wait_for_search_finished();
+
+  return e->engine.tt.attach(tt->table) ? SF_OK : SF_ERR_FULL;
+}
+
+sf_scheduler* sf_scheduler_new(int workers) {
+
+  sf_init(nullptr);
+
+  sf_scheduler* s = new sf_scheduler(size_t(std::max(workers, 0)));
+  load_network(s->scheduler.options());
+
+  return s;
+}
+
+void sf_scheduler_free(sf_scheduler* s) {
+
+  delete s;
+}
+
+int sf_scheduler_set_option(sf_scheduler* s, const char* name, const char* value) {
+
+  if (!s || !name || !s->scheduler.set_option(name, value ? value : ""))
+      return SF_ERR_ARG;
+
+  return SF_OK;
+}
+
+int64_t sf_scheduler_submit(sf_scheduler* s, const char* fen, const sf_limits* limits,
+                            int priority, int deadline_ms, sf_callback cb, void* user) {
+
+  if (!s)
+      return SF_ERR_ARG;
+
+  if (int err = check_position(s->scheduler.options(), fen))
+      return err;
+
+  TimePoint deadline = deadline_ms > 0 ? now() + deadline_ms : 0;
+
+  return int64_t(s->scheduler.submit(fen, to_limits(limits), priority, deadline,
+                  [cb, user](Engine& engine, const Thread& best) { report(engine, best, cb, user); }));
+}
+
+int sf_scheduler_cancel(sf_scheduler* s, int64_t job) {
+
+  if (!s || job <= 0)
+      return SF_ERR_ARG;
+
+  switch (s->scheduler.cancel(uint64_t(job))) {
+  case Scheduler::Dropped: return 1;
+  case Scheduler::Stopped: return 0;
+  default:                 return SF_ERR_ARG;
+  }
+}
+
+void sf_scheduler_set_preempt_priority(sf_scheduler* s, int priority) {
+
+  if (s)
+      s->scheduler.set_preempt_priority(priority);
+}
+
+int sf_scheduler_pending(sf_scheduler* s) {
+
+  return s ? int(s->scheduler.pending()) : 0;
+}
+
+} // extern "C"
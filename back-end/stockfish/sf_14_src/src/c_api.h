@@ -0,0 +1,290 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef C_API_H_INCLUDED
+#define C_API_H_INCLUDED
+
+/// C interface of libstockfish.so ('make lib'), for hosts that want to search
+/// in-process instead of talking UCI over a pipe. Each sf_engine is an
+/// independent Engine with its own threads and hash; any number of them can
+/// search at the same time. All functions return SF_OK (0) or a negative error.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+  SF_OK          =  0,
+  SF_ERR_ARG     = -1, // Bad option name/value, NULL pointer or invalid FEN
+  SF_ERR_NO_NET  = -2, // "Use NNUE" is on but the network could not be loaded
+  SF_ERR_FULL    = -3  // A shared hash table has no tenant slot left
+};
+
+/// Game state after a move, see sf_validate_move()
+enum {
+  SF_ONGOING       = 0,
+  SF_CHECKMATE     = 1,
+  SF_STALEMATE     = 2,
+  SF_REPETITION    = 3, // Third occurrence of the position
+  SF_FIFTY_MOVES   = 4,
+  SF_DEAD_POSITION = 5  // Neither side can mate: kings, at most one minor or only same colored bishops
+};
+
+typedef struct sf_engine sf_engine;
+typedef struct sf_scheduler sf_scheduler;
+typedef struct sf_game sf_game;
+typedef struct sf_tt sf_tt;
+
+/// Search limits, zero means unset. With every field zero the search runs
+/// until sf_stop() or the maximum depth. Times are in milliseconds.
+typedef struct {
+  int depth;
+  int64_t nodes;
+  int movetime;
+  int wtime, btime, winc, binc, movestogo;
+} sf_limits;
+
+/// Outcome of a search, from the side to move's point of view
+typedef struct {
+  char bestmove[6];   // UCI notation, "0000" (and no score) when there is no legal move
+  char ponder[6];     // Empty string when there is none
+  int score_cp;       // Centipawns, valid when mate == 0
+  int mate;           // Mate in N moves, negative when being mated
+  int depth, seldepth; // depth 0 with a move: a book move, scored 0
+  uint64_t nodes;
+  int64_t time_ms;
+} sf_result;
+
+/// Called once per search from an engine thread. It must return quickly and
+/// must not call sf_search() on the same engine.
+typedef void (*sf_callback)(const sf_result* result, void* user);
+
+/// Search progress: one PV line, the data of a UCI 'info ... pv' line. Moves
+/// are 16 bit Stockfish moves (bits 0-5 destination square a1 = 0 .. h8 = 63,
+/// 6-11 origin, 12-13 promotion piece from knight = 0 to queen = 3, 14-15 type:
+/// 1 promotion, 2 en passant, 3 castling encoded as king takes rook), see
+/// sf_move_to_uci(). 'pv' is valid only during the callback.
+typedef struct {
+  int depth, seldepth;
+  int multipv;        // 1 is the best line
+  int score_cp;       // Centipawns, valid when mate == 0
+  int mate;           // Mate in N moves, negative when being mated
+  int bound;          // 0 exact, 1 lowerbound, 2 upperbound
+  int wdl[3];         // Win, draw and loss per mille
+  uint64_t nodes, tbhits;
+  int hashfull;       // Per mille
+  int64_t time_ms;
+  int pv_length;
+  const uint16_t* pv;
+} sf_info;
+
+/// Called from the engine's main search thread, same rules as sf_callback
+typedef void (*sf_info_callback)(const sf_info* info, void* user);
+
+/// Outcome of sf_validate_move(). Only 'legal' is set for an illegal move.
+typedef struct {
+  int legal;
+  int check;          // The side to move is in check after the move
+  int status;         // SF_ONGOING, SF_CHECKMATE, ... after the move
+  char fen[128];      // The position after the move
+} sf_move_check;
+
+/// sf_init() sets up the process-wide tables. It is idempotent and is called
+/// implicitly by sf_engine_new(). 'path' is where to look for the network
+/// besides the working directory, usually the library's own path; may be NULL.
+int sf_init(const char* path);
+
+sf_engine* sf_engine_new(void);
+void sf_engine_free(sf_engine* e);
+
+/// Same names and values as the UCI "setoption" command. As with UCI, values
+/// out of range are ignored; only an unknown name is an error.
+int sf_set_option(sf_engine* e, const char* name, const char* value);
+
+/// Starts searching 'fen' and returns immediately. The result is passed to
+/// 'cb' when the search ends. If a search is already running on this engine
+/// the call waits for it to finish first.
+int sf_search(sf_engine* e, const char* fen, const sf_limits* limits,
+              sf_callback cb, void* user);
+
+/// Streams the search progress of every following search to 'cb', as often as
+/// a GUI would get 'info' lines: at least once per iteration. NULL turns it
+/// off. Waits for a running search to end first.
+int sf_set_info_callback(sf_engine* e, sf_info_callback cb, void* user);
+
+/// Writes a move of sf_info.pv in UCI notation to 'out', 6 chars with the NUL
+int sf_move_to_uci(uint16_t move, int chess960, char* out);
+
+/// Static NNUE evaluation of a game for post-game reports: 'fen' and then the
+/// position after each of 'moves' (UCI notation, separated by spaces), in
+/// centipawns from the side to move's point of view. The positions are
+/// evaluated as one batch, incrementally along the game. Returns the number
+/// of scores written, at most 'max_scores', or an error: SF_ERR_ARG for an
+/// illegal move, SF_ERR_NO_NET when "Use NNUE" is off or has no network.
+int sf_evaluate_game(sf_engine* e, const char* fen, const char* moves, int* scores, int max_scores);
+
+/// Judgement of a move in sf_analyse_game(), by the expected score it lost:
+/// at least 10, 20 and 30 percent for an inaccuracy, a mistake and a blunder
+enum {
+  SF_GOOD       = 0,
+  SF_INACCURACY = 1,
+  SF_MISTAKE    = 2,
+  SF_BLUNDER    = 3
+};
+
+/// One move of sf_analyse_game(), scores from the mover's point of view
+typedef struct {
+  int ply;            // 0 for the first move of the game
+  char move[6];       // The move played, UCI notation
+  char best[6];       // The engine's choice
+  int score_cp, score_mate;   // Of the best move, as in sf_result
+  int played_cp, played_mate; // Of the move played
+  int cp_loss;        // Centipawns lost, scores capped at 10 pawns
+  int loss;           // Expected score lost, per mille
+  int judgement;      // SF_GOOD ... SF_BLUNDER
+  int depth;
+  uint64_t nodes;
+} sf_ply_report;
+
+typedef void (*sf_ply_callback)(const sf_ply_report* ply, void* user);
+
+/// Whole game analysis, as the UCI 'analyse_game' command: 'game' is PGN, with
+/// moves in SAN, or UCI moves optionally after "fen <fen> moves". The positions
+/// are searched with 'limits' from the last one back to the first, on 'threads'
+/// single threaded engines sharing a hash table of the engine's "Hash" size,
+/// so that the searches of the later positions speed up the earlier ones. 'cb'
+/// gets each move as soon as the positions before and after it are searched,
+/// on an engine thread, one move at a time. Blocks until all are done, then
+/// returns the number of moves, or SF_ERR_ARG for an invalid FEN or move.
+int sf_analyse_game(sf_engine* e, const char* game, const sf_limits* limits, int threads,
+                    sf_ply_callback cb, void* user);
+
+/// Checks 'move' (UCI notation) in the position after 'fen' and 'moves', the
+/// moves played since 'fen' (may be NULL), which are needed to see repetitions.
+/// No engine is needed, any thread may call it. Returns SF_ERR_ARG for
+/// an invalid FEN or an illegal move in 'moves', SF_OK otherwise.
+int sf_validate_move(const char* fen, const char* moves, const char* move, int chess960,
+                     sf_move_check* out);
+
+/// A game handle keeps the position of a game and the states of the moves
+/// that led to it: moves are applied incrementally instead of setting up a FEN
+/// each time, and a search from the handle sees the repetitions of the game.
+/// NULL 'fen' is the start position; returns NULL for an invalid FEN.
+sf_game* sf_game_new(const char* fen, int chess960);
+void sf_game_free(sf_game* g);
+
+/// Plays 'move' (UCI notation) if it is legal, with 'out' filled in as by
+/// sf_validate_move(). An illegal move leaves the game as it is.
+int sf_game_push(sf_game* g, const char* move, sf_move_check* out);
+
+/// Takes back the last move, SF_ERR_ARG when there is none
+int sf_game_pop(sf_game* g);
+
+/// Writes the FEN of the current position, NUL terminated, to 'out'
+int sf_game_fen(const sf_game* g, char* out, int size);
+
+/// As sf_search(), from the current position of 'g'. The game must not be
+/// changed, freed or searched by another engine until the search ends.
+int sf_search_game(sf_engine* e, sf_game* g, const sf_limits* limits,
+                   sf_callback cb, void* user);
+
+/// Pondering, as UCI 'go ponder': as sf_search_game(), once the reply the last
+/// search predicted has been pushed on 'g', with the limits of the coming move.
+/// The search thinks on the opponent's time with the lowest priority, it pauses
+/// while any other search of the process runs. sf_ponderhit() turns it into the
+/// normal search when the reply is played, else sf_stop() ends it and its result
+/// is to be dropped. Either way the callback is called once.
+int sf_ponder_game(sf_engine* e, sf_game* g, const sf_limits* limits,
+                   sf_callback cb, void* user);
+void sf_ponderhit(sf_engine* e);
+
+void sf_stop(sf_engine* e);
+void sf_wait(sf_engine* e);
+
+/// Forgets everything learned in the previous games (UCI 'ucinewgame')
+void sf_new_game(sf_engine* e);
+
+/// Hash table snapshots, as the UCI 'save_tt' / 'load_tt' commands: saving and
+/// loading wait for a running search to end. Loading resizes the table to the
+/// snapshot's size and fails on a shared table or an invalid file.
+int sf_save_tt(sf_engine* e, const char* path);
+int sf_load_tt(sf_engine* e, const char* path);
+
+/// The counters of the UCI 'stats json' command, one NUL terminated JSON
+/// object in 'out', SF_ERR_ARG if it does not fit. Both calls wait for a
+/// running search to end; resetting starts the counters again.
+int sf_stats(sf_engine* e, char* out, int size);
+void sf_reset_stats(sf_engine* e);
+
+/// A shared hash table lets engines of different games reuse each other's
+/// entries while each one ages only its own, so up to 32 engines can share one
+/// big table without the busiest game evicting the others. The table lives as
+/// long as an engine uses it; sf_tt_free() only drops the caller's reference.
+/// While attached, "Hash" is ignored and sf_new_game() ages the engine's own
+/// entries instead of clearing the table.
+sf_tt* sf_tt_new(int mb);
+void sf_tt_free(sf_tt* tt);
+
+/// Opens the named shared memory segment 'name' as a shared hash table, made
+/// with 'mb' MB if it does not exist yet, so that engines in other processes
+/// can attach to it as well. The segment stays until removed from /dev/shm.
+/// Returns NULL if it can not be opened, or on Windows.
+sf_tt* sf_tt_open(const char* name, int mb);
+
+/// Attaches the engine to 'tt', waiting for a running search to end first
+int sf_engine_set_tt(sf_engine* e, sf_tt* tt);
+
+/// A scheduler runs many searches at once, one per core, each on its own
+/// single threaded engine: the way to serve many games against the engine.
+/// 'workers' is the number of engines, 0 means one per hardware thread.
+/// Freeing it drops the queued jobs without calling them back.
+sf_scheduler* sf_scheduler_new(int workers);
+void sf_scheduler_free(sf_scheduler* s);
+
+/// Applies to every worker; waits for the running searches to end first
+int sf_scheduler_set_option(sf_scheduler* s, const char* name, const char* value);
+
+/// Queues a search and returns immediately; 'cb' gets the result when it ends,
+/// on a worker thread. Higher priorities start first, then the earliest
+/// deadline. 'deadline_ms', counted from now, caps the search time including
+/// the time spent queued; 0 means no deadline. Returns the job's id, > 0, or
+/// an error.
+int64_t sf_scheduler_submit(sf_scheduler* s, const char* fen, const sf_limits* limits,
+                            int priority, int deadline_ms, sf_callback cb, void* user);
+
+/// Cancels a job: 1 if it was still queued, it is then not called back, 0 if
+/// it was running and is stopped, its callback follows with the best move so
+/// far, SF_ERR_ARG if the job is unknown or has ended already.
+int sf_scheduler_cancel(sf_scheduler* s, int64_t job);
+
+/// With every worker busy, a job of at least 'priority' suspends the running
+/// job of the lowest lower priority and runs first on a spare engine; the
+/// suspended search then resumes where it was. INT_MAX, the default, disables
+/// preemption. A suspended job's movetime and deadline keep running.
+void sf_scheduler_set_preempt_priority(sf_scheduler* s, int priority);
+
+/// Number of jobs waiting for a worker
+int sf_scheduler_pending(sf_scheduler* s);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // #ifndef C_API_H_INCLUDED
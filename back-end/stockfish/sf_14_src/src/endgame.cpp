@@ -67,7 +67,7 @@ namespace {
 
 namespace Endgames {
 
-  std::pair<Map<Value>, Map<ScaleFactor>> maps;
+  std::pair<Table<Value, 6>, Table<ScaleFactor, 5>> tables;
 
   void init() {
 
@@ -87,6 +87,9 @@ namespace Endgames {
     add<KBPKN>("KBPKN");
     add<KBPPKB>("KBPPKB");
     add<KRPPKRP>("KRPPKRP");
+
+    table<Value>().build();
+    table<ScaleFactor>().build();
   }
 }
 
@@ -19,12 +19,14 @@
 #ifndef ENDGAME_H_INCLUDED
 #define ENDGAME_H_INCLUDED
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <type_traits>
-#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "misc.h"
 #include "position.h"
 #include "types.h"
 
@@ -89,35 +91,90 @@ struct Endgame : public EndgameBase<T> {
 
 
 /// The Endgames namespace handles the pointers to endgame evaluation and scaling
-/// base objects in two std::map. We use polymorphism to invoke the actual
+/// base objects in two flat tables. We use polymorphism to invoke the actual
 /// endgame function by calling its virtual operator().
 
 namespace Endgames {
 
   template<typename T> using Ptr = std::unique_ptr<EndgameBase<T>>;
-  template<typename T> using Map = std::unordered_map<Key, Ptr<T>>;
 
-  extern std::pair<Map<Value>, Map<ScaleFactor>> maps;
+  /// Table is a perfect hash of the few material keys that have an endgame
+  /// function. Once they are all added, build() looks for a multiplier that
+  /// sends every key to a slot of its own, so that probe() is a multiply, one
+  /// load and one compare, without buckets to follow as in a std::unordered_map.
+  /// 1 << Bits slots must be at least twice the keys, two per endgame.
+  template<typename T, int Bits>
+  class Table {
+
+    struct Entry {
+      Key key;
+      const EndgameBase<T>* eg;
+    };
+
+    size_t index(Key key) const { return size_t((key * multiplier) >> (64 - Bits)); }
+
+    std::vector<std::pair<Key, Ptr<T>>> added;
+    Key multiplier = 0;
+    alignas(64) Entry entries[1 << Bits] = {};
+
+  public:
+    void add(Key key, Ptr<T>&& eg) {
+
+      auto it = std::find_if(added.begin(), added.end(), [&](const auto& a) { return a.first == key; });
+      if (it != added.end())
+          it->second = std::move(eg);
+      else
+          added.emplace_back(key, std::move(eg));
+    }
+
+    void build() {
+
+      assert(2 * added.size() <= (1 << Bits));
+
+      PRNG rng(1070372);
+      bool unique = false;
+
+      while (!unique)
+      {
+          multiplier = rng.rand<Key>() | 1;
+          std::fill(std::begin(entries), std::end(entries), Entry{});
+          unique = true;
+
+          for (const auto& [key, eg] : added)
+          {
+              Entry& e = entries[index(key)];
+              unique = unique && !e.eg;
+              e = { key, eg.get() };
+          }
+      }
+    }
+
+    const EndgameBase<T>* probe(Key key) const {
+      const Entry& e = entries[index(key)];
+      return e.key == key ? e.eg : nullptr;
+    }
+  };
+
+  extern std::pair<Table<Value, 6>, Table<ScaleFactor, 5>> tables;
 
   void init();
 
   template<typename T>
-  Map<T>& map() {
-    return std::get<std::is_same<T, ScaleFactor>::value>(maps);
+  auto& table() {
+    return std::get<std::is_same<T, ScaleFactor>::value>(tables);
   }
 
   template<EndgameCode E, typename T = eg_type<E>>
   void add(const std::string& code) {
 
     StateInfo st;
-    map<T>()[Position().set(code, WHITE, &st).material_key()] = Ptr<T>(new Endgame<E>(WHITE));
-    map<T>()[Position().set(code, BLACK, &st).material_key()] = Ptr<T>(new Endgame<E>(BLACK));
+    table<T>().add(Position().set(code, WHITE, &st).material_key(), Ptr<T>(new Endgame<E>(WHITE)));
+    table<T>().add(Position().set(code, BLACK, &st).material_key(), Ptr<T>(new Endgame<E>(BLACK)));
   }
 
   template<typename T>
-  const EndgameBase<T>* probe(Key key) {
-    auto it = map<T>().find(key);
-    return it != map<T>().end() ? it->second.get() : nullptr;
+  inline const EndgameBase<T>* probe(Key key) {
+    return table<T>().probe(key);
   }
 }
 
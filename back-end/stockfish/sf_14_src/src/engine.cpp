@@ -0,0 +1,42 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "engine.h"
+
+namespace Stockfish {
+
+/// Engine constructor sets up the default options and starts the search
+/// threads, which allocates the transposition table. The process-wide tables
+/// must have been initialized already (see main()).
+
+Engine::Engine() : threads(*this) {
+
+  UCI::init(options, *this);
+  threads.set(size_t(options["Threads"])); // Clears the threads and the TT
+}
+
+
+/// Engine destructor stops a running search, if any, and joins the threads
+
+Engine::~Engine() {
+
+  threads.stop = true;
+  threads.set(0);
+}
+
+} // namespace Stockfish
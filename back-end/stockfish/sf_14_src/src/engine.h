@@ -0,0 +1,74 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINE_H_INCLUDED
+#define ENGINE_H_INCLUDED
+
+#include <functional>
+
+#include "search.h"
+#include "thread.h"
+#include "timeman.h"
+#include "tt.h"
+#include "uci.h"
+#include "syzygy/tbprobe.h"
+
+namespace Stockfish {
+
+/// Engine keeps together everything that belongs to one independent search:
+/// UCI options, thread pool, transposition table, search limits, time manager
+/// and tablebase settings. Any number of engines can search concurrently in
+/// one process, each with its own thread budget. They share the read-only
+/// tables built at startup (bitboards, Zobrist keys, PSQT, bitbases, endgames,
+/// reductions) as well as the NNUE network, the Syzygy files, the opening book
+/// and the result cache, so "EvalFile", "Use NNUE", "SyzygyPath", "Book File",
+/// "Result Cache" and "Debug Log File" are process-wide and should be changed
+/// only while no engine is searching. "NNUE Int8" picks the weights of the
+/// shared network per engine.
+
+struct Engine {
+
+  Engine();
+ ~Engine();
+
+  Engine(const Engine&) = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  UCI::OptionsMap options;
+  ThreadPool threads;
+  TranspositionTable tt;
+  PerftTable perftTable;
+  Search::LimitsType limits;
+  TimeManagement time;
+  Tablebases::Config tb;
+
+  // Embedders (see c_api.cpp) clear uciOutput to keep the search off stdout
+  // and get the best thread through onSearchFinished instead. The callbacks
+  // run on the main search thread and must not start a new search themselves.
+  // onIteration gets each PV line the 'info' output would show, as it comes.
+  bool uciOutput = true;
+  std::function<void(const Thread& best)> onSearchFinished;
+  std::function<void(const Search::Iteration& it)> onIteration;
+
+  // "NNUE Int8": evaluate with the int8 feature transformer of the network
+  bool int8Net = false;
+};
+
+} // namespace Stockfish
+
+#endif // #ifndef ENGINE_H_INCLUDED
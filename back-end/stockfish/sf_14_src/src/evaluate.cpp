@@ -62,22 +62,25 @@ namespace Eval {
 
   bool useNNUE;
   string eval_file_loaded = "None";
+  unsigned netGeneration = 0;
 
   /// NNUE::init() tries to load a NNUE network at startup time, or when the engine
   /// receives a UCI command "setoption name EvalFile value nn-[a-z0-9]{12}.nnue"
   /// The name of the NNUE network is always retrieved from the EvalFile option.
+  /// The network is shared by every engine in the process, so the options passed
+  /// in are those of whichever engine last changed "Use NNUE" or "EvalFile".
   /// We search the given network in three locations: internally (the default
   /// network may be embedded in the binary), in the active working directory and
   /// in the engine directory. Distro packagers may define the DEFAULT_NNUE_DIRECTORY
   /// variable to have the engine search in a special directory in their distro.
 
-  void NNUE::init() {
+  void NNUE::init(UCI::OptionsMap& options) {
 
-    useNNUE = Options["Use NNUE"];
+    useNNUE = options["Use NNUE"];
     if (!useNNUE)
         return;
 
-    string eval_file = string(Options["EvalFile"]);
+    string eval_file = string(options["EvalFile"]);
 
     #if defined(DEFAULT_NNUE_DIRECTORY)
     #define stringify2(x) #x
@@ -90,14 +93,20 @@ namespace Eval {
     for (string directory : dirs)
         if (eval_file_loaded != eval_file)
         {
+            // Even a failed load may have overwritten part of the weights
+            ++netGeneration;
+
             if (directory != "<internal>")
             {
                 ifstream stream(directory + eval_file, ios::binary);
-                if (load_eval(eval_file, stream))
+                if (   load_image(eval_file, directory + eval_file)
+                    || (stream && load_eval(eval_file, stream)))
                     eval_file_loaded = eval_file;
             }
 
-            if (directory == "<internal>" && eval_file == EvalFileDefaultName)
+            // Without embedding there is only a one byte placeholder, not worth
+            // allocating a network for
+            if (directory == "<internal>" && eval_file == EvalFileDefaultName && gEmbeddedNNUESize > 1)
             {
                 // C++ way to prepare a buffer for a memory stream
                 class MemoryBuffer : public basic_streambuf<char> {
@@ -115,19 +124,16 @@ namespace Eval {
   }
 
   /// NNUE::verify() verifies that the last net used was loaded successfully
-  void NNUE::verify() {
+  void NNUE::verify(UCI::OptionsMap& options) {
 
-    string eval_file = string(Options["EvalFile"]);
+    string eval_file = string(options["EvalFile"]);
 
     if (useNNUE && eval_file_loaded != eval_file)
     {
-        UCI::OptionsMap defaults;
-        UCI::init(defaults);
-
         string msg1 = "If the UCI option \"Use NNUE\" is set to true, network evaluation parameters compatible with the engine must be available.";
         string msg2 = "The option is set to true, but the network file " + eval_file + " was not loaded successfully.";
         string msg3 = "The UCI option EvalFile might need to specify the full path, including the directory name, to the network file.";
-        string msg4 = "The default net can be downloaded from: https://tests.stockfishchess.org/api/nn/" + string(defaults["EvalFile"]);
+        string msg4 = "The default net can be downloaded from: https://tests.stockfishchess.org/api/nn/" + string(EvalFileDefaultName);
         string msg5 = "The engine will be terminated now.";
 
         sync_cout << "info string ERROR: " << msg1 << sync_endl;
@@ -139,8 +145,12 @@ namespace Eval {
         exit(EXIT_FAILURE);
     }
 
+    // The int8 transformer is built by the first engine that asks for it
+    bool int8 = useNNUE && options["NNUE Int8"] && quantize();
+
     if (useNNUE)
-        sync_cout << "info string NNUE evaluation using " << eval_file << " enabled" << sync_endl;
+        sync_cout << "info string NNUE evaluation using " << eval_file
+                  << (int8 ? " (int8)" : "") << " enabled" << sync_endl;
     else
         sync_cout << "info string classical evaluation enabled" << sync_endl;
   }
@@ -23,6 +23,7 @@
 #include <optional>
 
 #include "types.h"
+#include "uci.h"
 
 namespace Stockfish {
 
@@ -35,6 +36,7 @@ namespace Eval {
 
   extern bool useNNUE;
   extern std::string eval_file_loaded;
+  extern unsigned netGeneration; // Changes with every network (re)load
 
   // The default net name MUST follow the format nn-[SHA256 first 12 digits].nnue
   // for the build process (profile-build and fishtest) to work. Do not change the
@@ -45,13 +47,18 @@ namespace Eval {
 
     std::string trace(Position& pos);
     Value evaluate(const Position& pos, bool adjusted = false);
+    void evaluate(const Position* const* pos, std::size_t n, Value* out);
+    void evaluate(Position& pos, const Move* moves, std::size_t n, Value* out);
 
-    void init();
-    void verify();
+    void init(UCI::OptionsMap& options);
+    void verify(UCI::OptionsMap& options);
 
     bool load_eval(std::string name, std::istream& stream);
     bool save_eval(std::ostream& stream);
     bool save_eval(const std::optional<std::string>& filename);
+    bool load_image(std::string name, const std::string& path);
+    bool save_image(const std::string& filename);
+    bool quantize();
 
   } // namespace NNUE
 
@@ -20,6 +20,7 @@
 
 #include "bitboard.h"
 #include "endgame.h"
+#include "engine.h"
 #include "position.h"
 #include "psqt.h"
 #include "search.h"
@@ -35,19 +36,16 @@ int main(int argc, char* argv[]) {
   std::cout << engine_info() << std::endl;
 
   CommandLine::init(argc, argv);
-  UCI::init(Options);
-  Tune::init();
-  PSQT::init();
-  Bitboards::init();
-  Position::init();
-  Bitbases::init();
-  Endgames::init();
-  Threads.set(size_t(Options["Threads"]));
-  Search::clear(); // After threads are up
-  Eval::NNUE::init();
-
-  UCI::loop(argc, argv);
-
-  Threads.set(0);
+  Engine engine;                      Startup::mark("engine");
+  Tune::init(engine.options);
+  PSQT::init();                       Startup::mark("psqt");
+  Bitboards::init();                  Startup::mark("bitboards");
+  Position::init();                   Startup::mark("position");
+  Endgames::init();                   Startup::mark("endgames");
+  Search::init();                     Startup::mark("search");
+  Eval::NNUE::init(engine.options);   Startup::mark("nnue");
+
+  UCI::loop(engine, argc, argv);
+
   return 0;
 }
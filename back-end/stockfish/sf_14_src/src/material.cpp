@@ -126,10 +126,13 @@ namespace Material {
 Entry* probe(const Position& pos) {
 
   Key key = pos.material_key();
-  Entry* e = pos.this_thread()->materialTable[key];
+  Table& table = pos.this_thread()->materialTable;
+  Entry* e = table[key];
 
   if (e->key == key)
-      return e;
+      return ++table.hits, e;
+
+  ++table.misses;
 
   std::memset(e, 0, sizeof(Entry));
   e->key = key;
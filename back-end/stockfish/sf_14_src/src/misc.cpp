@@ -39,16 +39,23 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 }
 #endif
 
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <vector>
 #include <cstdlib>
 
 #if defined(__linux__) && !defined(__ANDROID__)
 #include <stdlib.h>
+#include <sched.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <linux/perf_event.h>
 #endif
 
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) || (defined(__GLIBCXX__) && !defined(_GLIBCXX_HAVE_ALIGNED_ALLOC) && !defined(_WIN32)) || defined(__e2k__)
@@ -237,6 +244,9 @@ std::string compiler_info() {
   #if defined(USE_VNNI)
     compiler += " VNNI";
   #endif
+  #if defined(USE_AVXVNNI)
+    compiler += " AVXVNNI";
+  #endif
   #if defined(USE_AVX512)
     compiler += " AVX512";
   #endif
@@ -260,6 +270,9 @@ std::string compiler_info() {
   #if defined(USE_NEON)
     compiler += " NEON";
   #endif
+  #if defined(USE_NEON_DOTPROD)
+    compiler += " DOTPROD";
+  #endif
 
   #if !defined(NDEBUG)
     compiler += " DEBUG";
@@ -591,6 +604,154 @@ void bindThisThread(size_t idx) {
 
 } // namespace WinProcGroup
 
+
+namespace Numa {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+namespace {
+
+  struct Node {
+    int id;
+    std::vector<int> cpus;
+  };
+
+  // parse_list() reads a sysfs list like "0-15,32-47"
+
+  std::vector<int> parse_list(const string& path) {
+
+    std::vector<int> list;
+    std::ifstream file(path);
+    string range;
+
+    while (std::getline(file, range, ','))
+    {
+        int first, last;
+        char dash;
+        std::istringstream ss(range);
+
+        if (!(ss >> first))
+            break;
+
+        last = (ss >> dash >> last) ? last : first;
+
+        for (int i = first; i <= last; ++i)
+            list.push_back(i);
+    }
+
+    return list;
+  }
+
+  // topology() is read once, the first time it is needed
+
+  const std::vector<Node>& topology() {
+
+    static const std::vector<Node> nodes = []() {
+
+        std::vector<Node> v;
+
+        for (int id : parse_list("/sys/devices/system/node/online"))
+        {
+            std::vector<int> cpus = parse_list("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            if (!cpus.empty())
+                v.push_back({id, cpus});
+        }
+
+        return v;
+    }();
+
+    return nodes;
+  }
+
+} // namespace
+
+size_t nodes() {
+
+  return std::max(topology().size(), size_t(1));
+}
+
+
+/// bind_thread() restricts the calling thread to the CPUs of its node, so that
+/// the memory it touches first is allocated there
+
+void bind_thread(size_t idx) {
+
+  if (nodes() < 2)
+      return;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  for (int cpu : topology()[node_of(idx)].cpus)
+      if (cpu < CPU_SETSIZE)
+          CPU_SET(cpu, &set);
+
+  sched_setaffinity(0, sizeof(set), &set);
+}
+
+
+/// bind_cpu() pins the calling thread to the idx-th CPU the process may run on,
+/// round-robin. The CPUs are listed in order, so that on the usual numbering the
+/// physical cores are taken before their SMT siblings.
+
+void bind_cpu(size_t idx) {
+
+  static const std::vector<int> cpus = []() {
+
+      std::vector<int> v;
+      cpu_set_t set;
+
+      if (!sched_getaffinity(0, sizeof(set), &set))
+          for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+              if (CPU_ISSET(cpu, &set))
+                  v.push_back(cpu);
+
+      return v;
+  }();
+
+  if (cpus.empty())
+      return;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpus[idx % cpus.size()], &set);
+
+  sched_setaffinity(0, sizeof(set), &set);
+}
+
+
+/// interleave() spreads the pages of 'mem' round-robin over all the nodes. It
+/// must be called before the memory is touched. We call mbind() directly so as
+/// not to depend on libnuma.
+
+void interleave(void* mem, size_t size) {
+
+  constexpr int MPOL_INTERLEAVE_ = 3;
+  constexpr size_t Bits = 8 * sizeof(unsigned long);
+
+  if (nodes() < 2)
+      return;
+
+  std::vector<unsigned long> mask(16);
+
+  for (const Node& n : topology())
+      if (size_t(n.id) < mask.size() * Bits)
+          mask[n.id / Bits] |= 1UL << (n.id % Bits);
+
+  syscall(SYS_mbind, mem, size, MPOL_INTERLEAVE_, mask.data(), mask.size() * Bits, 0);
+}
+
+#else
+
+size_t nodes() { return 1; }
+void bind_thread(size_t) {}
+void bind_cpu(size_t) {}
+void interleave(void*, size_t) {}
+
+#endif
+
+} // namespace Numa
+
 #ifdef _WIN32
 #include <direct.h>
 #define GETCWD _getcwd
@@ -599,6 +760,85 @@ void bindThisThread(size_t idx) {
 #define GETCWD getcwd
 #endif
 
+namespace Perf {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+/// resident() is the resident set size of the process in bytes, the second
+/// field of /proc/self/statm in pages.
+
+size_t resident() {
+
+  size_t pages = 0, rss = 0;
+  std::ifstream("/proc/self/statm") >> pages >> rss;
+  return rss * size_t(sysconf(_SC_PAGESIZE));
+}
+
+
+/// CacheMisses() opens a hardware cache miss counter for each thread of the
+/// process, as listed in /proc/self/task. If any of them fails the counting
+/// is given up, a partial count would be misleading.
+
+CacheMisses::CacheMisses() {
+
+  perf_event_attr attr = {};
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.exclude_kernel = attr.exclude_hv = 1;
+
+  DIR* dir = opendir("/proc/self/task");
+  if (!dir)
+      return;
+
+  bool failed = false;
+  while (dirent* e = readdir(dir))
+      if (e->d_name[0] != '.')
+      {
+          int fd = int(syscall(SYS_perf_event_open, &attr, pid_t(std::atoi(e->d_name)), -1, -1, 0));
+          if (fd < 0)
+              failed = true;
+          else
+              fds.push_back(fd);
+      }
+
+  closedir(dir);
+
+  if (failed)
+  {
+      for (int fd : fds)
+          close(fd);
+      fds.clear();
+  }
+}
+
+CacheMisses::~CacheMisses() {
+
+  for (int fd : fds)
+      close(fd);
+}
+
+uint64_t CacheMisses::count() const {
+
+  uint64_t sum = 0, n;
+  for (int fd : fds)
+      if (read(fd, &n, sizeof(n)) == sizeof(n))
+          sum += n;
+  return sum;
+}
+
+#else
+
+size_t resident() { return 0; }
+CacheMisses::CacheMisses() {}
+CacheMisses::~CacheMisses() {}
+uint64_t CacheMisses::count() const { return 0; }
+
+#endif
+
+} // namespace Perf
+
+
 namespace CommandLine {
 
 string argv0;            // path+name of the executable binary, as given by argv[0]
@@ -648,4 +888,65 @@ void init(int argc, char* argv[]) {
 
 } // namespace CommandLine
 
+namespace Startup {
+
+namespace {
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Step {
+    string name;
+    Clock::duration duration;
+    bool lazy;
+  };
+
+  std::mutex mutex;
+  Clock::time_point last = Clock::now(); // Static initialization, close enough to exec()
+  vector<Step> steps;
+}
+
+void mark(const string& step) {
+
+  std::lock_guard<std::mutex> lk(mutex);
+
+  Clock::time_point t = Clock::now();
+  steps.push_back({step, t - last, false});
+  last = t;
+}
+
+void lazy(const string& step, Clock::duration d) {
+
+  std::lock_guard<std::mutex> lk(mutex);
+
+  steps.push_back({step, d, true});
+}
+
+string report() {
+
+  std::lock_guard<std::mutex> lk(mutex);
+
+  std::stringstream ss;
+  Clock::duration total = Clock::duration::zero();
+
+  auto line = [&](const string& name, Clock::duration d, const char* note) {
+      ss << std::setw(12) << std::left << name << std::right << std::fixed << std::setprecision(3)
+         << std::setw(9) << std::chrono::duration<double, std::milli>(d).count() << " ms" << note << "\n";
+  };
+
+  for (const Step& s : steps)
+  {
+      line(s.name, s.duration, s.lazy ? " (lazy, on first use)" : "");
+      if (!s.lazy)
+          total += s.duration;
+  }
+
+  line("total", total, "");
+
+  string r = ss.str();
+  r.pop_back();
+  return r;
+}
+
+} // namespace Startup
+
 } // namespace Stockfish
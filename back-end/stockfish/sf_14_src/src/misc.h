@@ -51,12 +51,35 @@ inline TimePoint now() {
         (std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
+/// HashTable is a per-thread table of Size entries by default, resizable at
+/// run time. The owner counts its hits and misses, not atomically since only
+/// its thread probes it.
+
 template<class Entry, int Size>
 struct HashTable {
-  Entry* operator[](Key key) { return &table[(uint32_t)key & (Size - 1)]; }
+  Entry* operator[](Key key) { return &table[(uint32_t)key & mask]; }
+
+  // Rounds down to a power of two. A new size drops the entries and counts.
+  void resize(size_t size) {
+    size_t n = 1;
+    while (n <= size / 2)
+        n *= 2;
+
+    if (n != table.size())
+    {
+        table = std::vector<Entry>(n);
+        mask = uint32_t(n - 1);
+        hits = misses = 0;
+    }
+  }
+
+  size_t size() const { return table.size(); }
+
+  uint64_t hits = 0, misses = 0;
 
 private:
   std::vector<Entry> table = std::vector<Entry>(Size); // Allocate on the heap
+  uint32_t mask = Size - 1;
 };
 
 
@@ -188,6 +211,42 @@ namespace WinProcGroup {
   void bindThisThread(size_t idx);
 }
 
+/// Numa reads the NUMA topology of Linux machines from sysfs and binds threads
+/// and memory to the nodes. Thread idx goes to node idx % nodes(). Elsewhere,
+/// or on single node machines, nodes() is 1 and binding does nothing.
+
+namespace Numa {
+  enum Policy { FIRST_TOUCH, INTERLEAVE, LOCAL };
+
+  size_t nodes();
+  inline size_t node_of(size_t idx) { return idx % nodes(); }
+  void bind_thread(size_t idx);
+  void bind_cpu(size_t idx);
+  void interleave(void* mem, size_t size);
+}
+
+/// Perf reads the resident memory of the process and counts the cache misses
+/// of its threads with the Linux perf events. Elsewhere, or where the kernel
+/// does not allow hardware counters as in most containers, resident() is 0
+/// and a CacheMisses is not available().
+
+namespace Perf {
+  size_t resident();
+
+  class CacheMisses {
+    std::vector<int> fds; // One counter per thread running when constructed
+
+  public:
+    CacheMisses();
+    ~CacheMisses();
+    CacheMisses(const CacheMisses&) = delete;
+    CacheMisses& operator=(const CacheMisses&) = delete;
+
+    bool available() const { return !fds.empty(); }
+    uint64_t count() const;
+  };
+}
+
 namespace CommandLine {
   void init(int argc, char* argv[]);
 
@@ -195,6 +254,16 @@ namespace CommandLine {
   extern std::string workingDirectory; // path of the working directory
 }
 
+/// Startup keeps the time spent in each initialization step, for the 'startup'
+/// command. mark() ends a step begun at the previous mark, or at the start of
+/// the process for the first one. Tables built lazily on first use report
+/// themselves with lazy() when that happens, they are not part of the total.
+namespace Startup {
+  void mark(const std::string& step);
+  void lazy(const std::string& step, std::chrono::steady_clock::duration d);
+  std::string report();
+}
+
 } // namespace Stockfish
 
 #endif // #ifndef MISC_H_INCLUDED
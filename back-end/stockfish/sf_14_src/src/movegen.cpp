@@ -220,6 +220,99 @@ namespace {
     return moveList;
   }
 
+
+  template<Color Us, PieceType Pt>
+  ExtMove* generate_legal_moves(const Position& pos, ExtMove* moveList, Bitboard target, Square ksq) {
+
+    const Bitboard pinned = pos.blockers_for_king(Us) & pos.pieces(Us);
+
+    // A pinned knight can never move, other pinned pieces stay on their line
+    Bitboard bb = pos.pieces(Us, Pt) & (Pt == KNIGHT ? ~pinned : AllSquares);
+
+    while (bb)
+    {
+        Square from = pop_lsb(bb);
+        Bitboard b = attacks_bb<Pt>(from, pos.pieces()) & target;
+
+        if (pinned & from)
+            b &= line_bb(ksq, from);
+
+        while (b)
+            *moveList++ = make_move(from, pop_lsb(b));
+    }
+
+    return moveList;
+  }
+
+
+  // generate_legal() generates only legal moves, in the order of the
+  // pseudo-legal generators. The check and the pins are resolved once for the
+  // position, Position::legal() is left to en passant and castling.
+  template<Color Us>
+  ExtMove* generate_legal(const Position& pos, ExtMove* moveList) {
+
+    constexpr Color Them = ~Us;
+    const Square ksq = pos.square<KING>(Us);
+    const Bitboard checkers = pos.checkers();
+
+    // Skip generating non-king moves when in double check
+    if (!more_than_one(checkers))
+    {
+        // Non-king moves must capture or block the checker, if any
+        Bitboard target = ~pos.pieces(Us) & (checkers ? between_bb(ksq, lsb(checkers)) : AllSquares);
+        Bitboard pinned = pos.blockers_for_king(Us) & pos.pieces(Us);
+        ExtMove* cur = moveList;
+
+        moveList = checkers ? generate_pawn_moves<Us, EVASIONS    >(pos, moveList, target)
+                            : generate_pawn_moves<Us, NON_EVASIONS>(pos, moveList, target);
+
+        // Keep pinned pawns on their line. En passant may uncover the king
+        // along a rank, so it gets the full test.
+        while (cur != moveList)
+            if (  (type_of(*cur) == EN_PASSANT && !pos.legal(*cur))
+                || (pinned & from_sq(*cur) && !(line_bb(ksq, from_sq(*cur)) & to_sq(*cur))))
+                *cur = (--moveList)->move;
+            else
+                ++cur;
+
+        moveList = generate_legal_moves<Us, KNIGHT>(pos, moveList, target, ksq);
+        moveList = generate_legal_moves<Us, BISHOP>(pos, moveList, target, ksq);
+        moveList = generate_legal_moves<Us,   ROOK>(pos, moveList, target, ksq);
+        moveList = generate_legal_moves<Us,  QUEEN>(pos, moveList, target, ksq);
+    }
+
+    // The squares the enemy attacks, with sliders seeing through our king so
+    // that it cannot step back along the line of a check
+    Bitboard occupied = pos.pieces() ^ ksq;
+    Bitboard danger =  pawn_attacks_bb<Them>(pos.pieces(Them, PAWN))
+                     | attacks_bb<KING>(pos.square<KING>(Them));
+
+    for (Bitboard b = pos.pieces(Them, KNIGHT); b; )
+        danger |= attacks_bb<KNIGHT>(pop_lsb(b));
+
+    for (Bitboard b = pos.pieces(Them, BISHOP, QUEEN); b; )
+        danger |= attacks_bb<BISHOP>(pop_lsb(b), occupied);
+
+    for (Bitboard b = pos.pieces(Them, ROOK, QUEEN); b; )
+        danger |= attacks_bb<ROOK>(pop_lsb(b), occupied);
+
+    Bitboard b = attacks_bb<KING>(ksq) & ~pos.pieces(Us) & ~danger;
+
+    while (b)
+        *moveList++ = make_move(ksq, pop_lsb(b));
+
+    if (!checkers && pos.can_castle(Us & ANY_CASTLING))
+        for (CastlingRights cr : { Us & KING_SIDE, Us & QUEEN_SIDE } )
+            if (!pos.castling_impeded(cr) && pos.can_castle(cr))
+            {
+                Move m = make<CASTLING>(ksq, pos.castling_rook_square(cr));
+                if (pos.legal(m))
+                    *moveList++ = m;
+            }
+
+    return moveList;
+  }
+
 } // namespace
 
 
@@ -256,21 +349,8 @@ template ExtMove* generate<NON_EVASIONS>(const Position&, ExtMove*);
 template<>
 ExtMove* generate<LEGAL>(const Position& pos, ExtMove* moveList) {
 
-  Color us = pos.side_to_move();
-  Bitboard pinned = pos.blockers_for_king(us) & pos.pieces(us);
-  Square ksq = pos.square<KING>(us);
-  ExtMove* cur = moveList;
-
-  moveList = pos.checkers() ? generate<EVASIONS    >(pos, moveList)
-                            : generate<NON_EVASIONS>(pos, moveList);
-  while (cur != moveList)
-      if (  ((pinned && pinned & from_sq(*cur)) || from_sq(*cur) == ksq || type_of(*cur) == EN_PASSANT)
-          && !pos.legal(*cur))
-          *cur = (--moveList)->move;
-      else
-          ++cur;
-
-  return moveList;
+  return pos.side_to_move() == WHITE ? generate_legal<WHITE>(pos, moveList)
+                                     : generate_legal<BLACK>(pos, moveList);
 }
 
 } // namespace Stockfish
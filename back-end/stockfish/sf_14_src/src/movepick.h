@@ -78,6 +78,24 @@ struct Stats : public std::array<Stats<T, D, Sizes...>, Size>
 template <typename T, int D, int Size>
 struct Stats<T, D, Size> : public std::array<StatsEntry<T, D>, Size> {};
 
+/// PieceStats is a Stats table whose first dimension is a piece. Only the twelve
+/// real pieces and NO_PIECE, the sentinel of the continuation histories, are
+/// stored instead of PIECE_NB codes: the unused codes between the two colors
+/// are squeezed out of the index, so the tables, and most of all the nested
+/// continuation histories, are smaller and touch fewer cache lines.
+constexpr int PIECE_SLOT_NB = 13;
+
+constexpr int piece_slot(Piece pc) { return pc - 2 * (pc >> 3); }
+
+template <typename T, int D, int... Sizes>
+struct PieceStats : public Stats<T, D, PIECE_SLOT_NB, Sizes...>
+{
+  typedef Stats<T, D, PIECE_SLOT_NB, Sizes...> stats;
+
+  auto& operator[](Piece pc) { return stats::operator[](piece_slot(pc)); }
+  const auto& operator[](Piece pc) const { return stats::operator[](piece_slot(pc)); }
+};
+
 /// In stats table, D=0 means that the template parameter is not used
 enum StatsParams { NOT_USED = 0 };
 enum StatsType { NoCaptures, Captures };
@@ -96,18 +114,18 @@ typedef Stats<int16_t, 10692, MAX_LPH, int(SQUARE_NB) * int(SQUARE_NB)> LowPlyHi
 
 /// CounterMoveHistory stores counter moves indexed by [piece][to] of the previous
 /// move, see www.chessprogramming.org/Countermove_Heuristic
-typedef Stats<Move, NOT_USED, PIECE_NB, SQUARE_NB> CounterMoveHistory;
+typedef PieceStats<Move, NOT_USED, SQUARE_NB> CounterMoveHistory;
 
 /// CapturePieceToHistory is addressed by a move's [piece][to][captured piece type]
-typedef Stats<int16_t, 10692, PIECE_NB, SQUARE_NB, PIECE_TYPE_NB> CapturePieceToHistory;
+typedef PieceStats<int16_t, 10692, SQUARE_NB, PIECE_TYPE_NB> CapturePieceToHistory;
 
 /// PieceToHistory is like ButterflyHistory but is addressed by a move's [piece][to]
-typedef Stats<int16_t, 29952, PIECE_NB, SQUARE_NB> PieceToHistory;
+typedef PieceStats<int16_t, 29952, SQUARE_NB> PieceToHistory;
 
 /// ContinuationHistory is the combined history of a given pair of moves, usually
 /// the current one given a previous one. The nested history table is based on
 /// PieceToHistory instead of ButterflyBoards.
-typedef Stats<PieceToHistory, NOT_USED, PIECE_NB, SQUARE_NB> ContinuationHistory;
+typedef PieceStats<PieceToHistory, NOT_USED, SQUARE_NB> ContinuationHistory;
 
 
 /// MovePicker class is used to pick one pseudo-legal move at a time from the
@@ -121,6 +139,16 @@ class MovePicker {
   enum PickType { Next, Best };
 
 public:
+  // The stages of the picker. Once next_move() has returned the TT move the
+  // stage is already the *_INIT one that follows it.
+  enum Stages {
+    MAIN_TT, CAPTURE_INIT, GOOD_CAPTURE, REFUTATION, QUIET_INIT, QUIET, BAD_CAPTURE,
+    EVASION_TT, EVASION_INIT, EVASION,
+    PROBCUT_TT, PROBCUT_INIT, PROBCUT,
+    QSEARCH_TT, QCAPTURE_INIT, QCAPTURE, QCHECK_INIT, QCHECK,
+    STAGE_NB
+  };
+
   MovePicker(const MovePicker&) = delete;
   MovePicker& operator=(const MovePicker&) = delete;
   MovePicker(const Position&, Move, Value, const CapturePieceToHistory*);
@@ -136,6 +164,7 @@ public:
                                            const Move*,
                                            int);
   Move next_move(bool skipQuiets = false);
+  int current_stage() const { return stage; }
 
 private:
   template<PickType T, typename Pred> Move select(Pred);
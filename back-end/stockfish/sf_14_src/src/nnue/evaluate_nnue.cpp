@@ -18,15 +18,29 @@
 
 // Code for calculating NNUE evaluation function
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <iomanip>
 #include <fstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "../evaluate.h"
 #include "../position.h"
+#include "../engine.h"
 #include "../misc.h"
+#include "../thread.h"
 #include "../uci.h"
 #include "../types.h"
 
@@ -34,8 +48,11 @@
 
 namespace Stockfish::Eval::NNUE {
 
-  // Input feature converter
+  // Input feature converter, and its int8 quantization for the engines with
+  // "NNUE Int8", built when first needed
   LargePagePtr<FeatureTransformer> featureTransformer;
+  LargePagePtr<CompactFeatureTransformer> compactTransformer;
+  std::mutex compactMutex;
 
   // Evaluation function
   AlignedPtr<Network> network[LayerStacks];
@@ -44,6 +61,72 @@ namespace Stockfish::Eval::NNUE {
   std::string fileName;
   std::string netDescription;
 
+  // A network image is the in-memory layout of the parameters written out as
+  // it is, each part at a page boundary, so that loading it is a mmap() and
+  // processes using the same image share its pages through the page cache.
+  // It holds both feature transformers, a process only reads in the pages of
+  // the one its engines use.
+  // Images depend on the build: the layer sizes and the weight order differ
+  // between architectures, so they are checked on load.
+  constexpr std::size_t ImagePage = 4096;
+
+  struct ImageHeader {
+    char magic[8];
+    std::uint32_t hashValue;
+    std::uint32_t layout;
+    std::uint64_t transformerSize;
+    std::uint64_t compactSize;
+    std::uint64_t networkSize;
+    std::uint32_t descriptionSize;
+    char description[ImagePage - 44];
+  };
+
+  static_assert(sizeof(ImageHeader) == ImagePage);
+  static_assert(alignof(FeatureTransformer) <= ImagePage && alignof(Network) <= ImagePage);
+
+  constexpr char ImageMagic[8] = "SFNNIM2";
+
+  constexpr std::size_t page_ceil(std::size_t n) {
+    return (n + ImagePage - 1) / ImagePage * ImagePage;
+  }
+
+  constexpr std::size_t CompactOffset = ImagePage + page_ceil(sizeof(FeatureTransformer));
+  constexpr std::size_t NetworkOffset = CompactOffset + page_ceil(sizeof(CompactFeatureTransformer));
+  constexpr std::size_t ImageSize = NetworkOffset + LayerStacks * page_ceil(sizeof(Network));
+
+  // Weight order of the affine layers and byte order of this build
+  std::uint32_t image_layout() {
+#if defined(USE_SSSE3)
+    return 1 | (IsLittleEndian ? 0 : 2);
+#else
+    return 0 | (IsLittleEndian ? 0 : 2);
+#endif
+  }
+
+  // The mapping of the image in use, if any. It is destroyed before the
+  // network pointers above, which must not free mapped memory.
+  struct Image {
+    void* base = nullptr;
+    ~Image() { release(); }
+    void release();
+  } image;
+
+  void Image::release() {
+
+    if (!base)
+        return;
+
+    featureTransformer.release();
+    compactTransformer.release();
+    for (std::size_t i = 0; i < LayerStacks; ++i)
+        network[i].release();
+
+#ifndef _WIN32
+    munmap(base, ImageSize);
+#endif
+    base = nullptr;
+  }
+
   namespace Detail {
 
   // Initialize the evaluation function parameters
@@ -85,7 +168,9 @@ namespace Stockfish::Eval::NNUE {
   // Initialize the evaluation function parameters
   void initialize() {
 
+    image.release();
     Detail::initialize(featureTransformer);
+    compactTransformer.reset();
     for (std::size_t i = 0; i < LayerStacks; ++i)
       Detail::initialize(network[i]);
   }
@@ -136,6 +221,38 @@ namespace Stockfish::Eval::NNUE {
     return (bool)stream;
   }
 
+  // The refresh cache of the position's thread, positions without one refresh
+  // from scratch
+  static AccumulatorCache* cache_of(const Position& pos) {
+
+    return pos.this_thread() ? &pos.this_thread()->accumulatorCache : nullptr;
+  }
+
+  // Convert the input features of the position with the transformer its engine
+  // uses: the int8 one for "NNUE Int8", once built
+  static std::int32_t transform(const Position& pos, TransformedFeatureType* output, int bucket) {
+
+    const Thread* th = pos.this_thread();
+    return th && th->engine.int8Net && compactTransformer
+          ? compactTransformer->transform(pos, cache_of(pos), output, bucket)
+          : featureTransformer->transform(pos, cache_of(pos), output, bucket);
+  }
+
+  // Build the int8 transformer of the loaded network, if not done yet
+  bool quantize() {
+
+    std::lock_guard<std::mutex> lk(compactMutex);
+
+    if (compactTransformer || fileName.empty())
+        return bool(compactTransformer);
+
+    LargePagePtr<CompactFeatureTransformer> compact;
+    Detail::initialize(compact);
+    compact->quantize(*featureTransformer);
+    compactTransformer = std::move(compact);
+    return true;
+  }
+
   // Evaluation function. Perform differential calculation.
   Value evaluate(const Position& pos, bool adjusted) {
 
@@ -161,7 +278,7 @@ namespace Stockfish::Eval::NNUE {
     ASSERT_ALIGNED(buffer, alignment);
 
     const std::size_t bucket = (pos.count<ALL_PIECES>() - 1) / 4;
-    const auto psqt = featureTransformer->transform(pos, transformedFeatures, bucket);
+    const auto psqt = transform(pos, transformedFeatures, bucket);
     const auto output = network[bucket]->propagate(transformedFeatures, buffer);
 
     int materialist = psqt;
@@ -178,6 +295,77 @@ namespace Stockfish::Eval::NNUE {
     return static_cast<Value>( sum / OutputScale );
   }
 
+  // A position of a batch after the feature transformer, waiting for its layer stack
+  struct alignas(CacheLineSize) Transformed {
+    TransformedFeatureType features[FeatureTransformer::BufferSize];
+    std::int32_t psqt;
+    std::size_t bucket;
+  };
+
+  static void transform(const Position& pos, Transformed& t) {
+
+    t.bucket = (pos.count<ALL_PIECES>() - 1) / 4;
+    t.psqt = transform(pos, t.features, t.bucket);
+  }
+
+  // Runs the layer stacks over a whole batch, one stack at a time, so that
+  // the weights of each stack are brought into the cache once per batch.
+  static void propagate(const std::vector<Transformed>& batch, Value* out) {
+
+    constexpr uint64_t alignment = CacheLineSize;
+
+#if defined(ALIGNAS_ON_STACK_VARIABLES_BROKEN)
+    char bufferUnaligned[Network::BufferSize + alignment];
+    auto* buffer = align_ptr_up<alignment>(&bufferUnaligned[0]);
+#else
+    alignas(alignment) char buffer[Network::BufferSize];
+#endif
+
+    ASSERT_ALIGNED(buffer, alignment);
+
+    for (std::size_t bucket = 0; bucket < LayerStacks; ++bucket)
+      for (std::size_t i = 0; i < batch.size(); ++i)
+        if (batch[i].bucket == bucket)
+        {
+          const auto output = network[bucket]->propagate(batch[i].features, buffer);
+          out[i] = static_cast<Value>((batch[i].psqt + output[0]) / OutputScale);
+        }
+  }
+
+  // Evaluation of many positions at once, as evaluate(pos, false) would do one
+  // by one. Positions sharing a StateInfo chain, like the ones of a game, get
+  // incremental accumulator updates if they come in the order they were played.
+  void evaluate(const Position* const* pos, std::size_t n, Value* out) {
+
+    std::vector<Transformed> batch(n);
+
+    for (std::size_t i = 0; i < n; ++i)
+      transform(*pos[i], batch[i]);
+
+    propagate(batch, out);
+  }
+
+  // Evaluation of a whole game: 'pos' and then the position after each move,
+  // n + 1 values in all. 'pos' is left as it was.
+  void evaluate(Position& pos, const Move* moves, std::size_t n, Value* out) {
+
+    std::vector<Transformed> batch(n + 1);
+    std::deque<StateInfo> states(n);
+
+    transform(pos, batch[0]);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      pos.do_move(moves[i], states[i]);
+      transform(pos, batch[i + 1]);
+    }
+
+    for (std::size_t i = n; i > 0; --i)
+      pos.undo_move(moves[i - 1]);
+
+    propagate(batch, out);
+  }
+
   struct NnueEvalTrace {
     static_assert(LayerStacks == PSQTBuckets);
 
@@ -212,7 +400,7 @@ namespace Stockfish::Eval::NNUE {
     NnueEvalTrace t{};
     t.correctBucket = (pos.count<ALL_PIECES>() - 1) / 4;
     for (std::size_t bucket = 0; bucket < LayerStacks; ++bucket) {
-      const auto psqt = featureTransformer->transform(pos, transformedFeatures, bucket);
+      const auto psqt = transform(pos, transformedFeatures, bucket);
       const auto output = network[bucket]->propagate(transformedFeatures, buffer);
 
       int materialist = psqt;
@@ -409,6 +597,117 @@ namespace Stockfish::Eval::NNUE {
     return write_parameters(stream);
   }
 
+  // Load a network image, see ImageHeader. On Windows the image is read into
+  // allocated memory instead and nothing is shared.
+  bool load_image(std::string name, const std::string& path) {
+
+    ImageHeader header;
+
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && std::size_t(st.st_size) == ImageSize)
+        // Private and writable: only the pages written to, the one holding the
+        // feature transformer's version stamp, get copied.
+        base = mmap(nullptr, ImageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    std::memcpy(&header, base, sizeof(header));
+#else
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+#endif
+
+    bool valid =   std::memcmp(header.magic, ImageMagic, sizeof(ImageMagic)) == 0
+                && header.hashValue == HashValue
+                && header.layout == image_layout()
+                && header.transformerSize == sizeof(FeatureTransformer)
+                && header.compactSize == sizeof(CompactFeatureTransformer)
+                && header.networkSize == sizeof(Network)
+                && header.descriptionSize <= sizeof(header.description);
+
+#ifndef _WIN32
+    if (!valid)
+    {
+        munmap(base, ImageSize);
+        return false;
+    }
+
+    image.release();
+    featureTransformer.reset(reinterpret_cast<FeatureTransformer*>(static_cast<char*>(base) + ImagePage));
+    compactTransformer.reset(reinterpret_cast<CompactFeatureTransformer*>(static_cast<char*>(base) + CompactOffset));
+    for (std::size_t i = 0; i < LayerStacks; ++i)
+        network[i].reset(reinterpret_cast<Network*>(
+            static_cast<char*>(base) + NetworkOffset + i * page_ceil(sizeof(Network))));
+    image.base = base;
+#else
+    if (!valid)
+        return false;
+
+    initialize();
+    Detail::initialize(compactTransformer);
+    stream.read(reinterpret_cast<char*>(featureTransformer.get()), sizeof(FeatureTransformer));
+    stream.seekg(CompactOffset);
+    stream.read(reinterpret_cast<char*>(compactTransformer.get()), sizeof(CompactFeatureTransformer));
+    for (std::size_t i = 0; i < LayerStacks; ++i)
+    {
+        stream.seekg(NetworkOffset + i * page_ceil(sizeof(Network)));
+        stream.read(reinterpret_cast<char*>(network[i].get()), sizeof(Network));
+    }
+    if (!stream)
+        return false;
+#endif
+
+    featureTransformer->stamp();
+    compactTransformer->stamp();
+    fileName = name;
+    netDescription.assign(header.description, header.descriptionSize);
+    return true;
+  }
+
+  // Save the loaded network as an image, see ImageHeader
+  bool save_image(const std::string& filename) {
+
+    if (!quantize())
+        return false;
+
+    ImageHeader header = {};
+    std::memcpy(header.magic, ImageMagic, sizeof(ImageMagic));
+    header.hashValue = HashValue;
+    header.layout = image_layout();
+    header.transformerSize = sizeof(FeatureTransformer);
+    header.compactSize = sizeof(CompactFeatureTransformer);
+    header.networkSize = sizeof(Network);
+    header.descriptionSize = std::uint32_t(std::min(netDescription.size(), sizeof(header.description)));
+    std::memcpy(header.description, netDescription.data(), header.descriptionSize);
+
+    const std::vector<char> padding(ImagePage);
+    std::ofstream stream(filename, std::ios_base::binary);
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(featureTransformer.get()), sizeof(FeatureTransformer));
+    stream.write(padding.data(), page_ceil(sizeof(FeatureTransformer)) - sizeof(FeatureTransformer));
+    stream.write(reinterpret_cast<const char*>(compactTransformer.get()), sizeof(CompactFeatureTransformer));
+    stream.write(padding.data(), page_ceil(sizeof(CompactFeatureTransformer)) - sizeof(CompactFeatureTransformer));
+    for (std::size_t i = 0; i < LayerStacks; ++i)
+    {
+        stream.write(reinterpret_cast<const char*>(network[i].get()), sizeof(Network));
+        stream.write(padding.data(), page_ceil(sizeof(Network)) - sizeof(Network));
+    }
+
+    bool saved = bool(stream);
+    sync_cout << (saved ? "Network image saved successfully to " + filename
+                        : "Failed to export a network image") << sync_endl;
+    return saved;
+  }
+
   /// Save eval, to a file given by its name
   bool save_eval(const std::optional<std::string>& filename) {
 
@@ -70,6 +70,29 @@ namespace Stockfish::Eval::NNUE::Features {
     }
   }
 
+  void HalfKAv2::append_changed_indices(
+    const Position& pos,
+    Color perspective,
+    const Bitboard* byColorBB,
+    const Bitboard* byTypeBB,
+    ValueListInserter<IndexType> removed,
+    ValueListInserter<IndexType> added
+  ) {
+    Square ksq = orient(perspective, pos.square<KING>(perspective));
+    for (Color c : { WHITE, BLACK })
+      for (PieceType pt = PAWN; pt <= KING; ++pt)
+      {
+        Piece pc = make_piece(c, pt);
+        Bitboard before = byColorBB[c] & byTypeBB[pt];
+        Bitboard now = pos.pieces(c, pt);
+
+        for (Bitboard b = before & ~now; b; )
+          removed.push_back(make_index(perspective, pop_lsb(b), pc, ksq));
+        for (Bitboard b = now & ~before; b; )
+          added.push_back(make_index(perspective, pop_lsb(b), pc, ksq));
+      }
+  }
+
   int HalfKAv2::update_cost(StateInfo* st) {
     return st->dirtyPiece.dirty_num;
   }
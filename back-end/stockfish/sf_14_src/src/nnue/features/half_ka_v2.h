@@ -96,6 +96,16 @@ namespace Stockfish::Eval::NNUE::Features {
       ValueListInserter<IndexType> removed,
       ValueListInserter<IndexType> added);
 
+    // Get a list of indices for the features that differ between the pieces
+    // given by 'byColorBB' and 'byTypeBB' and the ones of the position
+    static void append_changed_indices(
+      const Position& pos,
+      Color perspective,
+      const Bitboard* byColorBB,
+      const Bitboard* byTypeBB,
+      ValueListInserter<IndexType> removed,
+      ValueListInserter<IndexType> added);
+
     // Returns the cost of updating one perspective, the most costly one.
     // Assumes no refresh needed.
     static int update_cost(StateInfo* st);
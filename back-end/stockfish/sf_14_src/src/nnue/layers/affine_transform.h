@@ -166,7 +166,9 @@ namespace Stockfish::Eval::NNUE::Layers {
       };
 
       [[maybe_unused]] auto m256_add_dpbusd_epi32 = [=](__m256i& acc, __m256i a, __m256i b) {
-#if defined (USE_VNNI)
+#if defined (USE_AVXVNNI)
+        acc = _mm256_dpbusd_avx_epi32(acc, a, b);
+#elif defined (USE_VNNI)
         acc = _mm256_dpbusd_epi32(acc, a, b);
 #else
         __m256i product0 = _mm256_maddubs_epi16(a, b);
@@ -177,7 +179,12 @@ namespace Stockfish::Eval::NNUE::Layers {
 
       [[maybe_unused]] auto m256_add_dpbusd_epi32x4 = [=](__m256i& acc, __m256i a0, __m256i b0, __m256i a1, __m256i b1,
                                                                         __m256i a2, __m256i b2, __m256i a3, __m256i b3) {
-#if defined (USE_VNNI)
+#if defined (USE_AVXVNNI)
+        acc = _mm256_dpbusd_avx_epi32(acc, a0, b0);
+        acc = _mm256_dpbusd_avx_epi32(acc, a1, b1);
+        acc = _mm256_dpbusd_avx_epi32(acc, a2, b2);
+        acc = _mm256_dpbusd_avx_epi32(acc, a3, b3);
+#elif defined (USE_VNNI)
         acc = _mm256_dpbusd_epi32(acc, a0, b0);
         acc = _mm256_dpbusd_epi32(acc, a1, b1);
         acc = _mm256_dpbusd_epi32(acc, a2, b2);
@@ -340,6 +347,12 @@ namespace Stockfish::Eval::NNUE::Layers {
       const __m64 Zeros = _mm_setzero_si64();
       const auto inputVector = reinterpret_cast<const __m64*>(input);
 
+#elif defined(USE_NEON_DOTPROD)
+      static_assert(InputDimensions % SimdWidth == 0);
+      constexpr IndexType NumChunks = InputDimensions / SimdWidth;
+      // The inputs are clipped to [0, 127], so they can be read as signed for sdot
+      const auto inputVector = reinterpret_cast<const int8x16_t*>(input);
+
 #elif defined(USE_NEON)
       static_assert(InputDimensions % SimdWidth == 0);
       constexpr IndexType NumChunks = InputDimensions / SimdWidth;
@@ -392,6 +405,13 @@ namespace Stockfish::Eval::NNUE::Layers {
         sum = _mm_add_pi32(sum, _mm_unpackhi_pi32(sum, sum));
         output[i] = _mm_cvtsi64_si32(sum);
 
+#elif defined(USE_NEON_DOTPROD)
+        int32x4_t sum = {biases[i]};
+        const auto row = reinterpret_cast<const int8x16_t*>(&weights[offset]);
+        for (IndexType j = 0; j < NumChunks; ++j)
+          sum = vdotq_s32(sum, inputVector[j], row[j]);
+        output[i] = vaddvq_s32(sum);
+
 #elif defined(USE_NEON)
         int32x4_t sum = {biases[i]};
         const auto row = reinterpret_cast<const int8x8_t*>(&weights[offset]);
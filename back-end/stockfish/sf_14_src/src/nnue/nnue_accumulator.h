@@ -32,6 +32,25 @@ namespace Stockfish::Eval::NNUE {
     bool computed[2];
   };
 
+  // AccumulatorCache ("finny tables") keeps, for each king square and
+  // perspective, the accumulator of the last position refreshed with that
+  // king square, and the pieces it was computed from. As the king square
+  // selects the features, a refresh then only needs the pieces that differ
+  // from the cached ones instead of all the pieces on the board.
+  struct AccumulatorCache {
+
+    struct alignas(CacheLineSize) Entry {
+      std::int16_t accumulation[TransformedFeatureDimensions];
+      std::int32_t psqtAccumulation[PSQTBuckets];
+      Bitboard byColorBB[COLOR_NB];
+      Bitboard byTypeBB[PIECE_TYPE_NB];
+    };
+
+    Entry entries[SQUARE_NB][COLOR_NB];
+    std::uint32_t version = 0; // Network the entries are valid for, 0 if none
+    std::uint64_t updates = 0, refreshes = 0; // Accumulators computed either way
+  };
+
 }  // namespace Stockfish::Eval::NNUE
 
 #endif // NNUE_ACCUMULATOR_H_INCLUDED
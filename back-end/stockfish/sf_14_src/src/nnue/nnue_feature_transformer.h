@@ -24,7 +24,10 @@
 #include "nnue_common.h"
 #include "nnue_architecture.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring> // std::memset()
+#include <type_traits>
 
 namespace Stockfish::Eval::NNUE {
 
@@ -47,6 +50,8 @@ namespace Stockfish::Eval::NNUE {
   #define vec_store(a,b) _mm512_store_si512(a,b)
   #define vec_add_16(a,b) _mm512_add_epi16(a,b)
   #define vec_sub_16(a,b) _mm512_sub_epi16(a,b)
+  #define vec_mul_16(a,b) _mm512_mullo_epi16(a,b)
+  #define vec_widen_8(a) _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a)))
   #define vec_load_psqt(a) _mm256_load_si256(a)
   #define vec_store_psqt(a,b) _mm256_store_si256(a,b)
   #define vec_add_psqt_32(a,b) _mm256_add_epi32(a,b)
@@ -61,6 +66,8 @@ namespace Stockfish::Eval::NNUE {
   #define vec_store(a,b) _mm256_store_si256(a,b)
   #define vec_add_16(a,b) _mm256_add_epi16(a,b)
   #define vec_sub_16(a,b) _mm256_sub_epi16(a,b)
+  #define vec_mul_16(a,b) _mm256_mullo_epi16(a,b)
+  #define vec_widen_8(a) _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)))
   #define vec_load_psqt(a) _mm256_load_si256(a)
   #define vec_store_psqt(a,b) _mm256_store_si256(a,b)
   #define vec_add_psqt_32(a,b) _mm256_add_epi32(a,b)
@@ -75,6 +82,13 @@ namespace Stockfish::Eval::NNUE {
   #define vec_store(a,b) *(a)=(b)
   #define vec_add_16(a,b) _mm_add_epi16(a,b)
   #define vec_sub_16(a,b) _mm_sub_epi16(a,b)
+  #define vec_mul_16(a,b) _mm_mullo_epi16(a,b)
+  #ifdef USE_SSE41
+  #define vec_widen_8(a) _mm_cvtepi8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a)))
+  #else
+  #define vec_widen_8(a) _mm_srai_epi16(_mm_unpacklo_epi8(_mm_setzero_si128(), \
+                                        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a))), 8)
+  #endif
   #define vec_load_psqt(a) (*(a))
   #define vec_store_psqt(a,b) *(a)=(b)
   #define vec_add_psqt_32(a,b) _mm_add_epi32(a,b)
@@ -89,6 +103,9 @@ namespace Stockfish::Eval::NNUE {
   #define vec_store(a,b) *(a)=(b)
   #define vec_add_16(a,b) _mm_add_pi16(a,b)
   #define vec_sub_16(a,b) _mm_sub_pi16(a,b)
+  #define vec_mul_16(a,b) _mm_mullo_pi16(a,b)
+  #define vec_widen_8(a) _mm_srai_pi16(_mm_unpacklo_pi8(_mm_setzero_si64(), \
+                                       _mm_cvtsi32_si64(*reinterpret_cast<const int*>(a))), 8)
   #define vec_load_psqt(a) (*(a))
   #define vec_store_psqt(a,b) *(a)=(b)
   #define vec_add_psqt_32(a,b) _mm_add_pi32(a,b)
@@ -103,6 +120,8 @@ namespace Stockfish::Eval::NNUE {
   #define vec_store(a,b) *(a)=(b)
   #define vec_add_16(a,b) vaddq_s16(a,b)
   #define vec_sub_16(a,b) vsubq_s16(a,b)
+  #define vec_mul_16(a,b) vmulq_s16(a,b)
+  #define vec_widen_8(a) vmovl_s8(vld1_s8(a))
   #define vec_load_psqt(a) (*(a))
   #define vec_store_psqt(a,b) *(a)=(b)
   #define vec_add_psqt_32(a,b) vaddq_s32(a,b)
@@ -163,8 +182,20 @@ namespace Stockfish::Eval::NNUE {
 
 
 
-  // Input feature converter
-  class FeatureTransformer {
+  // Stamps of the loaded transformers, shared by both weight types so that an
+  // accumulator cache never takes one for the other
+  inline std::uint32_t TransformerLoads = 0;
+
+  // Input feature converter. The weights are those of the network file, or
+  // int8 ones quantized from them with a scale per output dimension that
+  // take half the memory and cache lines: the accumulators are int16 for
+  // both, the int8 weights are widened and scaled when added.
+  template <typename Weight>
+  class BasicFeatureTransformer {
+
+    template <typename> friend class BasicFeatureTransformer;
+
+    static constexpr bool Compact = std::is_same_v<Weight, std::int8_t>;
 
    private:
     // Number of output dimensions for one side
@@ -201,9 +232,44 @@ namespace Stockfish::Eval::NNUE {
       read_little_endian<WeightType    >(stream, weights    , HalfDimensions * InputDimensions);
       read_little_endian<PSQTWeightType>(stream, psqtWeights, PSQTBuckets    * InputDimensions);
 
+      stamp();
       return !stream.fail();
     }
 
+    // Mark the parameters as new, accumulator caches filled with the previous
+    // network are stale then
+    void stamp() {
+      version = ++TransformerLoads;
+    }
+
+    // Quantize the weights of a full transformer: each output dimension gets
+    // the smallest scale that keeps its weights within int8.
+    void quantize(const BasicFeatureTransformer<WeightType>& full) {
+
+      static_assert(Compact);
+
+      std::memcpy(biases, full.biases, sizeof(biases));
+      std::memcpy(psqtWeights, full.psqtWeights, sizeof(psqtWeights));
+
+      for (IndexType j = 0; j < HalfDimensions; ++j)
+      {
+          int largest = 0;
+          for (IndexType i = 0; i < InputDimensions; ++i)
+              largest = std::max(largest, std::abs(int(full.weights[i * HalfDimensions + j])));
+
+          scales[j] = BiasType(std::max(1, (largest + 126) / 127));
+      }
+
+      for (IndexType i = 0; i < InputDimensions * HalfDimensions; ++i)
+      {
+          const int scale = scales[i % HalfDimensions];
+          const int w = full.weights[i];
+          weights[i] = Weight(std::clamp((w + (w < 0 ? -scale : scale) / 2) / scale, -127, 127));
+      }
+
+      stamp();
+    }
+
     // Write network parameters
     bool write_parameters(std::ostream& stream) const {
 
@@ -214,10 +280,15 @@ namespace Stockfish::Eval::NNUE {
       return !stream.fail();
     }
 
-    // Convert input features
-    std::int32_t transform(const Position& pos, OutputType* output, int bucket) const {
-      update_accumulator(pos, WHITE);
-      update_accumulator(pos, BLACK);
+    // Convert input features. 'cache' may be null, refreshes start from the
+    // biases then.
+    std::int32_t transform(const Position& pos, AccumulatorCache* cache, OutputType* output, int bucket) const {
+
+      if (cache && (cache->version != version || !version))
+          reset(*cache);
+
+      update_accumulator(pos, WHITE, cache);
+      update_accumulator(pos, BLACK, cache);
 
       const Color perspectives[2] = {pos.side_to_move(), ~pos.side_to_move()};
       const auto& accumulation = pos.state()->accumulator.accumulation;
@@ -364,7 +435,45 @@ namespace Stockfish::Eval::NNUE {
 
 
    private:
-    void update_accumulator(const Position& pos, const Color perspective) const {
+    // Weight i, scaled to the accumulator
+    BiasType weight(IndexType i) const {
+      if constexpr (Compact)
+          return BiasType(weights[i] * scales[i % HalfDimensions]);
+      else
+          return weights[i];
+    }
+
+  #ifdef VECTOR
+    // Register k of the weight tile at 'offset', a multiple of TileHeight
+    vec_t weight_tile(IndexType offset, IndexType k) const {
+      if constexpr (Compact)
+      {
+          constexpr IndexType Lanes = sizeof(vec_t) / sizeof(BiasType);
+          const IndexType i = offset + k * Lanes;
+          return vec_mul_16(vec_widen_8(&weights[i]),
+                            vec_load(reinterpret_cast<const vec_t*>(&scales[i % HalfDimensions])));
+      }
+      else
+          return reinterpret_cast<const vec_t*>(&weights[offset])[k];
+    }
+  #endif
+
+    // Empties the cache: every entry gets the accumulator of a board without pieces
+    void reset(AccumulatorCache& cache) const {
+
+      for (auto& entries : cache.entries)
+        for (auto& entry : entries)
+        {
+          std::memcpy(entry.accumulation, biases, HalfDimensions * sizeof(BiasType));
+          std::memset(entry.psqtAccumulation, 0, sizeof(entry.psqtAccumulation));
+          std::memset(entry.byColorBB, 0, sizeof(entry.byColorBB));
+          std::memset(entry.byTypeBB, 0, sizeof(entry.byTypeBB));
+        }
+
+      cache.version = version;
+    }
+
+    void update_accumulator(const Position& pos, const Color perspective, AccumulatorCache* cache) const {
 
       // The size must be enough to contain the largest possible update.
       // That might depend on the feature set and generally relies on the
@@ -399,6 +508,9 @@ namespace Stockfish::Eval::NNUE {
         if (next == nullptr)
           return;
 
+        if (cache)
+          ++cache->updates;
+
         // Update incrementally in two steps. First, we update the "next"
         // accumulator. Then, we update the current accumulator (pos.state()).
 
@@ -433,18 +545,16 @@ namespace Stockfish::Eval::NNUE {
             for (const auto index : removed[i])
             {
               const IndexType offset = HalfDimensions * index + j * TileHeight;
-              auto column = reinterpret_cast<const vec_t*>(&weights[offset]);
               for (IndexType k = 0; k < NumRegs; ++k)
-                acc[k] = vec_sub_16(acc[k], column[k]);
+                acc[k] = vec_sub_16(acc[k], weight_tile(offset, k));
             }
 
             // Difference calculation for the activated features
             for (const auto index : added[i])
             {
               const IndexType offset = HalfDimensions * index + j * TileHeight;
-              auto column = reinterpret_cast<const vec_t*>(&weights[offset]);
               for (IndexType k = 0; k < NumRegs; ++k)
-                acc[k] = vec_add_16(acc[k], column[k]);
+                acc[k] = vec_add_16(acc[k], weight_tile(offset, k));
             }
 
             // Store accumulator
@@ -509,7 +619,7 @@ namespace Stockfish::Eval::NNUE {
             const IndexType offset = HalfDimensions * index;
 
             for (IndexType j = 0; j < HalfDimensions; ++j)
-              st->accumulator.accumulation[perspective][j] -= weights[offset + j];
+              st->accumulator.accumulation[perspective][j] -= weight(offset + j);
 
             for (std::size_t k = 0; k < PSQTBuckets; ++k)
               st->accumulator.psqtAccumulation[perspective][k] -= psqtWeights[index * PSQTBuckets + k];
@@ -521,7 +631,7 @@ namespace Stockfish::Eval::NNUE {
             const IndexType offset = HalfDimensions * index;
 
             for (IndexType j = 0; j < HalfDimensions; ++j)
-              st->accumulator.accumulation[perspective][j] += weights[offset + j];
+              st->accumulator.accumulation[perspective][j] += weight(offset + j);
 
             for (std::size_t k = 0; k < PSQTBuckets; ++k)
               st->accumulator.psqtAccumulation[perspective][k] += psqtWeights[index * PSQTBuckets + k];
@@ -529,6 +639,115 @@ namespace Stockfish::Eval::NNUE {
         }
   #endif
       }
+      else if (cache)
+      {
+        // Refresh the accumulator from the cached one of the same king square,
+        // then store the result back in the cache.
+        auto& accumulator = pos.state()->accumulator;
+        accumulator.computed[perspective] = true;
+        ++cache->refreshes;
+        auto& entry = cache->entries[pos.square<KING>(perspective)][perspective];
+        IndexList removed, added;
+        FeatureSet::append_changed_indices(
+          pos, perspective, entry.byColorBB, entry.byTypeBB, removed, added);
+
+  #ifdef VECTOR
+        for (IndexType j = 0; j < HalfDimensions / TileHeight; ++j)
+        {
+          auto entryTile = reinterpret_cast<vec_t*>(
+              &entry.accumulation[j * TileHeight]);
+          for (IndexType k = 0; k < NumRegs; ++k)
+            acc[k] = vec_load(&entryTile[k]);
+
+          for (const auto index : removed)
+          {
+            const IndexType offset = HalfDimensions * index + j * TileHeight;
+            for (IndexType k = 0; k < NumRegs; ++k)
+              acc[k] = vec_sub_16(acc[k], weight_tile(offset, k));
+          }
+
+          for (const auto index : added)
+          {
+            const IndexType offset = HalfDimensions * index + j * TileHeight;
+            for (IndexType k = 0; k < NumRegs; ++k)
+              acc[k] = vec_add_16(acc[k], weight_tile(offset, k));
+          }
+
+          auto accTile = reinterpret_cast<vec_t*>(
+              &accumulator.accumulation[perspective][j * TileHeight]);
+          for (IndexType k = 0; k < NumRegs; ++k)
+          {
+            vec_store(&entryTile[k], acc[k]);
+            vec_store(&accTile[k], acc[k]);
+          }
+        }
+
+        for (IndexType j = 0; j < PSQTBuckets / PsqtTileHeight; ++j)
+        {
+          auto entryTilePsqt = reinterpret_cast<psqt_vec_t*>(
+              &entry.psqtAccumulation[j * PsqtTileHeight]);
+          for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+            psqt[k] = vec_load_psqt(&entryTilePsqt[k]);
+
+          for (const auto index : removed)
+          {
+            const IndexType offset = PSQTBuckets * index + j * PsqtTileHeight;
+            auto columnPsqt = reinterpret_cast<const psqt_vec_t*>(&psqtWeights[offset]);
+            for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+              psqt[k] = vec_sub_psqt_32(psqt[k], columnPsqt[k]);
+          }
+
+          for (const auto index : added)
+          {
+            const IndexType offset = PSQTBuckets * index + j * PsqtTileHeight;
+            auto columnPsqt = reinterpret_cast<const psqt_vec_t*>(&psqtWeights[offset]);
+            for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+              psqt[k] = vec_add_psqt_32(psqt[k], columnPsqt[k]);
+          }
+
+          auto accTilePsqt = reinterpret_cast<psqt_vec_t*>(
+              &accumulator.psqtAccumulation[perspective][j * PsqtTileHeight]);
+          for (std::size_t k = 0; k < NumPsqtRegs; ++k)
+          {
+            vec_store_psqt(&entryTilePsqt[k], psqt[k]);
+            vec_store_psqt(&accTilePsqt[k], psqt[k]);
+          }
+        }
+
+  #else
+        for (const auto index : removed)
+        {
+          const IndexType offset = HalfDimensions * index;
+
+          for (IndexType j = 0; j < HalfDimensions; ++j)
+            entry.accumulation[j] -= weight(offset + j);
+
+          for (std::size_t k = 0; k < PSQTBuckets; ++k)
+            entry.psqtAccumulation[k] -= psqtWeights[index * PSQTBuckets + k];
+        }
+
+        for (const auto index : added)
+        {
+          const IndexType offset = HalfDimensions * index;
+
+          for (IndexType j = 0; j < HalfDimensions; ++j)
+            entry.accumulation[j] += weight(offset + j);
+
+          for (std::size_t k = 0; k < PSQTBuckets; ++k)
+            entry.psqtAccumulation[k] += psqtWeights[index * PSQTBuckets + k];
+        }
+
+        std::memcpy(accumulator.accumulation[perspective], entry.accumulation,
+            HalfDimensions * sizeof(BiasType));
+        std::memcpy(accumulator.psqtAccumulation[perspective], entry.psqtAccumulation,
+            PSQTBuckets * sizeof(PSQTWeightType));
+  #endif
+
+        for (Color c : { WHITE, BLACK })
+          entry.byColorBB[c] = pos.pieces(c);
+        for (PieceType pt = PAWN; pt <= KING; ++pt)
+          entry.byTypeBB[pt] = pos.pieces(pt);
+      }
       else
       {
         // Refresh the accumulator
@@ -548,10 +767,8 @@ namespace Stockfish::Eval::NNUE {
           for (const auto index : active)
           {
             const IndexType offset = HalfDimensions * index + j * TileHeight;
-            auto column = reinterpret_cast<const vec_t*>(&weights[offset]);
-
             for (unsigned k = 0; k < NumRegs; ++k)
-              acc[k] = vec_add_16(acc[k], column[k]);
+              acc[k] = vec_add_16(acc[k], weight_tile(offset, k));
           }
 
           auto accTile = reinterpret_cast<vec_t*>(
@@ -592,7 +809,7 @@ namespace Stockfish::Eval::NNUE {
           const IndexType offset = HalfDimensions * index;
 
           for (IndexType j = 0; j < HalfDimensions; ++j)
-            accumulator.accumulation[perspective][j] += weights[offset + j];
+            accumulator.accumulation[perspective][j] += weight(offset + j);
 
           for (std::size_t k = 0; k < PSQTBuckets; ++k)
             accumulator.psqtAccumulation[perspective][k] += psqtWeights[index * PSQTBuckets + k];
@@ -606,10 +823,15 @@ namespace Stockfish::Eval::NNUE {
     }
 
     alignas(CacheLineSize) BiasType biases[HalfDimensions];
-    alignas(CacheLineSize) WeightType weights[HalfDimensions * InputDimensions];
+    alignas(CacheLineSize) BiasType scales[Compact ? HalfDimensions : 1];
+    alignas(CacheLineSize) Weight weights[HalfDimensions * InputDimensions];
     alignas(CacheLineSize) PSQTWeightType psqtWeights[InputDimensions * PSQTBuckets];
+    std::uint32_t version;
   };
 
+  using FeatureTransformer = BasicFeatureTransformer<WeightType>;
+  using CompactFeatureTransformer = BasicFeatureTransformer<std::int8_t>;
+
 }  // namespace Stockfish::Eval::NNUE
 
 #endif // #ifndef NNUE_FEATURE_TRANSFORMER_H_INCLUDED
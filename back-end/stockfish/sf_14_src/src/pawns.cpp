@@ -210,10 +210,13 @@ namespace Pawns {
 Entry* probe(const Position& pos) {
 
   Key key = pos.pawn_key();
-  Entry* e = pos.this_thread()->pawnsTable[key];
+  Table& table = pos.this_thread()->pawnsTable;
+  Entry* e = table[key];
 
   if (e->key == key)
-      return e;
+      return ++table.hits, e;
+
+  ++table.misses;
 
   e->key = key;
   e->blockedCount = 0;
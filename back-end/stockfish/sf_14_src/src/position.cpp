@@ -24,6 +24,7 @@
 #include <sstream>
 
 #include "bitboard.h"
+#include "engine.h"
 #include "misc.h"
 #include "movegen.h"
 #include "position.h"
@@ -392,6 +393,23 @@ Position& Position::set(const string& code, Color c, StateInfo* si) {
 }
 
 
+/// Position::set() is an overload to copy a position for another thread: the
+/// board is the same and 'si' gets a copy of the current state, so the chain of
+/// previous states, with the repetitions and the accumulator, is shared.
+
+Position& Position::set(const Position& pos, StateInfo* si, Thread* th) {
+
+  std::memcpy(this, &pos, sizeof(Position));
+  *si = *pos.st;
+  st = si;
+  thisThread = th;
+
+  assert(pos_is_ok());
+
+  return *this;
+}
+
+
 /// Position::fen() returns a FEN representation of the position. In case of
 /// Chess960 the Shredder-FEN notation is used. This is mainly a debugging function.
 
@@ -1013,7 +1031,7 @@ void Position::do_null_move(StateInfo& newSt) {
   }
 
   st->key ^= Zobrist::side;
-  prefetch(TT.first_entry(key()));
+  prefetch(thisThread->engine.tt.first_entry(key()));
 
   ++st->rule50;
   st->pliesFromNull = 0;
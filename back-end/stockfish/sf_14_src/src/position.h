@@ -19,10 +19,13 @@
 #ifndef POSITION_H_INCLUDED
 #define POSITION_H_INCLUDED
 
+#include <algorithm>
 #include <cassert>
+#include <cstring> // For std::memset
 #include <deque>
 #include <memory> // For std::unique_ptr
 #include <string>
+#include <vector>
 
 #include "bitboard.h"
 #include "evaluate.h"
@@ -66,9 +69,51 @@ struct StateInfo {
 
 /// A list to keep track of the position states along the setup moves (from the
 /// start position to the position just before the search starts). Needed by
-/// 'draw by repetition' detection. Use a std::deque because pointers to
-/// elements are not invalidated upon list resizing.
-typedef std::unique_ptr<std::deque<StateInfo>> StateListPtr;
+/// 'draw by repetition' detection. Like a std::deque pointers to elements are
+/// not invalidated upon list resizing, the states are kept in blocks that are
+/// not freed when the list shrinks: a list set up again, as for every position
+/// command of a game, reuses them instead of allocating.
+
+class StateList {
+
+  static constexpr size_t BlockSize = 16;
+
+  std::vector<std::unique_ptr<StateInfo[]>> blocks;
+  size_t used = 0;
+
+public:
+  explicit StateList(size_t n = 0) { resize(n); }
+  StateList(size_t n, const StateInfo& st) { while (used < n) emplace_back() = st; }
+
+  size_t size() const { return used; }
+  StateInfo& operator[](size_t i) { return blocks[i / BlockSize][i % BlockSize]; }
+  StateInfo& back() { return (*this)[used - 1]; }
+
+  StateInfo& emplace_back() {
+
+    if (used == blocks.size() * BlockSize)
+        blocks.emplace_back(new StateInfo[BlockSize]);
+
+    StateInfo& st = (*this)[used++];
+    std::memset(&st, 0, sizeof(StateInfo));
+    return st;
+  }
+
+  void resize(size_t n) {
+
+    used = std::min(used, n);
+    while (used < n)
+        emplace_back();
+  }
+
+  // What UCI::position() set the list up from, see there
+  std::string fen;
+  bool chess960 = false;
+  std::vector<std::string> moves;
+  Key key = 0;
+};
+
+typedef std::unique_ptr<StateList> StateListPtr;
 
 
 /// Position class stores information regarding the board representation as
@@ -88,6 +133,7 @@ public:
   // FEN string input/output
   Position& set(const std::string& fenStr, bool isChess960, StateInfo* si, Thread* th);
   Position& set(const std::string& code, Color c, StateInfo* si);
+  Position& set(const Position& pos, StateInfo* si, Thread* th);
   std::string fen() const;
 
   // Position representation
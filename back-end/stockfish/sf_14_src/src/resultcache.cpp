@@ -0,0 +1,136 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "engine.h"
+#include "evaluate.h"
+#include "position.h"
+#include "resultcache.h"
+
+namespace Stockfish::ResultCache {
+
+namespace {
+
+  std::mutex Mutex;
+  std::atomic<size_t> Capacity {0};
+  std::list<std::pair<Key, Entry>> Lru; // Most recently used first
+  std::unordered_map<Key, std::list<std::pair<Key, Entry>>::iterator> Index;
+
+  // mix() is the 64 bit finalizer of MurmurHash3, to fold the settings into
+  // the position key without collisions between nearby values
+
+  Key mix(Key k) {
+
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    return k ^ (k >> 33);
+  }
+
+} // namespace
+
+
+/// ResultCache::resize() sets the number of results kept, 0 disables the cache
+
+void resize(size_t entries) {
+
+  std::lock_guard<std::mutex> lk(Mutex);
+
+  Capacity = entries;
+
+  while (Lru.size() > Capacity)
+  {
+      Index.erase(Lru.back().first);
+      Lru.pop_back();
+  }
+}
+
+
+/// ResultCache::key() returns the cache key of searching 'pos' with the current
+/// limits and options of 'engine', or 0 when such a search is not cached
+
+Key key(const Position& pos, Engine& engine) {
+
+  const Search::LimitsType& limits = engine.limits;
+  UCI::OptionsMap& o = engine.options;
+
+  if (   !Capacity
+      || !(limits.depth || limits.nodes)
+      ||  limits.use_time_management() || limits.movetime || limits.deadline || limits.mate
+      ||  limits.infinite || limits.perft || !limits.searchmoves.empty()
+      ||  int(o["MultiPV"]) != 1
+      ||  pos.has_repeated())
+      return 0;
+
+  Key k = pos.key();
+
+  // The 50 moves counter is not in the position key but changes the result
+  for (uint64_t v : { uint64_t(pos.rule50_count()), uint64_t(limits.depth), uint64_t(limits.nodes),
+                      uint64_t(o["Skill Level"]), uint64_t(o["UCI_LimitStrength"]), uint64_t(o["UCI_Elo"]),
+                      uint64_t(o["Fast Skill"]), uint64_t(Eval::useNNUE), uint64_t(pos.is_chess960()) })
+      k = mix(k ^ v);
+
+  return k ? k : 1;
+}
+
+
+bool probe(Key key, Entry& e) {
+
+  std::lock_guard<std::mutex> lk(Mutex);
+
+  auto it = Index.find(key);
+  if (it == Index.end())
+      return false;
+
+  Lru.splice(Lru.begin(), Lru, it->second);
+  e = it->second->second;
+  return true;
+}
+
+
+void store(Key key, const Entry& e) {
+
+  std::lock_guard<std::mutex> lk(Mutex);
+
+  if (!Capacity)
+      return;
+
+  auto it = Index.find(key);
+  if (it != Index.end())
+  {
+      it->second->second = e;
+      Lru.splice(Lru.begin(), Lru, it->second);
+      return;
+  }
+
+  Lru.emplace_front(key, e);
+  Index[key] = Lru.begin();
+
+  if (Lru.size() > Capacity)
+  {
+      Index.erase(Lru.back().first);
+      Lru.pop_back();
+  }
+}
+
+} // namespace Stockfish::ResultCache
@@ -0,0 +1,54 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RESULTCACHE_H_INCLUDED
+#define RESULTCACHE_H_INCLUDED
+
+#include "types.h"
+
+namespace Stockfish {
+
+struct Engine;
+class Position;
+
+namespace ResultCache {
+
+/// The result cache remembers finished root decisions, so that a position
+/// searched again with the same limits and settings (lobby games repeat the
+/// same openings all the time) is answered from memory. It is an LRU list
+/// shared by all engines in the process, sized by the "Result Cache" option.
+/// Only deterministic searches are cached: depth and/or nodes limits, no
+/// clock, no MultiPV and no repetition in the game so far.
+
+struct Entry {
+  Move best, ponder;
+  Value score;
+  Depth depth;
+  int selDepth;
+};
+
+void resize(size_t entries);
+Key key(const Position& pos, Engine& engine);
+bool probe(Key key, Entry& e);
+void store(Key key, const Entry& e);
+
+} // namespace ResultCache
+
+} // namespace Stockfish
+
+#endif // #ifndef RESULTCACHE_H_INCLUDED
@@ -0,0 +1,337 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <deque>
+
+#include "scheduler.h"
+#include "timeman.h"
+
+namespace Stockfish {
+
+/// Scheduler constructor creates the workers, each an engine with one search
+/// thread, and the dispatcher thread that hands queued jobs to idle workers
+
+Scheduler::Scheduler(size_t n) {
+
+  n = n ? n : std::max(1u, std::thread::hardware_concurrency());
+
+  for (size_t i = 0; i < n; ++i)
+  {
+      workers.emplace_back(new_worker());
+      idle.push_back(workers.back().get());
+  }
+
+  dispatcher = std::thread(&Scheduler::dispatch_loop, this);
+}
+
+
+/// Scheduler::new_worker() creates an engine that calls the job back when its
+/// search ends. Spares are made the same way, with the options of the workers.
+
+Scheduler::Worker* Scheduler::new_worker() {
+
+  Worker* w = new Worker();
+
+  w->engine.uciOutput = false;
+  w->engine.onSearchFinished = [this, w](const Thread& best) {
+
+      w->job.done(w->engine, best);
+
+      std::lock_guard<std::mutex> lk(mutex);
+      finished(w);
+      cv.notify_all();
+  };
+
+  for (const auto& o : applied)
+      w->engine.options[o.first] = o.second;
+
+  return w;
+}
+
+
+/// Scheduler destructor drops the jobs still in the queue without calling
+/// them back, stops the running ones (those do report) and joins all threads
+
+Scheduler::~Scheduler() {
+
+  {
+      std::lock_guard<std::mutex> lk(mutex);
+      exit = true;
+      Load::queued -= int(queue.size());
+  }
+  cv.notify_all();
+  dispatcher.join();
+
+  for (auto* list : { &workers, &spares })
+      for (auto& w : *list)
+      {
+          w->engine.threads.stop = true;
+          w->engine.threads.main()->wait_for_search_finished();
+      }
+}
+
+
+/// Scheduler::finished() makes a worker available again once its job has been
+/// called back. A spare first resumes the job it suspended, if still there.
+
+void Scheduler::finished(Worker* w) {
+
+  w->busy = false;
+
+  // A suspended job can end too, cancelled: its spare has nothing to resume
+  if (w->suspended)
+  {
+      w->suspended = false;
+      for (auto& s : spares)
+          if (s->resumes == w)
+              s->resumes = nullptr;
+  }
+
+  if (std::find_if(spares.begin(), spares.end(), [w](const auto& s) { return s.get() == w; }) == spares.end())
+  {
+      idle.push_back(w);
+      return;
+  }
+
+  if (w->resumes)
+  {
+      w->resumes->suspended = false;
+      w->resumes->engine.threads.suspended = false;
+      w->resumes = nullptr;
+  }
+
+  idleSpares.push_back(w);
+}
+
+
+/// Scheduler::victim() is the running job that 'job' may suspend: the one of
+/// the lowest priority below its own, the latest started among those
+
+Scheduler::Worker* Scheduler::victim(const Job& job) const {
+
+  Worker* v = nullptr;
+
+  if (job.priority < preemptPriority || (idleSpares.empty() && spares.size() >= workers.size()))
+      return nullptr;
+
+  for (const auto& w : workers)
+      if (   w->busy && !w->suspended && w->job.priority < job.priority
+          && (!v || w->job.priority < v->job.priority
+                 || (w->job.priority == v->job.priority && w->job.seq > v->job.seq)))
+          v = w.get();
+
+  return v;
+}
+
+
+/// JobOrder is the "less than" of the priority queue: the top is the job with
+/// the highest priority, then the earliest deadline, then the oldest one
+
+bool Scheduler::JobOrder::operator()(const Job& a, const Job& b) const {
+
+  if (a.priority != b.priority)
+      return a.priority < b.priority;
+
+  if (a.deadline != b.deadline)
+      return !a.deadline || (b.deadline && a.deadline > b.deadline);
+
+  return a.seq > b.seq;
+}
+
+
+uint64_t Scheduler::submit(const std::string& fen, const Search::LimitsType& limits,
+                           int priority, TimePoint deadline, Callback done) {
+
+  uint64_t id;
+
+  {
+      std::lock_guard<std::mutex> lk(mutex);
+      id = nextSeq++;
+      queue.push_back(Job{fen, limits, priority, deadline, id, std::move(done)});
+      std::push_heap(queue.begin(), queue.end(), JobOrder());
+      ++Load::queued;
+  }
+  cv.notify_all();
+
+  return id;
+}
+
+
+/// Scheduler::cancel() finds the job in the queue or on a worker. A running
+/// job is stopped like by sf_stop(), a suspended one leaves its wait for that.
+
+Scheduler::CancelResult Scheduler::cancel(uint64_t id) {
+
+  std::lock_guard<std::mutex> lk(mutex);
+
+  auto it = std::find_if(queue.begin(), queue.end(), [id](const Job& j) { return j.seq == id; });
+  if (it != queue.end())
+  {
+      queue.erase(it);
+      std::make_heap(queue.begin(), queue.end(), JobOrder());
+      --Load::queued;
+      return Dropped;
+  }
+
+  for (auto* list : { &workers, &spares })
+      for (auto& w : *list)
+          if (w->busy && w->job.seq == id)
+          {
+              w->engine.threads.stop = true;
+              return Stopped;
+          }
+
+  return NotFound;
+}
+
+
+void Scheduler::set_preempt_priority(int priority) {
+
+  {
+      std::lock_guard<std::mutex> lk(mutex);
+      preemptPriority = priority;
+  }
+  cv.notify_all();
+}
+
+
+size_t Scheduler::pending() {
+
+  std::lock_guard<std::mutex> lk(mutex);
+  return queue.size();
+}
+
+
+/// Scheduler::set_option() holds the dispatcher back, lets the running jobs
+/// finish and then changes the option of every worker
+
+bool Scheduler::set_option(const std::string& name, const std::string& value) {
+
+  if (!workers[0]->engine.options.count(name))
+      return false;
+
+  {
+      std::lock_guard<std::mutex> lk(mutex);
+      paused = true;
+  }
+
+  // Spares first: a suspended worker ends only after its spare
+  for (auto* list : { &spares, &workers })
+      for (auto& w : *list)
+      {
+          w->engine.threads.main()->wait_for_search_finished();
+          w->engine.options[name] = value;
+      }
+
+  {
+      std::lock_guard<std::mutex> lk(mutex);
+      applied.emplace_back(name, value);
+      paused = false;
+  }
+  cv.notify_all();
+
+  return true;
+}
+
+
+/// Scheduler::dispatch_loop() is where the dispatcher thread waits for a job
+/// and an idle worker at the same time and then starts one on the other. With
+/// no idle worker an urgent job may suspend a running one and take a spare.
+
+void Scheduler::dispatch_loop() {
+
+  std::unique_lock<std::mutex> lk(mutex);
+
+  while (true)
+  {
+      cv.wait(lk, [&]{ return exit || (   !paused && !queue.empty()
+                                       && (!idle.empty() || victim(queue.front()))); });
+
+      if (exit)
+          return;
+
+      std::pop_heap(queue.begin(), queue.end(), JobOrder());
+      Job job = std::move(queue.back());
+      queue.pop_back();
+      --Load::queued;
+      Worker* w;
+
+      if (!idle.empty())
+      {
+          w = idle.back();
+          idle.pop_back();
+      }
+      else
+      {
+          Worker* v = victim(job);
+          v->suspended = true;
+          v->engine.threads.suspended = true;
+
+          if (idleSpares.empty())
+          {
+              spares.emplace_back(new_worker());
+              idleSpares.push_back(spares.back().get());
+          }
+
+          w = idleSpares.back();
+          idleSpares.pop_back();
+          w->resumes = v;
+      }
+
+      // Still under the lock, so set_option() never overlaps a start
+      start(w, std::move(job));
+  }
+}
+
+
+/// Scheduler::start() turns the job's deadline, less the move overhead, into
+/// the search's wall-clock deadline and starts it
+
+void Scheduler::start(Worker* w, Job&& job) {
+
+  Engine& engine = w->engine;
+  Search::LimitsType limits = job.limits;
+  limits.startTime = now();
+
+  if (job.deadline)
+  {
+      TimePoint left = job.deadline - limits.startTime - TimePoint(engine.options["Move Overhead"]);
+
+      // A job already past its deadline still gets a move, from a depth 1
+      // search: a deadline that close could stop the search before depth 1 is done.
+      if (left > 0)
+          limits.deadline = limits.startTime + left;
+      else
+          limits.depth = 1;
+  }
+
+  StateListPtr states(new StateList(1));
+  Position pos;
+  pos.set(job.fen, engine.options["UCI_Chess960"], &states->back(), engine.threads.main());
+
+  // The previous job on this worker called back already but its main thread
+  // may not have left the search yet
+  engine.threads.main()->wait_for_search_finished();
+  w->job = std::move(job);
+  w->busy = true;
+
+  engine.threads.start_thinking(pos, states, limits);
+}
+
+} // namespace Stockfish
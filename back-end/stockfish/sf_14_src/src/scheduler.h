@@ -0,0 +1,123 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2021 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCHEDULER_H_INCLUDED
+#define SCHEDULER_H_INCLUDED
+
+#include <climits>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "engine.h"
+
+namespace Stockfish {
+
+/// Scheduler runs many independent searches side by side, as needed by a
+/// server playing lots of games against the engine at once. Instead of giving
+/// every thread to one search it owns a pool of single threaded engines, one
+/// per core by default, and each queued job gets a whole engine to itself.
+/// Jobs are started by priority (higher first), then by earliest deadline,
+/// then in submission order. A deadline caps the job's movetime so the result
+/// arrives in time even after waiting in the queue.
+///
+/// Every job has an id to cancel it by. When no worker is free a job of at
+/// least the preemption priority suspends the running job of the lowest lower
+/// priority and runs on a spare engine meanwhile: the suspended search keeps
+/// its threads, stack and TT, and resumes where it was once the spare is done.
+
+class Scheduler {
+
+public:
+  typedef std::function<void(Engine& engine, const Thread& best)> Callback;
+
+  struct Job {
+    std::string fen;
+    Search::LimitsType limits;
+    int priority;
+    TimePoint deadline; // Absolute, compared with now(); 0 means none
+    uint64_t seq;
+    Callback done;
+  };
+
+  explicit Scheduler(size_t workers = 0);
+ ~Scheduler();
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  // The fen must be valid, the scheduler trusts it like Position::set() does.
+  // 'done' runs on the worker's search thread and must return quickly.
+  // Returns the job's id, never 0.
+  uint64_t submit(const std::string& fen, const Search::LimitsType& limits,
+                  int priority, TimePoint deadline, Callback done);
+
+  // Drops a queued job, which is not called back, or stops a running one, which
+  // reports its best move so far. NotFound if the job is unknown or has ended.
+  enum CancelResult { NotFound, Dropped, Stopped };
+  CancelResult cancel(uint64_t id);
+
+  // Jobs of at least this priority may suspend lower ones, INT_MAX for none
+  void set_preempt_priority(int priority);
+
+  // Applies a UCI option to every worker, between two of its jobs
+  bool set_option(const std::string& name, const std::string& value);
+
+  size_t size() const { return workers.size(); }
+  size_t pending();
+
+  // All workers have the same options, those of the first one stand for all
+  UCI::OptionsMap& options() { return workers[0]->engine.options; }
+
+private:
+  struct Worker {
+    Engine engine;
+    Job job;
+    bool busy = false, suspended = false;
+    Worker* resumes = nullptr; // The suspended worker of a spare's job
+  };
+
+  struct JobOrder {
+    bool operator()(const Job& a, const Job& b) const;
+  };
+
+  Worker* new_worker();
+  void finished(Worker* w);
+  Worker* victim(const Job& job) const;
+  void dispatch_loop();
+  void start(Worker* w, Job&& job);
+
+  std::vector<std::unique_ptr<Worker>> workers, spares;
+  std::vector<Worker*> idle, idleSpares;
+  std::vector<Job> queue; // A heap, JobOrder puts the next job at the front
+  std::vector<std::pair<std::string, std::string>> applied; // Replayed on spares
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint64_t nextSeq = 1;
+  int preemptPriority = INT_MAX;
+  bool paused = false, exit = false;
+  std::thread dispatcher;
+};
+
+} // namespace Stockfish
+
+#endif // #ifndef SCHEDULER_H_INCLUDED
@@ -22,12 +22,16 @@
 #include <cstring>   // For std::memset
 #include <iostream>
 #include <sstream>
+#include <thread>
 
+#include "book.h"
+#include "engine.h"
 #include "evaluate.h"
 #include "misc.h"
 #include "movegen.h"
 #include "movepick.h"
 #include "position.h"
+#include "resultcache.h"
 #include "search.h"
 #include "thread.h"
 #include "timeman.h"
@@ -37,19 +41,6 @@
 
 namespace Stockfish {
 
-namespace Search {
-
-  LimitsType Limits;
-}
-
-namespace Tablebases {
-
-  int Cardinality;
-  bool RootInTB;
-  bool UseRule50;
-  Depth ProbeDepth;
-}
-
 namespace TB = Tablebases;
 
 using std::string;
@@ -58,6 +49,11 @@ using namespace Search;
 
 namespace {
 
+  // Sizes and phases of the skip blocks, used for distributing search depths
+  // across the helper threads with "SMP Skip Blocks"
+  constexpr int SkipSize[]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+  constexpr int SkipPhase[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
   // Different node types, used as a template parameter
   enum NodeType { NonPV, PV, Root };
 
@@ -96,7 +92,8 @@ namespace {
     explicit Skill(int l) : level(l) {}
     bool enabled() const { return level < 20; }
     bool time_to_pick(Depth depth) const { return depth == 1 + level; }
-    Move pick_best(size_t multiPV);
+    uint64_t node_budget() const { return uint64_t(1024) << (level / 2); }
+    Move pick_best(const RootMoves& rootMoves, size_t multiPV);
 
     int level;
     Move best = MOVE_NONE;
@@ -118,36 +115,123 @@ namespace {
 
   // perft() is our utility to verify move generation. All the leaf nodes up
   // to the given depth are generated and counted, and the sum is returned.
-  template<bool Root>
-  uint64_t perft(Position& pos, Depth depth) {
+  // Subtrees of depth 3 and more go through the perft hash, when enabled.
+  uint64_t perft(Position& pos, Depth depth, PerftTable& table) {
+
+    if (depth <= 1)
+        return depth == 1 ? MoveList<LEGAL>(pos).size() : 1;
+
+    uint64_t nodes = 0;
+    const bool hashed = depth >= 3 && table.enabled();
+
+    if (hashed && table.probe(pos.key(), depth, nodes))
+        return nodes;
 
     StateInfo st;
     ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
 
-    uint64_t cnt, nodes = 0;
-    const bool leaf = (depth == 2);
-
     for (const auto& m : MoveList<LEGAL>(pos))
     {
-        if (Root && depth <= 1)
-            cnt = 1, nodes++;
-        else
-        {
-            pos.do_move(m, st);
-            cnt = leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - 1);
-            nodes += cnt;
-            pos.undo_move(m);
-        }
-        if (Root)
-            sync_cout << UCI::move(m, pos.is_chess960()) << ": " << cnt << sync_endl;
+        pos.do_move(m, st);
+        nodes += depth == 2 ? MoveList<LEGAL>(pos).size() : perft(pos, depth - 1, table);
+        pos.undo_move(m);
     }
+
+    if (hashed)
+        table.store(pos.key(), depth, nodes);
+
     return nodes;
   }
 
+  // perft_root_moves() counts the subtrees of the root moves not yet taken by
+  // another thread of the pool, until none is left
+  void perft_root_moves(Thread& th) {
+
+    Engine& engine = th.engine;
+    Position& pos = th.rootPos;
+    StateInfo st;
+    ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
+
+    for (size_t i; (i = engine.threads.perftNext++) < th.rootMoves.size(); )
+    {
+        Move m = th.rootMoves[i].pv[0];
+        pos.do_move(m, st);
+        engine.threads.perftCounts[i] = perft(pos, engine.limits.perft - 1, engine.perftTable);
+        pos.undo_move(m);
+    }
+  }
+
+  // send_pv() reports the PV lines to the GUI and to the embedder, if any
+  void send_pv(const Position& pos, Depth depth, Value alpha, Value beta) {
+
+    Engine& engine = pos.this_thread()->engine;
+
+    if (engine.uciOutput)
+        sync_cout << UCI::pv(pos, depth, alpha, beta) << sync_endl;
+
+    if (engine.onIteration)
+    {
+        size_t multiPV = std::min((size_t)engine.options["MultiPV"], pos.this_thread()->rootMoves.size());
+        Iteration it;
+
+        for (size_t i = 0; i < multiPV; ++i)
+            if (Search::iteration(pos, depth, alpha, beta, i, it))
+                engine.onIteration(it);
+    }
+  }
+
+  // merge_lines() collects the lines of the shares of a split MultiPV search
+  // into 'merged', best first, and with 'all' the moves without a line after
+  // them. Returns the depth the lines are searched to, at least.
+
+  Depth merge_lines(ThreadPool& threads, RootMoves& merged, bool all) {
+
+    RootMoves rest;
+    Depth depth = MAX_PLY;
+    std::lock_guard<std::mutex> lk(threads.linesMutex);
+
+    merged.clear();
+
+    for (size_t i = 0; i < threads.splitShares; ++i)
+    {
+        const Thread* th = threads[i];
+
+        if (!th->lines.empty())
+            depth = std::min(depth, th->linesDepth);
+
+        merged.insert(merged.end(), th->lines.begin(), th->lines.end());
+
+        if (all)
+            for (const RootMove& rm : th->rootMoves)
+                if (std::find(th->lines.begin(), th->lines.end(), rm.pv[0]) == th->lines.end())
+                    rest.push_back(rm);
+    }
+
+    std::stable_sort(merged.begin(), merged.end());
+    std::stable_sort(rest.begin(), rest.end());
+    merged.insert(merged.end(), rest.begin(), rest.end());
+
+    return depth == MAX_PLY ? 0 : depth;
+  }
+
+  // send_split_pv() reports the merged lines, shown in place of the main
+  // thread's own share while the GUI is updated
+
+  void send_split_pv(Thread* mainThread) {
+
+    RootMoves merged;
+    Depth depth = merge_lines(mainThread->engine.threads, merged, false);
+
+    std::swap(mainThread->rootMoves, merged);
+    send_pv(mainThread->rootPos, depth, -VALUE_INFINITE, VALUE_INFINITE);
+    std::swap(mainThread->rootMoves, merged);
+  }
+
 } // namespace
 
 
-/// Search::init() is called at startup to initialize various lookup tables
+/// Search::init() is called at startup to initialize various lookup tables.
+/// They do not depend on the number of threads and are shared by all engines.
 
 void Search::init() {
 
@@ -156,16 +240,16 @@ void Search::init() {
 }
 
 
-/// Search::clear() resets search state to its initial value
+/// Search::clear() resets the search state of the given engine to its initial
+/// value. Tablebase files are shared between engines and are left alone.
 
-void Search::clear() {
+void Search::clear(Engine& engine) {
 
-  Threads.main()->wait_for_search_finished();
+  engine.threads.main()->wait_for_search_finished();
 
-  Time.availableNodes = 0;
-  TT.clear();
-  Threads.clear();
-  Tablebases::init(Options["SyzygyPath"]); // Free mapped files
+  engine.time.availableNodes = 0;
+  engine.tt.clear(engine.threads.size());
+  engine.threads.clear();
 }
 
 
@@ -174,70 +258,203 @@ void Search::clear() {
 
 void MainThread::search() {
 
-  if (Limits.perft)
+  if (engine.limits.perft)
   {
-      nodes = perft<true>(rootPos, Limits.perft);
-      sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
+      ThreadPool& threads = engine.threads;
+      threads.perftNext = 0;
+      threads.perftCounts.assign(rootMoves.size(), 0);
+
+      threads.start_searching(); // start non-main threads
+      perft_root_moves(*this);
+      threads.wait_for_search_finished();
+
+      // The count of do_move() calls is not what a perft reports
+      for (Thread* th : threads)
+          th->nodes = 0;
+
+      nodes = 0;
+      for (size_t i = 0; i < rootMoves.size(); ++i)
+      {
+          nodes += threads.perftCounts[i];
+          sync_cout << UCI::move(rootMoves[i].pv[0], rootPos.is_chess960())
+                    << ": " << threads.perftCounts[i] << sync_endl;
+      }
+
+      TimePoint elapsed = now() - engine.limits.startTime + 1;
+      sync_cout << "\nNodes searched: " << nodes
+                << "\nNodes/second: "  << 1000 * nodes / elapsed
+                << "\nTime (ms): "     << elapsed << "\n" << sync_endl;
       return;
   }
 
   Color us = rootPos.side_to_move();
-  Time.init(Limits, us, rootPos.game_ply());
-  TT.new_search();
+  int threadCount = int(engine.threads.size());
+  {
+      std::lock_guard<std::mutex> lk(loadMutex);
+      loadThreads = ponder ? 0 : threadCount;
+      Load::threads += loadThreads;
+  }
+  engine.time.init(engine, us, rootPos.game_ply());
+  engine.tt.new_search();
+
+  if (engine.uciOutput)
+      Eval::NNUE::verify(engine.options);
+
+  // A book move is played without searching, unless we are analysing
+  Move bookMove =   !engine.limits.infinite
+                 && rootPos.game_ply() < engine.options["Book Depth"] ?
+                    Book::probe(rootPos, int(engine.options["Book Variety"])) : MOVE_NONE;
 
-  Eval::NNUE::verify();
+  auto rm = std::find(rootMoves.begin(), rootMoves.end(), bookMove);
+  bool inBook = rm != rootMoves.end();
+
+  // Otherwise the same search may have been done already, by any engine
+  ResultCache::Entry cached;
+  Key cacheKey = inBook ? 0 : ResultCache::key(rootPos, engine);
+  bool inCache = false;
+
+  if (cacheKey && ResultCache::probe(cacheKey, cached))
+  {
+      rm = std::find(rootMoves.begin(), rootMoves.end(), cached.best);
+      inCache = rm != rootMoves.end();
+  }
 
   if (rootMoves.empty())
   {
       rootMoves.emplace_back(MOVE_NONE);
-      sync_cout << "info depth 0 score "
-                << UCI::value(rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW)
-                << sync_endl;
+
+      if (engine.uciOutput)
+          sync_cout << "info depth 0 score "
+                    << UCI::value(rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW)
+                    << sync_endl;
+  }
+  else if (inBook)
+  {
+      std::swap(rootMoves[0], *rm);
+      rootMoves[0].score = VALUE_ZERO;
+
+      if (engine.uciOutput)
+          sync_cout << "info string book move " << UCI::move(bookMove, rootPos.is_chess960()) << sync_endl;
+  }
+  else if (inCache)
+  {
+      std::swap(rootMoves[0], *rm);
+      rootMoves[0].score = rootMoves[0].previousScore = cached.score;
+      rootMoves[0].selDepth = cached.selDepth;
+      if (cached.ponder != MOVE_NONE)
+          rootMoves[0].pv.push_back(cached.ponder);
+      completedDepth = cached.depth;
+
+      if (engine.uciOutput)
+          sync_cout << "info string cached result" << sync_endl;
+
+      send_pv(rootPos, completedDepth, -VALUE_INFINITE, VALUE_INFINITE);
   }
   else
   {
-      Threads.start_searching(); // start non-main threads
-      Thread::search();          // main thread start searching
+      engine.threads.start_searching(); // start non-main threads
+      Thread::search();                 // main thread start searching
+
+      // A split search to a fixed depth is done when every share is
+      auto sharesDone = [&] {
+          std::lock_guard<std::mutex> lk(engine.threads.linesMutex);
+          for (size_t i = 0; i < engine.threads.splitShares; ++i)
+              if (engine.threads[i]->linesDepth < engine.limits.depth)
+                  return false;
+          return true;
+      };
+
+      while (engine.threads.splitShares && engine.limits.depth && !engine.threads.stop && !sharesDone())
+      {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          callsCnt = 0;
+          check_time();
+      }
   }
 
   // When we reach the maximum depth, we can arrive here without a raise of
-  // Threads.stop. However, if we are pondering or in an infinite search,
+  // engine.threads.stop. However, if we are pondering or in an infinite search,
   // the UCI protocol states that we shouldn't print the best move before the
   // GUI sends a "stop" or "ponderhit" command. We therefore simply wait here
-  // until the GUI sends one of those commands.
+  // until the GUI sends one of those commands, with the helpers paused so
+  // that the CPU is free meanwhile.
+
+  if (!engine.threads.stop && (ponder || engine.limits.infinite))
+  {
+      engine.threads.paused = true;
 
-  while (!Threads.stop && (ponder || Limits.infinite))
-  {} // Busy wait for a stop or a ponder reset
+      while (!engine.threads.stop && (ponder || engine.limits.infinite))
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
 
   // Stop the threads if not already stopped (also raise the stop if
-  // "ponderhit" just reset Threads.ponder).
-  Threads.stop = true;
+  // "ponderhit" just reset engine.threads.ponder).
+  engine.threads.stop = true;
+  engine.threads.paused = false;
 
   // Wait until all threads have finished
-  Threads.wait_for_search_finished();
+  engine.threads.wait_for_search_finished();
+  {
+      std::lock_guard<std::mutex> lk(loadMutex);
+      Load::threads -= loadThreads;
+      loadThreads = -1;
+  }
+
+  // The main thread reports for all the shares
+  if (engine.threads.splitShares)
+  {
+      RootMoves merged;
+      completedDepth = merge_lines(engine.threads, merged, true);
+      rootMoves = std::move(merged);
+
+      if (engine.uciOutput || engine.onIteration)
+          send_pv(rootPos, completedDepth, -VALUE_INFINITE, VALUE_INFINITE);
+  }
 
   // When playing in 'nodes as time' mode, subtract the searched nodes from
   // the available ones before exiting.
-  if (Limits.npmsec)
-      Time.availableNodes += Limits.inc[us] - Threads.nodes_searched();
+  if (engine.limits.npmsec)
+      engine.time.availableNodes += engine.limits.inc[us] - engine.threads.nodes_searched();
 
   Thread* bestThread = this;
 
-  if (   int(Options["MultiPV"]) == 1
-      && !Limits.depth
-      && !(Skill(Options["Skill Level"]).enabled() || int(Options["UCI_LimitStrength"]))
-      && rootMoves[0].pv[0] != MOVE_NONE)
-      bestThread = Threads.get_best_thread();
+  if (   int(engine.options["MultiPV"]) == 1
+      && !engine.limits.depth
+      && !(Skill(engine.options["Skill Level"]).enabled() || int(engine.options["UCI_LimitStrength"]))
+      && rootMoves[0].pv[0] != MOVE_NONE
+      && !inBook && !inCache) // Helper threads have not searched
+
+      bestThread = engine.threads.get_best_thread();
 
   bestPreviousScore = bestThread->rootMoves[0].score;
 
+  bool hasPonder =   bestThread->rootMoves[0].pv.size() > 1
+                   || bestThread->rootMoves[0].extract_ponder_from_tt(rootPos);
+
+  // Only a search that ran to its own limit is worth reusing
+  if (   cacheKey && !inCache
+      && bestThread->rootMoves[0].pv[0] != MOVE_NONE
+      && (   (engine.limits.depth && bestThread->completedDepth >= engine.limits.depth)
+          || (engine.limits.nodes && engine.threads.nodes_searched() >= uint64_t(engine.limits.nodes))))
+  {
+      const RootMove& best = bestThread->rootMoves[0];
+      ResultCache::store(cacheKey, { best.pv[0], hasPonder ? best.pv[1] : MOVE_NONE,
+                                     best.score, bestThread->completedDepth, best.selDepth });
+  }
+
   // Send again PV info if we have a new best thread
   if (bestThread != this)
-      sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+      send_pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE);
+
+  if (engine.onSearchFinished)
+      engine.onSearchFinished(*bestThread);
+
+  if (!engine.uciOutput)
+      return;
 
   sync_cout << "bestmove " << UCI::move(bestThread->rootMoves[0].pv[0], rootPos.is_chess960());
 
-  if (bestThread->rootMoves[0].pv.size() > 1 || bestThread->rootMoves[0].extract_ponder_from_tt(rootPos))
+  if (hasPonder)
       std::cout << " ponder " << UCI::move(bestThread->rootMoves[0].pv[1], rootPos.is_chess960());
 
   std::cout << sync_endl;
@@ -250,6 +467,12 @@ void MainThread::search() {
 
 void Thread::search() {
 
+  if (engine.limits.perft)
+  {
+      perft_root_moves(*this);
+      return;
+  }
+
   // To allow access to (ss-7) up to (ss+2), the stack must be oversized.
   // The former is needed to allow update_continuation_histories(ss-1, ...),
   // which accesses its argument at ss-6, also near the root.
@@ -259,7 +482,7 @@ void Thread::search() {
   Value bestValue, alpha, beta, delta;
   Move  lastBestMove = MOVE_NONE;
   Depth lastBestMoveDepth = 0;
-  MainThread* mainThread = (this == Threads.main() ? Threads.main() : nullptr);
+  MainThread* mainThread = (this == engine.threads.main() ? engine.threads.main() : nullptr);
   double timeReduction = 1, totBestMoveChanges = 0;
   Color us = rootPos.side_to_move();
   int iterIdx = 0;
@@ -289,7 +512,7 @@ void Thread::search() {
   std::copy(&lowPlyHistory[2][0], &lowPlyHistory.back().back() + 1, &lowPlyHistory[0][0]);
   std::fill(&lowPlyHistory[MAX_LPH - 2][0], &lowPlyHistory.back().back() + 1, 0);
 
-  size_t multiPV = size_t(Options["MultiPV"]);
+  size_t multiPV = size_t(engine.options["MultiPV"]);
 
   // Pick integer skill levels, but non-deterministically round up or down
   // such that the average integer skill corresponds to the input floating point one.
@@ -297,17 +520,25 @@ void Thread::search() {
   // to CCRL Elo (goldfish 1.13 = 2000) and a fit through Ordo derived Elo
   // for match (TC 60+0.6) results spanning a wide range of k values.
   PRNG rng(now());
-  double floatLevel = Options["UCI_LimitStrength"] ?
-                      std::clamp(std::pow((Options["UCI_Elo"] - 1346.6) / 143.4, 1 / 0.806), 0.0, 20.0) :
-                        double(Options["Skill Level"]);
+  double floatLevel = engine.options["UCI_LimitStrength"] ?
+                      std::clamp(std::pow((engine.options["UCI_Elo"] - 1346.6) / 143.4, 1 / 0.806), 0.0, 20.0) :
+                        double(engine.options["Skill Level"]);
   int intLevel = int(floatLevel) +
                  ((floatLevel - int(floatLevel)) * 1024 > rng.rand<unsigned>() % 1024  ? 1 : 0);
   Skill skill(intLevel);
 
   // When playing with strength handicap enable MultiPV search that we will
-  // use behind the scenes to retrieve a set of possible moves.
+  // use behind the scenes to retrieve a set of possible moves. In the fast
+  // mode the search is cut to what pick_best() needs: exactly four lines, no
+  // iteration past the picking depth and a node budget growing with the level,
+  // so a beginner level move costs a few hundred nodes instead of a full search.
+  bool fastSkill = skill.enabled() && engine.options["Fast Skill"];
+
   if (skill.enabled())
-      multiPV = std::max(multiPV, (size_t)4);
+      multiPV = fastSkill ? 4 : std::max(multiPV, (size_t)4);
+
+  if (mainThread)
+      mainThread->skillNodes = fastSkill ? skill.node_budget() : 0;
 
   multiPV = std::min(multiPV, rootMoves.size());
   ttHitAverage = TtHitAverageWindow * TtHitAverageResolution / 2;
@@ -315,12 +546,24 @@ void Thread::search() {
   trend = SCORE_ZERO;
 
   int searchAgainCounter = 0;
+  bool skipBlocks = engine.options["SMP Skip Blocks"];
 
   // Iterative deepening loop until requested to stop or the target depth is reached
   while (   ++rootDepth < MAX_PLY
-         && !Threads.stop
-         && !(Limits.depth && mainThread && rootDepth > Limits.depth))
+         && !engine.threads.stop
+         && !(   engine.limits.depth && (mainThread || engine.threads.splitShares)
+              && rootDepth > engine.limits.depth))
   {
+      // Distribute search depths across the helper threads, each one skips
+      // blocks of depths of its own size and phase. Shares of a split MultiPV
+      // search need every depth.
+      if (skipBlocks && idx > 0 && idx >= engine.threads.splitShares)
+      {
+          int i = (idx - 1) % 20;
+          if (((rootDepth + SkipPhase[i]) / SkipSize[i]) % 2)
+              continue; // Retry with an incremented rootDepth
+      }
+
       // Age out PV variability metric
       if (mainThread)
           totBestMoveChanges /= 2;
@@ -333,11 +576,11 @@ void Thread::search() {
       size_t pvFirst = 0;
       pvLast = 0;
 
-      if (!Threads.increaseDepth)
+      if (!engine.threads.increaseDepth)
          searchAgainCounter++;
 
       // MultiPV loop. We perform a full root search for each PV line
-      for (pvIdx = 0; pvIdx < multiPV && !Threads.stop; ++pvIdx)
+      for (pvIdx = 0; pvIdx < multiPV && !engine.threads.stop; ++pvIdx)
       {
           if (pvIdx == pvLast)
           {
@@ -385,16 +628,17 @@ void Thread::search() {
               // If search has been stopped, we break immediately. Sorting is
               // safe because RootMoves is still valid, although it refers to
               // the previous iteration.
-              if (Threads.stop)
+              if (engine.threads.stop)
                   break;
 
               // When failing high/low give some update (without cluttering
               // the UI) before a re-search.
               if (   mainThread
+                  && (engine.uciOutput || engine.onIteration)
                   && multiPV == 1
                   && (bestValue <= alpha || bestValue >= beta)
-                  && Time.elapsed() > 3000)
-                  sync_cout << UCI::pv(rootPos, rootDepth, alpha, beta) << sync_endl;
+                  && engine.time.elapsed() > 3000)
+                  send_pv(rootPos, rootDepth, alpha, beta);
 
               // In case of failing low/high increase aspiration window and
               // re-search, otherwise exit the loop.
@@ -424,34 +668,63 @@ void Thread::search() {
           std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
           if (    mainThread
-              && (Threads.stop || pvIdx + 1 == multiPV || Time.elapsed() > 3000))
-              sync_cout << UCI::pv(rootPos, rootDepth, alpha, beta) << sync_endl;
+              && !engine.threads.splitShares
+              && (engine.uciOutput || engine.onIteration)
+              && (engine.threads.stop || pvIdx + 1 == multiPV || engine.time.elapsed() > 3000))
+              send_pv(rootPos, rootDepth, alpha, beta);
       }
 
-      if (!Threads.stop)
+      if (!engine.threads.stop)
           completedDepth = rootDepth;
 
+      // A share of a split MultiPV search publishes its lines once complete
+      if (!engine.threads.stop && idx < engine.threads.splitShares)
+      {
+          {
+              std::lock_guard<std::mutex> lk(engine.threads.linesMutex);
+              lines.assign(rootMoves.begin(), rootMoves.begin() + multiPV);
+              linesDepth = rootDepth;
+          }
+
+          if (mainThread && (engine.uciOutput || engine.onIteration))
+              send_split_pv(this);
+      }
+
       if (rootMoves[0].pv[0] != lastBestMove) {
          lastBestMove = rootMoves[0].pv[0];
          lastBestMoveDepth = rootDepth;
       }
 
       // Have we found a "mate in x"?
-      if (   Limits.mate
+      if (   engine.limits.mate
           && bestValue >= VALUE_MATE_IN_MAX_PLY
-          && VALUE_MATE - bestValue <= 2 * Limits.mate)
-          Threads.stop = true;
+          && VALUE_MATE - bestValue <= 2 * engine.limits.mate)
+          engine.threads.stop = true;
 
       if (!mainThread)
           continue;
 
       // If skill level is enabled and time is up, pick a sub-optimal best move
       if (skill.enabled() && skill.time_to_pick(rootDepth))
-          skill.pick_best(multiPV);
+          skill.pick_best(rootMoves, multiPV);
+
+      // The fast mode is done once the move is picked or the node budget is
+      // spent. A ponder or infinite search leaves the loop without stopping,
+      // to wait for "ponderhit" or "stop" in MainThread::search().
+      if (   fastSkill
+          && (skill.best || engine.threads.nodes_searched() >= mainThread->skillNodes))
+      {
+          if (mainThread->ponder || engine.limits.infinite)
+          {
+              mainThread->stopOnPonderhit = true;
+              break;
+          }
+          engine.threads.stop = true;
+      }
 
       // Do we have time for the next iteration? Can we stop searching now?
-      if (    Limits.use_time_management()
-          && !Threads.stop
+      if (    engine.limits.use_time_management()
+          && !engine.threads.stop
           && !mainThread->stopOnPonderhit)
       {
           double fallingEval = (318 + 6 * (mainThread->bestPreviousScore - bestValue)
@@ -463,14 +736,14 @@ void Thread::search() {
           double reduction = (1.47 + mainThread->previousTimeReduction) / (2.32 * timeReduction);
 
           // Use part of the gained time from a previous stable move for the current move
-          for (Thread* th : Threads)
+          for (Thread* th : engine.threads)
           {
               totBestMoveChanges += th->bestMoveChanges;
               th->bestMoveChanges = 0;
           }
           double bestMoveInstability = 1.073 + std::max(1.0, 2.25 - 9.9 / rootDepth)
-                                              * totBestMoveChanges / Threads.size();
-          double totalTime = Time.optimum() * fallingEval * reduction * bestMoveInstability;
+                                              * totBestMoveChanges / engine.threads.size();
+          double totalTime = engine.time.optimum() * fallingEval * reduction * bestMoveInstability;
 
           // Cap used time in case of a single legal move for a better viewer experience in tournaments
           // yielding correct scores and sufficiently fast moves.
@@ -478,21 +751,21 @@ void Thread::search() {
               totalTime = std::min(500.0, totalTime);
 
           // Stop the search if we have exceeded the totalTime
-          if (Time.elapsed() > totalTime)
+          if (engine.time.elapsed() > totalTime)
           {
               // If we are allowed to ponder do not stop the search now but
               // keep pondering until the GUI sends "ponderhit" or "stop".
               if (mainThread->ponder)
                   mainThread->stopOnPonderhit = true;
               else
-                  Threads.stop = true;
+                  engine.threads.stop = true;
           }
-          else if (   Threads.increaseDepth
+          else if (   engine.threads.increaseDepth
                    && !mainThread->ponder
-                   && Time.elapsed() > totalTime * 0.58)
-                   Threads.increaseDepth = false;
+                   && engine.time.elapsed() > totalTime * 0.58)
+                   engine.threads.increaseDepth = false;
           else
-                   Threads.increaseDepth = true;
+                   engine.threads.increaseDepth = true;
       }
 
       mainThread->iterValue[iterIdx] = bestValue;
@@ -507,7 +780,7 @@ void Thread::search() {
   // If skill level is enabled, swap best PV line with the sub-optimal one
   if (skill.enabled())
       std::swap(rootMoves[0], *std::find(rootMoves.begin(), rootMoves.end(),
-                skill.best ? skill.best : skill.pick_best(multiPV)));
+                skill.best ? skill.best : skill.pick_best(rootMoves, multiPV)));
 }
 
 
@@ -560,6 +833,8 @@ namespace {
 
     // Step 1. Initialize node
     Thread* thisThread = pos.this_thread();
+    Engine& engine     = thisThread->engine;
+    ++thisThread->counters.searchNodes;
     ss->inCheck        = pos.checkers();
     priorCapture       = pos.captured_piece();
     Color us           = pos.side_to_move();
@@ -568,9 +843,13 @@ namespace {
     maxValue           = VALUE_INFINITE;
 
     // Check for the available remaining time
-    if (thisThread == Threads.main())
+    if (thisThread == engine.threads.main())
         static_cast<MainThread*>(thisThread)->check_time();
 
+    else if (engine.threads.paused.load(std::memory_order_relaxed))
+        while (engine.threads.paused)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
     // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
     if (PvNode && thisThread->selDepth < ss->ply + 1)
         thisThread->selDepth = ss->ply + 1;
@@ -578,7 +857,7 @@ namespace {
     if (!rootNode)
     {
         // Step 2. Check for aborted search and immediate draw
-        if (   Threads.stop.load(std::memory_order_relaxed)
+        if (   engine.threads.stop.load(std::memory_order_relaxed)
             || pos.is_draw(ss->ply)
             || ss->ply >= MAX_PLY)
             return (ss->ply >= MAX_PLY && !ss->inCheck) ? evaluate(pos)
@@ -617,7 +896,9 @@ namespace {
     // position key in case of an excluded move.
     excludedMove = ss->excludedMove;
     posKey = excludedMove == MOVE_NONE ? pos.key() : pos.key() ^ make_key(excludedMove);
-    tte = TT.probe(posKey, ss->ttHit);
+    tte = engine.tt.probe(posKey, ss->ttHit);
+    ++thisThread->counters.ttProbes;
+    thisThread->counters.ttHits += ss->ttHit;
     ttValue = ss->ttHit ? value_from_tt(tte->value(), ss->ply, pos.rule50_count()) : VALUE_NONE;
     ttMove =  rootNode ? thisThread->rootMoves[thisThread->pvIdx].pv[0]
             : ss->ttHit    ? tte->move() : MOVE_NONE;
@@ -673,27 +954,27 @@ namespace {
     }
 
     // Step 5. Tablebases probe
-    if (!rootNode && TB::Cardinality)
+    if (!rootNode && engine.tb.cardinality)
     {
         int piecesCount = pos.count<ALL_PIECES>();
 
-        if (    piecesCount <= TB::Cardinality
-            && (piecesCount <  TB::Cardinality || depth >= TB::ProbeDepth)
+        if (    piecesCount <= engine.tb.cardinality
+            && (piecesCount <  engine.tb.cardinality || depth >= engine.tb.probeDepth)
             &&  pos.rule50_count() == 0
             && !pos.can_castle(ANY_CASTLING))
         {
             TB::ProbeState err;
-            TB::WDLScore wdl = Tablebases::probe_wdl(pos, &err);
+            TB::WDLScore wdl = Tablebases::probe_wdl(pos, &err, thisThread->tbCache);
 
             // Force check of time on the next occasion
-            if (thisThread == Threads.main())
+            if (thisThread == engine.threads.main())
                 static_cast<MainThread*>(thisThread)->callsCnt = 0;
 
             if (err != TB::ProbeState::FAIL)
             {
                 thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
 
-                int drawScore = TB::UseRule50 ? 1 : 0;
+                int drawScore = engine.tb.useRule50 ? 1 : 0;
 
                 // use the range VALUE_MATE_IN_MAX_PLY to VALUE_TB_WIN_IN_MAX_PLY to score
                 value =  wdl < -drawScore ? VALUE_MATED_IN_MAX_PLY + ss->ply + 1
@@ -708,7 +989,7 @@ namespace {
                 {
                     tte->save(posKey, value_to_tt(value, ss->ply), ss->ttPv, b,
                               std::min(MAX_PLY - 1, depth + 6),
-                              MOVE_NONE, VALUE_NONE);
+                              MOVE_NONE, VALUE_NONE, engine.tt);
 
                     return value;
                 }
@@ -760,7 +1041,7 @@ namespace {
             ss->staticEval = eval = -(ss-1)->staticEval;
 
         // Save static evaluation into transposition table
-        tte->save(posKey, VALUE_NONE, ss->ttPv, BOUND_NONE, DEPTH_NONE, MOVE_NONE, eval);
+        tte->save(posKey, VALUE_NONE, ss->ttPv, BOUND_NONE, DEPTH_NONE, MOVE_NONE, eval, engine.tt);
     }
 
     // Use static evaluation difference to improve quiet move ordering
@@ -868,6 +1149,7 @@ namespace {
 
                 captureOrPromotion = true;
                 probCutCount++;
+                ++thisThread->counters.picked[mp.current_stage()];
 
                 ss->currentMove = move;
                 ss->continuationHistory = &thisThread->continuationHistory[ss->inCheck]
@@ -894,7 +1176,8 @@ namespace {
                        && ttValue != VALUE_NONE))
                         tte->save(posKey, value_to_tt(value, ss->ply), ttPv,
                             BOUND_LOWER,
-                            depth - 3, move, ss->staticEval);
+                            depth - 3, move, ss->staticEval, engine.tt);
+                    ++thisThread->counters.cutoffs[mp.current_stage()];
                     return value;
                 }
             }
@@ -974,7 +1257,7 @@ moves_loop: // When in check, search starts from here
 
       ss->moveCount = ++moveCount;
 
-      if (rootNode && thisThread == Threads.main() && Time.elapsed() > 3000)
+      if (rootNode && thisThread == engine.threads.main() && engine.uciOutput && engine.time.elapsed() > 3000)
           sync_cout << "info depth " << depth
                     << " currmove " << UCI::move(move, pos.is_chess960())
                     << " currmovenumber " << moveCount + thisThread->pvIdx << sync_endl;
@@ -1105,10 +1388,11 @@ moves_loop: // When in check, search starts from here
       ss->doubleExtensions = (ss-1)->doubleExtensions + (extension == 2);
 
       // Speculative prefetch as early as possible
-      prefetch(TT.first_entry(pos.key_after(move)));
+      prefetch(engine.tt.first_entry(pos.key_after(move)));
 
       // Update the current move (this must be done after singular extension search)
       ss->currentMove = move;
+      ++thisThread->counters.picked[mp.current_stage()];
       ss->continuationHistory = &thisThread->continuationHistory[ss->inCheck]
                                                                 [captureOrPromotion]
                                                                 [movedPiece]
@@ -1230,7 +1514,7 @@ moves_loop: // When in check, search starts from here
       // Finished searching the move. If a stop occurred, the return value of
       // the search cannot be trusted, and we return immediately without
       // updating best move, PV and TT.
-      if (Threads.stop.load(std::memory_order_relaxed))
+      if (engine.threads.stop.load(std::memory_order_relaxed))
           return VALUE_ZERO;
 
       if (rootNode)
@@ -1278,6 +1562,7 @@ moves_loop: // When in check, search starts from here
               else
               {
                   assert(value >= beta); // Fail high
+                  ++thisThread->counters.cutoffs[mp.current_stage()];
                   break;
               }
           }
@@ -1298,7 +1583,7 @@ moves_loop: // When in check, search starts from here
     // completed. But in this case bestValue is valid because we have fully
     // searched our subtree, and we can anyhow save the result in TT.
     /*
-       if (Threads.stop)
+       if (engine.threads.stop)
         return VALUE_DRAW;
     */
 
@@ -1341,7 +1626,7 @@ moves_loop: // When in check, search starts from here
         tte->save(posKey, value_to_tt(bestValue, ss->ply), ss->ttPv,
                   bestValue >= beta ? BOUND_LOWER :
                   PvNode && bestMove ? BOUND_EXACT : BOUND_UPPER,
-                  depth, bestMove, ss->staticEval);
+                  depth, bestMove, ss->staticEval, engine.tt);
 
     assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
 
@@ -1381,6 +1666,8 @@ moves_loop: // When in check, search starts from here
     }
 
     Thread* thisThread = pos.this_thread();
+    Engine& engine = thisThread->engine;
+    ++thisThread->counters.qsearchNodes;
     bestMove = MOVE_NONE;
     ss->inCheck = pos.checkers();
     moveCount = 0;
@@ -1399,7 +1686,9 @@ moves_loop: // When in check, search starts from here
                                                   : DEPTH_QS_NO_CHECKS;
     // Transposition table lookup
     posKey = pos.key();
-    tte = TT.probe(posKey, ss->ttHit);
+    tte = engine.tt.probe(posKey, ss->ttHit);
+    ++thisThread->counters.ttProbes;
+    thisThread->counters.ttHits += ss->ttHit;
     ttValue = ss->ttHit ? value_from_tt(tte->value(), ss->ply, pos.rule50_count()) : VALUE_NONE;
     ttMove = ss->ttHit ? tte->move() : MOVE_NONE;
     pvHit = ss->ttHit && tte->is_pv();
@@ -1444,7 +1733,7 @@ moves_loop: // When in check, search starts from here
             // Save gathered info in transposition table
             if (!ss->ttHit)
                 tte->save(posKey, value_to_tt(bestValue, ss->ply), false, BOUND_LOWER,
-                          DEPTH_NONE, MOVE_NONE, ss->staticEval);
+                          DEPTH_NONE, MOVE_NONE, ss->staticEval, engine.tt);
 
             return bestValue;
         }
@@ -1509,7 +1798,7 @@ moves_loop: // When in check, search starts from here
           continue;
 
       // Speculative prefetch as early as possible
-      prefetch(TT.first_entry(pos.key_after(move)));
+      prefetch(engine.tt.first_entry(pos.key_after(move)));
 
       // Check for legality just before making the move
       if (!pos.legal(move))
@@ -1523,6 +1812,7 @@ moves_loop: // When in check, search starts from here
                                                                 [captureOrPromotion]
                                                                 [pos.moved_piece(move)]
                                                                 [to_sq(move)];
+      ++thisThread->counters.picked[mp.current_stage()];
 
       // Continuation history based pruning
       if (  !captureOrPromotion
@@ -1553,7 +1843,10 @@ moves_loop: // When in check, search starts from here
               if (PvNode && value < beta) // Update alpha here!
                   alpha = value;
               else
+              {
+                  ++thisThread->counters.cutoffs[mp.current_stage()];
                   break; // Fail high
+              }
           }
        }
     }
@@ -1571,7 +1864,7 @@ moves_loop: // When in check, search starts from here
     tte->save(posKey, value_to_tt(bestValue, ss->ply), pvHit,
               bestValue >= beta ? BOUND_LOWER :
               PvNode && bestValue > oldAlpha  ? BOUND_EXACT : BOUND_UPPER,
-              ttDepth, bestMove, ss->staticEval);
+              ttDepth, bestMove, ss->staticEval, engine.tt);
 
     assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
 
@@ -1732,10 +2025,9 @@ moves_loop: // When in check, search starts from here
   // When playing with strength handicap, choose best move among a set of RootMoves
   // using a statistical rule dependent on 'level'. Idea by Heinz van Saanen.
 
-  Move Skill::pick_best(size_t multiPV) {
+  Move Skill::pick_best(const RootMoves& rootMoves, size_t multiPV) {
 
-    const RootMoves& rootMoves = Threads.main()->rootMoves;
-    static PRNG rng(now()); // PRNG sequence should be non-deterministic
+    thread_local PRNG rng(now()); // PRNG sequence should be non-deterministic
 
     // RootMoves are already sorted by score in descending order
     Value topScore = rootMoves[0].score;
@@ -1773,13 +2065,18 @@ void MainThread::check_time() {
   if (--callsCnt > 0)
       return;
 
+  // The "Fast Skill" budget of an infinite search ends its iterations instead
+  uint64_t maxNodes = engine.limits.nodes;
+  if (skillNodes && !engine.limits.infinite && (!maxNodes || skillNodes < maxNodes))
+      maxNodes = skillNodes;
+
   // When using nodes, ensure checking rate is not lower than 0.1% of nodes
-  callsCnt = Limits.nodes ? std::min(1024, int(Limits.nodes / 1024)) : 1024;
+  callsCnt = maxNodes ? std::min(1024, int(maxNodes / 1024)) : 1024;
 
   static TimePoint lastInfoTime = now();
 
-  TimePoint elapsed = Time.elapsed();
-  TimePoint tick = Limits.startTime + elapsed;
+  TimePoint elapsed = engine.time.elapsed();
+  TimePoint tick = engine.limits.startTime + elapsed;
 
   if (tick - lastInfoTime >= 1000)
   {
@@ -1787,14 +2084,98 @@ void MainThread::check_time() {
       dbg_print();
   }
 
-  // We should not stop pondering until told so by the GUI
+  // We should not stop pondering until told so by the GUI. Pondering has the
+  // lowest priority: it is not counted in Load::threads and, while any other
+  // search of the process runs, it pauses with all its threads.
   if (ponder)
+  {
+      if (Load::threads > 0 && !engine.threads.stop)
+      {
+          engine.threads.paused = true;
+
+          while (ponder && !engine.threads.stop && Load::threads > 0)
+              std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+          engine.threads.paused = false;
+      }
       return;
+  }
 
-  if (   (Limits.use_time_management() && (elapsed > Time.maximum() - 10 || stopOnPonderhit))
-      || (Limits.movetime && elapsed >= Limits.movetime)
-      || (Limits.nodes && Threads.nodes_searched() >= (uint64_t)Limits.nodes))
-      Threads.stop = true;
+  // A job suspended by the scheduler waits here like a ponder. Its clock runs
+  // on: a movetime or deadline that passes meanwhile stops it on resume.
+  if (engine.threads.suspended && !engine.threads.stop)
+  {
+      engine.threads.paused = true;
+      Load::threads -= loadThreads;
+
+      while (engine.threads.suspended && !engine.threads.stop)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+      Load::threads += loadThreads;
+      engine.threads.paused = false;
+  }
+
+  if (   (engine.limits.use_time_management() && (elapsed > engine.time.maximum() - 10 || stopOnPonderhit))
+      || (engine.limits.movetime && elapsed >= engine.limits.movetime)
+      || (engine.limits.deadline && now() >= engine.limits.deadline)
+      || (maxNodes && engine.threads.nodes_searched() >= maxNodes))
+      engine.threads.stop = true;
+}
+
+
+/// MainThread::ponderhit() switches a ponder search to a normal one. From then
+/// on it counts in Load::threads like any other, until MainThread::search()
+/// takes off what was added. A search that has already ended is not counted.
+
+void MainThread::ponderhit() {
+
+  std::lock_guard<std::mutex> lk(loadMutex);
+
+  if (ponder && loadThreads == 0)
+      Load::threads += loadThreads = int(engine.threads.size());
+
+  ponder = false;
+}
+
+
+/// Search::iteration() fills 'it' with the PV line 'idx' of the last iteration.
+/// Unsearched lines get the previous iteration's score, and none is reported
+/// at depth 1. Returns false when the line is to be skipped.
+
+bool Search::iteration(const Position& pos, Depth depth, Value alpha, Value beta, size_t idx, Iteration& it) {
+
+  Engine& engine = pos.this_thread()->engine;
+  const RootMove& rm = pos.this_thread()->rootMoves[idx];
+  bool updated = rm.score != -VALUE_INFINITE;
+
+  if (depth == 1 && !updated && idx > 0)
+      return false;
+
+  Value v = updated ? rm.score : rm.previousScore;
+
+  if (v == -VALUE_INFINITE)
+      v = VALUE_ZERO;
+
+  bool tb = engine.tb.rootInTB && abs(v) < VALUE_MATE_IN_MAX_PLY;
+  v = tb ? rm.tbScore : v;
+
+  it.depth    = updated ? depth : std::max(1, depth - 1);
+  it.selDepth = rm.selDepth;
+  it.multiPV  = int(idx) + 1;
+  it.score    = v;
+  it.bound    =  tb || idx != pos.this_thread()->pvIdx ? BOUND_EXACT
+               : v >= beta ? BOUND_LOWER : v <= alpha ? BOUND_UPPER : BOUND_EXACT;
+  it.wdl[0]   = UCI::win_rate( v, pos.game_ply());
+  it.wdl[2]   = UCI::win_rate(-v, pos.game_ply());
+  it.wdl[1]   = 1000 - it.wdl[0] - it.wdl[2];
+  it.nodes    = engine.threads.nodes_searched();
+  it.tbHits   = engine.threads.tb_hits() + (engine.tb.rootInTB ? pos.this_thread()->rootMoves.size() : 0);
+  it.hashfull = engine.tt.hashfull();
+  it.time     = engine.time.elapsed();
+  it.pv       = rm.pv.data();
+  it.pvLength = rm.pv.size();
+
+  return true;
 }
 
 
@@ -1803,57 +2184,45 @@ void MainThread::check_time() {
 
 string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
 
+  Engine& engine = pos.this_thread()->engine;
   std::stringstream ss;
-  TimePoint elapsed = Time.elapsed() + 1;
-  const RootMoves& rootMoves = pos.this_thread()->rootMoves;
-  size_t pvIdx = pos.this_thread()->pvIdx;
-  size_t multiPV = std::min((size_t)Options["MultiPV"], rootMoves.size());
-  uint64_t nodesSearched = Threads.nodes_searched();
-  uint64_t tbHits = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
+  size_t multiPV = std::min((size_t)engine.options["MultiPV"], pos.this_thread()->rootMoves.size());
+  Search::Iteration it;
 
   for (size_t i = 0; i < multiPV; ++i)
   {
-      bool updated = rootMoves[i].score != -VALUE_INFINITE;
-
-      if (depth == 1 && !updated && i > 0)
+      if (!Search::iteration(pos, depth, alpha, beta, i, it))
           continue;
 
-      Depth d = updated ? depth : std::max(1, depth - 1);
-      Value v = updated ? rootMoves[i].score : rootMoves[i].previousScore;
-
-      if (v == -VALUE_INFINITE)
-          v = VALUE_ZERO;
-
-      bool tb = TB::RootInTB && abs(v) < VALUE_MATE_IN_MAX_PLY;
-      v = tb ? rootMoves[i].tbScore : v;
+      TimePoint elapsed = it.time + 1;
 
       if (ss.rdbuf()->in_avail()) // Not at first line
           ss << "\n";
 
       ss << "info"
-         << " depth "    << d
-         << " seldepth " << rootMoves[i].selDepth
-         << " multipv "  << i + 1
-         << " score "    << UCI::value(v);
+         << " depth "    << it.depth
+         << " seldepth " << it.selDepth
+         << " multipv "  << it.multiPV
+         << " score "    << UCI::value(it.score);
 
-      if (Options["UCI_ShowWDL"])
-          ss << UCI::wdl(v, pos.game_ply());
+      if (engine.options["UCI_ShowWDL"])
+          ss << " wdl " << it.wdl[0] << " " << it.wdl[1] << " " << it.wdl[2];
 
-      if (!tb && i == pvIdx)
-          ss << (v >= beta ? " lowerbound" : v <= alpha ? " upperbound" : "");
+      if (it.bound != BOUND_EXACT)
+          ss << (it.bound == BOUND_LOWER ? " lowerbound" : " upperbound");
 
-      ss << " nodes "    << nodesSearched
-         << " nps "      << nodesSearched * 1000 / elapsed;
+      ss << " nodes "    << it.nodes
+         << " nps "      << it.nodes * 1000 / elapsed;
 
       if (elapsed > 1000) // Earlier makes little sense
-          ss << " hashfull " << TT.hashfull();
+          ss << " hashfull " << it.hashfull;
 
-      ss << " tbhits "   << tbHits
+      ss << " tbhits "   << it.tbHits
          << " time "     << elapsed
          << " pv";
 
-      for (Move m : rootMoves[i].pv)
-          ss << " " << UCI::move(m, pos.is_chess960());
+      for (size_t j = 0; j < it.pvLength; ++j)
+          ss << " " << UCI::move(it.pv[j], pos.is_chess960());
   }
 
   return ss.str();
@@ -1870,6 +2239,7 @@ bool RootMove::extract_ponder_from_tt(Position& pos) {
     StateInfo st;
     ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
 
+    Engine& engine = pos.this_thread()->engine;
     bool ttHit;
 
     assert(pv.size() == 1);
@@ -1878,7 +2248,7 @@ bool RootMove::extract_ponder_from_tt(Position& pos) {
         return false;
 
     pos.do_move(pv[0], st);
-    TTEntry* tte = TT.probe(pos.key(), ttHit);
+    TTEntry* tte = engine.tt.probe(pos.key(), ttHit);
 
     if (ttHit)
     {
@@ -1891,36 +2261,39 @@ bool RootMove::extract_ponder_from_tt(Position& pos) {
     return pv.size() > 1;
 }
 
-void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
+Tablebases::Config Tablebases::rank_root_moves(UCI::OptionsMap& options, Position& pos, Search::RootMoves& rootMoves) {
 
-    RootInTB = false;
-    UseRule50 = bool(Options["Syzygy50MoveRule"]);
-    ProbeDepth = int(Options["SyzygyProbeDepth"]);
-    Cardinality = int(Options["SyzygyProbeLimit"]);
+    Config config;
+    config.useRule50 = bool(options["Syzygy50MoveRule"]);
+    config.probeDepth = int(options["SyzygyProbeDepth"]);
+    config.cardinality = int(options["SyzygyProbeLimit"]);
     bool dtz_available = true;
 
+    if (options["SyzygyPrefetch"])
+        prefetch(pos);
+
     // Tables with fewer pieces than SyzygyProbeLimit are searched with
-    // ProbeDepth == DEPTH_ZERO
-    if (Cardinality > MaxCardinality)
+    // probeDepth == DEPTH_ZERO
+    if (config.cardinality > MaxCardinality)
     {
-        Cardinality = MaxCardinality;
-        ProbeDepth = 0;
+        config.cardinality = MaxCardinality;
+        config.probeDepth = 0;
     }
 
-    if (Cardinality >= popcount(pos.pieces()) && !pos.can_castle(ANY_CASTLING))
+    if (config.cardinality >= popcount(pos.pieces()) && !pos.can_castle(ANY_CASTLING))
     {
         // Rank moves using DTZ tables
-        RootInTB = root_probe(pos, rootMoves);
+        config.rootInTB = root_probe(pos, rootMoves, config.useRule50);
 
-        if (!RootInTB)
+        if (!config.rootInTB)
         {
             // DTZ tables are missing; try to rank moves using WDL tables
             dtz_available = false;
-            RootInTB = root_probe_wdl(pos, rootMoves);
+            config.rootInTB = root_probe_wdl(pos, rootMoves, config.useRule50);
         }
     }
 
-    if (RootInTB)
+    if (config.rootInTB)
     {
         // Sort moves according to TB rank
         std::stable_sort(rootMoves.begin(), rootMoves.end(),
@@ -1928,7 +2301,7 @@ void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
 
         // Probe during search only if DTZ is not available and we are winning
         if (dtz_available || rootMoves[0].tbScore <= VALUE_DRAW)
-            Cardinality = 0;
+            config.cardinality = 0;
     }
     else
     {
@@ -1936,6 +2309,8 @@ void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
         for (auto& m : rootMoves)
             m.tbRank = 0;
     }
+
+    return config;
 }
 
 } // namespace Stockfish
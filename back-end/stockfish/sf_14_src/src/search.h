@@ -28,6 +28,7 @@
 namespace Stockfish {
 
 class Position;
+struct Engine;
 
 namespace Search {
 
@@ -87,7 +88,7 @@ typedef std::vector<RootMove> RootMoves;
 struct LimitsType {
 
   LimitsType() { // Init explicitly due to broken value-initialization of non POD in MSVC
-    time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
+    time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = deadline = TimePoint(0);
     movestogo = depth = mate = perft = infinite = 0;
     nodes = 0;
   }
@@ -98,14 +99,34 @@ struct LimitsType {
 
   std::vector<Move> searchmoves;
   TimePoint time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, startTime;
+  TimePoint deadline; // Absolute wall-clock time the search must stop at, 0 if none
   int movestogo, depth, mate, perft, infinite;
   int64_t nodes;
 };
 
-extern LimitsType Limits;
+/// Iteration struct is one PV line of the search progress, the same data as a
+/// UCI 'info' line, for embedders that want it without formatting and parsing
+/// text. 'pv' points into the root moves and is valid only during the callback.
+
+struct Iteration {
+  Depth depth;
+  int selDepth;
+  int multiPV;    // 1 is the best line
+  Value score;
+  Bound bound;    // BOUND_LOWER / BOUND_UPPER while failing high / low
+  int wdl[3];     // Win, draw and loss per mille, for the side to move
+  uint64_t nodes;
+  uint64_t tbHits;
+  int hashfull;
+  TimePoint time;
+  const Move* pv;
+  size_t pvLength;
+};
+
+bool iteration(const Position& pos, Depth depth, Value alpha, Value beta, size_t idx, Iteration& it);
 
 void init();
-void clear();
+void clear(Engine& engine);
 
 } // namespace Search
 
@@ -18,13 +18,16 @@
 
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>   // For std::memset and std::memcpy
 #include <deque>
 #include <fstream>
 #include <iostream>
 #include <list>
+#include <map>
 #include <sstream>
+#include <thread>
 #include <type_traits>
 #include <mutex>
 
@@ -38,6 +41,7 @@
 #include "tbprobe.h"
 
 #ifndef _WIN32
+#include <dirent.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
@@ -59,6 +63,7 @@ namespace Stockfish {
 namespace {
 
 constexpr int TBPIECES = 7; // Max number of supported pieces
+constexpr uint64_t WillNeedSize = 16 * 1024 * 1024; // Files read ahead whole when mapped
 
 enum { BigEndian, LittleEndian };
 enum TBType { WDL, DTZ }; // Used as template parameter
@@ -165,39 +170,75 @@ static_assert(sizeof(LR) == 3, "LR tree entry must be 3 bytes");
 
 // class TBFile memory maps/unmaps the single .rtbw and .rtbz files. Files are
 // memory mapped for best performance. Files are mapped at first access: at init
-// time only existence of the file is checked.
+// time the directories are only listed, no file is opened.
 class TBFile : public std::ifstream {
 
     std::string fname;
 
 public:
-    // Look for and open the file among the Paths directories where the .rtbw
-    // and .rtbz files can be found. Multiple directories are separated by ";"
-    // on Windows and by ":" on Unix-based operating systems.
+    // Files maps the name of every .rtbw and .rtbz file to its directory, the
+    // first of the paths that has it
+    static std::map<std::string, std::string> Files;
+
+    // List the directories where the .rtbw and .rtbz files can be found, once
+    // each: on a network mount that is a few round trips instead of a look up
+    // per possible table and directory. Multiple directories are separated by
+    // ";" on Windows and by ":" on Unix-based operating systems.
     //
     // Example:
     // C:\tb\wdl345;C:\tb\wdl6;D:\tb\dtz345;D:\tb\dtz6
-    static std::string Paths;
-
-    TBFile(const std::string& f) {
+    static void list(const std::string& paths) {
 
 #ifndef _WIN32
         constexpr char SepChar = ':';
 #else
         constexpr char SepChar = ';';
 #endif
-        std::stringstream ss(Paths);
+        std::stringstream ss(paths);
         std::string path;
 
+        Files.clear();
+
         while (std::getline(ss, path, SepChar))
         {
-            fname = path + "/" + f;
-            std::ifstream::open(fname);
-            if (is_open())
-                return;
+            auto add = [&](const std::string& name) {
+                if (   name.size() > 5
+                    && (!name.compare(name.size() - 5, 5, ".rtbw") || !name.compare(name.size() - 5, 5, ".rtbz")))
+                    Files.emplace(name, path);
+            };
+#ifndef _WIN32
+            if (DIR* dir = opendir(path.c_str()))
+            {
+                while (dirent* e = readdir(dir))
+                    add(e->d_name);
+
+                closedir(dir);
+            }
+#else
+            WIN32_FIND_DATAA data;
+            HANDLE h = FindFirstFileA((path + "\\*.rtb?").c_str(), &data);
+
+            if (h != INVALID_HANDLE_VALUE)
+            {
+                do add(data.cFileName); while (FindNextFileA(h, &data));
+                FindClose(h);
+            }
+#endif
         }
     }
 
+    static bool exists(const std::string& f) { return Files.count(f); }
+
+    TBFile(const std::string& f) {
+
+        auto it = Files.find(f);
+        if (it == Files.end())
+            return;
+
+        fname = it->second + "/" + f;
+        std::ifstream::open(fname);
+    }
+
     // Memory map the file and check it. File should be already open and will be
     // closed after mapping.
     uint8_t* map(void** baseAddress, uint64_t* mapping, TBType type) {
@@ -224,7 +265,11 @@ public:
         *mapping = statbuf.st_size;
         *baseAddress = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
 #if defined(MADV_RANDOM)
-        madvise(*baseAddress, statbuf.st_size, MADV_RANDOM);
+        // Probes jump all over a file, so read ahead whole only the small ones.
+        // On slow storage that is one long read instead of a fault per probe.
+        if (*baseAddress != MAP_FAILED)
+            madvise(*baseAddress, statbuf.st_size,
+                    uint64_t(statbuf.st_size) <= WillNeedSize ? MADV_WILLNEED : MADV_RANDOM);
 #endif
         ::close(fd);
 
@@ -295,7 +340,7 @@ public:
     }
 };
 
-std::string TBFile::Paths;
+std::map<std::string, std::string> TBFile::Files;
 
 // struct PairsData contains low level indexing information to access TB data.
 // There are 8, 4 or 2 PairsData records for each TBTable, according to type of
@@ -469,6 +514,30 @@ public:
 
 TBTables TBTables;
 
+// Prefetcher maps, on a thread of its own, the tables a search is likely to
+// reach next: those of the root material and of one capture or queen
+// promotion away. The search threads then neither open the files nor parse
+// their headers on the first probe, which on network storage is the longest
+// stall. Enabled with "SyzygyPrefetch".
+class Prefetcher {
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::string> queue; // Material codes like "KRPvKR"
+    std::thread thread;
+    bool busy = false;
+
+    void loop();
+
+public:
+    void push(const Position& pos);
+    void drain();
+};
+
+// Never destroyed: a search thread calling exit() on a corrupt file may hold
+// the mapping lock the prefetch thread waits for, joining it would hang.
+Prefetcher& Prefetcher = *new class Prefetcher();
+
 // If the corresponding file exists two new objects TBTable<WDL> and TBTable<DTZ>
 // are created and added to the lists and hash table. Called at init time.
 void TBTables::add(const std::vector<PieceType>& pieces) {
@@ -478,13 +547,11 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
     for (PieceType pt : pieces)
         code += PieceToChar[pt];
 
-    TBFile file(code.insert(code.find('K', 1), "v") + ".rtbw"); // KRK -> KRvK
+    code.insert(code.find('K', 1), "v"); // KRK -> KRvK
 
-    if (!file.is_open()) // Only WDL file is checked
+    if (!TBFile::exists(code + ".rtbw")) // Only WDL file is checked
         return;
 
-    file.close();
-
     MaxCardinality = std::max((int)pieces.size(), MaxCardinality);
 
     wdlTable.emplace_back(code);
@@ -1166,6 +1233,94 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     return e.baseAddress;
 }
 
+// Prefetcher::push() queues the tables around the material of 'pos' and wakes
+// the prefetch thread, starting it the first time. Mapped tables cost nothing.
+void Prefetcher::push(const Position& pos) {
+
+    int count[COLOR_NB][PIECE_TYPE_NB];
+    for (Color c : { WHITE, BLACK })
+        for (PieceType pt = PAWN; pt <= KING; ++pt)
+            count[c][pt] = popcount(pos.pieces(c, pt));
+
+    // The code of the material, with one 'removed' and one 'added' piece of 'c'
+    auto code = [&](Color c, PieceType removed, PieceType added) {
+        std::string s[COLOR_NB];
+        for (Color side : { WHITE, BLACK })
+            for (PieceType pt = KING; pt >= PAWN; --pt)
+                s[side] += std::string(count[side][pt] - (side == c && pt == removed)
+                                                      + (side == c && pt == added), PieceToChar[pt]);
+        return s[WHITE] + 'v' + s[BLACK];
+    };
+
+    std::vector<std::string> codes;
+    int pieces = popcount(pos.pieces());
+
+    if (pieces <= MaxCardinality)
+        codes.push_back(code(WHITE, NO_PIECE_TYPE, NO_PIECE_TYPE));
+
+    for (Color c : { WHITE, BLACK })
+        for (PieceType pt = PAWN; pt < KING; ++pt)
+            if (count[c][pt])
+            {
+                if (pieces - 1 <= MaxCardinality && pieces > 3)
+                    codes.push_back(code(c, pt, NO_PIECE_TYPE));
+
+                if (pt == PAWN && pieces <= MaxCardinality)
+                    codes.push_back(code(c, PAWN, QUEEN));
+            }
+
+    std::unique_lock<std::mutex> lk(mutex);
+
+    for (const std::string& c : codes)
+        if (std::find(queue.begin(), queue.end(), c) == queue.end())
+            queue.push_back(c);
+
+    if (!thread.joinable())
+        thread = std::thread(&Prefetcher::loop, this);
+
+    lk.unlock();
+    cv.notify_all();
+}
+
+// Prefetcher::drain() drops the queued tables and waits for the one being
+// mapped, so that Tablebases::init() can free the tables
+void Prefetcher::drain() {
+
+    std::unique_lock<std::mutex> lk(mutex);
+    queue.clear();
+    cv.wait(lk, [&]{ return !busy; });
+}
+
+void Prefetcher::loop() {
+
+    std::unique_lock<std::mutex> lk(mutex);
+
+    while (true)
+    {
+        busy = false;
+        cv.notify_all();
+        cv.wait(lk, [&]{ return !queue.empty(); });
+
+        std::string code = queue.front();
+        queue.pop_front();
+        busy = true;
+        lk.unlock();
+
+        // A position with the material of the code, the tables are found by key
+        StateInfo st;
+        Position pos;
+        pos.set(code, WHITE, &st);
+
+        if (TBTable<WDL>* wdl = TBTables.get<WDL>(pos.material_key()))
+            mapped(*wdl, pos);
+
+        if (TBTable<DTZ>* dtz = TBTables.get<DTZ>(pos.material_key()))
+            mapped(*dtz, pos);
+
+        lk.lock();
+    }
+}
+
 template<TBType Type, typename Ret = typename TBTable<Type>::Ret>
 Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw) {
 
@@ -1263,11 +1418,12 @@ WDLScore search(Position& pos, ProbeState* result) {
 /// safe, nor it needs to be.
 void Tablebases::init(const std::string& paths) {
 
+    Prefetcher.drain();
     TBTables.clear();
     MaxCardinality = 0;
-    TBFile::Paths = paths;
+    TBFile::list(paths == "<empty>" ? "" : paths);
 
-    if (paths.empty() || paths == "<empty>")
+    if (TBFile::Files.empty())
         return;
 
     // MapB1H1H7[] encodes a square below a1-h8 diagonal to 0..27
@@ -1419,6 +1575,32 @@ WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
     return search<false>(pos, result);
 }
 
+// Same as above, through the thread's cache. Failed probes are not cached: the
+// table may just not be mapped yet.
+WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result, Cache& cache) {
+
+    CacheEntry* e = cache[pos.key()];
+
+    if (e->key == pos.key())
+        return *result = ProbeState(e->state), WDLScore(e->wdl);
+
+    WDLScore wdl = probe_wdl(pos, result);
+
+    if (*result != FAIL)
+        *e = { pos.key(), int8_t(wdl), int8_t(*result) };
+
+    return wdl;
+}
+
+// Maps in the background the tables the search from 'pos' will likely probe
+// first, see Prefetcher. Only positions at most one capture away from the
+// tables are worth it.
+void Tablebases::prefetch(const Position& pos) {
+
+    if (MaxCardinality && popcount(pos.pieces()) <= MaxCardinality + 1)
+        Prefetcher.push(pos);
+}
+
 // Probe the DTZ table for a particular position.
 // If *result != FAIL, the probe was successful.
 // The return value is from the point of view of the side to move:
@@ -1511,7 +1693,7 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
 // Use the DTZ tables to rank root moves.
 //
 // A return value false indicates that not all probes were successful.
-bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves) {
+bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves, bool rule50) {
 
     ProbeState result;
     StateInfo st;
@@ -1522,7 +1704,7 @@ bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves) {
     // Check whether a position was repeated since the last zeroing move.
     bool rep = pos.has_repeated();
 
-    int dtz, bound = Options["Syzygy50MoveRule"] ? 900 : 1;
+    int dtz, bound = rule50 ? 900 : 1;
 
     // Probe and rank each move
     for (auto& m : rootMoves)
@@ -1588,7 +1770,7 @@ bool Tablebases::root_probe(Position& pos, Search::RootMoves& rootMoves) {
 // This is a fallback for the case that some or all DTZ tables are missing.
 //
 // A return value false indicates that not all probes were successful.
-bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves) {
+bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50) {
 
     static const int WDL_to_rank[] = { -1000, -899, 0, 899, 1000 };
 
@@ -1596,8 +1778,6 @@ bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves) {
     StateInfo st;
     WDLScore wdl;
 
-    bool rule50 = Options["Syzygy50MoveRule"];
-
     // Probe and rank each move
     for (auto& m : rootMoves)
     {
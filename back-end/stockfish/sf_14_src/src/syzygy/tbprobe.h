@@ -22,6 +22,7 @@
 #include <ostream>
 
 #include "../search.h"
+#include "../uci.h"
 
 namespace Stockfish::Tablebases {
 
@@ -43,14 +44,36 @@ enum ProbeState {
     ZEROING_BEST_MOVE =  2  // Best move zeroes DTZ (capture or pawn move)
 };
 
+// Per-search probing settings, computed by rank_root_moves() from the engine
+// options and the root position. The tables themselves are shared by all
+// engines in the process, so MaxCardinality stays global.
+struct Config {
+    int cardinality = 0;
+    bool rootInTB = false;
+    bool useRule50 = true;
+    Depth probeDepth = 0;
+};
+
+// Cache keeps the WDL probes of one search thread by position key: endgame
+// positions come back through transpositions, and a hit saves decompressing
+// the block again or even a page fault on a cold page of the table.
+struct CacheEntry {
+    Key key;
+    int8_t wdl, state;
+};
+
+typedef HashTable<CacheEntry, 4096> Cache;
+
 extern int MaxCardinality;
 
 void init(const std::string& paths);
 WDLScore probe_wdl(Position& pos, ProbeState* result);
+WDLScore probe_wdl(Position& pos, ProbeState* result, Cache& cache);
+void prefetch(const Position& pos);
 int probe_dtz(Position& pos, ProbeState* result);
-bool root_probe(Position& pos, Search::RootMoves& rootMoves);
-bool root_probe_wdl(Position& pos, Search::RootMoves& rootMoves);
-void rank_root_moves(Position& pos, Search::RootMoves& rootMoves);
+bool root_probe(Position& pos, Search::RootMoves& rootMoves, bool rule50);
+bool root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
+Config rank_root_moves(UCI::OptionsMap& options, Position& pos, Search::RootMoves& rootMoves);
 
 inline std::ostream& operator<<(std::ostream& os, const WDLScore v) {
 
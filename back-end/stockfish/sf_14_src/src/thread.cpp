@@ -19,6 +19,10 @@
 #include <cassert>
 
 #include <algorithm> // For std::count
+#include <iomanip>
+#include <sstream>
+#include "engine.h"
+#include "evaluate.h"
 #include "movegen.h"
 #include "search.h"
 #include "thread.h"
@@ -28,13 +32,10 @@
 
 namespace Stockfish {
 
-ThreadPool Threads; // Global object
-
-
 /// Thread constructor launches the thread and waits until it goes to sleep
 /// in idle_loop(). Note that 'searching' and 'exit' should be already set.
 
-Thread::Thread(size_t n) : idx(n), stdThread(&Thread::idle_loop, this) {
+Thread::Thread(Engine& e, size_t n) : idx(n), engine(e), stdThread(&Thread::idle_loop, this) {
 
   wait_for_search_finished();
 }
@@ -73,6 +74,17 @@ void Thread::clear() {
 }
 
 
+/// Thread::memory() is the memory the thread owns: the thread object, most of
+/// it the history tables, and its pawn and material hash tables.
+
+size_t Thread::memory() const {
+
+  return (idx ? sizeof(Thread) : sizeof(MainThread))
+        + pawnsTable.size() * sizeof(Pawns::Entry)
+        + materialTable.size() * sizeof(Material::Entry);
+}
+
+
 /// Thread::start_searching() wakes up the thread that will start the search
 
 void Thread::start_searching() {
@@ -93,6 +105,30 @@ void Thread::wait_for_search_finished() {
 }
 
 
+/// Thread::idle_time() is the time the thread has spent waiting for a search
+/// in idle_loop(), including the current wait
+
+TimePoint Thread::idle_time() {
+
+  std::lock_guard<std::mutex> lk(mutex);
+  return idleTime + (searching ? 0 : now() - idleStart);
+}
+
+
+/// Thread::reset_counters() zeroes the counters of a thread that is not searching
+
+void Thread::reset_counters() {
+
+  std::lock_guard<std::mutex> lk(mutex);
+  counters = Counters();
+  pawnsTable.hits = pawnsTable.misses = 0;
+  materialTable.hits = materialTable.misses = 0;
+  accumulatorCache.updates = accumulatorCache.refreshes = 0;
+  idleTime = 0;
+  idleStart = now();
+}
+
+
 /// Thread::idle_loop() is where the thread is parked, blocked on the
 /// condition variable, when it has no work to do.
 
@@ -102,16 +138,23 @@ void Thread::idle_loop() {
   // the choice, eventually we are one of many one-threaded processes running on
   // some Windows NUMA hardware, for instance in fishtest. To make it simple,
   // just check if running threads are below a threshold, in this case all this
-  // NUMA machinery is not needed.
-  if (Options["Threads"] > 8)
+  // NUMA machinery is not needed. With "NUMA Bind" the threads are spread over
+  // the nodes of Linux machines instead, and "CPU Bind" pins each one to a CPU.
+  if (engine.options["CPU Bind"])
+      Numa::bind_cpu(idx);
+  else if (engine.options["NUMA Bind"])
+      Numa::bind_thread(idx);
+  else if (engine.options["Threads"] > 8)
       WinProcGroup::bindThisThread(idx);
 
   while (true)
   {
       std::unique_lock<std::mutex> lk(mutex);
       searching = false;
+      idleStart = now();
       cv.notify_one(); // Wake up anyone waiting for search finished
       cv.wait(lk, [&]{ return searching; });
+      idleTime += now() - idleStart;
 
       if (exit)
           return;
@@ -138,21 +181,140 @@ void ThreadPool::set(size_t requested) {
 
   if (requested > 0)   // create new thread(s)
   {
-      push_back(new MainThread(0));
+      push_back(new MainThread(engine, 0));
 
       while (size() < requested)
-          push_back(new Thread(size()));
+          push_back(new Thread(engine, size()));
       clear();
+      resize_tables();
+      reset_stats();
 
       // Reallocate the hash with the new threadpool size
-      TT.resize(size_t(Options["Hash"]));
+      engine.tt.resize(size_t(engine.options["Hash"]), size(), UCI::numa_policy(engine.options));
+  }
+}
+
+
+/// ThreadPool::resize_tables() sizes the pawn and material tables of every
+/// thread from the "Pawn Table" and "Material Table" options
+
+void ThreadPool::resize_tables() {
 
-      // Init thread number dependent search params.
-      Search::init();
+  main()->wait_for_search_finished();
+
+  for (Thread* th : *this)
+  {
+      th->pawnsTable.resize(size_t(engine.options["Pawn Table"]));
+      th->materialTable.resize(size_t(engine.options["Material Table"]));
   }
 }
 
 
+/// ThreadPool::reset_stats() restarts the counters reported by stats()
+
+void ThreadPool::reset_stats() {
+
+  main()->wait_for_search_finished();
+
+  for (Thread* th : *this)
+      th->reset_counters();
+
+  statsStart = now();
+}
+
+
+/// ThreadPool::stats() reports the counters of the threads, summed over all of
+/// them, since the last reset_stats(): how the per-thread tables and the TT hit,
+/// how the NNUE accumulators were computed, the share of qsearch nodes, the
+/// beta cutoffs per stage of the move picker and the time spent in idle_loop().
+/// With 'json' the same numbers are written as one JSON object.
+
+std::string ThreadPool::stats(bool json) const {
+
+  // The stage a move was picked in, the TT moves are seen in the stage after
+  constexpr const char* StageNames[MovePicker::STAGE_NB] = {
+    nullptr, "tt", "good capture", "refutation", nullptr, "quiet", "bad capture",
+    nullptr, "evasion tt", "evasion",
+    nullptr, "probcut tt", "probcut",
+    nullptr, "qsearch tt", "qsearch capture", nullptr, "qsearch check"
+  };
+
+  Counters c = {};
+  uint64_t hits[2] = {}, misses[2] = {}, updates = 0, refreshes = 0;
+  TimePoint idle = 0, elapsed = std::max(now() - statsStart, TimePoint(1));
+
+  for (Thread* th : *this)
+  {
+      const Counters& t = th->counters;
+      c.ttProbes += t.ttProbes, c.ttHits += t.ttHits;
+      c.searchNodes += t.searchNodes, c.qsearchNodes += t.qsearchNodes;
+      for (int i = 0; i < MovePicker::STAGE_NB; ++i)
+          c.picked[i] += t.picked[i], c.cutoffs[i] += t.cutoffs[i];
+
+      hits[0] += th->pawnsTable.hits,    misses[0] += th->pawnsTable.misses;
+      hits[1] += th->materialTable.hits, misses[1] += th->materialTable.misses;
+      updates += th->accumulatorCache.updates, refreshes += th->accumulatorCache.refreshes;
+      idle += th->idle_time();
+  }
+
+  auto percent = [](uint64_t n, uint64_t total) { return 100.0 * n / std::max(total, uint64_t(1)); };
+  uint64_t nodes = c.searchNodes + c.qsearchNodes;
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(2);
+
+  if (json)
+  {
+      auto table = [&](const char* name, size_t entries, uint64_t h, uint64_t m) {
+          ss << ",\"" << name << "\":{\"entries\":" << entries << ",\"hits\":" << h << ",\"misses\":" << m << "}";
+      };
+
+      ss << "{\"threads\":" << size() << ",\"elapsed_ms\":" << elapsed << ",\"idle_ms\":" << idle
+         << ",\"tt\":{\"probes\":" << c.ttProbes << ",\"hits\":" << c.ttHits << "}"
+         << ",\"nnue\":{\"updates\":" << updates << ",\"refreshes\":" << refreshes << "}"
+         << ",\"nodes\":{\"search\":" << c.searchNodes << ",\"qsearch\":" << c.qsearchNodes << "}";
+      table("pawn_table",     main()->pawnsTable.size(),    hits[0], misses[0]);
+      table("material_table", main()->materialTable.size(), hits[1], misses[1]);
+      ss << ",\"stages\":{";
+      for (int i = 0, first = 1; i < MovePicker::STAGE_NB; ++i)
+          if (StageNames[i])
+          {
+              ss << (first ? "" : ",") << "\"" << StageNames[i] << "\":{\"moves\":" << c.picked[i]
+                 << ",\"cutoffs\":" << c.cutoffs[i] << "}";
+              first = 0;
+          }
+      ss << "}}";
+      return ss.str();
+  }
+
+  auto table = [&](const std::string& name, size_t entries, size_t entrySize, uint64_t h, uint64_t m) {
+      ss << std::left << std::setw(16) << name << std::right
+         << std::setw(9) << entries << " entries " << std::setw(8) << entries * entrySize / 1024 << " KB per thread, "
+         << std::setw(6) << percent(h, h + m) << "% hits of " << h + m << " probes\n";
+  };
+
+  ss << std::left << std::setw(16) << "Threads" << std::right << std::setw(9) << size() << ", "
+     << std::setw(6) << percent(idle, elapsed * size()) << "% idle over " << elapsed << " ms\n"
+     << std::left << std::setw(16) << "TT" << std::right
+     << std::setw(6) << percent(c.ttHits, c.ttProbes) << "% hits of " << c.ttProbes << " probes\n"
+     << std::left << std::setw(16) << "NNUE" << std::right
+     << std::setw(6) << percent(refreshes, updates + refreshes) << "% refreshes of " << updates + refreshes << " accumulators\n"
+     << std::left << std::setw(16) << "Qsearch" << std::right
+     << std::setw(6) << percent(c.qsearchNodes, nodes) << "% of " << nodes << " nodes\n";
+  table("Pawn table",     main()->pawnsTable.size(),    sizeof(Pawns::Entry),    hits[0], misses[0]);
+  table("Material table", main()->materialTable.size(), sizeof(Material::Entry), hits[1], misses[1]);
+
+  ss << "\n" << std::left << std::setw(16) << "Stage" << std::right
+     << std::setw(14) << "moves" << std::setw(14) << "cutoffs" << std::setw(9) << "rate\n";
+  for (int i = 0; i < MovePicker::STAGE_NB; ++i)
+      if (StageNames[i])
+          ss << std::left << std::setw(16) << StageNames[i] << std::right
+             << std::setw(14) << c.picked[i] << std::setw(14) << c.cutoffs[i]
+             << std::setw(7) << percent(c.cutoffs[i], c.picked[i]) << "%\n";
+
+  return ss.str();
+}
+
+
 /// ThreadPool::clear() sets threadPool data to initial values
 
 void ThreadPool::clear() {
@@ -174,10 +336,10 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
 
   main()->wait_for_search_finished();
 
-  main()->stopOnPonderhit = stop = false;
+  main()->stopOnPonderhit = stop = paused = suspended = false;
   increaseDepth = true;
   main()->ponder = ponderMode;
-  Search::Limits = limits;
+  engine.limits = limits;
   Search::RootMoves rootMoves;
 
   for (const auto& m : MoveList<LEGAL>(pos))
@@ -186,7 +348,18 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
           rootMoves.emplace_back(m);
 
   if (!rootMoves.empty())
-      Tablebases::rank_root_moves(pos, rootMoves);
+      engine.tb = Tablebases::rank_root_moves(engine.options, pos, rootMoves);
+
+  // Splitting needs lines to merge and leaves out Skill, which picks its move
+  // among the main thread's lines
+  splitShares =    engine.options["MultiPV Split"]
+                && int(engine.options["MultiPV"]) > 1
+                && int(engine.options["Skill Level"]) == 20
+                && !engine.options["UCI_LimitStrength"]
+                && !limits.perft ? std::min(size(), rootMoves.size()) : 0;
+
+  if (splitShares < 2)
+      splitShares = 0;
 
   // After ownership transfer 'states' becomes empty, so if we stop the search
   // and call 'go' again without setting a new position states.get() == NULL.
@@ -195,23 +368,49 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   if (states.get())
       setupStates = std::move(states); // Ownership transfer, states is now empty
 
-  // We use Position::set() to set root position across threads. But there are
-  // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
-  // be deduced from a fen string, so set() clears them and they are set from
-  // setupStates->back() later. The rootState is per thread, earlier states are shared
-  // since they are read-only.
+  // The accumulators of the setup states were computed with the other feature
+  // transformer if "NNUE Int8" changed since the last search, or with another
+  // network if one was loaded since (by any engine, the network is shared)
+  if (setupInt8 != engine.int8Net || setupNet != Eval::netGeneration)
+  {
+      for (size_t i = 0; i < setupStates->size(); ++i)
+          (*setupStates)[i].accumulator.computed[WHITE] = (*setupStates)[i].accumulator.computed[BLACK] = false;
+      setupInt8 = engine.int8Net;
+      setupNet = Eval::netGeneration;
+  }
+
+  // We use Position::set() to copy the root position to every thread. The
+  // rootState is per thread and is taken from setupStates->back(), earlier
+  // states are shared since they are read-only.
   for (Thread* th : *this)
   {
       th->nodes = th->tbHits = th->nmpMinPly = th->bestMoveChanges = 0;
-      th->rootDepth = th->completedDepth = 0;
-      th->rootMoves = rootMoves;
-      th->rootPos.set(pos.fen(), pos.is_chess960(), &th->rootState, th);
+      th->rootDepth = th->completedDepth = th->linesDepth = 0;
+      th->lines.clear();
+      th->rootMoves.clear();
+
+      // Shares are dealt round-robin, threads beyond them search every move
+      if (th->id() < splitShares)
+          for (size_t i = th->id(); i < rootMoves.size(); i += splitShares)
+              th->rootMoves.push_back(rootMoves[i]);
+      else
+          th->rootMoves = rootMoves;
+      th->rootPos.set(pos, &th->rootState, th);
       th->rootState = setupStates->back();
   }
 
   main()->start_searching();
 }
 
+/// ThreadPool::reclaim_states() gives back the setup states of the last search
+/// once it is over, for the next position to reuse. While the search runs they
+/// stay here, the root positions of the threads point into them.
+
+StateListPtr ThreadPool::reclaim_states() {
+
+  return main()->is_searching() ? StateListPtr() : std::move(setupStates);
+}
+
 Thread* ThreadPool::get_best_thread() const {
 
     Thread* bestThread = front();
@@ -31,13 +31,26 @@
 #include "position.h"
 #include "search.h"
 #include "thread_win32_osx.h"
+#include "syzygy/tbprobe.h"
 
 namespace Stockfish {
 
+struct Engine;
+
+/// Counters are the statistics of the hot paths of a thread. Only the thread
+/// itself writes them, so they are plain integers, read while it is idle.
+
+struct Counters {
+  uint64_t ttProbes, ttHits;           // Lookups in search() and qsearch()
+  uint64_t searchNodes, qsearchNodes;  // Calls of search() and qsearch()
+  uint64_t picked[MovePicker::STAGE_NB], cutoffs[MovePicker::STAGE_NB]; // Moves searched and beta cutoffs per stage
+};
+
 /// Thread class keeps together all the thread-related stuff. We use
 /// per-thread pawn and material hash tables so that once we get a
 /// pointer to an entry its life time is unlimited and we don't have
-/// to care about someone changing the entry under our feet.
+/// to care about someone changing the entry under our feet. Every thread
+/// belongs to exactly one Engine, reached through the 'engine' reference.
 
 class Thread {
 
@@ -45,10 +58,16 @@ class Thread {
   std::condition_variable cv;
   size_t idx;
   bool exit = false, searching = true; // Set before starting std::thread
+  TimePoint idleTime = 0, idleStart;   // Guarded by 'mutex'
+
+public:
+  Engine& engine; // Set before starting std::thread
+
+private:
   NativeThread stdThread;
 
 public:
-  explicit Thread(size_t);
+  Thread(Engine&, size_t);
   virtual ~Thread();
   virtual void search();
   void clear();
@@ -56,9 +75,16 @@ public:
   void start_searching();
   void wait_for_search_finished();
   size_t id() const { return idx; }
+  bool is_searching() { std::lock_guard<std::mutex> lk(mutex); return searching; }
+  TimePoint idle_time();
+  void reset_counters();
+  size_t memory() const;
 
   Pawns::Table pawnsTable;
   Material::Table materialTable;
+  Eval::NNUE::AccumulatorCache accumulatorCache;
+  Tablebases::Cache tbCache;
+  Counters counters;
   size_t pvIdx, pvLast;
   uint64_t ttHitAverage;
   int selDepth, nmpMinPly;
@@ -68,6 +94,8 @@ public:
   Position rootPos;
   StateInfo rootState;
   Search::RootMoves rootMoves;
+  Search::RootMoves lines; // Split MultiPV: the last completed iteration's
+  Depth linesDepth;        // best lines, guarded by ThreadPool::linesMutex
   Depth rootDepth, completedDepth;
   CounterMoveHistory counterMoves;
   ButterflyHistory mainHistory;
@@ -86,25 +114,35 @@ struct MainThread : public Thread {
 
   void search() override;
   void check_time();
+  void ponderhit();
 
   double previousTimeReduction;
   Value bestPreviousScore;
   Value iterValue[4];
   int callsCnt;
+  uint64_t skillNodes; // Node budget of the "Fast Skill" mode, 0 if off
   bool stopOnPonderhit;
   std::atomic_bool ponder;
+  std::mutex loadMutex;  // Guards loadThreads against ponderhit() from another thread
+  int loadThreads = -1;  // Threads counted in Load::threads, none while pondering, -1 when idle
 };
 
 
 /// ThreadPool struct handles all the threads-related stuff like init, starting,
 /// parking and, most importantly, launching a thread. All the access to threads
-/// is done through this class.
+/// is done through this class. Each Engine owns one pool.
 
 struct ThreadPool : public std::vector<Thread*> {
 
+  explicit ThreadPool(Engine& e) : engine(e) {}
+
   void start_thinking(Position&, StateListPtr&, const Search::LimitsType&, bool = false);
+  StateListPtr reclaim_states();
   void clear();
   void set(size_t);
+  void resize_tables();
+  void reset_stats();
+  std::string stats(bool json = false) const;
 
   MainThread* main()        const { return static_cast<MainThread*>(front()); }
   uint64_t nodes_searched() const { return accumulate(&Thread::nodes); }
@@ -114,9 +152,25 @@ struct ThreadPool : public std::vector<Thread*> {
   void wait_for_search_finished() const;
 
   std::atomic_bool stop, increaseDepth;
+  std::atomic_bool paused; // The helpers wait, see MainThread::check_time()
+  std::atomic_bool suspended; // Set by the Scheduler to preempt the search
+
+  // A perft hands out the root moves one at a time, each thread counts the
+  // subtrees it takes into perftCounts
+  std::atomic<size_t> perftNext;
+  std::vector<uint64_t> perftCounts;
+
+  // With "MultiPV Split" the first splitShares threads each search their own
+  // share of the root moves, the lines of all of them are merged
+  size_t splitShares = 0;
+  std::mutex linesMutex;
 
 private:
+  Engine& engine;
+  TimePoint statsStart;
   StateListPtr setupStates;
+  bool setupInt8 = false;  // The "NNUE Int8" of the last search
+  unsigned setupNet = 0;   // and the Eval::netGeneration
 
   uint64_t accumulate(std::atomic<uint64_t> Thread::* member) const {
 
@@ -127,8 +181,6 @@ private:
   }
 };
 
-extern ThreadPool Threads;
-
 } // namespace Stockfish
 
 #endif // #ifndef THREAD_H_INCLUDED
@@ -20,25 +20,43 @@
 #include <cfloat>
 #include <cmath>
 
+#include "engine.h"
 #include "search.h"
 #include "timeman.h"
 #include "uci.h"
 
 namespace Stockfish {
 
-TimeManagement Time; // Our global time management object
+namespace Load {
 
+std::atomic<int> threads, queued;
+
+}
+
+namespace {
+
+  // Under any load a search keeps at least this share of its normal time
+  constexpr double MinShare = 0.1;
+
+}
 
 /// TimeManagement::init() is called at the beginning of the search and calculates
 /// the bounds of time allowed for the current game ply. We currently support:
 //      1) x basetime (+ z increment)
 //      2) x moves in y seconds (+ z increment)
+//      3) y milliseconds per move, a wall-clock deadline
+// With "CPU Budget" set, the times are scaled by the share of the budget each
+// thread gets when the process asks for more threads than that.
 
-void TimeManagement::init(Search::LimitsType& limits, Color us, int ply) {
+void TimeManagement::init(Engine& engine, Color us, int ply) {
 
-  TimePoint moveOverhead    = TimePoint(Options["Move Overhead"]);
-  TimePoint slowMover       = TimePoint(Options["Slow Mover"]);
-  TimePoint npmsec          = TimePoint(Options["nodestime"]);
+  Search::LimitsType& limits = engine.limits;
+  TimePoint moveOverhead    = TimePoint(engine.options["Move Overhead"]);
+  TimePoint slowMover       = TimePoint(engine.options["Slow Mover"]);
+  TimePoint npmsec          = TimePoint(engine.options["nodestime"]);
+
+  searchLimits = &engine.limits;
+  pool = &engine.threads;
 
   // optScale is a percentage of available time to use for the current move.
   // maxScale is a multiplier applied to optimumTime.
@@ -61,6 +79,20 @@ void TimeManagement::init(Search::LimitsType& limits, Color us, int ply) {
 
   startTime = limits.startTime;
 
+  // The threads of this search are counted already, see MainThread::search()
+  double budgetShare = 1.0;
+  if (int budget = engine.options["CPU Budget"])
+      budgetShare = std::clamp(double(budget) / std::max(Load::threads + Load::queued, 1), MinShare, 1.0);
+
+  // A movetime is a hard limit on the wall clock, also in 'nodes as time'
+  // mode. Under load the search aims at its share of it.
+  if (limits.movetime)
+  {
+      TimePoint deadline = startTime + limits.movetime;
+      limits.deadline = limits.deadline ? std::min(limits.deadline, deadline) : deadline;
+      limits.movetime = std::max(TimePoint(1), TimePoint(budgetShare * limits.movetime));
+  }
+
   // Maximum move horizon of 50 moves
   int mtg = limits.movestogo ? std::min(limits.movestogo, 50) : 50;
 
@@ -94,8 +126,11 @@ void TimeManagement::init(Search::LimitsType& limits, Color us, int ply) {
   optimumTime = TimePoint(optScale * timeLeft);
   maximumTime = TimePoint(std::min(0.8 * limits.time[us] - moveOverhead, maxScale * optimumTime));
 
-  if (Options["Ponder"])
+  if (engine.options["Ponder"])
       optimumTime += optimumTime / 4;
+
+  optimumTime = TimePoint(budgetShare * optimumTime);
+  maximumTime = TimePoint(budgetShare * maximumTime);
 }
 
 } // namespace Stockfish
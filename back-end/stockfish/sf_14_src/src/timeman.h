@@ -19,33 +19,48 @@
 #ifndef TIMEMAN_H_INCLUDED
 #define TIMEMAN_H_INCLUDED
 
+#include <atomic>
+
 #include "misc.h"
 #include "search.h"
 #include "thread.h"
 
 namespace Stockfish {
 
+struct Engine;
+
+/// Load is the demand on the CPUs by the whole process: the threads of the
+/// running searches of every engine and the jobs queued in the schedulers,
+/// each of those a search thread to come. The "CPU Budget" mode of
+/// TimeManagement measures it against the cores the searches may use.
+
+namespace Load {
+
+extern std::atomic<int> threads, queued;
+
+}
+
 /// The TimeManagement class computes the optimal time to think depending on
 /// the maximum available time, the game move number and other parameters.
 
 class TimeManagement {
 public:
-  void init(Search::LimitsType& limits, Color us, int ply);
+  void init(Engine& engine, Color us, int ply);
   TimePoint optimum() const { return optimumTime; }
   TimePoint maximum() const { return maximumTime; }
-  TimePoint elapsed() const { return Search::Limits.npmsec ?
-                                     TimePoint(Threads.nodes_searched()) : now() - startTime; }
+  TimePoint elapsed() const { return searchLimits->npmsec ?
+                                     TimePoint(pool->nodes_searched()) : now() - startTime; }
 
-  int64_t availableNodes; // When in 'nodes as time' mode
+  int64_t availableNodes = 0; // When in 'nodes as time' mode
 
 private:
+  const Search::LimitsType* searchLimits = nullptr; // Of the engine last passed to init()
+  const ThreadPool* pool = nullptr;
   TimePoint startTime;
   TimePoint optimumTime;
   TimePoint maximumTime;
 };
 
-extern TimeManagement Time;
-
 } // namespace Stockfish
 
 #endif // #ifndef TIMEMAN_H_INCLUDED
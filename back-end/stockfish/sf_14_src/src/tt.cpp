@@ -16,10 +16,21 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <cstring>   // For std::memset
+#include <algorithm>
+#include <cstring>   // For std::memset and std::memcpy
+#include <fstream>
 #include <iostream>
 #include <thread>
 
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "bitboard.h"
 #include "misc.h"
 #include "thread.h"
@@ -28,20 +39,50 @@
 
 namespace Stockfish {
 
-TranspositionTable TT; // Our global transposition table
+namespace {
+
+  // Header of a hash table snapshot file, followed by the raw clusters. The
+  // layout is that of the build which wrote it, snapshots are not portable.
+  struct SnapshotHeader {
+    char magic[8];
+    uint64_t clusterCount;
+    uint8_t generation8;
+    uint8_t xorKeys; // Written from a shared table, see TTEntry::check()
+    char padding[46]; // Keep the clusters 64 byte aligned in the file
+  };
+
+  static_assert(sizeof(SnapshotHeader) == 64, "Unexpected SnapshotHeader size");
+
+  constexpr char SnapshotMagic[8] = "SFTT001";
+  constexpr char SegmentMagic[8] = "SFSHTT1";
+
+  int32_t process_id() {
+#ifndef _WIN32
+    return int32_t(getpid());
+#else
+    return 0;
+#endif
+  }
+
+} // namespace
 
 /// TTEntry::save() populates the TTEntry with a new node's data, possibly
-/// overwriting an old position. Update is not atomic and can be racy.
+/// overwriting an old position. Update is not atomic and can be racy. The
+/// table is passed in by the caller because an entry does not know which of
+/// the engines' tables it belongs to, nor the generation of the writer.
+
+void TTEntry::save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, const TranspositionTable& tt) {
 
-void TTEntry::save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev) {
+  const bool shared = tt.is_shared();
+  const uint16_t stored = shared ? uint16_t(key16 ^ check()) : key16;
 
   // Preserve any existing move for the same position
-  if (m || (uint16_t)k != key16)
+  if (m || (uint16_t)k != stored)
       move16 = (uint16_t)m;
 
   // Overwrite less valuable entries (cheapest checks first)
   if (b == BOUND_EXACT
-      || (uint16_t)k != key16
+      || (uint16_t)k != stored
       || d - DEPTH_OFFSET > depth8 - 4)
   {
       assert(d > DEPTH_OFFSET);
@@ -49,26 +90,31 @@ void TTEntry::save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev)
 
       key16     = (uint16_t)k;
       depth8    = (uint8_t)(d - DEPTH_OFFSET);
-      genBound8 = (uint8_t)(TT.generation8 | uint8_t(pv) << 2 | b);
+      genBound8 = (uint8_t)(tt.generation() | uint8_t(pv) << 2 | b);
       value16   = (int16_t)v;
       eval16    = (int16_t)ev;
   }
-}
-
 
-/// TranspositionTable::resize() sets the size of the transposition table,
-/// measured in megabytes. Transposition table consists of a power of 2 number
-/// of clusters and each cluster consists of ClusterSize number of TTEntry.
+  if (shared)
+  {
+      key16 = uint16_t(k) ^ check();
+      tt.set_owner(this);
+  }
+}
 
-void TranspositionTable::resize(size_t mbSize) {
 
-  Threads.main()->wait_for_search_finished();
+/// TranspositionTable::allocate() and zero() do the memory work for both the
+/// private and the shared tables. zero() uses as many helper threads as the
+/// owning engine has search threads. The NUMA policy decides where the pages
+/// land: FIRST_TOUCH leaves it to the thread that zeroes them, INTERLEAVE
+/// spreads them over all nodes and LOCAL zeroes each node's share of the table
+/// from a thread bound to that node, as the search threads are with NUMA Bind.
 
-  aligned_large_pages_free(table);
+TranspositionTable::Cluster* TranspositionTable::allocate(size_t mbSize, size_t& clusterCount) {
 
   clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
 
-  table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
+  Cluster* table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
   if (!table)
   {
       std::cerr << "Failed to allocate " << mbSize
@@ -76,29 +122,33 @@ void TranspositionTable::resize(size_t mbSize) {
       exit(EXIT_FAILURE);
   }
 
-  clear();
+  return table;
 }
 
+void TranspositionTable::zero(Cluster* table, size_t clusterCount, size_t threadCount, Numa::Policy policy) {
 
-/// TranspositionTable::clear() initializes the entire transposition table to zero,
-//  in a multi-threaded way.
+  std::vector<std::thread> threads;
 
-void TranspositionTable::clear() {
+  if (policy == Numa::INTERLEAVE)
+      Numa::interleave(table, clusterCount * sizeof(Cluster));
 
-  std::vector<std::thread> threads;
+  if (policy == Numa::LOCAL)
+      threadCount = std::max(threadCount, Numa::nodes());
 
-  for (size_t idx = 0; idx < Options["Threads"]; ++idx)
+  for (size_t idx = 0; idx < threadCount; ++idx)
   {
-      threads.emplace_back([this, idx]() {
+      threads.emplace_back([table, clusterCount, idx, threadCount, policy]() {
 
           // Thread binding gives faster search on systems with a first-touch policy
-          if (Options["Threads"] > 8)
+          if (policy == Numa::LOCAL)
+              Numa::bind_thread(idx);
+          else if (threadCount > 8)
               WinProcGroup::bindThisThread(idx);
 
           // Each thread will zero its part of the hash table
-          const size_t stride = size_t(clusterCount / Options["Threads"]),
+          const size_t stride = size_t(clusterCount / threadCount),
                        start  = size_t(stride * idx),
-                       len    = idx != Options["Threads"] - 1 ?
+                       len    = idx != threadCount - 1 ?
                                 stride : clusterCount - start;
 
           std::memset(&table[start], 0, len * sizeof(Cluster));
@@ -110,6 +160,396 @@ void TranspositionTable::clear() {
 }
 
 
+/// TranspositionTable destructor frees a private table or gives the tenant
+/// slot of a shared one back
+
+TranspositionTable::~TranspositionTable() {
+
+  if (shared)
+      shared->header->live &= ~(1u << tenant);
+  else
+      aligned_large_pages_free(table);
+}
+
+
+/// TranspositionTable::resize() sets the size of the transposition table,
+/// measured in megabytes. Transposition table consists of a power of 2 number
+/// of clusters and each cluster consists of ClusterSize number of TTEntry.
+/// The caller must make sure the owning engine is not searching. A shared
+/// table keeps the size it was created with.
+
+void TranspositionTable::resize(size_t mbSize, size_t threadCount, Numa::Policy policy) {
+
+  if (shared)
+      return;
+
+  numaPolicy = policy;
+  aligned_large_pages_free(table);
+  table = allocate(mbSize, clusterCount);
+  clear(threadCount);
+}
+
+
+/// TranspositionTable::clear() initializes the entire transposition table to
+/// zero. On a shared table, which other engines still use, the entries of this
+/// engine are made old instead: half a generation cycle ahead they look stale.
+
+void TranspositionTable::clear(size_t threadCount) {
+
+  if (shared)
+  {
+      generation8 += 16 * GENERATION_DELTA;
+      shared->header->generation8[tenant] = generation8;
+  }
+  else
+      zero(table, clusterCount, threadCount, numaPolicy);
+}
+
+
+/// TranspositionTable::new_search() advances the generation, only the one of
+/// this engine in a shared table
+
+void TranspositionTable::new_search() {
+
+  generation8 += GENERATION_DELTA; // Lower bits are used for other things
+
+  if (shared)
+      shared->header->generation8[tenant].store(generation8, std::memory_order_relaxed);
+}
+
+
+/// TranspositionTable::attach() drops the private table and takes a free tenant
+/// slot of 'st' instead. It fails when all MaxTenants slots are in use. The
+/// slot is claimed with a compare and swap, tenants may be in other processes.
+/// The caller must make sure the owning engine is not searching.
+
+bool TranspositionTable::attach(std::shared_ptr<SharedTT> st) {
+
+  SharedTT::Header& h = *st->header;
+  uint32_t live = h.live.load();
+  int slot;
+
+  do {
+      if (!~live && !st->reclaim(live))
+          return false;
+
+      slot = lsb(~live);
+  } while (!h.live.compare_exchange_weak(live, live | 1u << slot));
+
+  // Whatever the previous tenant of the slot left, it is half a cycle old
+  h.pid[slot] = process_id();
+  h.generation8[slot] = uint8_t(h.generation8[slot] + 16 * GENERATION_DELTA);
+
+  if (shared)
+      shared->header->live &= ~(1u << tenant);
+  else
+      aligned_large_pages_free(table);
+
+  shared       = st;
+  tenant       = slot;
+  table        = st->table;
+  clusterCount = st->clusterCount;
+  generation8  = h.generation8[slot];
+
+  return true;
+}
+
+
+/// TranspositionTable::detach() gives the tenant slot of a shared table back.
+/// The engine is left without a table, resize() must be called next.
+
+void TranspositionTable::detach() {
+
+  if (!shared)
+      return;
+
+  shared->header->live &= ~(1u << tenant);
+  shared.reset();
+  table = nullptr;
+  clusterCount = 0;
+  generation8 = 0;
+}
+
+
+/// TranspositionTable::set_owner() records in the cluster which tenant an entry
+/// of a shared table belongs to. Clusters are 32 bytes and the table is page
+/// aligned, so the cluster is found by masking the entry's address.
+
+void TranspositionTable::set_owner(TTEntry* tte) const {
+
+  Cluster* c = reinterpret_cast<Cluster*>(uintptr_t(tte) & ~uintptr_t(sizeof(Cluster) - 1));
+  int shift = 5 * int(tte - c->entry);
+
+  c->owners = uint16_t((c->owners & ~(0x1F << shift)) | tenant << shift);
+}
+
+
+/// TranspositionTable::save() writes the whole table to a snapshot file, through
+/// a shared file mapping where there is mmap(). The owning engine should not be
+/// searching, or the snapshot will have torn entries.
+
+bool TranspositionTable::save(const std::string& path) const {
+
+  SnapshotHeader h = {};
+  std::memcpy(h.magic, SnapshotMagic, sizeof(h.magic));
+  h.clusterCount = clusterCount;
+  h.generation8 = generation8;
+  h.xorKeys = bool(shared);
+
+  const size_t size = sizeof(h) + clusterCount * sizeof(Cluster);
+
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1)
+      return false;
+
+  if (ftruncate(fd, off_t(size)) == -1)
+  {
+      ::close(fd);
+      return false;
+  }
+
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (base == MAP_FAILED)
+      return false;
+
+  std::memcpy(base, &h, sizeof(h));
+  std::memcpy(static_cast<char*>(base) + sizeof(h), table, size - sizeof(h));
+
+  return munmap(base, size) == 0;
+#else
+  std::ofstream f(path, std::ios::binary);
+  f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  f.write(reinterpret_cast<const char*>(table), std::streamsize(size - sizeof(h)));
+
+  return bool(f);
+#endif
+}
+
+
+/// TranspositionTable::load() replaces the table with a snapshot written by
+/// save(), resizing it to the snapshot's size if needed ("Hash" keeps its value
+/// though, so changing "Hash" or "Threads" later drops the snapshot). Returns
+/// false, leaving the table untouched, if the file is not a valid snapshot.
+/// A shared table can not be loaded into, other engines are using it.
+
+bool TranspositionTable::load(const std::string& path) {
+
+  if (shared)
+      return false;
+
+  SnapshotHeader h;
+
+#ifndef _WIN32
+  struct stat statbuf;
+  int fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd == -1)
+      return false;
+
+  if (fstat(fd, &statbuf) == -1 || size_t(statbuf.st_size) < sizeof(h))
+  {
+      ::close(fd);
+      return false;
+  }
+
+  const size_t size = size_t(statbuf.st_size);
+  void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (base == MAP_FAILED)
+      return false;
+
+  std::memcpy(&h, base, sizeof(h));
+  const char* data = static_cast<const char*>(base) + sizeof(h);
+#else
+  std::ifstream f(path, std::ios::binary | std::ios::ate);
+  const size_t size = f ? size_t(f.tellg()) : 0;
+
+  if (size < sizeof(h))
+      return false;
+
+  std::vector<char> buffer(size);
+  f.seekg(0).read(buffer.data(), std::streamsize(size));
+  std::memcpy(&h, buffer.data(), sizeof(h));
+  const char* data = buffer.data() + sizeof(h);
+#endif
+
+  const size_t MB = 1024 * 1024;
+  bool valid =   !std::memcmp(h.magic, SnapshotMagic, sizeof(h.magic))
+              &&  h.clusterCount
+              &&  size == sizeof(h) + h.clusterCount * sizeof(Cluster)
+              &&  h.clusterCount * sizeof(Cluster) % MB == 0;
+
+  if (valid)
+  {
+      if (h.clusterCount != clusterCount)
+      {
+          aligned_large_pages_free(table);
+          table = allocate(h.clusterCount * sizeof(Cluster) / MB, clusterCount);
+
+          if (numaPolicy == Numa::INTERLEAVE)
+              Numa::interleave(table, clusterCount * sizeof(Cluster));
+      }
+
+      std::memcpy(table, data, clusterCount * sizeof(Cluster));
+      generation8 = h.generation8;
+
+      // Keys of a shared table snapshot are XOR-ed with the entry data
+      if (h.xorKeys)
+          for (size_t i = 0; i < clusterCount; ++i)
+              for (TTEntry& tte : table[i].entry)
+                  tte.key16 ^= tte.check();
+  }
+
+#ifndef _WIN32
+  munmap(base, size);
+#endif
+
+  return valid;
+}
+
+
+/// SharedTT constructor makes a table for the engines of this process only
+
+SharedTT::SharedTT(size_t mbSize, size_t threadCount) {
+
+  header = new Header();
+  table = TranspositionTable::allocate(mbSize, clusterCount);
+  TranspositionTable::zero(table, clusterCount, std::max(threadCount, size_t(1)), Numa::FIRST_TOUCH);
+}
+
+SharedTT::~SharedTT() {
+
+#ifndef _WIN32
+  if (mapSize)
+  {
+      munmap(table, mapSize);
+      return;
+  }
+#endif
+
+  aligned_large_pages_free(table);
+  delete header;
+}
+
+
+/// SharedTT::open() attaches to the named shared memory segment 'name', or
+/// creates it with a table of 'mbSize' MB if there is none yet. The segment
+/// outlives the processes using it, until it is removed from /dev/shm. Pages
+/// are zero when first used and backed by huge pages where the kernel allows
+/// it for shared memory (transparent_hugepage/shmem_enabled). Returns nullptr
+/// if the segment can not be opened or is not a table of this layout.
+
+std::shared_ptr<SharedTT> SharedTT::open(const std::string& name, size_t mbSize) {
+
+#ifndef _WIN32
+  const std::string path = name[0] == '/' ? name : "/" + name;
+  size_t size = mbSize * 1024 * 1024 / sizeof(TranspositionTable::Cluster)
+                       * sizeof(TranspositionTable::Cluster) + HeaderSpace;
+  bool created = true;
+
+  int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1 && errno == EEXIST)
+      created = false, fd = shm_open(path.c_str(), O_RDWR, 0);
+
+  if (fd == -1)
+      return nullptr;
+
+  if (created && ftruncate(fd, off_t(size)) == -1)
+  {
+      ::close(fd);
+      shm_unlink(path.c_str());
+      return nullptr;
+  }
+
+  // An existing segment has the size its creator gave it, maybe only just now
+  for (int i = 0; !created; ++i)
+  {
+      struct stat statbuf;
+      size = fstat(fd, &statbuf) == -1 ? 0 : size_t(statbuf.st_size);
+
+      if (size || i == 1000)
+          break;
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  if (size < HeaderSpace + sizeof(TranspositionTable::Cluster) || size % HeaderSpace)
+  {
+      ::close(fd);
+      return nullptr;
+  }
+
+  void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (base == MAP_FAILED)
+      return nullptr;
+
+#if defined(MADV_HUGEPAGE)
+  madvise(base, size - HeaderSpace, MADV_HUGEPAGE);
+#endif
+
+  std::shared_ptr<SharedTT> st(new SharedTT());
+  st->mapSize = size;
+  st->table = static_cast<TranspositionTable::Cluster*>(base);
+  st->clusterCount = (size - HeaderSpace) / sizeof(TranspositionTable::Cluster);
+  st->header = reinterpret_cast<Header*>(static_cast<char*>(base) + size - HeaderSpace);
+
+  Header& h = *st->header;
+
+  if (created)
+  {
+      std::memcpy(h.magic, SegmentMagic, sizeof(h.magic));
+      h.clusterCount = st->clusterCount;
+      h.ready.store(1, std::memory_order_release);
+  }
+  else
+      for (int i = 0; i < 1000 && !h.ready.load(std::memory_order_acquire); ++i)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  if (   !h.ready.load(std::memory_order_acquire)
+      ||  std::memcmp(h.magic, SegmentMagic, sizeof(h.magic))
+      ||  h.clusterCount != st->clusterCount)
+      return nullptr;
+
+  return st;
+#else
+  (void)name, (void)mbSize;
+  return nullptr;
+#endif
+}
+
+
+/// SharedTT::reclaim() frees the slots of tenants whose process is gone and
+/// updates 'live'. Returns false if there was none.
+
+bool SharedTT::reclaim(uint32_t& live) {
+
+  uint32_t dead = 0;
+
+#ifndef _WIN32
+  for (uint32_t b = live; b; b &= b - 1)
+  {
+      int slot = lsb(b);
+      int32_t pid = header->pid[slot];
+
+      if (pid && kill(pid, 0) == -1 && errno == ESRCH)
+          dead |= 1u << slot;
+  }
+#endif
+
+  if (!dead)
+      return false;
+
+  live = header->live.fetch_and(~dead) & ~dead;
+  return true;
+}
+
+
 /// TranspositionTable::probe() looks up the current position in the transposition
 /// table. It returns true and a pointer to the TTEntry if the position is found.
 /// Otherwise, it returns false and a pointer to an empty or least valuable TTEntry
@@ -119,6 +559,9 @@ void TranspositionTable::clear() {
 
 TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
 
+  if (shared)
+      return probe_shared(key, found);
+
   TTEntry* const tte = first_entry(key);
   const uint16_t key16 = (uint16_t)key;  // Use the low 16 bits as key inside the cluster
 
@@ -146,6 +589,47 @@ TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
 }
 
 
+/// TranspositionTable::probe_shared() is probe() for a shared table: keys are
+/// XOR-verified, a hit makes the entry ours, and the age of an entry is taken
+/// from the generation of its owner. Entries of detached tenants go first.
+
+TTEntry* TranspositionTable::probe_shared(const Key key, bool& found) const {
+
+  TTEntry* const tte = first_entry(key);
+  const uint16_t key16 = (uint16_t)key;
+
+  for (int i = 0; i < ClusterSize; ++i)
+      if ((tte[i].key16 ^ tte[i].check()) == key16 || !tte[i].depth8)
+      {
+          tte[i].genBound8 = uint8_t(generation8 | (tte[i].genBound8 & (GENERATION_DELTA - 1))); // Refresh
+          set_owner(&tte[i]);
+
+          return found = (bool)tte[i].depth8, &tte[i];
+      }
+
+  const Cluster* c = reinterpret_cast<const Cluster*>(tte);
+  const uint32_t live = shared->header->live.load(std::memory_order_relaxed);
+  int value[ClusterSize];
+
+  for (int i = 0; i < ClusterSize; ++i)
+  {
+      int owner = (c->owners >> (5 * i)) & 0x1F;
+      int age = live & (1u << owner) ?
+                (GENERATION_CYCLE + shared->header->generation8[owner].load(std::memory_order_relaxed) - tte[i].genBound8) & GENERATION_MASK
+              : GENERATION_MASK;
+
+      value[i] = tte[i].depth8 - age;
+  }
+
+  int r = 0;
+  for (int i = 1; i < ClusterSize; ++i)
+      if (value[r] > value[i])
+          r = i;
+
+  return found = false, &tte[r];
+}
+
+
 /// TranspositionTable::hashfull() returns an approximation of the hashtable
 /// occupation during a search. The hash is x permill full, as per UCI protocol.
 
@@ -154,9 +638,61 @@ int TranspositionTable::hashfull() const {
   int cnt = 0;
   for (int i = 0; i < 1000; ++i)
       for (int j = 0; j < ClusterSize; ++j)
-          cnt += table[i].entry[j].depth8 && (table[i].entry[j].genBound8 & GENERATION_MASK) == generation8;
+          cnt +=  table[i].entry[j].depth8
+              && (table[i].entry[j].genBound8 & GENERATION_MASK) == generation8
+              && (!shared || ((table[i].owners >> (5 * j)) & 0x1F) == tenant);
 
   return cnt / ClusterSize;
 }
 
+
+/// PerftTable::resize() sets the size of the perft hash in megabytes, 0 frees
+/// it. The previous counts are dropped.
+
+void PerftTable::resize(size_t mbSize) {
+
+  aligned_large_pages_free(table);
+  table = nullptr;
+  entryCount = mbSize * 1024 * 1024 / sizeof(Entry);
+
+  if (!entryCount)
+      return;
+
+  table = static_cast<Entry*>(aligned_large_pages_alloc(entryCount * sizeof(Entry)));
+  if (!table)
+  {
+      std::cerr << "Failed to allocate " << mbSize
+                << "MB for the perft hash table." << std::endl;
+      exit(EXIT_FAILURE);
+  }
+
+  std::memset(static_cast<void*>(table), 0, entryCount * sizeof(Entry));
+}
+
+
+/// PerftTable::probe() looks up the leaf count of the subtree of the given
+/// depth under the position with the given key
+
+bool PerftTable::probe(Key key, Depth d, uint64_t& nodes) const {
+
+  const Entry& e = table[mul_hi64(depth_key(key, d), entryCount)];
+  uint64_t n = e.nodes.load(std::memory_order_relaxed);
+
+  if ((e.check.load(std::memory_order_relaxed) ^ n) != depth_key(key, d) || !n)
+      return false;
+
+  nodes = n;
+  return true;
+}
+
+
+/// PerftTable::store() saves a leaf count, always replacing the slot's entry
+
+void PerftTable::store(Key key, Depth d, uint64_t nodes) {
+
+  Entry& e = table[mul_hi64(depth_key(key, d), entryCount)];
+  e.nodes.store(nodes, std::memory_order_relaxed);
+  e.check.store(depth_key(key, d) ^ nodes, std::memory_order_relaxed);
+}
+
 } // namespace Stockfish
@@ -19,11 +19,17 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <atomic>
+#include <memory>
+#include <string>
+
 #include "misc.h"
 #include "types.h"
 
 namespace Stockfish {
 
+class TranspositionTable;
+
 /// TTEntry struct is the 10 bytes transposition table entry, defined as below:
 ///
 /// key        16 bit
@@ -43,11 +49,18 @@ struct TTEntry {
   Depth depth() const { return (Depth)depth8 + DEPTH_OFFSET; }
   bool is_pv()  const { return (bool)(genBound8 & 0x4); }
   Bound bound() const { return (Bound)(genBound8 & 0x3); }
-  void save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev);
+  void save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, const TranspositionTable& tt);
 
 private:
   friend class TranspositionTable;
 
+  // In a shared table key16 is stored XOR-ed with check(), so an entry torn by
+  // two concurrent writers no longer matches its key and reads as a miss. The
+  // generation bits are left out, probe() refreshes them in place.
+  uint16_t check() const {
+    return uint16_t(depth8 | (genBound8 & 0x7) << 8) ^ move16 ^ uint16_t(value16) ^ uint16_t(eval16);
+  }
+
   uint16_t key16;
   uint8_t  depth8;
   uint8_t  genBound8;
@@ -62,14 +75,23 @@ private:
 /// contains information on exactly one position. The size of a Cluster should
 /// divide the size of a cache line for best performance, as the cacheline is
 /// prefetched when possible.
+///
+/// Every engine has a table of its own unless it is attached to a SharedTT,
+/// see below. The table is then only a view of the shared clusters, with the
+/// engine's own generation counter.
+
+class SharedTT;
 
 class TranspositionTable {
 
+  friend struct TTEntry;
+  friend class SharedTT;
+
   static constexpr int ClusterSize = 3;
 
   struct Cluster {
     TTEntry entry[ClusterSize];
-    char padding[2]; // Pad to 32 bytes
+    uint16_t owners; // Tenant of each entry, 5 bits each, in shared tables only
   };
 
   static_assert(sizeof(Cluster) == 32, "Unexpected Cluster size");
@@ -81,26 +103,118 @@ class TranspositionTable {
   static constexpr int      GENERATION_MASK  = (0xFF << GENERATION_BITS) & 0xFF; // mask to pull out generation number
 
 public:
- ~TranspositionTable() { aligned_large_pages_free(table); }
-  void new_search() { generation8 += GENERATION_DELTA; } // Lower bits are used for other things
+  static constexpr int MaxTenants = 32; // What fits in Cluster::owners
+
+  TranspositionTable() = default;
+ ~TranspositionTable();
+
+  TranspositionTable(const TranspositionTable&) = delete;
+  TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+  void new_search();
+  uint8_t generation() const { return generation8; }
   TTEntry* probe(const Key key, bool& found) const;
   int hashfull() const;
-  void resize(size_t mbSize);
-  void clear();
+  void resize(size_t mbSize, size_t threadCount, Numa::Policy policy = Numa::FIRST_TOUCH);
+  void clear(size_t threadCount);
+  bool attach(std::shared_ptr<SharedTT> st);
+  void detach();
+  bool is_shared() const { return bool(shared); }
+  bool save(const std::string& path) const;
+  bool load(const std::string& path);
 
   TTEntry* first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
   }
 
 private:
-  friend struct TTEntry;
+  static Cluster* allocate(size_t mbSize, size_t& clusterCount);
+  static void zero(Cluster* table, size_t clusterCount, size_t threadCount, Numa::Policy policy);
+  TTEntry* probe_shared(const Key key, bool& found) const;
+  void set_owner(TTEntry* tte) const;
+
+  size_t clusterCount = 0;
+  Cluster* table = nullptr;
+  uint8_t generation8 = 0; // Size must be not bigger than TTEntry::genBound8
+  Numa::Policy numaPolicy = Numa::FIRST_TOUCH;
+  std::shared_ptr<SharedTT> shared;
+  int tenant = 0;
+};
+
+
+/// SharedTT is one hash table for several engines, so that games played side
+/// by side reuse each other's work. Each attached engine is a tenant with a
+/// generation counter of its own, and an entry ages with the searches of the
+/// tenant that wrote or last hit it: a busy game no longer ages out the entries
+/// of a slow one. Entries of a detached tenant are replaced first. Writes are
+/// not locked, entries are XOR-verified instead (see TTEntry::check()). The
+/// size is fixed, "Hash" does not change it, and "Clear Hash" or a new game
+/// only ages the engine's own entries.
+///
+/// A table made by open() is a named shared memory segment that the engines of
+/// other processes can attach to as well. The tenants' state then lives in the
+/// segment too, after the clusters, and a tenant whose process died is freed
+/// by the next engine that finds all slots taken.
+
+class SharedTT {
+
+  friend class TranspositionTable;
 
-  size_t clusterCount;
-  Cluster* table;
-  uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
+  struct Header {
+    char magic[8];
+    uint64_t clusterCount;
+    std::atomic<uint8_t> generation8[TranspositionTable::MaxTenants];
+    std::atomic<int32_t> pid[TranspositionTable::MaxTenants]; // Process of each tenant
+    std::atomic<uint32_t> live;  // One bit per tenant
+    std::atomic<uint32_t> ready; // Set by the creator of a segment once sized
+  };
+
+  static constexpr size_t HeaderSpace = 4096;
+  static_assert(sizeof(Header) <= HeaderSpace, "Unexpected Header size");
+
+  SharedTT() = default;
+  bool reclaim(uint32_t& live);
+
+  TranspositionTable::Cluster* table = nullptr;
+  size_t clusterCount = 0;
+  Header* header = nullptr;
+  size_t mapSize = 0; // Of a named segment, 0 for a table of this process only
+
+public:
+  SharedTT(size_t mbSize, size_t threadCount);
+ ~SharedTT();
+
+  SharedTT(const SharedTT&) = delete;
+  SharedTT& operator=(const SharedTT&) = delete;
+
+  static std::shared_ptr<SharedTT> open(const std::string& name, size_t mbSize);
 };
 
-extern TranspositionTable TT;
+
+/// PerftTable memoizes the leaf counts of perft subtrees by position key and
+/// depth ("Perft Hash" MB, off when 0). The threads of a parallel perft share
+/// it without locks: an entry stores its key XOR-ed with its count, so a torn
+/// entry reads as a miss.
+
+class PerftTable {
+
+  struct Entry {
+    std::atomic<uint64_t> check, nodes;
+  };
+
+public:
+ ~PerftTable() { aligned_large_pages_free(table); }
+  void resize(size_t mbSize);
+  bool probe(Key key, Depth d, uint64_t& nodes) const;
+  void store(Key key, Depth d, uint64_t nodes);
+  bool enabled() const { return entryCount != 0; }
+
+private:
+  static Key depth_key(Key key, Depth d) { return key ^ (uint64_t(d) * 0x9E3779B97F4A7C15ULL); }
+
+  Entry* table = nullptr;
+  size_t entryCount = 0;
+};
 
 } // namespace Stockfish
 
@@ -30,8 +30,19 @@ namespace Stockfish {
 
 bool Tune::update_on_last;
 const UCI::Option* LastOption = nullptr;
+static UCI::OptionsMap* TuneOptions = nullptr; // Tuned values are globals, so one map drives them
 static std::map<std::string, int> TuneResults;
 
+void Tune::init(UCI::OptionsMap& o) {
+
+  TuneOptions = &o;
+
+  for (auto& e : instance().list)
+      e->init_option();
+
+  read_options();
+}
+
 string Tune::next(string& names, bool pop) {
 
   string name;
@@ -66,8 +77,8 @@ static void make_option(const string& n, int v, const SetRange& r) {
   if (TuneResults.count(n))
       v = TuneResults[n];
 
-  Options[n] << UCI::Option(v, r(v).first, r(v).second, on_tune);
-  LastOption = &Options[n];
+  (*TuneOptions)[n] << UCI::Option(v, r(v).first, r(v).second, on_tune);
+  LastOption = &(*TuneOptions)[n];
 
   // Print formatted parameters, ready to be copy-pasted in Fishtest
   std::cout << n << ","
@@ -81,15 +92,15 @@ static void make_option(const string& n, int v, const SetRange& r) {
 template<> void Tune::Entry<int>::init_option() { make_option(name, value, range); }
 
 template<> void Tune::Entry<int>::read_option() {
-  if (Options.count(name))
-      value = int(Options[name]);
+  if (TuneOptions->count(name))
+      value = int((*TuneOptions)[name]);
 }
 
 template<> void Tune::Entry<Value>::init_option() { make_option(name, value, range); }
 
 template<> void Tune::Entry<Value>::read_option() {
-  if (Options.count(name))
-      value = Value(int(Options[name]));
+  if (TuneOptions->count(name))
+      value = Value(int((*TuneOptions)[name]));
 }
 
 template<> void Tune::Entry<Score>::init_option() {
@@ -98,11 +109,11 @@ template<> void Tune::Entry<Score>::init_option() {
 }
 
 template<> void Tune::Entry<Score>::read_option() {
-  if (Options.count("m" + name))
-      value = make_score(int(Options["m" + name]), eg_value(value));
+  if (TuneOptions->count("m" + name))
+      value = make_score(int((*TuneOptions)["m" + name]), eg_value(value));
 
-  if (Options.count("e" + name))
-      value = make_score(mg_value(value), int(Options["e" + name]));
+  if (TuneOptions->count("e" + name))
+      value = make_score(mg_value(value), int((*TuneOptions)["e" + name]));
 }
 
 // Instead of a variable here we have a PostUpdate function: just call it
@@ -19,6 +19,7 @@
 #ifndef TUNE_H_INCLUDED
 #define TUNE_H_INCLUDED
 
+#include <map>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -26,6 +27,12 @@
 
 namespace Stockfish {
 
+namespace UCI { // Same declarations as in uci.h, which includes us via types.h
+class Option;
+struct CaseInsensitiveLess;
+typedef std::map<std::string, Option, CaseInsensitiveLess> OptionsMap;
+}
+
 typedef std::pair<int, int> Range; // Option's min-max values
 typedef Range (RangeFun) (int);
 
@@ -145,7 +152,7 @@ public:
   static int add(const std::string& names, Args&&... args) {
     return instance().add(SetDefaultRange, names.substr(1, names.size() - 2), args...); // Remove trailing parenthesis
   }
-  static void init() { for (auto& e : instance().list) e->init_option(); read_options(); } // Deferred, due to UCI::Options access
+  static void init(UCI::OptionsMap& o); // Deferred, due to UCI::Options access
   static void read_options() { for (auto& e : instance().list) e->read_option(); }
   static bool update_on_last;
 };
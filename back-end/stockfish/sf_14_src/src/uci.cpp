@@ -18,10 +18,15 @@
 
 #include <cassert>
 #include <cmath>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
 
+#include "analysis.h"
+#include "book.h"
+#include "engine.h"
 #include "evaluate.h"
 #include "movegen.h"
 #include "position.h"
@@ -49,10 +54,12 @@ namespace {
   // or the starting position ("startpos") and then makes the moves given in the
   // following move list ("moves").
 
-  void position(Position& pos, istringstream& is, StateListPtr& states) {
+  void position(Engine& engine, Position& pos, istringstream& is, StateListPtr& states) {
 
     Move m;
     string token, fen;
+    vector<string> moves;
+    bool chess960 = engine.options["UCI_Chess960"];
 
     is >> token;
 
@@ -67,27 +74,61 @@ namespace {
     else
         return;
 
-    states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
-    pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+    while (is >> token)
+        moves.push_back(token);
+
+    // The states of the last position, if 'go' handed them to a search that
+    // is over by now
+    if (!states)
+        states = engine.threads.reclaim_states();
+
+    // GUIs send the whole game before every move: when the moves extend those
+    // of the last position, which is still the current one (not flipped, same
+    // main thread), only the new ones are played. Otherwise the list is set up
+    // again in the storage it already has.
+    size_t played = 0;
+
+    if (   states
+        && states->fen == fen
+        && states->chess960 == chess960
+        && states->moves.size() <= moves.size()
+        && std::equal(states->moves.begin(), states->moves.end(), moves.begin())
+        && pos.state() == &states->back()
+        && pos.key() == states->key
+        && pos.this_thread() == engine.threads.main())
+        played = states->moves.size();
+    else
+    {
+        if (!states)
+            states = StateListPtr(new StateList);
+
+        states->resize(1);
+        states->fen = fen;
+        states->chess960 = chess960;
+        states->moves.clear();
+        pos.set(fen, chess960, &states->back(), engine.threads.main());
+    }
 
     // Parse move list (if any)
-    while (is >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE)
+    for ( ; played < moves.size() && (m = UCI::to_move(pos, moves[played])) != MOVE_NONE; ++played)
     {
-        states->emplace_back();
-        pos.do_move(m, states->back());
+        pos.do_move(m, states->emplace_back());
+        states->moves.push_back(moves[played]);
     }
+
+    states->key = pos.key();
   }
 
   // trace_eval() prints the evaluation for the current position, consistent with the UCI
   // options set so far.
 
-  void trace_eval(Position& pos) {
+  void trace_eval(Engine& engine, Position& pos) {
 
-    StateListPtr states(new std::deque<StateInfo>(1));
+    StateListPtr states(new StateList(1));
     Position p;
-    p.set(pos.fen(), Options["UCI_Chess960"], &states->back(), Threads.main());
+    p.set(pos.fen(), engine.options["UCI_Chess960"], &states->back(), engine.threads.main());
 
-    Eval::NNUE::verify();
+    Eval::NNUE::verify(engine.options);
 
     sync_cout << "\n" << Eval::trace(p) << sync_endl;
   }
@@ -96,7 +137,7 @@ namespace {
   // setoption() is called when engine receives the "setoption" UCI command. The
   // function updates the UCI option ("name") to the given value ("value").
 
-  void setoption(istringstream& is) {
+  void setoption(Engine& engine, istringstream& is) {
 
     string token, name, value;
 
@@ -110,8 +151,8 @@ namespace {
     while (is >> token)
         value += (value.empty() ? "" : " ") + token;
 
-    if (Options.count(name))
-        Options[name] = value;
+    if (engine.options.count(name))
+        engine.options[name] = value;
     else
         sync_cout << "No such option: " << name << sync_endl;
   }
@@ -121,7 +162,7 @@ namespace {
   // the thinking time and other parameters from the input string, then starts
   // the search.
 
-  void go(Position& pos, istringstream& is, StateListPtr& states) {
+  void go(Engine& engine, Position& pos, istringstream& is, StateListPtr& states) {
 
     Search::LimitsType limits;
     string token;
@@ -147,20 +188,174 @@ namespace {
         else if (token == "infinite")  limits.infinite = 1;
         else if (token == "ponder")    ponderMode = true;
 
-    Threads.start_thinking(pos, states, limits, ponderMode);
+    engine.threads.start_thinking(pos, states, limits, ponderMode);
+  }
+
+
+  // sweep() is called by "bench sweep": it runs the bench once for each pair
+  // of the listed hash sizes and thread counts, e.g.
+  //
+  //   bench sweep hash=16,256 threads=1,4,16 limit=13 type=depth fens=our.fen
+  //
+  // and writes one record per position and one per configuration (position
+  // "all") as JSON lines or, with format=csv, as CSV, to stdout at the end or
+  // to the file out=<name>. 'fens', 'limit', 'type' and 'eval' are as for the
+  // plain bench. The memory is the engine's own: TT and per-thread state. The
+  // speedups of time and nodes per second are relative to the first thread
+  // count of the same hash size, with a depth limit the former is the scaling
+  // of the time to depth.
+
+  void sweep(Engine& engine, Position& pos, istream& args, StateListPtr& states) {
+
+    vector<string> hashes = { "16" }, threads = { "1" };
+    string token, limit = "13", type = "depth", fens = "default", eval = "mixed", format = "json", out;
+
+    auto split = [](const string& list) {
+        vector<string> v;
+        istringstream ss(list);
+        for (string item; getline(ss, item, ',');)
+            if (!item.empty())
+                v.push_back(item);
+        return v;
+    };
+
+    while (args >> token)
+    {
+        size_t eq = token.find('=');
+        string key = token.substr(0, eq), value = eq == string::npos ? "" : token.substr(eq + 1);
+
+        if (key == "hash")         hashes = split(value);
+        else if (key == "threads") threads = split(value);
+        else if (key == "limit")   limit = value;
+        else if (key == "type")    type = value;
+        else if (key == "fens")    fens = value;
+        else if (key == "eval")    eval = value;
+        else if (key == "format")  format = value;
+        else if (key == "out")     out = value;
+        else
+        {
+            sync_cout << "info string Unknown sweep parameter " << token << sync_endl;
+            return;
+        }
+    }
+
+    bool csv = format == "csv";
+    stringstream records;
+
+    // The time and nodes per second of the total and of each position, from 1,
+    // with the first thread count of the current hash size
+    vector<pair<TimePoint, uint64_t>> base;
+
+    auto record = [&](const string& hash, const string& thr, const string& position, const string& fen,
+                      int depth, uint64_t nodes, TimePoint time, size_t memory) {
+        time = std::max(time, TimePoint(1));
+        uint64_t nps = 1000 * nodes / time;
+        size_t i = position == "all" ? 0 : stoul(position);
+
+        if (thr == threads.front())
+            base.resize(std::max(base.size(), i + 1)), base[i] = { time, nps };
+
+        double ttdSpeedup = i < base.size() ? double(base[i].first) / time : 0;
+        double npsSpeedup = i < base.size() && base[i].second ? double(nps) / base[i].second : 0;
+
+        records << std::fixed << std::setprecision(2);
+        if (csv)
+            records << hash << ',' << thr << ',' << position << ",\"" << fen << "\"," << depth << ','
+                    << nodes << ',' << time << ',' << nps << ',' << memory / 1024 << ','
+                    << ttdSpeedup << ',' << npsSpeedup << '\n';
+        else
+            records << "{\"hash\":" << hash << ",\"threads\":" << thr << ",\"position\":"
+                    << (position == "all" ? "\"all\"" : position) << ",\"fen\":\"" << fen
+                    << "\",\"depth\":" << depth << ",\"nodes\":" << nodes << ",\"time_ms\":" << time
+                    << ",\"nps\":" << nps << ",\"memory_kb\":" << memory / 1024
+                    << ",\"time_speedup\":" << ttdSpeedup << ",\"nps_speedup\":" << npsSpeedup << "}\n";
+    };
+
+    if (csv)
+        records << "hash,threads,position,fen,depth,nodes,time_ms,nps,memory_kb,time_speedup,nps_speedup\n";
+
+    for (const string& hash : hashes)
+        for (const string& thr : threads)
+        {
+            istringstream is(hash + " " + thr + " " + limit + " " + fens + " " + type + " " + eval);
+
+            if (thr == threads.front())
+                base.clear();
+            uint64_t totalNodes = 0, cnt = 0;
+            TimePoint totalTime = 0;
+            int minDepth = MAX_PLY;
+            size_t memory = 0;
+
+            for (const auto& cmd : setup_bench(pos, is))
+            {
+                istringstream cs(cmd);
+                cs >> skipws >> token;
+
+                if (token == "go")
+                {
+                    string fen = pos.fen();
+                    cerr << "\nSweep hash " << hash << " threads " << thr
+                         << " position " << ++cnt << " (" << fen << ")" << endl;
+
+                    TimePoint start = now();
+                    go(engine, pos, cs, states);
+                    engine.threads.main()->wait_for_search_finished();
+                    TimePoint time = now() - start;
+
+                    // The memory of the engine as set up for this configuration
+                    memory = size_t(engine.options["Hash"]) * 1024 * 1024;
+                    for (Thread* th : engine.threads)
+                        memory += th->memory();
+
+                    int depth = engine.threads.main()->completedDepth;
+                    uint64_t nodes = engine.threads.nodes_searched();
+                    record(hash, thr, std::to_string(cnt), fen, depth, nodes, time, memory);
+
+                    totalNodes += nodes, totalTime += time;
+                    minDepth = std::min(minDepth, depth);
+                }
+                else if (token == "setoption")  setoption(engine, cs);
+                else if (token == "position")   position(engine, pos, cs, states);
+                else if (token == "ucinewgame") Search::clear(engine);
+            }
+
+            record(hash, thr, "all", "", cnt ? minDepth : 0, totalNodes, totalTime, memory);
+        }
+
+    if (out.empty())
+        sync_cout << records.str() << sync_endl;
+    else
+    {
+        ofstream file(out);
+        file << records.str();
+        if (!file)
+            sync_cout << "info string Unable to write " << out << sync_endl;
+    }
   }
 
 
   // bench() is called when engine receives the "bench" command. Firstly
   // a list of UCI commands is setup according to bench parameters, then
-  // it is run one by one printing a summary at the end.
+  // it is run one by one printing a summary at the end. "bench sweep" runs
+  // it over several configurations instead, see sweep().
 
-  void bench(Position& pos, istream& args, StateListPtr& states) {
+  void bench(Engine& engine, Position& pos, istream& args, StateListPtr& states) {
 
     string token;
-    uint64_t num, nodes = 0, cnt = 1;
+    uint64_t num, nodes = 0, cnt = 1, misses = 0;
+    bool counted = true;
+
+    auto start = args.tellg();
+    if (args >> token && token == "sweep")
+    {
+        sweep(engine, pos, args, states);
+        return;
+    }
+    args.clear();
+    args.seekg(start);
 
     vector<string> list = setup_bench(pos, args);
+    vector<uint64_t> nodesPerNode(Numa::nodes());
     num = count_if(list.begin(), list.end(), [](string s) { return s.find("go ") == 0 || s.find("eval") == 0; });
 
     TimePoint elapsed = now();
@@ -175,16 +370,22 @@ namespace {
             cerr << "\nPosition: " << cnt++ << '/' << num << " (" << pos.fen() << ")" << endl;
             if (token == "go")
             {
-               go(pos, is, states);
-               Threads.main()->wait_for_search_finished();
-               nodes += Threads.nodes_searched();
+               Perf::CacheMisses cacheMisses; // Opened here for the threads of this search
+               go(engine, pos, is, states);
+               engine.threads.main()->wait_for_search_finished();
+               nodes += engine.threads.nodes_searched();
+               misses += cacheMisses.count();
+               counted = counted && cacheMisses.available();
+
+               for (Thread* th : engine.threads)
+                   nodesPerNode[Numa::node_of(th->id())] += th->nodes;
             }
             else
-               trace_eval(pos);
+               trace_eval(engine, pos);
         }
-        else if (token == "setoption")  setoption(is);
-        else if (token == "position")   position(pos, is, states);
-        else if (token == "ucinewgame") { Search::clear(); elapsed = now(); } // Search::clear() may take some while
+        else if (token == "setoption")  setoption(engine, is);
+        else if (token == "position")   position(engine, pos, is, states);
+        else if (token == "ucinewgame") { Search::clear(engine); elapsed = now(); } // Search::clear() may take some while
     }
 
     elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
@@ -195,28 +396,98 @@ namespace {
          << "\nTotal time (ms) : " << elapsed
          << "\nNodes searched  : " << nodes
          << "\nNodes/second    : " << 1000 * nodes / elapsed << endl;
+
+    // The memory footprint: what each thread owns, the history tables being
+    // the bulk of it, and the resident memory of the whole process.
+    const Thread& th = *engine.threads.back();
+    size_t histories =  sizeof(th.counterMoves) + sizeof(th.mainHistory) + sizeof(th.lowPlyHistory)
+                      + sizeof(th.captureHistory) + sizeof(th.continuationHistory);
+
+    cerr << "Thread memory   : " << th.memory() / 1024 << " KB per thread, histories "
+         << histories / 1024 << " KB"
+         << "\nResident memory : " << Perf::resident() / 1024 << " KB with "
+         << engine.threads.size() << " threads" << endl;
+
+    if (counted && nodes)
+        cerr << "Cache misses    : " << std::fixed << std::setprecision(2)
+             << double(misses) / nodes << " per node" << endl;
+
+    // With bound threads, show how much each NUMA node contributed
+    if (engine.options["NUMA Bind"])
+        for (size_t n = 0; n < nodesPerNode.size(); ++n)
+            cerr << "Nodes/second " << n << "  : " << 1000 * nodesPerNode[n] / elapsed << endl;
   }
 
-  // The win rate model returns the probability (per mille) of winning given an eval
-  // and a game-ply. The model fits rather accurately the LTC fishtest statistics.
-  int win_rate_model(Value v, int ply) {
+  // analyse_game() reports on every move of a game, given as PGN from a file
+  // ("pgn <file>") or inline after the limits: moves in SAN or UCI notation,
+  // optionally after "fen <fen> moves". On as many single threaded engines
+  // as the "Threads" option unless "threads" is given.
+
+  void analyse_game(Engine& engine, istringstream& is) {
+
+    const char* Judgements[] = { "good", "inaccuracy", "mistake", "blunder" };
+    Search::LimitsType limits;
+    size_t threads = size_t(engine.options["Threads"]);
+    string token, text, movetext, fen;
+    vector<Move> moves;
+    bool chess960 = engine.options["UCI_Chess960"];
+
+    engine.threads.main()->wait_for_search_finished();
 
-     // The model captures only up to 240 plies, so limit input (and rescale)
-     double m = std::min(240, ply) / 64.0;
+    while (is >> token)
+        if      (token == "depth")    is >> limits.depth;
+        else if (token == "movetime") is >> limits.movetime;
+        else if (token == "nodes")    is >> limits.nodes;
+        else if (token == "threads")  is >> threads;
+        else if (token == "pgn")
+        {
+            ifstream f(is >> skipws >> token ? token : "");
+            text.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+            if (!f.is_open())
+            {
+                sync_cout << "info string Failed to open " << token << sync_endl;
+                return;
+            }
+            break;
+        }
+        else
+        {
+            getline(is, text);
+            text = token + text;
+            break;
+        }
 
-     // Coefficients of a 3rd order polynomial fit based on fishtest data
-     // for two parameters needed to transform eval to the argument of a
-     // logistic function.
-     double as[] = {-3.68389304,  30.07065921, -60.52878723, 149.53378557};
-     double bs[] = {-2.0181857,   15.85685038, -29.83452023,  47.59078827};
-     double a = (((as[0] * m + as[1]) * m + as[2]) * m) + as[3];
-     double b = (((bs[0] * m + bs[1]) * m + bs[2]) * m) + bs[3];
+    fen = Analysis::split_game(text, movetext);
 
-     // Transform eval to centipawns with limited range
-     double x = std::clamp(double(100 * v) / PawnValueEg, -2000.0, 2000.0);
+    if (!Analysis::read_moves(fen, movetext, chess960, engine.threads.main(), moves))
+    {
+        sync_cout << "info string Illegal move after " << moves.size() << " plies" << sync_endl;
+        return;
+    }
 
-     // Return win rate in per mille (rounded to nearest)
-     return int(0.5 + 1000 / (1 + std::exp((a - x) / b)));
+    Eval::NNUE::verify(engine.options);
+
+    Analysis::Summary s = Analysis::analyse(engine, fen, moves, limits, threads, [&](const Analysis::Ply& p) {
+
+        sync_cout << "info analysis ply " << p.ply
+                  << " move "      << UCI::move(p.move, chess960)
+                  << " best "      << UCI::move(p.best, chess960)
+                  << " score "     << UCI::value(p.score)
+                  << " played "    << UCI::value(p.played)
+                  << " cploss "    << p.cpLoss
+                  << " loss "      << p.loss
+                  << " judgement " << Judgements[p.judgement]
+                  << " depth "     << p.depth
+                  << " nodes "     << p.nodes << sync_endl;
+    });
+
+    sync_cout << "info analysis done plies " << s.plies << " nodes " << s.nodes << " time " << s.time;
+    for (Color c : { WHITE, BLACK })
+        cout << (c == WHITE ? " white" : " black") << " cploss " << s.cpLoss[c]
+             << " inaccuracies " << s.count[c][Analysis::INACCURACY]
+             << " mistakes "     << s.count[c][Analysis::MISTAKE]
+             << " blunders "     << s.count[c][Analysis::BLUNDER];
+    cout << sync_endl;
   }
 
 } // namespace
@@ -227,14 +498,15 @@ namespace {
 /// GUI dies unexpectedly. When called with some command line arguments, e.g. to
 /// run 'bench', once the command is executed the function returns immediately.
 /// In addition to the UCI ones, also some additional debug commands are supported.
+/// The loop drives a single engine; other engines in the process are unaffected.
 
-void UCI::loop(int argc, char* argv[]) {
+void UCI::loop(Engine& engine, int argc, char* argv[]) {
 
   Position pos;
   string token, cmd;
-  StateListPtr states(new std::deque<StateInfo>(1));
+  StateListPtr states(new StateList(1));
 
-  pos.set(StartFEN, false, &states->back(), Threads.main());
+  pos.set(StartFEN, false, &states->back(), engine.threads.main());
 
   for (int i = 1; i < argc; ++i)
       cmd += std::string(argv[i]) + " ";
@@ -250,33 +522,47 @@ void UCI::loop(int argc, char* argv[]) {
 
       if (    token == "quit"
           ||  token == "stop")
-          Threads.stop = true;
+          engine.threads.stop = true;
 
       // The GUI sends 'ponderhit' to tell us the user has played the expected move.
       // So 'ponderhit' will be sent if we were told to ponder on the same move the
       // user has played. We should continue searching but switch from pondering to
       // normal search.
       else if (token == "ponderhit")
-          Threads.main()->ponder = false; // Switch to normal search
+          engine.threads.main()->ponderhit(); // Switch to normal search
 
       else if (token == "uci")
           sync_cout << "id name " << engine_info(true)
-                    << "\n"       << Options
+                    << "\n"       << engine.options
                     << "\nuciok"  << sync_endl;
 
-      else if (token == "setoption")  setoption(is);
-      else if (token == "go")         go(pos, is, states);
-      else if (token == "position")   position(pos, is, states);
-      else if (token == "ucinewgame") Search::clear();
+      else if (token == "setoption")  setoption(engine, is);
+      else if (token == "go")         go(engine, pos, is, states);
+      else if (token == "position")   position(engine, pos, is, states);
+      else if (token == "ucinewgame")
+      {
+          Search::clear(engine);
+          Tablebases::init(engine.options["SyzygyPath"]); // Free mapped files
+      }
       else if (token == "isready")    sync_cout << "readyok" << sync_endl;
 
       // Additional custom non-UCI commands, mainly for debugging.
       // Do not use these commands during a search!
       else if (token == "flip")     pos.flip();
-      else if (token == "bench")    bench(pos, is, states);
+      else if (token == "bench")    bench(engine, pos, is, states);
       else if (token == "d")        sync_cout << pos << sync_endl;
-      else if (token == "eval")     trace_eval(pos);
+      else if (token == "eval")     trace_eval(engine, pos);
       else if (token == "compiler") sync_cout << compiler_info() << sync_endl;
+      else if (token == "startup")  sync_cout << Startup::report() << sync_endl;
+      else if (token == "stats")
+      {
+          std::string arg;
+          is >> skipws >> arg;
+          if (arg == "reset")
+              engine.threads.reset_stats();
+          else
+              sync_cout << engine.threads.stats(arg == "json") << sync_endl;
+      }
       else if (token == "export_net")
       {
           std::optional<std::string> filename;
@@ -285,6 +571,34 @@ void UCI::loop(int argc, char* argv[]) {
               filename = f;
           Eval::NNUE::save_eval(filename);
       }
+      else if (token == "export_net_image")
+      {
+          std::string f;
+          if (is >> skipws >> f)
+              Eval::NNUE::save_image(f);
+      }
+      else if (token == "analyse_game") analyse_game(engine, is);
+      else if (token == "makebook")
+      {
+          std::string games, book;
+          int plies;
+          if (!(is >> skipws >> games >> book))
+              sync_cout << "Usage: makebook <games file> <book file> [plies]" << sync_endl;
+          else if (!Book::make(games, book, (is >> plies) ? plies : 20, engine.threads.main()))
+              sync_cout << "Failed to make a book from " << games << sync_endl;
+      }
+      else if (token == "save_tt" || token == "load_tt")
+      {
+          std::string f;
+          if (!(is >> skipws >> f))
+              sync_cout << "Missing file name" << sync_endl;
+          else if (token == "save_tt")
+              sync_cout << (engine.tt.save(f) ? "Hash table saved to " + f
+                                              : "Failed to save the hash table to " + f) << sync_endl;
+          else
+              sync_cout << (engine.tt.load(f) ? "Hash table loaded from " + f
+                                              : "Failed to load a hash table from " + f) << sync_endl;
+      }
       else if (!token.empty() && token[0] != '#')
           sync_cout << "Unknown command: " << cmd << sync_endl;
 
@@ -314,6 +628,30 @@ string UCI::value(Value v) {
 }
 
 
+/// UCI::win_rate() returns the probability (per mille) of winning given an eval
+/// and a game ply. The model fits rather accurately the LTC fishtest statistics.
+
+int UCI::win_rate(Value v, int ply) {
+
+  // The model captures only up to 240 plies, so limit input (and rescale)
+  double m = std::min(240, ply) / 64.0;
+
+  // Coefficients of a 3rd order polynomial fit based on fishtest data
+  // for two parameters needed to transform eval to the argument of a
+  // logistic function.
+  double as[] = {-3.68389304,  30.07065921, -60.52878723, 149.53378557};
+  double bs[] = {-2.0181857,   15.85685038, -29.83452023,  47.59078827};
+  double a = (((as[0] * m + as[1]) * m + as[2]) * m) + as[3];
+  double b = (((bs[0] * m + bs[1]) * m + bs[2]) * m) + bs[3];
+
+  // Transform eval to centipawns with limited range
+  double x = std::clamp(double(100 * v) / PawnValueEg, -2000.0, 2000.0);
+
+  // Return win rate in per mille (rounded to nearest)
+  return int(0.5 + 1000 / (1 + std::exp((a - x) / b)));
+}
+
+
 /// UCI::wdl() report WDL statistics given an evaluation and a game ply, based on
 /// data gathered for fishtest LTC games.
 
@@ -321,8 +659,8 @@ string UCI::wdl(Value v, int ply) {
 
   stringstream ss;
 
-  int wdl_w = win_rate_model( v, ply);
-  int wdl_l = win_rate_model(-v, ply);
+  int wdl_w = win_rate( v, ply);
+  int wdl_l = win_rate(-v, ply);
   int wdl_d = 1000 - wdl_w - wdl_l;
   ss << " wdl " << wdl_w << " " << wdl_d << " " << wdl_l;
 
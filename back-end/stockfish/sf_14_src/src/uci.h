@@ -19,14 +19,17 @@
 #ifndef UCI_H_INCLUDED
 #define UCI_H_INCLUDED
 
+#include <functional>
 #include <map>
 #include <string>
 
+#include "misc.h"
 #include "types.h"
 
 namespace Stockfish {
 
 class Position;
+struct Engine;
 
 namespace UCI {
 
@@ -43,7 +46,7 @@ typedef std::map<std::string, Option, CaseInsensitiveLess> OptionsMap;
 /// Option class implements an option as defined by UCI protocol
 class Option {
 
-  typedef void (*OnChange)(const Option&);
+  typedef std::function<void(const Option&)> OnChange;
 
 public:
   Option(OnChange = nullptr);
@@ -67,19 +70,19 @@ private:
   OnChange on_change;
 };
 
-void init(OptionsMap&);
-void loop(int argc, char* argv[]);
+void init(OptionsMap&, Engine&);
+Numa::Policy numa_policy(OptionsMap&);
+void loop(Engine& engine, int argc, char* argv[]);
 std::string value(Value v);
 std::string square(Square s);
 std::string move(Move m, bool chess960);
 std::string pv(const Position& pos, Depth depth, Value alpha, Value beta);
 std::string wdl(Value v, int ply);
+int win_rate(Value v, int ply);
 Move to_move(const Position& pos, std::string& str);
 
 } // namespace UCI
 
-extern UCI::OptionsMap Options;
-
 } // namespace Stockfish
 
 #endif // #ifndef UCI_H_INCLUDED
@@ -17,12 +17,17 @@
 */
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <ostream>
 #include <sstream>
+#include <vector>
 
+#include "book.h"
+#include "engine.h"
 #include "evaluate.h"
 #include "misc.h"
+#include "resultcache.h"
 #include "search.h"
 #include "thread.h"
 #include "tt.h"
@@ -33,18 +38,47 @@ using std::string;
 
 namespace Stockfish {
 
-UCI::OptionsMap Options; // Global object
-
 namespace UCI {
 
-/// 'On change' actions, triggered by an option's value change
-void on_clear_hash(const Option&) { Search::clear(); }
-void on_hash_size(const Option& o) { TT.resize(size_t(o)); }
-void on_logger(const Option& o) { start_logger(o); }
-void on_threads(const Option& o) { Threads.set(size_t(o)); }
-void on_tb_path(const Option& o) { Tablebases::init(o); }
-void on_use_NNUE(const Option& ) { Eval::NNUE::init(); }
-void on_eval_file(const Option& ) { Eval::NNUE::init(); }
+/// 'On change' actions, triggered by an option's value change. The logger, the
+/// tablebases and the network are process-wide, so setting those options on
+/// any engine affects every engine in the process.
+void on_clear_hash(Engine& e, const Option&) { Search::clear(e); }
+void on_hash_size(Engine& e, const Option&) {
+  e.threads.main()->wait_for_search_finished(); // resize() expects an idle engine
+  e.tt.resize(size_t(e.options["Hash"]), e.threads.size(), numa_policy(e.options));
+}
+void on_shared_hash(Engine& e, const Option& o) {
+  e.threads.main()->wait_for_search_finished();
+
+  const string name = o;
+  if (name.empty() || name == "<empty>")
+  {
+      if (e.tt.is_shared())
+      {
+          e.tt.detach();
+          on_hash_size(e, o);
+      }
+      return;
+  }
+
+  auto st = SharedTT::open(name, size_t(e.options["Hash"]));
+  if (!st || !e.tt.attach(st))
+      sync_cout << "info string Could not attach to shared hash " << name << sync_endl;
+}
+void on_perft_hash(Engine& e, const Option& o) {
+  e.threads.main()->wait_for_search_finished();
+  e.perftTable.resize(size_t(o));
+}
+void on_logger(Engine&, const Option& o) { start_logger(o); }
+void on_threads(Engine& e, const Option&) { e.threads.set(size_t(e.options["Threads"])); }
+void on_tables(Engine& e, const Option&) { e.threads.resize_tables(); }
+void on_tb_path(Engine&, const Option& o) { Tablebases::init(o); }
+void on_book_file(Engine&, const Option& o) { Book::init(o); }
+void on_result_cache(Engine&, const Option& o) { ResultCache::resize(size_t(o)); }
+void on_use_NNUE(Engine& e, const Option& ) { Eval::NNUE::init(e.options); }
+void on_eval_file(Engine& e, const Option& ) { Eval::NNUE::init(e.options); }
+void on_int8_net(Engine& e, const Option& o) { if ((e.int8Net = bool(o))) Eval::NNUE::quantize(); }
 
 /// Our case insensitive less() function as required by UCI protocol
 bool CaseInsensitiveLess::operator() (const string& s1, const string& s2) const {
@@ -54,58 +88,95 @@ bool CaseInsensitiveLess::operator() (const string& s1, const string& s2) const
 }
 
 
-/// UCI::init() initializes the UCI options to their hard-coded default values
+/// UCI::numa_policy() maps the "NUMA Hash" option to the allocation policy
 
-void init(OptionsMap& o) {
+Numa::Policy numa_policy(OptionsMap& o) {
+
+  return o["NUMA Hash"] == "interleave" ? Numa::INTERLEAVE
+       : o["NUMA Hash"] == "local"      ? Numa::LOCAL
+                                        : Numa::FIRST_TOUCH;
+}
+
+
+/// UCI::init() initializes the UCI options of an engine to their hard-coded
+/// default values. The 'on change' actions are bound to that engine.
+
+void init(OptionsMap& o, Engine& engine) {
 
   constexpr int MaxHashMB = Is64Bit ? 33554432 : 2048;
 
-  o["Debug Log File"]        << Option("", on_logger);
-  o["Threads"]               << Option(1, 1, 512, on_threads);
-  o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
-  o["Clear Hash"]            << Option(on_clear_hash);
+  auto on = [&engine](void (*f)(Engine&, const Option&)) {
+      return [&engine, f](const Option& opt) { f(engine, opt); };
+  };
+
+  o["Debug Log File"]        << Option("", on(on_logger));
+  o["Threads"]               << Option(1, 1, 512, on(on_threads));
+  o["Hash"]                  << Option(16, 1, MaxHashMB, on(on_hash_size));
+  o["Clear Hash"]            << Option(on(on_clear_hash));
+  o["Shared Hash"]           << Option("<empty>", on(on_shared_hash));
+  o["Pawn Table"]            << Option(131072, 1, 1 << 24, on(on_tables));
+  o["Material Table"]        << Option(8192, 1, 1 << 24, on(on_tables));
+  o["Perft Hash"]            << Option(0, 0, MaxHashMB, on(on_perft_hash));
+  o["NUMA Bind"]             << Option(false, on(on_threads));
+  o["CPU Bind"]              << Option(false, on(on_threads));
+  o["SMP Skip Blocks"]       << Option(false);
+  o["NUMA Hash"]             << Option("default var default var interleave var local", "default", on(on_hash_size));
   o["Ponder"]                << Option(false);
   o["MultiPV"]               << Option(1, 1, 500);
+  o["MultiPV Split"]         << Option(false);
   o["Skill Level"]           << Option(20, 0, 20);
+  o["Fast Skill"]            << Option(false);
   o["Move Overhead"]         << Option(10, 0, 5000);
   o["Slow Mover"]            << Option(100, 10, 1000);
+  o["CPU Budget"]            << Option(0, 0, 4096);
   o["nodestime"]             << Option(0, 0, 10000);
   o["UCI_Chess960"]          << Option(false);
   o["UCI_AnalyseMode"]       << Option(false);
   o["UCI_LimitStrength"]     << Option(false);
   o["UCI_Elo"]               << Option(1350, 1350, 2850);
   o["UCI_ShowWDL"]           << Option(false);
-  o["SyzygyPath"]            << Option("<empty>", on_tb_path);
+  o["SyzygyPath"]            << Option("<empty>", on(on_tb_path));
   o["SyzygyProbeDepth"]      << Option(1, 1, 100);
   o["Syzygy50MoveRule"]      << Option(true);
   o["SyzygyProbeLimit"]      << Option(7, 0, 7);
-  o["Use NNUE"]              << Option(true, on_use_NNUE);
-  o["EvalFile"]              << Option(EvalFileDefaultName, on_eval_file);
+  o["SyzygyPrefetch"]        << Option(false);
+  o["Book File"]             << Option("<empty>", on(on_book_file));
+  o["Book Depth"]            << Option(20, 0, 200);
+  o["Book Variety"]          << Option(0, 0, 100);
+  o["Result Cache"]          << Option(0, 0, 1 << 24, on(on_result_cache));
+  o["Use NNUE"]              << Option(true, on(on_use_NNUE));
+  o["EvalFile"]              << Option(EvalFileDefaultName, on(on_eval_file));
+  o["NNUE Int8"]             << Option(false, on(on_int8_net));
 }
 
 
 /// operator<<() is used to print all the options default values in chronological
 /// insertion order (the idx field) and in the format defined by the UCI protocol.
+/// The insertion counter is shared by all engines, so idx is only increasing
+/// within one map, not dense.
 
 std::ostream& operator<<(std::ostream& os, const OptionsMap& om) {
 
-  for (size_t idx = 0; idx < om.size(); ++idx)
-      for (const auto& it : om)
-          if (it.second.idx == idx)
-          {
-              const Option& o = it.second;
-              os << "\noption name " << it.first << " type " << o.type;
+  std::vector<const OptionsMap::value_type*> ordered;
+  for (const auto& it : om)
+      ordered.push_back(&it);
+
+  std::sort(ordered.begin(), ordered.end(),
+            [](const auto* a, const auto* b) { return a->second.idx < b->second.idx; });
 
-              if (o.type == "string" || o.type == "check" || o.type == "combo")
-                  os << " default " << o.defaultValue;
+  for (const auto* it : ordered)
+  {
+      const Option& o = it->second;
+      os << "\noption name " << it->first << " type " << o.type;
 
-              if (o.type == "spin")
-                  os << " default " << int(stof(o.defaultValue))
-                     << " min "     << o.min
-                     << " max "     << o.max;
+      if (o.type == "string" || o.type == "check" || o.type == "combo")
+          os << " default " << o.defaultValue;
 
-              break;
-          }
+      if (o.type == "spin")
+          os << " default " << int(stof(o.defaultValue))
+             << " min "     << o.min
+             << " max "     << o.max;
+  }
 
   return os;
 }
@@ -149,7 +220,7 @@ bool Option::operator==(const char* s) const {
 
 void Option::operator<<(const Option& o) {
 
-  static size_t insert_order = 0;
+  static std::atomic<size_t> insert_order = 0; // Engines may be created concurrently
 
   *this = o;
   idx = insert_order++;
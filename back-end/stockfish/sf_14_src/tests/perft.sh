@@ -10,11 +10,14 @@ trap 'error ${LINENO}' ERR
 
 echo "perft testing started"
 
+# single threaded without a hash, then on every core with a perft hash
+for options in "" "setoption name Threads value $(nproc)\\nsetoption name Perft Hash value 64\\n"; do
+
 cat << EOF > perft.exp
    set timeout 10
    lassign \$argv pos depth result
    spawn ./stockfish
-   send "position \$pos\\ngo perft \$depth\\n"
+   send "${options}position \$pos\\ngo perft \$depth\\n"
    expect "Nodes searched? \$result" {} timeout {exit 1}
    send "quit\\n"
    expect eof
@@ -27,6 +30,8 @@ expect perft.exp "fen r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq
 expect perft.exp "fen rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8" 5 89941194 > /dev/null
 expect perft.exp "fen r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10" 5 164075551 > /dev/null
 
+done
+
 rm perft.exp
 
 echo "perft testing OK"
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# Training run for `make profile-lib`: drives libstockfish.so the way the
+# chess back-end does (native_engine.py) - short games from opening and
+# middlegame positions with low-depth searches at a spread of skill levels,
+# pondering on the expected reply, and every move checked with the move
+# validator first. Usage, from src/:
+#
+#   python3 ../tests/pgo_workload.py ./libstockfish.so [fens.txt]
+#
+# fens.txt holds one FEN per line (production positions, '#' comments);
+# without it the positions below are used.
+
+import sys
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parents[3]))
+
+from native_engine import MoveValidator, NativeGame, NativeStockfish
+
+POSITIONS = [
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2",
+    "rnbqkb1r/pppppppp/5n2/8/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 1 2",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "rnbqkb1r/pp2pppp/3p1n2/8/3NP3/8/PPP2PPP/RNBQKB1R w KQkq - 1 5",
+    "rnbqk2r/ppp1bppp/4pn2/3p4/2PP4/2N2N2/PP2PPPP/R1BQKB1R w KQkq - 4 5",
+    "r1bq1rk1/ppp2ppp/2np1n2/2b1p3/2B1P3/2NP1N2/PPP2PPP/R1BQ1RK1 w - - 0 7",
+    "r2q1rk1/pp2bppp/2n1pn2/3p4/3P1B2/2NBPN2/PP3PPP/R2QK2R w KQ - 4 9",
+    "r1bq1rk1/pp3ppp/2n1pn2/2bp4/2P5/2N1PN2/PPQ2PPP/R1B1KB1R w KQ - 0 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "2rq1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1P2PN2/PB1NBPPP/2RQ1RK1 w - - 2 11",
+    "r1b2rk1/2q1bppp/p2ppn2/1p6/3BPP2/2N2Q2/PPP3PP/2KR1B1R w - - 0 13",
+]
+
+SKILL_LEVELS = [0, 3, 6, 10, 20]
+DEPTHS = [2, 4, 6, 8, 10, 12]
+PLIES = 16
+
+
+def read_positions(path):
+    with open(path) as f:
+        return [line.strip() for line in f if line.strip() and not line.startswith('#')]
+
+
+def play(engine, validator, library_path, fen, depth):
+    """A short self-play game from fen, pondering as the AI player does"""
+    game = NativeGame(fen, library_path=library_path)
+    result = engine.search_game(game, depth=depth)
+    for ply in range(PLIES):
+        move = result['bestmove']
+        validator.validate(game.fen(), 'a1a1')
+        check = validator.validate(fen, move, game.moves)
+        if move == '0000' or not check['legal'] or check['status'] != 'ongoing':
+            break
+        game.push(move)
+
+        # Ponder on the predicted reply; every other time it is "played"
+        reply = result['ponder']
+        if reply and game.push(reply)['legal']:
+            if engine.ponder_game(game, depth=depth) and ply % 2 == 0:
+                result = engine.ponderhit()
+                continue
+            engine.stop_ponder()
+            game.pop()
+        result = engine.search_game(game, depth=depth)
+    game.close()
+
+
+def main():
+    library_path = str(Path(sys.argv[1] if len(sys.argv) > 1 else './libstockfish.so').resolve())
+    positions = read_positions(sys.argv[2]) if len(sys.argv) > 2 else POSITIONS
+
+    validator = MoveValidator(library_path)
+    engines = []
+    for skill in SKILL_LEVELS:
+        engines.append(NativeStockfish(library_path, threads=1, hash_mb=16, options={'Skill Level': skill}))
+
+    for i, fen in enumerate(positions):
+        engine = engines[i % len(engines)]
+        play(engine, validator, library_path, fen, DEPTHS[i % len(DEPTHS)])
+        engine.search(fen, depth=DEPTHS[(i + 2) % len(DEPTHS)])
+
+    for engine in engines:
+        engine.close()
+
+
+if __name__ == '__main__':
+    main()
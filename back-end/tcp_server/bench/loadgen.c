@@ -0,0 +1,947 @@
+/*
+ * Load generator for the chess TCP protocol.
+ *
+ * Opens many connections, registers and logs every one of them in,
+ * matchmakes, and plays a scripted game on each board at a fixed move
+ * rate. At the end it reports move round-trip latency percentiles (move
+ * sent -> own GAME_STATE_UPDATE), opponent relay latency (move sent ->
+ * opponent's OPPONENT_MOVE) and message throughput.
+ *
+ * Framing and the binary codec come from desktop-app/tcp_client
+ * (protocol.h, client_core.c). Build with `make loadgen`, then e.g.:
+ *
+ *   ./loadgen -h 127.0.0.1 -p 8765 -c 1000 -r 2 -d 30 -b
+ */
+#define _GNU_SOURCE
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+
+/* ========== Configuration ========== */
+
+#define EPOLL_BATCH 256                  /* Max events fetched per epoll_wait() */
+#define RECV_INITIAL 4096                /* Receive buffers grow up to BUFFER_SIZE */
+#define USERNAME_MAX 48
+
+typedef struct {
+    const char* host;
+    int port;
+    int connections;                     /* Simulated players */
+    double move_rate;                    /* Moves per second on every board */
+    double connect_rate;                 /* New connections per second */
+    int duration_s;
+    int binary;                          /* Send binary MAKE_MOVE frames */
+    const char* prefix;                  /* Username prefix */
+} LoadConfig;
+
+static LoadConfig config = {
+    .host = "127.0.0.1",
+    .port = 8765,
+    .connections = 100,
+    .move_rate = 2.0,
+    .connect_rate = 500.0,
+    .duration_s = 30,
+    .binary = 0,
+    .prefix = "loadgen"
+};
+
+/* Ruy Lopez, Breyer variation: every ply is legal, so the server's
+ * validation path runs for real */
+static const char* const script[] = {
+    "e2e4", "e7e5", "g1f3", "b8c6", "f1b5", "a7a6", "b5a4", "g8f6",
+    "e1g1", "f8e7", "f1e1", "b7b5", "a4b3", "d7d6", "c2c3", "e8g8",
+    "h2h3", "c6b8", "d2d4", "b8d7"
+};
+#define SCRIPT_PLIES ((int)(sizeof(script) / sizeof(script[0])))
+
+/* ========== Player State ========== */
+
+typedef enum {
+    PLAYER_IDLE = 0,                     /* Not connected yet */
+    PLAYER_CONNECTING,
+    PLAYER_LOGGING_IN,
+    PLAYER_QUEUED,                       /* FIND_MATCH sent */
+    PLAYER_PLAYING,
+    PLAYER_CLOSED
+} PlayerState;
+
+typedef enum {
+    TIMER_NONE = 0,
+    TIMER_CONNECT,
+    TIMER_MOVE,
+    TIMER_FIND_MATCH
+} TimerAction;
+
+typedef struct {
+    int fd;
+    PlayerState state;
+    uint8_t* recv_buffer;
+    size_t recv_capacity;
+    size_t recv_length;
+    uint8_t* send_buffer;                /* Bytes the socket has not taken yet */
+    size_t send_capacity;
+    size_t send_length;
+    int want_write;
+    char game_id[BINARY_GAME_ID_MAX];
+    int color;                           /* 0 = white, 1 = black */
+    int opponent;                        /* Player index (-1 if unknown) */
+    int ply;                             /* Plies played in the current game */
+    int awaiting_state;                  /* Own move sent, GAME_STATE_UPDATE pending */
+    int awaiting_relay;                  /* Own move sent, opponent relay pending */
+    uint64_t move_sent_us;
+    TimerAction timer_action;
+    uint32_t timer_generation;           /* Invalidates superseded heap entries */
+} Player;
+
+typedef struct {
+    uint64_t at_us;
+    int player;
+    uint32_t generation;
+} Timer;
+
+typedef struct {
+    uint64_t* values;
+    size_t count;
+    size_t capacity;
+} Samples;
+
+typedef struct {
+    int connected;
+    int logged_in;
+    int connect_failures;
+    int disconnects;
+    unsigned long long games_started;
+    unsigned long long games_finished;
+    unsigned long long moves;
+    unsigned long long invalid_moves;
+    unsigned long long frames_sent;
+    unsigned long long frames_received;
+    unsigned long long bytes_sent;
+    unsigned long long bytes_received;
+} LoadStats;
+
+static Player* players = NULL;
+static Timer* timers = NULL;             /* Binary min-heap on at_us */
+static size_t timer_count = 0;
+static size_t timer_capacity = 0;
+static Samples move_rtt = { NULL, 0, 0 };
+static Samples relay_latency = { NULL, 0, 0 };
+static LoadStats stats;
+static int epoll_fd = -1;
+static struct sockaddr_in server_addr;
+static uint64_t move_interval_us = 0;
+static char json_scratch[BUFFER_SIZE + 1];
+
+/* ========== Helper Functions ========== */
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void samples_add(Samples* samples, uint64_t value) {
+    if (samples->count == samples->capacity) {
+        size_t capacity = samples->capacity ? samples->capacity * 2 : 4096;
+        uint64_t* grown = realloc(samples->values, capacity * sizeof(uint64_t));
+        if (!grown) {
+            return;
+        }
+        samples->values = grown;
+        samples->capacity = capacity;
+    }
+    samples->values[samples->count++] = value;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static uint64_t percentile(const Samples* samples, double p) {
+    size_t rank = (size_t)(p * (double)samples->count);
+    if (rank >= samples->count) {
+        rank = samples->count - 1;
+    }
+    return samples->values[rank];
+}
+
+static void report_samples(const char* name, Samples* samples) {
+    if (samples->count == 0) {
+        printf("%-16s no samples\n", name);
+        return;
+    }
+    qsort(samples->values, samples->count, sizeof(uint64_t), compare_u64);
+    printf("%-16s n=%zu  p50 %.3f ms  p99 %.3f ms  p999 %.3f ms  max %.3f ms\n",
+           name, samples->count,
+           percentile(samples, 0.50) / 1000.0,
+           percentile(samples, 0.99) / 1000.0,
+           percentile(samples, 0.999) / 1000.0,
+           samples->values[samples->count - 1] / 1000.0);
+}
+
+static void timer_swap(size_t a, size_t b) {
+    Timer tmp = timers[a];
+    timers[a] = timers[b];
+    timers[b] = tmp;
+}
+
+static void timer_push(Timer timer) {
+    if (timer_count == timer_capacity) {
+        size_t capacity = timer_capacity ? timer_capacity * 2 : 1024;
+        Timer* grown = realloc(timers, capacity * sizeof(Timer));
+        if (!grown) {
+            fprintf(stderr, "Out of memory growing timer heap\n");
+            exit(1);
+        }
+        timers = grown;
+        timer_capacity = capacity;
+    }
+    size_t i = timer_count++;
+    timers[i] = timer;
+    while (i > 0 && timers[(i - 1) / 2].at_us > timers[i].at_us) {
+        timer_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static Timer timer_pop(void) {
+    Timer top = timers[0];
+    timers[0] = timers[--timer_count];
+    size_t i = 0;
+    for (;;) {
+        size_t left = 2 * i + 1, right = left + 1, smallest = i;
+        if (left < timer_count && timers[left].at_us < timers[smallest].at_us) {
+            smallest = left;
+        }
+        if (right < timer_count && timers[right].at_us < timers[smallest].at_us) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        timer_swap(i, smallest);
+        i = smallest;
+    }
+    return top;
+}
+
+/* Replace a player's pending timer */
+static void schedule(int index, TimerAction action, uint64_t at_us) {
+    Player* player = &players[index];
+    player->timer_action = action;
+    player->timer_generation++;
+    Timer timer = { at_us, index, player->timer_generation };
+    timer_push(timer);
+}
+
+/* Copy a payload into a NUL-terminated scratch buffer for the JSON helpers */
+static const char* json_text(const uint8_t* payload, uint32_t length) {
+    if (length > BUFFER_SIZE) {
+        length = BUFFER_SIZE;
+    }
+    memcpy(json_scratch, payload, length);
+    json_scratch[length] = '\0';
+    return json_scratch;
+}
+
+/* Locate the value of a top-level "key" (flat objects only) */
+static const char* json_value(const char* json, const char* key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char* found = strstr(json, pattern);
+    if (!found) {
+        return NULL;
+    }
+    found += strlen(pattern);
+    while (*found == ' ' || *found == ':') {
+        found++;
+    }
+    return found;
+}
+
+static int json_string(const char* json, const char* key, char* out, size_t out_size) {
+    const char* value = json_value(json, key);
+    if (!value || *value != '"') {
+        return -1;
+    }
+    value++;
+    size_t length = 0;
+    while (value[length] && value[length] != '"' && length + 1 < out_size) {
+        out[length] = value[length];
+        length++;
+    }
+    out[length] = '\0';
+    return 0;
+}
+
+static int json_true(const char* json, const char* key) {
+    const char* value = json_value(json, key);
+    return value && strncmp(value, "true", 4) == 0;
+}
+
+/* ========== Connection Handling ========== */
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        perror("fcntl");
+        return -1;
+    }
+    return 0;
+}
+
+static void update_interest(int index) {
+    Player* player = &players[index];
+    int want_write = player->state == PLAYER_CONNECTING || player->send_length > 0;
+    if (want_write == player->want_write) {
+        return;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | (want_write ? EPOLLOUT : 0);
+    ev.data.u32 = (uint32_t)index;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, player->fd, &ev) == 0) {
+        player->want_write = want_write;
+    }
+}
+
+static void close_player(int index, const char* reason) {
+    Player* player = &players[index];
+    if (player->fd == -1) {
+        return;
+    }
+    if (player->state == PLAYER_CONNECTING) {
+        stats.connect_failures++;
+    } else {
+        stats.disconnects++;
+    }
+    if (reason) {
+        fprintf(stderr, "player %d: %s\n", index, reason);
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, player->fd, NULL);
+    close(player->fd);
+    player->fd = -1;
+    player->state = PLAYER_CLOSED;
+    player->timer_action = TIMER_NONE;
+    player->timer_generation++;
+}
+
+/* Write whatever the socket takes; returns -1 on a dead connection */
+static int flush_player(int index) {
+    Player* player = &players[index];
+    size_t written = 0;
+    while (written < player->send_length) {
+        ssize_t sent = send(player->fd, player->send_buffer + written,
+                            player->send_length - written, MSG_NOSIGNAL);
+        if (sent > 0) {
+            written += (size_t)sent;
+            continue;
+        }
+        if (sent == -1 && errno == EINTR) {
+            continue;
+        }
+        if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        return -1;
+    }
+    memmove(player->send_buffer, player->send_buffer + written, player->send_length - written);
+    player->send_length -= written;
+    stats.bytes_sent += written;
+    update_interest(index);
+    return 0;
+}
+
+/* Frame a message into the player's send buffer and push it out */
+static int send_frame(int index, uint16_t message_id, const void* payload, uint32_t length) {
+    Player* player = &players[index];
+    size_t needed = player->send_length + HEADER_SIZE + length;
+    if (needed > player->send_capacity) {
+        size_t capacity = player->send_capacity ? player->send_capacity : 1024;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        uint8_t* grown = realloc(player->send_buffer, capacity);
+        if (!grown) {
+            close_player(index, "out of memory");
+            return -1;
+        }
+        player->send_buffer = grown;
+        player->send_capacity = capacity;
+    }
+
+    MessageHeader header;
+    header.message_id = htons(message_id);
+    header.payload_length = htonl(length);
+    memcpy(player->send_buffer + player->send_length, &header, HEADER_SIZE);
+    if (length > 0) {
+        memcpy(player->send_buffer + player->send_length + HEADER_SIZE, payload, length);
+    }
+    player->send_length = needed;
+    stats.frames_sent++;
+
+    if (flush_player(index) == -1) {
+        close_player(index, "send failed");
+        return -1;
+    }
+    return 0;
+}
+
+static int send_json(int index, uint16_t message_id, const char* format, ...) {
+    char payload[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(payload, sizeof(payload), format, args);
+    va_end(args);
+    if (length < 0 || (size_t)length >= sizeof(payload)) {
+        return -1;
+    }
+    return send_frame(index, message_id, payload, (uint32_t)length);
+}
+
+static void start_connect(int index) {
+    Player* player = &players[index];
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        perror("socket");
+        stats.connect_failures++;
+        player->state = PLAYER_CLOSED;
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (set_nonblocking(fd) == -1) {
+        close(fd);
+        stats.connect_failures++;
+        player->state = PLAYER_CLOSED;
+        return;
+    }
+    if (connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1
+        && errno != EINPROGRESS) {
+        perror("connect");
+        close(fd);
+        stats.connect_failures++;
+        player->state = PLAYER_CLOSED;
+        return;
+    }
+
+    player->fd = fd;
+    player->state = PLAYER_CONNECTING;
+    player->want_write = 1;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+    ev.data.u32 = (uint32_t)index;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl ADD");
+        close_player(index, NULL);
+    }
+}
+
+/* Connection established: register (harmless if the user exists) and log in */
+static void on_connected(int index) {
+    Player* player = &players[index];
+    player->state = PLAYER_LOGGING_IN;
+    stats.connected++;
+    send_json(index, MSG_C2S_REGISTER,
+              "{\"username\": \"%s_%d\", \"password\": \"loadgen\", "
+              "\"email\": \"%s_%d@loadgen.invalid\", \"fullname\": \"Load %d\"}",
+              config.prefix, index, config.prefix, index, index);
+    if (player->fd != -1) {
+        send_json(index, MSG_C2S_LOGIN, "{\"username\": \"%s_%d\", \"password\": \"loadgen\"}",
+                  config.prefix, index);
+    }
+}
+
+/* ========== Game Flow ========== */
+
+static void find_match(int index) {
+    Player* player = &players[index];
+    player->state = PLAYER_QUEUED;
+    player->game_id[0] = '\0';
+    player->opponent = -1;
+    send_json(index, MSG_C2S_FIND_MATCH, "{}");
+}
+
+static void send_next_move(int index) {
+    Player* player = &players[index];
+    if (player->state != PLAYER_PLAYING || player->ply >= SCRIPT_PLIES) {
+        return;
+    }
+    const char* uci = script[player->ply];
+    player->move_sent_us = now_us();
+    player->awaiting_state = 1;
+    player->awaiting_relay = 1;
+
+    if (config.binary) {
+        MovePayload move;
+        uint8_t payload[2 + 4 + 1 + BINARY_GAME_ID_MAX];
+        memset(&move, 0, sizeof(move));
+        move.move = move_from_uci(uci);
+        snprintf(move.game_id, sizeof(move.game_id), "%s", player->game_id);
+        int length = encode_move_payload(&move, payload, sizeof(payload));
+        if (length > 0) {
+            send_frame(index, MSG_C2S_MAKE_MOVE | MSG_FLAG_BINARY, payload, (uint32_t)length);
+        }
+    } else {
+        send_json(index, MSG_C2S_MAKE_MOVE, "{\"game_id\": \"%s\", \"move\": \"%s\"}",
+                  player->game_id, uci);
+    }
+}
+
+/* Leave the current game and queue again after one move interval */
+static void leave_game(int index) {
+    Player* player = &players[index];
+    player->state = PLAYER_QUEUED;
+    player->awaiting_state = 0;
+    player->awaiting_relay = 0;
+    schedule(index, TIMER_FIND_MATCH, now_us() + move_interval_us);
+}
+
+/* The opponent's username carries its player index: <prefix>_<index> */
+static int opponent_index(const char* username) {
+    size_t prefix_length = strlen(config.prefix);
+    if (strncmp(username, config.prefix, prefix_length) != 0 || username[prefix_length] != '_') {
+        return -1;
+    }
+    int index = atoi(username + prefix_length + 1);
+    return index >= 0 && index < config.connections ? index : -1;
+}
+
+static void on_game_start(int index, const char* json) {
+    Player* player = &players[index];
+    char color[8];
+    if (json_string(json, "game_id", player->game_id, sizeof(player->game_id)) == -1
+        || json_string(json, "color", color, sizeof(color)) == -1) {
+        return;
+    }
+    player->state = PLAYER_PLAYING;
+    player->color = strcmp(color, "white") == 0 ? 0 : 1;
+    player->ply = 0;
+    player->awaiting_state = 0;
+    player->awaiting_relay = 0;
+    if (player->color == 0) {
+        stats.games_started++;
+        schedule(index, TIMER_MOVE, now_us() + move_interval_us);
+    }
+}
+
+static void on_state_update(int index, const char* game_id) {
+    Player* player = &players[index];
+    if (player->state != PLAYER_PLAYING || strcmp(game_id, player->game_id) != 0) {
+        return;
+    }
+    uint64_t now = now_us();
+    if (player->awaiting_state) {
+        samples_add(&move_rtt, now - player->move_sent_us);
+        player->awaiting_state = 0;
+        stats.moves++;
+    }
+    player->ply++;
+
+    if (player->ply >= SCRIPT_PLIES) {
+        if (player->color == 0) {
+            stats.games_finished++;
+            send_json(index, MSG_C2S_RESIGN, "{\"game_id\": \"%s\"}", player->game_id);
+        }
+        if (player->fd != -1) {
+            leave_game(index);
+        }
+        return;
+    }
+    if (player->ply % 2 == player->color) {
+        schedule(index, TIMER_MOVE, now + move_interval_us);
+    }
+}
+
+static void on_opponent_move(int index) {
+    Player* player = &players[index];
+    if (player->state != PLAYER_PLAYING || player->opponent == -1) {
+        return;
+    }
+    Player* mover = &players[player->opponent];
+    if (mover->awaiting_relay && strcmp(mover->game_id, player->game_id) == 0) {
+        samples_add(&relay_latency, now_us() - mover->move_sent_us);
+        mover->awaiting_relay = 0;
+    }
+}
+
+/* A rejected move desynchronizes the script: abandon the game on both sides */
+static void on_invalid_move(int index) {
+    Player* player = &players[index];
+    stats.invalid_moves++;
+    if (player->state != PLAYER_PLAYING) {
+        return;
+    }
+    send_json(index, MSG_C2S_RESIGN, "{\"game_id\": \"%s\"}", player->game_id);
+    int opponent = player->opponent;
+    if (opponent != -1 && players[opponent].state == PLAYER_PLAYING
+        && strcmp(players[opponent].game_id, player->game_id) == 0) {
+        leave_game(opponent);
+    }
+    if (player->fd != -1) {
+        leave_game(index);
+    }
+}
+
+static void handle_frame(int index, uint16_t message_id, const uint8_t* payload, uint32_t length) {
+    Player* player = &players[index];
+    uint16_t type = message_id & MSG_ID_MASK;
+    stats.frames_received++;
+
+    if (message_id & MSG_FLAG_BINARY) {
+        if (type == MSG_S2C_GAME_STATE_UPDATE) {
+            GameStatePayload state;
+            if (decode_game_state_payload(payload, length, &state) == 0) {
+                on_state_update(index, state.game_id);
+            }
+        } else if (type == MSG_S2C_OPPONENT_MOVE) {
+            on_opponent_move(index);
+        }
+        return;
+    }
+
+    const char* json = json_text(payload, length);
+    char text[BINARY_GAME_ID_MAX];
+    switch (type) {
+        case MSG_S2C_LOGIN_RESULT:
+            if (player->state != PLAYER_LOGGING_IN) {
+                break;
+            }
+            if (!json_true(json, "success")) {
+                close_player(index, "login rejected");
+                break;
+            }
+            stats.logged_in++;
+            find_match(index);
+            break;
+        case MSG_S2C_MATCH_FOUND:
+            if (json_string(json, "opponent_username", text, sizeof(text)) == 0) {
+                player->opponent = opponent_index(text);
+            }
+            break;
+        case MSG_S2C_GAME_START:
+            on_game_start(index, json);
+            break;
+        case MSG_S2C_GAME_STATE_UPDATE:
+            if (json_string(json, "game_id", text, sizeof(text)) == 0) {
+                on_state_update(index, text);
+            }
+            break;
+        case MSG_S2C_OPPONENT_MOVE:
+            on_opponent_move(index);
+            break;
+        case MSG_S2C_INVALID_MOVE:
+            on_invalid_move(index);
+            break;
+        default:
+            break;                       /* Lobby broadcasts, GAME_OVER, ... */
+    }
+}
+
+/* Read until the socket would block, dispatching complete frames */
+static void handle_readable(int index) {
+    Player* player = &players[index];
+    for (;;) {
+        if (player->recv_length == player->recv_capacity) {
+            if (player->recv_capacity >= BUFFER_SIZE) {
+                close_player(index, "frame exceeds BUFFER_SIZE");
+                return;
+            }
+            size_t capacity = player->recv_capacity ? player->recv_capacity * 2 : RECV_INITIAL;
+            uint8_t* grown = realloc(player->recv_buffer, capacity);
+            if (!grown) {
+                close_player(index, "out of memory");
+                return;
+            }
+            player->recv_buffer = grown;
+            player->recv_capacity = capacity;
+        }
+
+        ssize_t received = recv(player->fd, player->recv_buffer + player->recv_length,
+                                player->recv_capacity - player->recv_length, 0);
+        if (received == 0) {
+            close_player(index, "server closed the connection");
+            return;
+        }
+        if (received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                close_player(index, strerror(errno));
+            }
+            return;
+        }
+        player->recv_length += (size_t)received;
+        stats.bytes_received += (size_t)received;
+
+        size_t start = 0;
+        while (player->recv_length - start >= HEADER_SIZE) {
+            const MessageHeader* header = (const MessageHeader*)(player->recv_buffer + start);
+            uint32_t length = ntohl(header->payload_length);
+            if (HEADER_SIZE + (size_t)length > BUFFER_SIZE) {
+                close_player(index, "oversized frame");
+                return;
+            }
+            if (player->recv_length - start < HEADER_SIZE + (size_t)length) {
+                break;
+            }
+            handle_frame(index, ntohs(header->message_id),
+                         player->recv_buffer + start + HEADER_SIZE, length);
+            if (player->fd == -1) {
+                return;
+            }
+            start += HEADER_SIZE + length;
+        }
+        memmove(player->recv_buffer, player->recv_buffer + start, player->recv_length - start);
+        player->recv_length -= start;
+    }
+}
+
+static void handle_writable(int index) {
+    Player* player = &players[index];
+    if (player->state == PLAYER_CONNECTING) {
+        int error = 0;
+        socklen_t error_length = sizeof(error);
+        if (getsockopt(player->fd, SOL_SOCKET, SO_ERROR, &error, &error_length) == -1 || error != 0) {
+            close_player(index, error ? strerror(error) : "connect failed");
+            return;
+        }
+        on_connected(index);
+        if (player->fd == -1) {
+            return;
+        }
+    }
+    if (flush_player(index) == -1) {
+        close_player(index, "send failed");
+        return;
+    }
+    update_interest(index);
+}
+
+static void run_timer(Timer timer) {
+    Player* player = &players[timer.player];
+    if (timer.generation != player->timer_generation) {
+        return;                          /* Superseded */
+    }
+    TimerAction action = player->timer_action;
+    player->timer_action = TIMER_NONE;
+
+    switch (action) {
+        case TIMER_CONNECT:
+            start_connect(timer.player);
+            break;
+        case TIMER_MOVE:
+            send_next_move(timer.player);
+            break;
+        case TIMER_FIND_MATCH:
+            if (player->fd != -1) {
+                find_match(timer.player);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* ========== Main ========== */
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [-h host] [-p port] [-c connections] [-r moves/s per game]\n"
+            "          [-R connects/s] [-d seconds] [-u username prefix] [-b]\n"
+            "  -b  send binary MAKE_MOVE frames (default JSON)\n",
+            program);
+}
+
+static int parse_args(int argc, char** argv) {
+    int option;
+    while ((option = getopt(argc, argv, "h:p:c:r:R:d:u:b")) != -1) {
+        switch (option) {
+            case 'h': config.host = optarg; break;
+            case 'p': config.port = atoi(optarg); break;
+            case 'c': config.connections = atoi(optarg); break;
+            case 'r': config.move_rate = atof(optarg); break;
+            case 'R': config.connect_rate = atof(optarg); break;
+            case 'd': config.duration_s = atoi(optarg); break;
+            case 'u': config.prefix = optarg; break;
+            case 'b': config.binary = 1; break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+    if (config.connections < 2 || config.move_rate <= 0 || config.connect_rate <= 0
+        || config.duration_s <= 0 || config.port <= 0 || strlen(config.prefix) > USERNAME_MAX - 12) {
+        usage(argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+/* Each connection needs a descriptor: raise the soft limit as far as allowed */
+static void raise_fd_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+        && (rlim_t)config.connections + 16 > limit.rlim_cur) {
+        fprintf(stderr, "Warning: RLIMIT_NOFILE is %llu, some connections will fail\n",
+                (unsigned long long)limit.rlim_cur);
+    }
+}
+
+static int resolve_server(void) {
+    struct addrinfo hints, *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(config.host, NULL, &hints, &result) != 0 || !result) {
+        fprintf(stderr, "ERROR: Host not found: %s\n", config.host);
+        return -1;
+    }
+    memcpy(&server_addr, result->ai_addr, sizeof(server_addr));
+    server_addr.sin_port = htons(config.port);
+    freeaddrinfo(result);
+    return 0;
+}
+
+static int count_in_state(PlayerState state) {
+    int count = 0;
+    for (int i = 0; i < config.connections; i++) {
+        count += players[i].state == state;
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    if (parse_args(argc, argv) == -1 || resolve_server() == -1) {
+        return 2;
+    }
+    raise_fd_limit();
+
+    players = calloc((size_t)config.connections, sizeof(Player));
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (!players || epoll_fd == -1) {
+        perror("setup");
+        return 1;
+    }
+    memset(&stats, 0, sizeof(stats));
+    move_interval_us = (uint64_t)(1000000.0 / config.move_rate);
+
+    /* Ramp connections in at connect_rate */
+    uint64_t start = now_us();
+    uint64_t connect_step = (uint64_t)(1000000.0 / config.connect_rate);
+    for (int i = 0; i < config.connections; i++) {
+        players[i].fd = -1;
+        players[i].opponent = -1;
+        schedule(i, TIMER_CONNECT, start + (uint64_t)i * connect_step);
+    }
+
+    printf("loadgen: %d connections -> %s:%d, %.1f moves/s per game, %s moves, %d s\n",
+           config.connections, config.host, config.port, config.move_rate,
+           config.binary ? "binary" : "JSON", config.duration_s);
+
+    uint64_t end = start + (uint64_t)config.duration_s * 1000000u;
+    uint64_t next_report = start + 1000000u;
+    unsigned long long frames_at_report = 0, moves_at_report = 0;
+    struct epoll_event events[EPOLL_BATCH];
+
+    for (;;) {
+        uint64_t now = now_us();
+        if (now >= end) {
+            break;
+        }
+
+        while (timer_count > 0 && timers[0].at_us <= now) {
+            run_timer(timer_pop());
+        }
+
+        if (now >= next_report) {
+            unsigned long long frames = stats.frames_sent + stats.frames_received;
+            printf("t=%3llus  connected %d  logged in %d  playing %d  moves %llu (%llu/s)  msgs %llu/s\n",
+                   (unsigned long long)((now - start) / 1000000u), stats.connected, stats.logged_in,
+                   count_in_state(PLAYER_PLAYING), stats.moves, stats.moves - moves_at_report,
+                   frames - frames_at_report);
+            fflush(stdout);
+            frames_at_report = frames;
+            moves_at_report = stats.moves;
+            next_report += 1000000u;
+        }
+
+        uint64_t wake = next_report < end ? next_report : end;
+        if (timer_count > 0 && timers[0].at_us < wake) {
+            wake = timers[0].at_us;
+        }
+        int timeout_ms = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+
+        int count = epoll_wait(epoll_fd, events, EPOLL_BATCH, timeout_ms);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            int index = (int)events[i].data.u32;
+            uint32_t flags = events[i].events;
+            if (players[index].fd == -1) {
+                continue;
+            }
+            if ((flags & EPOLLOUT) || players[index].state == PLAYER_CONNECTING) {
+                handle_writable(index);
+            }
+            if (players[index].fd != -1 && (flags & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))) {
+                handle_readable(index);
+            }
+        }
+    }
+
+    double elapsed = (double)(now_us() - start) / 1e6;
+    printf("\n=== loadgen summary (%.1f s) ===\n", elapsed);
+    printf("connections      %d requested, %d connected, %d logged in, %d failed, %d dropped\n",
+           config.connections, stats.connected, stats.logged_in, stats.connect_failures, stats.disconnects);
+    printf("games            %llu started, %llu finished\n", stats.games_started, stats.games_finished);
+    printf("moves            %llu acknowledged (%.1f/s), %llu rejected\n",
+           stats.moves, stats.moves / elapsed, stats.invalid_moves);
+    printf("messages         %llu sent, %llu received (%.1f msg/s, %.2f MB/s)\n",
+           stats.frames_sent, stats.frames_received,
+           (stats.frames_sent + stats.frames_received) / elapsed,
+           (stats.bytes_sent + stats.bytes_received) / elapsed / 1e6);
+    report_samples("move RTT", &move_rtt);
+    report_samples("relay latency", &relay_latency);
+
+    for (int i = 0; i < config.connections; i++) {
+        if (players[i].fd != -1) {
+            close(players[i].fd);
+        }
+        free(players[i].recv_buffer);
+        free(players[i].send_buffer);
+    }
+    free(players);
+    free(timers);
+    free(move_rtt.values);
+    free(relay_latency.values);
+    close(epoll_fd);
+    return stats.moves > 0 ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""
+Training run for `make profile-build`: plays loadgen against a small lobby
+served straight on the instrumented libchess_server.so, so the profile
+covers what the game server runs - framing, routed move relay, clock
+switches, state updates in JSON and binary, spectator streams and the
+event queue. The lobby answers logins, pairs players and echoes moves;
+nothing is validated or stored. A first phase polls one shard inline (the
+default server), a second runs two shards on native threads with binary
+moves. Run from tcp_server/ after `make loadgen`.
+
+    python3 bench/pgo_train.py [seconds per phase]
+"""
+
+import ctypes
+import itertools
+import json
+import subprocess
+import sys
+
+PORT = 18765
+CLOCK_MS = 300000
+INCREMENT_MS = 2000
+KEYFRAME_PLIES = 16
+
+EVENT_NEW_CONNECTION = 1
+EVENT_CLIENT_DISCONNECTED = 2
+EVENT_MESSAGE_RECEIVED = 3
+EVENT_FLAG_BINARY = 0x0002
+EVENT_FLAG_CLOCK_SWITCHED = 0x0008
+MSG_FLAG_BINARY = 0x8000
+
+REGISTER, LOGIN, FIND_MATCH, MAKE_MOVE, RESIGN = 0x0001, 0x0002, 0x0010, 0x0020, 0x0021
+REGISTER_RESULT, LOGIN_RESULT = 0x1001, 0x1002
+MATCH_FOUND, GAME_START = 0x1100, 0x1101
+GAME_STATE_UPDATE, GAME_OVER = 0x1200, 0x1202
+
+
+class NetworkEvent(ctypes.Structure):
+    _fields_ = [
+        ("type", ctypes.c_int),
+        ("client_fd", ctypes.c_int),
+        ("message_id", ctypes.c_uint16),
+        ("payload_length", ctypes.c_uint32),
+        ("payload_data", ctypes.c_void_p),
+        ("flags", ctypes.c_uint32)
+    ]
+
+
+class MovePayload(ctypes.Structure):
+    _fields_ = [
+        ("move", ctypes.c_uint16),
+        ("clock_ms", ctypes.c_uint32),
+        ("game_id", ctypes.c_char * 64)
+    ]
+
+
+class GameStatePayload(ctypes.Structure):
+    _fields_ = [
+        ("last_move", ctypes.c_uint16),
+        ("flags", ctypes.c_uint8),
+        ("white_ms", ctypes.c_uint32),
+        ("black_ms", ctypes.c_uint32),
+        ("game_id", ctypes.c_char * 64),
+        ("fen", ctypes.c_char * 100)
+    ]
+
+
+START_FEN = b"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+
+class Lobby:
+    def __init__(self, lib):
+        self.lib = lib
+        self.names = {}                  # fd -> username
+        self.waiting = None
+        self.games = {}                  # game_id -> [white_fd, black_fd, ply]
+        self.player_game = {}            # fd -> game_id
+        self.ids = itertools.count(1)
+        self.out = ctypes.create_string_buffer(256)
+
+    def send(self, fd, message_id, data):
+        payload = json.dumps(data).encode('utf-8')
+        self.lib.send_message(fd, message_id, payload, len(payload))
+
+    def handle(self, event, payload):
+        fd = event.client_fd
+        if event.type == EVENT_CLIENT_DISCONNECTED:
+            self.end_game(fd)
+            self.names.pop(fd, None)
+            if self.waiting == fd:
+                self.waiting = None
+            return
+        if event.type != EVENT_MESSAGE_RECEIVED:
+            return
+
+        if event.message_id == MAKE_MOVE:
+            self.make_move(event, payload)
+            return
+        data = json.loads(payload) if payload else {}
+        if event.message_id == REGISTER:
+            self.send(fd, REGISTER_RESULT, {'success': True})
+        elif event.message_id == LOGIN:
+            self.names[fd] = data.get('username', '')
+            self.send(fd, LOGIN_RESULT, {'success': True, 'username': self.names[fd], 'user_id': fd})
+        elif event.message_id == FIND_MATCH:
+            self.find_match(fd)
+        elif event.message_id == RESIGN:
+            self.end_game(fd)
+
+    def find_match(self, fd):
+        if self.waiting is None or self.waiting == fd:
+            self.waiting = fd
+            return
+        white, black, self.waiting = self.waiting, fd, None
+        game_id = f"pgo-{next(self.ids)}"
+        if self.lib.server_shard_count() > 1:
+            self.lib.server_pin_clients((ctypes.c_int * 2)(white, black), 2)
+        self.lib.server_route_game(white, black)
+        for player, opponent, color in ((white, black, 'white'), (black, white, 'black')):
+            self.send(player, MATCH_FOUND, {'opponent_username': self.names.get(opponent, '')})
+            self.send(player, GAME_START, {'game_id': game_id, 'color': color,
+                                           'fen': START_FEN.decode('ascii')})
+            self.lib.server_set_clock(player, CLOCK_MS, INCREMENT_MS)
+            self.player_game[player] = game_id
+        self.lib.server_start_clock(white)
+        self.games[game_id] = [white, black, 0]
+        state = GameStatePayload(game_id=game_id.encode('ascii'), fen=START_FEN,
+                                 white_ms=CLOCK_MS, black_ms=CLOCK_MS)
+        self.lib.server_stream_keyframe(game_id.encode('ascii'), 0, ctypes.byref(state))
+
+    def make_move(self, event, payload):
+        if event.flags & EVENT_FLAG_BINARY:
+            move = MovePayload()
+            if self.lib.decode_move_payload(payload, len(payload), ctypes.byref(move)) != 0:
+                return
+            uci_move, game_id = move.move, move.game_id.decode('ascii')
+        else:
+            data = json.loads(payload)
+            game_id = data.get('game_id', '')
+            uci_move = self.lib.move_from_uci(data.get('move', '').encode('ascii'))
+        game = self.games.get(game_id)
+        if game is None:
+            return
+        white, black, ply = game
+        mover, opponent = (white, black) if ply % 2 == 0 else (black, white)
+        if not event.flags & EVENT_FLAG_CLOCK_SWITCHED:
+            self.lib.server_switch_clock(mover, opponent)
+        game[2] = ply = ply + 1
+
+        white_ms = max(self.lib.server_clock_remaining(white), 0)
+        black_ms = max(self.lib.server_clock_remaining(black), 0)
+        state = GameStatePayload(last_move=uci_move, flags=ply % 2, white_ms=white_ms, black_ms=black_ms,
+                                 game_id=game_id.encode('ascii'), fen=START_FEN)
+        if event.flags & EVENT_FLAG_BINARY:
+            length = self.lib.encode_game_state_payload(ctypes.byref(state), self.out, len(self.out))
+            for fd in (white, black):
+                self.lib.send_message(fd, GAME_STATE_UPDATE | MSG_FLAG_BINARY, self.out, length)
+        else:
+            self.lib.move_to_uci(uci_move, self.out)
+            update = {'game_id': game_id, 'fen': START_FEN.decode('ascii'),
+                      'last_move': self.out.value.decode('ascii'), 'turn': 'white' if ply % 2 == 0 else 'black',
+                      'white_time_ms': white_ms, 'black_time_ms': black_ms}
+            for fd in (white, black):
+                self.send(fd, GAME_STATE_UPDATE, update)
+
+        if ply % KEYFRAME_PLIES == 0:
+            self.lib.server_stream_keyframe(game_id.encode('ascii'), ply, ctypes.byref(state))
+        else:
+            self.lib.server_stream_move(game_id.encode('ascii'), ply, uci_move, state.flags,
+                                        white_ms, black_ms)
+
+    def end_game(self, fd):
+        game_id = self.player_game.pop(fd, None)
+        game = self.games.pop(game_id, None)
+        if game is None:
+            return
+        for player in game[:2]:
+            self.player_game.pop(player, None)
+            self.lib.server_stop_clock(player)
+            if self.lib.server_client_shard(player) >= 0:    # Not closed meanwhile
+                self.send(player, GAME_OVER, {'game_id': game_id, 'result': 'resign'})
+        self.lib.server_unroute_game(fd)
+        self.lib.server_stream_close(game_id.encode('ascii'))
+
+
+def load_library(path):
+    lib = ctypes.CDLL(path)
+    lib.send_message.argtypes = [ctypes.c_int, ctypes.c_uint16, ctypes.c_char_p, ctypes.c_uint32]
+    lib.server_poll_batch.argtypes = [ctypes.POINTER(NetworkEvent), ctypes.c_int]
+    lib.free_event_batch.argtypes = [ctypes.POINTER(NetworkEvent), ctypes.c_int]
+    lib.move_from_uci.restype = ctypes.c_uint16
+    lib.server_clock_remaining.restype = ctypes.c_int64
+    lib.server_stop_clock.restype = ctypes.c_int64
+    lib.server_stream_move.argtypes = [ctypes.c_char_p, ctypes.c_uint16, ctypes.c_uint16, ctypes.c_uint8,
+                                       ctypes.c_uint32, ctypes.c_uint32]
+    lib.decode_move_payload.argtypes = [ctypes.c_char_p, ctypes.c_uint32, ctypes.POINTER(MovePayload)]
+    return lib
+
+
+def run_phase(lib, shards, threaded, loadgen_args):
+    if lib.server_init_shards(PORT, shards) != 0:
+        sys.exit("pgo_train: cannot start the server")
+    if threaded:
+        lib.server_start_thread(50)
+    lobby = Lobby(lib)
+    batch = (NetworkEvent * 256)()
+    loadgen = subprocess.Popen(['./loadgen', '-p', str(PORT)] + loadgen_args, stdout=subprocess.DEVNULL)
+    while loadgen.poll() is None:
+        lib.server_poll(20)
+        count = lib.server_poll_batch(batch, len(batch))
+        for event in batch[:count]:
+            payload = ctypes.string_at(event.payload_data, event.payload_length) if event.payload_length else b''
+            lobby.handle(event, payload)
+        lib.free_event_batch(batch, count)
+    lib.server_shutdown()
+
+
+def main():
+    seconds = sys.argv[1] if len(sys.argv) > 1 else '10'
+    lib = load_library('./libchess_server.so')
+    run_phase(lib, 1, False, ['-c', '200', '-r', '10', '-d', seconds])
+    run_phase(lib, 2, True, ['-c', '400', '-r', '10', '-d', seconds, '-b'])
+
+
+if __name__ == '__main__':
+    main()
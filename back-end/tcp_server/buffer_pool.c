@@ -0,0 +1,121 @@
+#include "buffer_pool.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+/* ========== Pool State ========== */
+
+/* Free blocks are chained through their first bytes */
+typedef struct FreeBlock {
+    struct FreeBlock* next;
+} FreeBlock;
+
+static const size_t class_sizes[POOL_CLASS_COUNT] = { POOL_MIN_BLOCK, POOL_MIN_BLOCK * 4, POOL_MAX_BLOCK };
+static const int class_cache_limit[POOL_CLASS_COUNT] = { 512, 128, 32 };
+
+static FreeBlock* free_lists[POOL_CLASS_COUNT];
+static int free_counts[POOL_CLASS_COUNT];
+static size_t bytes_in_use = 0;
+static size_t bytes_cached = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;   /* Reactor threads share the pool */
+
+/* ========== Helper Functions ========== */
+
+static int class_index(size_t size) {
+    for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+        if (size <= class_sizes[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* ========== Pool API ========== */
+
+size_t pool_class_size(size_t min_size) {
+    int index = class_index(min_size);
+    return index == -1 ? 0 : class_sizes[index];
+}
+
+uint8_t* pool_acquire(size_t min_size, size_t* capacity) {
+    int index = class_index(min_size);
+    if (index == -1) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&pool_lock);
+    uint8_t* block = (uint8_t*)free_lists[index];
+    if (block) {
+        free_lists[index] = free_lists[index]->next;
+        free_counts[index]--;
+        bytes_cached -= class_sizes[index];
+    }
+    pthread_mutex_unlock(&pool_lock);
+    
+    if (!block) {
+        block = malloc(class_sizes[index]);
+        if (!block) {
+            return NULL;
+        }
+    }
+    
+    pthread_mutex_lock(&pool_lock);
+    bytes_in_use += class_sizes[index];
+    pthread_mutex_unlock(&pool_lock);
+    if (capacity) {
+        *capacity = class_sizes[index];
+    }
+    return block;
+}
+
+void pool_release(uint8_t* block, size_t capacity) {
+    if (!block) {
+        return;
+    }
+    
+    int index = class_index(capacity);
+    if (index == -1 || class_sizes[index] != capacity) {
+        free(block);
+        return;
+    }
+    
+    pthread_mutex_lock(&pool_lock);
+    bytes_in_use -= capacity;
+    if (free_counts[index] < class_cache_limit[index]) {
+        FreeBlock* node = (FreeBlock*)block;
+        node->next = free_lists[index];
+        free_lists[index] = node;
+        free_counts[index]++;
+        bytes_cached += capacity;
+        block = NULL;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    free(block);
+}
+
+size_t pool_bytes_in_use(void) {
+    pthread_mutex_lock(&pool_lock);
+    size_t bytes = bytes_in_use;
+    pthread_mutex_unlock(&pool_lock);
+    return bytes;
+}
+
+size_t pool_bytes_cached(void) {
+    pthread_mutex_lock(&pool_lock);
+    size_t bytes = bytes_cached;
+    pthread_mutex_unlock(&pool_lock);
+    return bytes;
+}
+
+void pool_trim(void) {
+    pthread_mutex_lock(&pool_lock);
+    for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+        while (free_lists[i]) {
+            FreeBlock* next = free_lists[i]->next;
+            free(free_lists[i]);
+            free_lists[i] = next;
+        }
+        free_counts[i] = 0;
+    }
+    bytes_cached = 0;
+    pthread_mutex_unlock(&pool_lock);
+}
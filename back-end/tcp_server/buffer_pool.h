@@ -0,0 +1,36 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ========== Size-Classed Buffer Pool ========== */
+
+/*
+ * Session buffers come from a small set of power-of-four size classes.
+ * Released blocks are kept on a per-class free list (up to a cap) so
+ * reconnect storms and message bursts reuse memory instead of hitting
+ * malloc, while idle connections only hold the smallest class.
+ */
+
+#define POOL_CLASS_COUNT    3
+#define POOL_MIN_BLOCK      4096                 /* Default per-connection buffer */
+#define POOL_MAX_BLOCK      65536                /* Largest class (== BUFFER_SIZE) */
+
+/* Acquire a block of at least min_size bytes; capacity receives the real size */
+uint8_t* pool_acquire(size_t min_size, size_t* capacity);
+
+/* Return a block previously obtained from pool_acquire() */
+void pool_release(uint8_t* block, size_t capacity);
+
+/* Size of the class that would serve a request of min_size bytes (0 if too big) */
+size_t pool_class_size(size_t min_size);
+
+/* Bytes currently handed out and bytes parked on the free lists */
+size_t pool_bytes_in_use(void);
+size_t pool_bytes_cached(void);
+
+/* Free every cached block */
+void pool_trim(void);
+
+#endif /* BUFFER_POOL_H */
@@ -0,0 +1,110 @@
+#include "event_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ========== Helper Functions ========== */
+
+static EventSegment* segment_new(EventQueue* queue) {
+    EventSegment* segment = atomic_exchange_explicit(&queue->spare, NULL, memory_order_acquire);
+    if (!segment) {
+        segment = malloc(sizeof(EventSegment));
+        if (!segment) {
+            return NULL;
+        }
+    }
+    atomic_init(&segment->next, NULL);
+    return segment;
+}
+
+/* Drop the payload an undelivered event owns */
+static void event_free_payload(NetworkEvent* event) {
+    if (event->payload_data && !(event->flags & EVENT_FLAG_PAYLOAD_VIEW)) {
+        free(event->payload_data);
+    }
+}
+
+/* ========== Queue API ========== */
+
+int event_queue_init(EventQueue* queue) {
+    memset(queue, 0, sizeof(*queue));
+    atomic_init(&queue->spare, NULL);
+    EventSegment* first = segment_new(queue);
+    if (!first) {
+        return -1;
+    }
+    queue->head = queue->tail = first;
+    queue->head_pos = queue->tail_pos = 0;
+    atomic_init(&queue->enqueued, 0);
+    atomic_init(&queue->dequeued, 0);
+    return 0;
+}
+
+void event_queue_destroy(EventQueue* queue) {
+    NetworkEvent event;
+    while (event_queue_pop(queue, &event, 1) == 1) {
+        event_free_payload(&event);
+    }
+    free(queue->head);
+    free(atomic_load(&queue->spare));
+    memset(queue, 0, sizeof(*queue));
+}
+
+int event_queue_push(EventQueue* queue, const NetworkEvent* event) {
+    if (queue->tail_pos == EVENT_SEGMENT_SIZE) {
+        EventSegment* segment = segment_new(queue);
+        if (!segment) {
+            return -1;
+        }
+        /* Link before publishing the count so the consumer always finds it */
+        atomic_store_explicit(&queue->tail->next, segment, memory_order_release);
+        queue->tail = segment;
+        queue->tail_pos = 0;
+    }
+    queue->tail->events[queue->tail_pos++] = *event;
+    atomic_fetch_add_explicit(&queue->enqueued, 1, memory_order_release);
+    return 0;
+}
+
+int event_queue_pop(EventQueue* queue, NetworkEvent* out, int max) {
+    size_t done = atomic_load_explicit(&queue->dequeued, memory_order_relaxed);
+    size_t available = atomic_load_explicit(&queue->enqueued, memory_order_acquire) - done;
+    int count = 0;
+    
+    while (count < max && (size_t)count < available) {
+        if (queue->head_pos == EVENT_SEGMENT_SIZE) {
+            EventSegment* next = atomic_load_explicit(&queue->head->next, memory_order_acquire);
+            EventSegment* retired = queue->head;
+            queue->head = next;
+            queue->head_pos = 0;
+            /* Keep one segment for the producer, free any older spare */
+            free(atomic_exchange_explicit(&queue->spare, retired, memory_order_release));
+        }
+        out[count++] = queue->head->events[queue->head_pos++];
+    }
+    
+    if (count > 0) {
+        atomic_store_explicit(&queue->dequeued, done + (size_t)count, memory_order_release);
+    }
+    return count;
+}
+
+size_t event_queue_size(EventQueue* queue) {
+    /* dequeued first: it never passes an enqueued loaded after it */
+    size_t done = atomic_load_explicit(&queue->dequeued, memory_order_acquire);
+    return atomic_load_explicit(&queue->enqueued, memory_order_acquire) - done;
+}
+
+void event_queue_for_each(EventQueue* queue, void (*fn)(NetworkEvent*, void*), void* ctx) {
+    EventSegment* segment = queue->head;
+    size_t pos = queue->head_pos;
+    size_t remaining = event_queue_size(queue);
+    
+    while (remaining > 0) {
+        if (pos == EVENT_SEGMENT_SIZE) {
+            segment = atomic_load_explicit(&segment->next, memory_order_acquire);
+            pos = 0;
+        }
+        fn(&segment->events[pos++], ctx);
+        remaining--;
+    }
+}
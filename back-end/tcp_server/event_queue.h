@@ -0,0 +1,56 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include "protocol.h"
+#include <stdatomic.h>
+
+/* ========== Unbounded Lock-Free Event Queue ========== */
+
+/*
+ * Single-consumer queue built from linked fixed-size segments. The
+ * producer side is wait-free as long as it is driven by one thread at a
+ * time (the server serializes producers with its session lock); the
+ * consumer never takes a lock, so Python can drain the queue while the
+ * poll thread keeps filling it. Full segments are unlinked by the
+ * consumer and one is kept aside for reuse, so steady traffic does not
+ * allocate.
+ */
+
+#define EVENT_SEGMENT_SIZE 1024
+
+typedef struct EventSegment {
+    NetworkEvent events[EVENT_SEGMENT_SIZE];
+    _Atomic(struct EventSegment*) next;
+} EventSegment;
+
+typedef struct {
+    /* Consumer side */
+    EventSegment* head;
+    size_t head_pos;
+    _Atomic size_t dequeued;
+    
+    /* Producer side */
+    EventSegment* tail;
+    size_t tail_pos;
+    _Atomic size_t enqueued;
+    
+    _Atomic(EventSegment*) spare;    /* Recycled segment handed back by the consumer */
+} EventQueue;
+
+int event_queue_init(EventQueue* queue);
+void event_queue_destroy(EventQueue* queue);
+
+/* Producer: append one event; returns -1 only when out of memory */
+int event_queue_push(EventQueue* queue, const NetworkEvent* event);
+
+/* Consumer: pop up to max events into out; returns the number popped */
+int event_queue_pop(EventQueue* queue, NetworkEvent* out, int max);
+
+/* Number of events currently queued (approximate under concurrency) */
+size_t event_queue_size(EventQueue* queue);
+
+/* Visit queued events in order. Only valid from the consumer thread while
+ * the producer is held off (e.g. by the lock it pushes under). */
+void event_queue_for_each(EventQueue* queue, void (*fn)(NetworkEvent*, void*), void* ctx);
+
+#endif /* EVENT_QUEUE_H */
@@ -0,0 +1,594 @@
+#define _POSIX_C_SOURCE 200809L                  /* ftruncate(), strnlen() under -std=c11 */
+#include "game_store.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* ========== Store State ========== */
+
+#define STORE_MAGIC         "CHSTORE1"
+#define STORE_HEADER_SIZE   8
+#define FRAME_OVERHEAD      8                    /* Length before the body, checksum after */
+#define VARINT_MAX          10
+
+/* Upper bound of one encoded body: times, result and flags, six strings
+ * with their lengths, moves and clocks */
+#define BODY_MAX (2 * VARINT_MAX + 2 + 6 * (VARINT_MAX + STORE_ID_MAX) + \
+                  VARINT_MAX + 1 + STORE_MAX_MOVES * (2 + VARINT_MAX))
+
+typedef struct {
+    char id[STORE_ID_MAX];
+    uint64_t* offsets;                   /* Their records, oldest first */
+    uint32_t count;
+    uint32_t capacity;
+    GameStoreStats stats;
+} UserIndex;
+
+static int store_fd = -1;
+static uint64_t file_size = 0;           /* Bytes of complete records, header included */
+static const uint8_t* map_base = NULL;
+static size_t map_size = 0;
+static int64_t record_count = 0;
+
+static UserIndex* users = NULL;
+static uint32_t user_count = 0;
+static uint32_t user_capacity = 0;
+static int32_t* user_slots = NULL;       /* Open addressing over users[], -1 empty */
+static uint32_t slot_mask = 0;
+
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ========== Encoding ========== */
+
+static uint32_t checksum(const uint8_t* data, size_t length) {
+    uint32_t hash = 2166136261u;         /* FNV-1a */
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t put_varint(uint8_t* out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static size_t put_string(uint8_t* out, const char* value) {
+    size_t length = strlen(value);
+    size_t n = put_varint(out, length);
+    memcpy(out + n, value, length);
+    return n + length;
+}
+
+static void put_u32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static uint32_t get_u32(const uint8_t* in) {
+    return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8 | in[3];
+}
+
+/* Bounded reader over one record body; any overrun sets failed */
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t pos;
+    int failed;
+} Reader;
+
+static uint64_t get_varint(Reader* in) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in->pos >= in->length) {
+            break;
+        }
+        uint8_t byte = in->data[in->pos++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    in->failed = 1;
+    return 0;
+}
+
+static uint8_t get_u8(Reader* in) {
+    if (in->pos >= in->length) {
+        in->failed = 1;
+        return 0;
+    }
+    return in->data[in->pos++];
+}
+
+static void get_string(Reader* in, char* out, size_t capacity) {
+    uint64_t length = get_varint(in);
+    if (in->failed || length >= capacity || length > in->length - in->pos) {
+        in->failed = 1;
+        out[0] = '\0';
+        return;
+    }
+    memcpy(out, in->data + in->pos, length);
+    out[length] = '\0';
+    in->pos += length;
+}
+
+static int fits(const char* field, size_t capacity) {
+    return strnlen(field, capacity) < capacity;
+}
+
+static size_t encode_record(const GameRecord* record, const uint16_t* moves,
+                            const uint32_t* clocks_ms, uint16_t move_count, uint8_t* out) {
+    size_t n = 0;
+    n += put_varint(out + n, record->start_time);
+    n += put_varint(out + n, record->end_time);
+    out[n++] = record->result;
+    out[n++] = record->flags;
+    n += put_string(out + n, record->status);
+    n += put_string(out + n, record->game_id);
+    n += put_string(out + n, record->white_id);
+    n += put_string(out + n, record->black_id);
+    n += put_string(out + n, record->white_name);
+    n += put_string(out + n, record->black_name);
+    n += put_varint(out + n, move_count);
+    for (uint16_t i = 0; i < move_count; i++) {
+        out[n++] = (uint8_t)(moves[i] >> 8);
+        out[n++] = (uint8_t)moves[i];
+    }
+    out[n++] = clocks_ms != NULL;
+    if (clocks_ms) {
+        for (uint16_t i = 0; i < move_count; i++) {
+            n += put_varint(out + n, clocks_ms[i]);
+        }
+    }
+    return n;
+}
+
+/* Decode a body up to its moves; the reader is left at the first move */
+static int decode_record(Reader* in, uint64_t offset, GameRecord* record) {
+    memset(record, 0, sizeof(*record));
+    record->offset = offset;
+    record->start_time = get_varint(in);
+    record->end_time = get_varint(in);
+    record->result = get_u8(in);
+    record->flags = get_u8(in);
+    get_string(in, record->status, sizeof(record->status));
+    get_string(in, record->game_id, sizeof(record->game_id));
+    get_string(in, record->white_id, sizeof(record->white_id));
+    get_string(in, record->black_id, sizeof(record->black_id));
+    get_string(in, record->white_name, sizeof(record->white_name));
+    get_string(in, record->black_name, sizeof(record->black_name));
+    uint64_t move_count = get_varint(in);
+    if (in->failed || move_count > STORE_MAX_MOVES || move_count * 2 > in->length - in->pos) {
+        return -1;
+    }
+    record->move_count = (uint16_t)move_count;
+    return 0;
+}
+
+/* ========== Mapping ========== */
+
+/* Map at least the complete records; called with the lock held */
+static int ensure_mapped(void) {
+    if (map_base && map_size >= file_size) {
+        return 0;
+    }
+    if (map_base) {
+        munmap((void*)map_base, map_size);
+        map_base = NULL;
+        map_size = 0;
+    }
+    void* base = mmap(NULL, file_size, PROT_READ, MAP_SHARED, store_fd, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap game store");
+        return -1;
+    }
+    map_base = base;
+    map_size = file_size;
+    return 0;
+}
+
+/* Body of the record at offset, NULL if offset doesn't start one */
+static const uint8_t* record_body(uint64_t offset, size_t* length) {
+    if (offset < STORE_HEADER_SIZE || offset + FRAME_OVERHEAD > file_size || ensure_mapped() == -1) {
+        return NULL;
+    }
+    uint32_t body_length = get_u32(map_base + offset);
+    if (body_length > file_size - offset - FRAME_OVERHEAD) {
+        return NULL;
+    }
+    *length = body_length;
+    return map_base + offset + 4;
+}
+
+/* ========== User Index ========== */
+
+static uint32_t hash_id(const char* id) {
+    return checksum((const uint8_t*)id, strlen(id));
+}
+
+static int grow_slots(void) {
+    uint32_t capacity = slot_mask ? (slot_mask + 1) * 2 : 256;
+    int32_t* slots = malloc(capacity * sizeof(int32_t));
+    if (!slots) {
+        return -1;
+    }
+    memset(slots, 0xFF, capacity * sizeof(int32_t));
+    for (uint32_t i = 0; i < user_count; i++) {
+        uint32_t slot = hash_id(users[i].id) & (capacity - 1);
+        while (slots[slot] != -1) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = (int32_t)i;
+    }
+    free(user_slots);
+    user_slots = slots;
+    slot_mask = capacity - 1;
+    return 0;
+}
+
+static UserIndex* find_user(const char* id, int create) {
+    if (!user_slots) {
+        if (!create || grow_slots() == -1) {
+            return NULL;
+        }
+    }
+    uint32_t slot = hash_id(id) & slot_mask;
+    while (user_slots[slot] != -1) {
+        UserIndex* user = &users[user_slots[slot]];
+        if (strcmp(user->id, id) == 0) {
+            return user;
+        }
+        slot = (slot + 1) & slot_mask;
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    /* Keep the table at most half full */
+    if ((user_count + 1) * 2 > slot_mask + 1) {
+        if (grow_slots() == -1) {
+            return NULL;
+        }
+        return find_user(id, create);
+    }
+    if (user_count == user_capacity) {
+        uint32_t capacity = user_capacity ? user_capacity * 2 : 64;
+        UserIndex* grown = realloc(users, capacity * sizeof(UserIndex));
+        if (!grown) {
+            return NULL;
+        }
+        users = grown;
+        user_capacity = capacity;
+    }
+    UserIndex* user = &users[user_count];
+    memset(user, 0, sizeof(*user));
+    snprintf(user->id, sizeof(user->id), "%s", id);
+    user_slots[slot] = (int32_t)user_count++;
+    return user;
+}
+
+static int index_game(const char* id, uint64_t offset, uint8_t result, int is_white) {
+    UserIndex* user = find_user(id, 1);
+    if (!user) {
+        return -1;
+    }
+    if (user->count == user->capacity) {
+        uint32_t capacity = user->capacity ? user->capacity * 2 : 8;
+        uint64_t* grown = realloc(user->offsets, capacity * sizeof(uint64_t));
+        if (!grown) {
+            return -1;
+        }
+        user->offsets = grown;
+        user->capacity = capacity;
+    }
+    user->offsets[user->count++] = offset;
+
+    GameStoreStats* stats = &user->stats;
+    if (result == STORE_RESULT_DRAW) {
+        stats->draws++;
+    } else if (result == STORE_RESULT_WHITE_WIN || result == STORE_RESULT_BLACK_WIN) {
+        if ((result == STORE_RESULT_WHITE_WIN) == is_white) {
+            stats->wins++;
+        } else {
+            stats->losses++;
+        }
+    } else {
+        return 0;                        /* Unfinished results don't count as games */
+    }
+    stats->games++;
+    return 0;
+}
+
+static int index_record(const GameRecord* record) {
+    if (record->white_id[0] && index_game(record->white_id, record->offset, record->result, 1) == -1) {
+        return -1;
+    }
+    if (record->black_id[0] && strcmp(record->black_id, record->white_id) != 0 &&
+        index_game(record->black_id, record->offset, record->result, 0) == -1) {
+        return -1;
+    }
+    record_count++;
+    return 0;
+}
+
+static void free_index(void) {
+    for (uint32_t i = 0; i < user_count; i++) {
+        free(users[i].offsets);
+    }
+    free(users);
+    free(user_slots);
+    users = NULL;
+    user_slots = NULL;
+    user_count = 0;
+    user_capacity = 0;
+    slot_mask = 0;
+    record_count = 0;
+}
+
+/* Index every complete record and cut off a torn tail */
+static int scan_store(uint64_t end) {
+    uint64_t offset = STORE_HEADER_SIZE;
+    file_size = end;
+    if (ensure_mapped() == -1) {
+        return -1;
+    }
+    while (offset + FRAME_OVERHEAD <= end) {
+        uint32_t body_length = get_u32(map_base + offset);
+        if (body_length > end - offset - FRAME_OVERHEAD) {
+            break;
+        }
+        const uint8_t* body = map_base + offset + 4;
+        if (checksum(body, body_length) != get_u32(body + body_length)) {
+            break;
+        }
+        Reader in = { body, body_length, 0, 0 };
+        GameRecord record;
+        if (decode_record(&in, offset, &record) == -1) {
+            break;
+        }
+        if (index_record(&record) == -1) {
+            return -1;
+        }
+        offset += FRAME_OVERHEAD + body_length;
+    }
+
+    if (offset != end) {
+        fprintf(stderr, "Game store: dropping %llu bytes after the last complete record\n",
+                (unsigned long long)(end - offset));
+        if (ftruncate(store_fd, (off_t)offset) == -1) {
+            perror("ftruncate game store");
+            return -1;
+        }
+        file_size = offset;
+    }
+    return 0;
+}
+
+/* ========== Store API ========== */
+
+static void close_locked(void) {
+    if (map_base) {
+        munmap((void*)map_base, map_size);
+    }
+    if (store_fd != -1) {
+        close(store_fd);
+    }
+    map_base = NULL;
+    map_size = 0;
+    store_fd = -1;
+    file_size = 0;
+    free_index();
+}
+
+int game_store_open(const char* path) {
+    pthread_mutex_lock(&store_lock);
+    close_locked();
+
+    store_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (store_fd == -1) {
+        perror("open game store");
+        pthread_mutex_unlock(&store_lock);
+        return -1;
+    }
+
+    int created = 0;
+    struct stat st;
+    if (fstat(store_fd, &st) == -1) {
+        perror("fstat game store");
+        close_locked();
+        pthread_mutex_unlock(&store_lock);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        if (write(store_fd, STORE_MAGIC, STORE_HEADER_SIZE) != STORE_HEADER_SIZE) {
+            perror("write game store");
+            close_locked();
+            pthread_mutex_unlock(&store_lock);
+            return -1;
+        }
+        st.st_size = STORE_HEADER_SIZE;
+        created = 1;
+    }
+
+    char magic[STORE_HEADER_SIZE];
+    if (pread(store_fd, magic, sizeof(magic), 0) != STORE_HEADER_SIZE ||
+        memcmp(magic, STORE_MAGIC, STORE_HEADER_SIZE) != 0) {
+        fprintf(stderr, "Game store: %s is not a game store\n", path);
+        close_locked();
+        pthread_mutex_unlock(&store_lock);
+        return -1;
+    }
+
+    if (scan_store((uint64_t)st.st_size) == -1) {
+        close_locked();
+        pthread_mutex_unlock(&store_lock);
+        return -1;
+    }
+    pthread_mutex_unlock(&store_lock);
+    return created;
+}
+
+void game_store_close(void) {
+    pthread_mutex_lock(&store_lock);
+    close_locked();
+    pthread_mutex_unlock(&store_lock);
+}
+
+int64_t game_store_append(const GameRecord* record, const uint16_t* moves,
+                          const uint32_t* clocks_ms, uint16_t move_count) {
+    if (move_count > STORE_MAX_MOVES || (move_count && !moves) ||
+        !fits(record->status, sizeof(record->status)) ||
+        !fits(record->game_id, sizeof(record->game_id)) ||
+        !fits(record->white_id, sizeof(record->white_id)) ||
+        !fits(record->black_id, sizeof(record->black_id)) ||
+        !fits(record->white_name, sizeof(record->white_name)) ||
+        !fits(record->black_name, sizeof(record->black_name))) {
+        return -1;
+    }
+
+    uint8_t* frame = malloc(FRAME_OVERHEAD + BODY_MAX);
+    if (!frame) {
+        return -1;
+    }
+    size_t body_length = encode_record(record, moves, clocks_ms, move_count, frame + 4);
+    put_u32(frame, (uint32_t)body_length);
+    put_u32(frame + 4 + body_length, checksum(frame + 4, body_length));
+    size_t length = FRAME_OVERHEAD + body_length;
+
+    pthread_mutex_lock(&store_lock);
+    if (store_fd == -1) {
+        pthread_mutex_unlock(&store_lock);
+        free(frame);
+        return -1;
+    }
+
+    uint64_t offset = file_size;
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = write(store_fd, frame + written, length - written);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("write game store");
+            /* Don't leave half a record for the next append to follow */
+            if (ftruncate(store_fd, (off_t)offset) == -1) {
+                perror("ftruncate game store");
+            }
+            pthread_mutex_unlock(&store_lock);
+            free(frame);
+            return -1;
+        }
+        written += (size_t)n;
+    }
+    file_size += length;
+
+    GameRecord indexed = *record;
+    indexed.offset = offset;
+    int result = index_record(&indexed);
+    pthread_mutex_unlock(&store_lock);
+    free(frame);
+    return result == -1 ? -1 : (int64_t)offset;
+}
+
+int game_store_history(const char* user_id, uint32_t skip, GameRecord* out, int max) {
+    pthread_mutex_lock(&store_lock);
+    if (store_fd == -1) {
+        pthread_mutex_unlock(&store_lock);
+        return -1;
+    }
+
+    int written = 0;
+    UserIndex* user = find_user(user_id, 0);
+    if (user) {
+        for (uint32_t i = skip; i < user->count && written < max; i++) {
+            uint64_t offset = user->offsets[user->count - 1 - i];
+            size_t length;
+            const uint8_t* body = record_body(offset, &length);
+            if (!body) {
+                break;
+            }
+            Reader in = { body, length, 0, 0 };
+            if (decode_record(&in, offset, &out[written]) == 0) {
+                written++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&store_lock);
+    return written;
+}
+
+int game_store_stats(const char* user_id, GameStoreStats* stats) {
+    pthread_mutex_lock(&store_lock);
+    if (store_fd == -1) {
+        pthread_mutex_unlock(&store_lock);
+        return -1;
+    }
+    UserIndex* user = find_user(user_id, 0);
+    if (user) {
+        *stats = user->stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+    pthread_mutex_unlock(&store_lock);
+    return 0;
+}
+
+int game_store_moves(uint64_t offset, uint16_t* moves, uint32_t* clocks_ms, int max,
+                     int* clocks_recorded) {
+    pthread_mutex_lock(&store_lock);
+    size_t length;
+    const uint8_t* body = store_fd == -1 ? NULL : record_body(offset, &length);
+    if (!body) {
+        pthread_mutex_unlock(&store_lock);
+        return -1;
+    }
+
+    Reader in = { body, length, 0, 0 };
+    GameRecord record;
+    if (decode_record(&in, offset, &record) == -1) {
+        pthread_mutex_unlock(&store_lock);
+        return -1;
+    }
+    int count = record.move_count < max ? record.move_count : max;
+    for (int i = 0; i < count; i++) {
+        moves[i] = (uint16_t)(body[in.pos + 2 * i] << 8 | body[in.pos + 2 * i + 1]);
+    }
+    in.pos += 2 * (size_t)record.move_count;
+
+    int has_clocks = get_u8(&in);
+    if (clocks_recorded) {
+        *clocks_recorded = has_clocks && clocks_ms != NULL;
+    }
+    if (has_clocks && clocks_ms) {
+        for (int i = 0; i < record.move_count && !in.failed; i++) {
+            uint32_t clock = (uint32_t)get_varint(&in);
+            if (i < count) {
+                clocks_ms[i] = clock;
+            }
+        }
+    }
+    pthread_mutex_unlock(&store_lock);
+    return count;
+}
+
+int64_t game_store_count(void) {
+    pthread_mutex_lock(&store_lock);
+    int64_t count = store_fd == -1 ? -1 : record_count;
+    pthread_mutex_unlock(&store_lock);
+    return count;
+}
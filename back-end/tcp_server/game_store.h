@@ -0,0 +1,87 @@
+#ifndef GAME_STORE_H
+#define GAME_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ========== Append-Only Game Store ========== */
+
+/*
+ * Finished games as compact records in one append-only file, read back
+ * through a shared mapping. A record holds the players, result and times,
+ * the moves as 16-bit Moves (the GAME_STATE_UPDATE encoding) and the
+ * clock after each move as a varint; integers are varints, moves
+ * big-endian. Each record is framed by its length and a checksum, so a
+ * torn append is cut off on the next open.
+ *
+ * Opening the file indexes it by user id: every user keeps the offsets of
+ * their games in play order and running win/loss/draw counts, so history
+ * pages and stats never scan the file. Appends go through write() and the
+ * mapping is grown when a reader reaches past it. All functions lock the
+ * store. Strings longer than the fields below are refused.
+ */
+
+#define STORE_ID_MAX        64           /* game_id and user ids, NUL included */
+#define STORE_NAME_MAX      64           /* Usernames, NUL included */
+#define STORE_MAX_MOVES     2048
+
+enum {
+    STORE_RESULT_WHITE_WIN = 0,
+    STORE_RESULT_BLACK_WIN = 1,
+    STORE_RESULT_DRAW      = 2,
+    STORE_RESULT_UNKNOWN   = 3
+};
+
+#define STORE_FLAG_AI_GAME  0x01
+
+/* A record without its moves; offset names it for game_store_moves() */
+typedef struct {
+    uint64_t offset;
+    uint64_t start_time;                 /* Unix seconds */
+    uint64_t end_time;
+    uint8_t result;                      /* STORE_RESULT_* */
+    uint8_t flags;                       /* STORE_FLAG_* */
+    uint16_t move_count;
+    char status[16];                     /* completed, resigned, draw, timeout... */
+    char game_id[STORE_ID_MAX];
+    char white_id[STORE_ID_MAX];
+    char black_id[STORE_ID_MAX];
+    char white_name[STORE_NAME_MAX];
+    char black_name[STORE_NAME_MAX];
+} GameRecord;
+
+typedef struct {
+    uint32_t games;
+    uint32_t wins;
+    uint32_t losses;
+    uint32_t draws;
+} GameStoreStats;
+
+/* Open (creating it if needed) and index the store. Returns 0 for an
+ * existing file, 1 for a new one, -1 on error. Reopening closes the
+ * previous store first. */
+int game_store_open(const char* path);
+void game_store_close(void);
+
+/* Append a finished game. clocks_ms may be NULL, otherwise it holds one
+ * remaining time per move. Returns the record's offset, or -1. */
+int64_t game_store_append(const GameRecord* record, const uint16_t* moves,
+                          const uint32_t* clocks_ms, uint16_t move_count);
+
+/* A user's games, newest first, skipping the newest 'skip'. Returns the
+ * records written (0 for an unknown user), -1 without a store. */
+int game_store_history(const char* user_id, uint32_t skip, GameRecord* out, int max);
+
+/* A user's aggregates; zeroes for an unknown user. -1 without a store. */
+int game_store_stats(const char* user_id, GameStoreStats* stats);
+
+/* The moves (and clocks, if recorded and clocks_ms isn't NULL) of the
+ * record at offset. Returns the moves written, clocks_recorded tells
+ * whether clocks were filled; -1 for a bad offset. */
+int game_store_moves(uint64_t offset, uint16_t* moves, uint32_t* clocks_ms, int max,
+                     int* clocks_recorded);
+
+/* Records in the store, -1 without one */
+int64_t game_store_count(void);
+
+#endif /* GAME_STORE_H */
@@ -0,0 +1,138 @@
+#define _POSIX_C_SOURCE 200809L                  /* clock_gettime() under -std=c11 */
+#include "metrics.h"
+#include <time.h>
+
+/* ========== Message Table ========== */
+
+typedef struct {
+    _Atomic uint32_t key;                        /* message_id + 1, 0 while free */
+    _Atomic uint64_t received;
+    _Atomic uint64_t received_bytes;
+    _Atomic uint64_t sent;
+    _Atomic uint64_t sent_bytes;
+    AtomicHistogram latency;
+} MessageSlot;
+
+static const uint64_t latency_bounds[METRICS_LATENCY_BUCKETS - 1] = { METRICS_LATENCY_BOUNDS_US };
+
+/* The table, then the METRICS_OTHER_ID slot */
+static MessageSlot message_slots[METRICS_MESSAGE_SLOTS + 1];
+
+_Static_assert((METRICS_MESSAGE_SLOTS & (METRICS_MESSAGE_SLOTS - 1)) == 0,
+               "slot count must be a power of two");
+
+uint64_t metrics_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* Find or claim the slot of an id; ids beyond a full table share the last */
+static MessageSlot* message_slot(uint16_t message_id) {
+    uint32_t key = (uint32_t)message_id + 1;
+    uint32_t start = (key * 2654435761u) >> 16 & (METRICS_MESSAGE_SLOTS - 1);
+
+    for (uint32_t n = 0; n < METRICS_MESSAGE_SLOTS; n++) {
+        MessageSlot* slot = &message_slots[(start + n) & (METRICS_MESSAGE_SLOTS - 1)];
+        uint32_t current = atomic_load_explicit(&slot->key, memory_order_acquire);
+        if (current == 0) {
+            uint32_t expected = 0;
+            if (atomic_compare_exchange_strong(&slot->key, &expected, key)) {
+                return slot;
+            }
+            current = expected; /* Claimed meanwhile, maybe for this id */
+        }
+        if (current == key) {
+            return slot;
+        }
+    }
+    return &message_slots[METRICS_MESSAGE_SLOTS];
+}
+
+static void add(_Atomic uint64_t* counter, uint64_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+static uint64_t load(_Atomic uint64_t* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void metrics_count_received(uint16_t message_id, uint32_t bytes) {
+    MessageSlot* slot = message_slot(message_id);
+    add(&slot->received, 1);
+    add(&slot->received_bytes, bytes);
+}
+
+void metrics_count_sent(uint16_t message_id, uint32_t bytes) {
+    MessageSlot* slot = message_slot(message_id);
+    add(&slot->sent, 1);
+    add(&slot->sent_bytes, bytes);
+}
+
+void metrics_record_reply(uint16_t request_id, uint64_t latency_us) {
+    histogram_record(&message_slot(request_id)->latency, latency_us);
+}
+
+/* ========== Histograms ========== */
+
+void histogram_record(AtomicHistogram* histogram, uint64_t value_us) {
+    int bucket = 0;
+    while (bucket < METRICS_LATENCY_BUCKETS - 1 && value_us > latency_bounds[bucket]) {
+        bucket++;
+    }
+    add(&histogram->buckets[bucket], 1);
+    add(&histogram->total_us, value_us);
+    add(&histogram->count, 1);
+
+    uint64_t max = load(&histogram->max_us);
+    while (value_us > max &&
+           !atomic_compare_exchange_weak_explicit(&histogram->max_us, &max, value_us,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void histogram_read(AtomicHistogram* histogram, LatencyHistogram* out) {
+    out->count = load(&histogram->count);
+    out->total_us = load(&histogram->total_us);
+    out->max_us = load(&histogram->max_us);
+    for (int b = 0; b < METRICS_LATENCY_BUCKETS; b++) {
+        out->buckets[b] = load(&histogram->buckets[b]);
+    }
+}
+
+void histogram_reset_peak(AtomicHistogram* histogram) {
+    atomic_store_explicit(&histogram->max_us, 0, memory_order_relaxed);
+}
+
+/* ========== Readers ========== */
+
+static void read_slot(MessageSlot* slot, uint16_t message_id, MessageMetrics* out) {
+    out->message_id = message_id;
+    out->received = load(&slot->received);
+    out->received_bytes = load(&slot->received_bytes);
+    out->sent = load(&slot->sent);
+    out->sent_bytes = load(&slot->sent_bytes);
+    histogram_read(&slot->latency, &out->latency);
+}
+
+int server_message_metrics(MessageMetrics* out, int max) {
+    int count = 0;
+    for (int i = 0; i < METRICS_MESSAGE_SLOTS && count < max; i++) {
+        uint32_t key = atomic_load_explicit(&message_slots[i].key, memory_order_acquire);
+        if (key != 0) {
+            read_slot(&message_slots[i], (uint16_t)(key - 1), &out[count++]);
+        }
+    }
+
+    MessageSlot* other = &message_slots[METRICS_MESSAGE_SLOTS];
+    if (count < max && (load(&other->received) || load(&other->sent) || load(&other->latency.count))) {
+        read_slot(other, METRICS_OTHER_ID, &out[count++]);
+    }
+    return count;
+}
+
+void metrics_reset_message_peaks(void) {
+    for (int i = 0; i <= METRICS_MESSAGE_SLOTS; i++) {
+        histogram_reset_peak(&message_slots[i].latency);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/* ========== Server Metrics ========== */
+
+/*
+ * Counters for scraping while the server runs. Per message id the server
+ * counts frames and wire bytes in each direction, and how long requests
+ * took from being queued as an event to the next send_message() to the
+ * same client (a request that arrives while its client still waits on
+ * another isn't timed). Ids share a fixed open-addressed table whose
+ * slots are claimed with a compare-and-swap; once it is full, further ids
+ * are counted under METRICS_OTHER_ID. Per shard the reactor keeps event
+ * queue depth and drops, the send queue high-water mark, slow consumers
+ * dropped and the time each poll iteration spent outside its wait.
+ *
+ * Every counter is a relaxed atomic: recording never takes a lock and the
+ * readers below may run on any thread (not across server_shutdown()).
+ * Counters only grow; server_reset_metrics_peaks() restarts the maxima.
+ */
+
+#define METRICS_MESSAGE_SLOTS   128          /* Distinct message ids tracked */
+#define METRICS_OTHER_ID        0xFFFF       /* Ids that found the table full */
+
+/* Latency histograms: bucket i counts values <= bound i (microseconds),
+ * the last bucket everything above */
+#define METRICS_LATENCY_BUCKETS 15
+#define METRICS_LATENCY_BOUNDS_US \
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t max_us;                     /* Since the last peak reset */
+    uint64_t buckets[METRICS_LATENCY_BUCKETS];
+} LatencyHistogram;
+
+typedef struct {
+    uint16_t message_id;                 /* Flags stripped */
+    uint64_t received;                   /* Frames from clients */
+    uint64_t received_bytes;             /* Header included */
+    uint64_t sent;                       /* Frames to clients, one per recipient */
+    uint64_t sent_bytes;                 /* On the wire, after compression */
+    LatencyHistogram latency;            /* Requests of this id, queued to reply */
+} MessageMetrics;
+
+typedef struct {
+    uint64_t events_queued;              /* Waiting in the event queue now */
+    uint64_t events_queued_max;
+    uint64_t events_pushed;
+    uint64_t events_dropped;             /* Lost to an unavailable queue */
+    uint64_t send_queue_max;             /* Most bytes one session had queued */
+    uint64_t slow_consumers;             /* Sessions closed over SEND_HIGH_WATER */
+    LatencyHistogram iteration;          /* Poll iteration time, wait excluded */
+} ShardMetrics;
+
+/* Recording side (the server). AtomicHistogram is the live form of a
+ * LatencyHistogram; the shards keep their iteration times in one. */
+uint64_t metrics_now_us(void);
+void metrics_count_received(uint16_t message_id, uint32_t bytes);
+void metrics_count_sent(uint16_t message_id, uint32_t bytes);
+void metrics_record_reply(uint16_t request_id, uint64_t latency_us);
+void metrics_reset_message_peaks(void);
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t total_us;
+    _Atomic uint64_t max_us;
+    _Atomic uint64_t buckets[METRICS_LATENCY_BUCKETS];
+} AtomicHistogram;
+
+void histogram_record(AtomicHistogram* histogram, uint64_t value_us);
+void histogram_read(AtomicHistogram* histogram, LatencyHistogram* out);
+void histogram_reset_peak(AtomicHistogram* histogram);
+
+/* Reading side. server_message_metrics() fills up to max entries, one per
+ * id seen, and returns how many; server_shard_metrics() returns -1 for a
+ * shard that doesn't exist. */
+int server_message_metrics(MessageMetrics* out, int max);
+int server_shard_metrics(int shard, ShardMetrics* out);
+void server_reset_metrics_peaks(void);
+
+#endif /* METRICS_H */
@@ -0,0 +1,128 @@
+"""
+Metrics Exporter - the C server's metrics in the Prometheus text format
+NetworkManager.metrics() reads the native counters without locking, so the
+exporter answers scrapes on its own thread while the event loop runs.
+The maxima (*_max gauges) cover the time since the previous scrape.
+"""
+
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Any, Dict, List
+
+
+CONTENT_TYPE = 'text/plain; version=0.0.4; charset=utf-8'
+
+
+def _labels(**labels) -> str:
+    return '{' + ','.join(f'{key}="{value}"' for key, value in labels.items()) + '}'
+
+
+def _histogram(lines: List[str], name: str, histogram: Dict[str, Any], bounds: List[int],
+               labels: Dict[str, str]):
+    """Emit a microsecond histogram as cumulative buckets in seconds"""
+    cumulative = 0
+    for bound, count in zip(bounds, histogram['buckets']):
+        cumulative += count
+        lines.append(f'{name}_bucket{_labels(**labels, le=bound / 1e6)} {cumulative}')
+    lines.append(f'{name}_bucket{_labels(**labels, le="+Inf")} {histogram["count"]}')
+    lines.append(f'{name}_sum{_labels(**labels)} {histogram["total_us"] / 1e6}')
+    lines.append(f'{name}_count{_labels(**labels)} {histogram["count"]}')
+
+
+def render(metrics: Dict[str, Any], clients: int) -> str:
+    """Format a NetworkManager.metrics() snapshot"""
+    bounds = metrics['latency_bounds_us']
+    lines = [
+        '# HELP chess_clients Connected clients',
+        '# TYPE chess_clients gauge',
+        f'chess_clients {clients}'
+    ]
+
+    counters = [
+        ('chess_messages_received_total', 'received', 'Frames received from clients'),
+        ('chess_message_received_bytes_total', 'received_bytes', 'Bytes received, headers included'),
+        ('chess_messages_sent_total', 'sent', 'Frames sent, one per recipient'),
+        ('chess_message_sent_bytes_total', 'sent_bytes', 'Bytes sent after compression')
+    ]
+    for name, key, text in counters:
+        lines += [f'# HELP {name} {text}', f'# TYPE {name} counter']
+        for message in metrics['messages']:
+            lines.append(f'{name}{_labels(type=message["name"])} {message[key]}')
+
+    lines += ['# HELP chess_request_latency_seconds Request queued as an event until the next reply to its client',
+              '# TYPE chess_request_latency_seconds histogram']
+    for message in metrics['messages']:
+        if message['latency']['count']:
+            _histogram(lines, 'chess_request_latency_seconds', message['latency'], bounds,
+                       {'type': message['name']})
+    lines += ['# HELP chess_request_latency_max_seconds Slowest request since the last scrape',
+              '# TYPE chess_request_latency_max_seconds gauge']
+    for message in metrics['messages']:
+        if message['latency']['count']:
+            lines.append(f'chess_request_latency_max_seconds{_labels(type=message["name"])} '
+                         f'{message["latency"]["max_us"] / 1e6}')
+
+    gauges = [
+        ('chess_event_queue_depth', 'events_queued', 'gauge', 'Events waiting for Python'),
+        ('chess_event_queue_depth_max', 'events_queued_max', 'gauge', 'Deepest event queue since the last scrape'),
+        ('chess_events_total', 'events_pushed', 'counter', 'Events queued'),
+        ('chess_events_dropped_total', 'events_dropped', 'counter', 'Events lost to an unavailable queue'),
+        ('chess_send_queue_max_bytes', 'send_queue_max', 'gauge', 'Most bytes one client had queued since the last scrape'),
+        ('chess_slow_consumers_total', 'slow_consumers', 'counter', 'Clients closed for exceeding the send high-water mark')
+    ]
+    for name, key, kind, text in gauges:
+        lines += [f'# HELP {name} {text}', f'# TYPE {name} {kind}']
+        for index, shard in enumerate(metrics['shards']):
+            lines.append(f'{name}{_labels(shard=index)} {shard[key]}')
+
+    lines += ['# HELP chess_poll_iteration_seconds Reactor iteration time outside the wait',
+              '# TYPE chess_poll_iteration_seconds histogram']
+    for index, shard in enumerate(metrics['shards']):
+        _histogram(lines, 'chess_poll_iteration_seconds', shard['iteration'], bounds,
+                   {'shard': str(index)})
+    lines += ['# HELP chess_poll_iteration_max_seconds Longest iteration since the last scrape',
+              '# TYPE chess_poll_iteration_max_seconds gauge']
+    for index, shard in enumerate(metrics['shards']):
+        lines.append(f'chess_poll_iteration_max_seconds{_labels(shard=index)} {shard["iteration"]["max_us"] / 1e6}')
+
+    return '\n'.join(lines) + '\n'
+
+
+class MetricsServer:
+    """Serves /metrics for a NetworkManager on a daemon thread"""
+
+    def __init__(self, network, port: int, host: str = '0.0.0.0'):
+        self.network = network
+
+        exporter = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self):
+                if self.path.split('?')[0] != '/metrics':
+                    self.send_error(404)
+                    return
+                body = exporter.scrape().encode('utf-8')
+                self.send_response(200)
+                self.send_header('Content-Type', CONTENT_TYPE)
+                self.send_header('Content-Length', str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, format, *args):
+                pass
+
+        self.httpd = ThreadingHTTPServer((host, port), Handler)
+        self.httpd.daemon_threads = True
+        self.thread = threading.Thread(target=self.httpd.serve_forever, daemon=True)
+
+    def scrape(self) -> str:
+        return render(self.network.metrics(reset_peaks=True), self.network.get_client_count())
+
+    def start(self):
+        self.thread.start()
+        print(f"✓ Metrics on http://{self.httpd.server_address[0]}:{self.httpd.server_address[1]}/metrics")
+
+    def stop(self):
+        """Stop serving; call before the network is shut down"""
+        self.httpd.shutdown()
+        self.httpd.server_close()
@@ -4,6 +4,7 @@ This module provides a Python interface to the C TCP server using ctypes.
 """
 
 import ctypes
+import itertools
 import json
 import os
 import sys
@@ -19,7 +20,7 @@ from database import get_db_connection, init_db
 from services.user_service import create_user, verify_user, get_user_by_username
 from services.game_service import (
     create_game, get_game, update_game_state, end_game,
-    get_user_game_history, get_user_stats, validate_move, get_game_pgn
+    get_user_game_history, get_user_stats, validate_move, get_game_pgn, init_game_store
 )
 
 
@@ -43,6 +44,9 @@ class MessageTypeC2S(IntEnum):
     DECLINE_CHALLENGE = 0x0027
     GET_STATS = 0x0030
     GET_HISTORY = 0x0031
+    SPECTATE = 0x0040
+    STOP_SPECTATING = 0x0041
+    SET_COMPRESSION = 0x0050  # Handled by the server itself, never an event
 
 
 class MessageTypeS2C(IntEnum):
@@ -61,8 +65,11 @@ class MessageTypeS2C(IntEnum):
     CHALLENGE_RECEIVED = 0x1205
     CHALLENGE_ACCEPTED = 0x1206
     CHALLENGE_DECLINED = 0x1207
+    OPPONENT_MOVE = 0x1208
     STATS_RESPONSE = 0x1300
     HISTORY_RESPONSE = 0x1301
+    SPECTATE_KEYFRAME = 0x1400  # Always binary
+    SPECTATE_DELTA = 0x1401     # Always binary
 
 
 class EventType(IntEnum):
@@ -71,6 +78,9 @@ class EventType(IntEnum):
     CLIENT_DISCONNECTED = 2
     MESSAGE_RECEIVED = 3
     ERROR = 4
+    FLAG_FALL = 5
+    IDLE_TIMEOUT = 6
+    HEARTBEAT = 7
 
 
 class ClientState(IntEnum):
@@ -92,6 +102,43 @@ class MessageHeader(ctypes.Structure):
     ]
 
 
+# Events drained per server_poll_batch() call
+EVENT_BATCH_SIZE = 256
+
+# Binary payload encoding (see protocol.h)
+MSG_FLAG_BINARY = 0x8000
+EVENT_FLAG_BINARY = 0x0002
+EVENT_FLAG_RELAYED = 0x0004
+EVENT_FLAG_CLOCK_SWITCHED = 0x0008
+STATE_FLAG_BLACK_TO_MOVE = 0x01
+STATE_FLAG_IN_CHECK = 0x02
+STATE_FLAG_GAME_OVER = 0x04
+BINARY_GAME_ID_MAX = 64
+BINARY_FEN_MAX = 100
+SPECTATOR_KEYFRAME_PLIES = 16  # Must stay below SPECTATOR_DELTA_LOG in protocol.h
+
+
+class MovePayload(ctypes.Structure):
+    """Decoded binary MAKE_MOVE payload"""
+    _fields_ = [
+        ("move", ctypes.c_uint16),
+        ("clock_ms", ctypes.c_uint32),
+        ("game_id", ctypes.c_char * BINARY_GAME_ID_MAX)
+    ]
+
+
+class GameStatePayload(ctypes.Structure):
+    """Binary GAME_STATE_UPDATE payload before encoding"""
+    _fields_ = [
+        ("last_move", ctypes.c_uint16),
+        ("flags", ctypes.c_uint8),
+        ("white_ms", ctypes.c_uint32),
+        ("black_ms", ctypes.c_uint32),
+        ("game_id", ctypes.c_char * BINARY_GAME_ID_MAX),
+        ("fen", ctypes.c_char * BINARY_FEN_MAX)
+    ]
+
+
 class NetworkEvent(ctypes.Structure):
     """Network event structure"""
     _fields_ = [
@@ -99,7 +146,19 @@ class NetworkEvent(ctypes.Structure):
         ("client_fd", ctypes.c_int),
         ("message_id", ctypes.c_uint16),
         ("payload_length", ctypes.c_uint32),
-        ("payload_data", ctypes.POINTER(ctypes.c_uint8))
+        ("payload_data", ctypes.POINTER(ctypes.c_uint8)),
+        ("flags", ctypes.c_uint32)
+    ]
+
+
+class Timer(ctypes.Structure):
+    """Session timer, linked into the reactor's timer wheel"""
+    _fields_ = [
+        ("next", ctypes.c_void_p),
+        ("pprev", ctypes.c_void_p),
+        ("deadline", ctypes.c_uint64),
+        ("level", ctypes.c_uint8),
+        ("slot", ctypes.c_uint8)
     ]
 
 
@@ -108,17 +167,122 @@ class ClientSession(ctypes.Structure):
     _fields_ = [
         ("fd", ctypes.c_int),
         ("state", ctypes.c_int),
-        ("recv_buffer", ctypes.c_uint8 * 65536),
+        ("recv_buffer", ctypes.POINTER(ctypes.c_uint8)),
+        ("recv_capacity", ctypes.c_size_t),
+        ("recv_start", ctypes.c_size_t),
         ("recv_offset", ctypes.c_size_t),
-        ("send_buffer", ctypes.c_uint8 * 65536),
-        ("send_offset", ctypes.c_size_t),
-        ("send_length", ctypes.c_size_t),
+        ("views_pending", ctypes.c_int),
+        ("read_deferred", ctypes.c_int),
+        ("send_queue_head", ctypes.c_void_p),
+        ("send_queue_tail", ctypes.c_void_p),
+        ("send_queue_bytes", ctypes.c_size_t),
+        ("want_write", ctypes.c_int),
         ("username", ctypes.c_char * 64),
         ("user_id", ctypes.c_uint32),
-        ("game_id", ctypes.c_int)
+        ("game_id", ctypes.c_int),
+        ("peer_fd", ctypes.c_int),
+        ("speaks_binary", ctypes.c_int),
+        ("last_active_ms", ctypes.c_uint64),
+        ("heartbeat_due_ms", ctypes.c_uint64),
+        ("activity_timer", Timer),
+        ("clock_timer", Timer),
+        ("clock_ms", ctypes.c_uint32),
+        ("increment_ms", ctypes.c_uint32),
+        ("has_clock", ctypes.c_int),
+        ("serial", ctypes.c_uint32),
+        ("compression", ctypes.c_int),
+        ("deflater", ctypes.c_void_p),
+        ("request_us", ctypes.c_uint64),
+        ("request_id", ctypes.c_uint16)
+    ]
+
+
+ACCEPT_LATENCY_BUCKETS = 5  # Backlog waits < 1, < 10, < 100, < 1000, >= 1000 ms
+
+
+class AcceptStats(ctypes.Structure):
+    """Accept counters summed over the shards"""
+    _fields_ = [
+        ("accepted", ctypes.c_uint64),
+        ("rejected", ctypes.c_uint64),
+        ("batches", ctypes.c_uint64),
+        ("max_batch", ctypes.c_uint32),
+        ("latency_max_ms", ctypes.c_uint32),
+        ("latency_total_ms", ctypes.c_uint64),
+        ("latency_buckets", ctypes.c_uint64 * ACCEPT_LATENCY_BUCKETS)
+    ]
+
+
+class CompressionStats(ctypes.Structure):
+    """Compressed replies summed over the shards"""
+    _fields_ = [
+        ("messages", ctypes.c_uint64),
+        ("bytes_in", ctypes.c_uint64),
+        ("bytes_out", ctypes.c_uint64)
+    ]
+
+
+METRICS_MESSAGE_SLOTS = 128
+METRICS_OTHER_ID = 0xFFFF
+METRICS_LATENCY_BOUNDS_US = (50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000,
+                             50000, 100000, 250000, 500000, 1000000)
+METRICS_LATENCY_BUCKETS = len(METRICS_LATENCY_BOUNDS_US) + 1  # Last one is +Inf
+
+
+class LatencyHistogram(ctypes.Structure):
+    """LatencyHistogram: counts per METRICS_LATENCY_BOUNDS_US bucket, not cumulative"""
+    _fields_ = [
+        ("count", ctypes.c_uint64),
+        ("total_us", ctypes.c_uint64),
+        ("max_us", ctypes.c_uint64),
+        ("buckets", ctypes.c_uint64 * METRICS_LATENCY_BUCKETS)
+    ]
+
+
+class MessageMetrics(ctypes.Structure):
+    """MessageMetrics: traffic and request latency of one message id"""
+    _fields_ = [
+        ("message_id", ctypes.c_uint16),
+        ("received", ctypes.c_uint64),
+        ("received_bytes", ctypes.c_uint64),
+        ("sent", ctypes.c_uint64),
+        ("sent_bytes", ctypes.c_uint64),
+        ("latency", LatencyHistogram)
     ]
 
 
+class ShardMetrics(ctypes.Structure):
+    """ShardMetrics: one reactor's queues and poll iterations"""
+    _fields_ = [
+        ("events_queued", ctypes.c_uint64),
+        ("events_queued_max", ctypes.c_uint64),
+        ("events_pushed", ctypes.c_uint64),
+        ("events_dropped", ctypes.c_uint64),
+        ("send_queue_max", ctypes.c_uint64),
+        ("slow_consumers", ctypes.c_uint64),
+        ("iteration", LatencyHistogram)
+    ]
+
+
+def _histogram(histogram: LatencyHistogram) -> Dict[str, Any]:
+    return {
+        'count': histogram.count,
+        'total_us': histogram.total_us,
+        'max_us': histogram.max_us,
+        'buckets': list(histogram.buckets)
+    }
+
+
+def ply_from_fen(fen: str) -> int:
+    """Half-moves played before a FEN position, from its fullmove number and side to move"""
+    fields = fen.split()
+    try:
+        fullmove = int(fields[5])
+    except (IndexError, ValueError):
+        return 0
+    return max(fullmove - 1, 0) * 2 + (1 if fields[1] == 'b' else 0)
+
+
 # ========== Network Manager Class ==========
 
 class NetworkManager:
@@ -150,8 +314,14 @@ class NetworkManager:
         # Message handlers
         self.handlers: Dict[int, Callable] = {}
         
+        # Timer event handlers (flag fall, idle timeout, heartbeat)
+        self.event_handlers: Dict[int, Callable] = {}
+        
         # Client session tracking
         self.client_sessions: Dict[int, Dict[str, Any]] = {}
+        
+        # Reusable array for draining events in batches
+        self.event_batch = (NetworkEvent * EVENT_BATCH_SIZE)()
     
     def _setup_function_signatures(self):
         """Setup ctypes function signatures for C library"""
@@ -160,6 +330,60 @@ class NetworkManager:
         self.lib.server_init.argtypes = [ctypes.c_int]
         self.lib.server_init.restype = ctypes.c_int
         
+        # int server_init_shards(int port, int shards)
+        self.lib.server_init_shards.argtypes = [ctypes.c_int, ctypes.c_int]
+        self.lib.server_init_shards.restype = ctypes.c_int
+        
+        # int server_shard_count(void) / int server_client_shard(int client_fd)
+        self.lib.server_shard_count.argtypes = []
+        self.lib.server_shard_count.restype = ctypes.c_int
+        self.lib.server_client_shard.argtypes = [ctypes.c_int]
+        self.lib.server_client_shard.restype = ctypes.c_int
+        
+        # int server_pin_clients(const int* client_fds, int count)
+        self.lib.server_pin_clients.argtypes = [ctypes.POINTER(ctypes.c_int), ctypes.c_int]
+        self.lib.server_pin_clients.restype = ctypes.c_int
+        
+        # int server_route_game(int white_fd, int black_fd) / void server_unroute_game(int client_fd)
+        self.lib.server_route_game.argtypes = [ctypes.c_int, ctypes.c_int]
+        self.lib.server_route_game.restype = ctypes.c_int
+        self.lib.server_unroute_game.argtypes = [ctypes.c_int]
+        self.lib.server_unroute_game.restype = None
+        
+        # Idle timeouts, heartbeats and game clocks (timer wheel)
+        self.lib.server_set_timeouts.argtypes = [ctypes.c_int, ctypes.c_int]
+        self.lib.server_set_timeouts.restype = None
+        self.lib.server_set_clock.argtypes = [ctypes.c_int, ctypes.c_uint32, ctypes.c_uint32]
+        self.lib.server_set_clock.restype = ctypes.c_int
+        self.lib.server_start_clock.argtypes = [ctypes.c_int]
+        self.lib.server_start_clock.restype = ctypes.c_int
+        self.lib.server_stop_clock.argtypes = [ctypes.c_int]
+        self.lib.server_stop_clock.restype = ctypes.c_int64
+        self.lib.server_clock_remaining.argtypes = [ctypes.c_int]
+        self.lib.server_clock_remaining.restype = ctypes.c_int64
+        self.lib.server_switch_clock.argtypes = [ctypes.c_int, ctypes.c_int]
+        self.lib.server_switch_clock.restype = ctypes.c_int
+        self.lib.server_undo_switch.argtypes = [ctypes.c_int, ctypes.c_int]
+        self.lib.server_undo_switch.restype = ctypes.c_int
+        
+        # Listen backlog and accept counters
+        self.lib.server_set_backlog.argtypes = [ctypes.c_int]
+        self.lib.server_set_backlog.restype = ctypes.c_int
+        self.lib.server_accept_stats.argtypes = [ctypes.POINTER(AcceptStats)]
+        self.lib.server_accept_stats.restype = None
+        self.lib.server_reset_accept_stats.argtypes = []
+        self.lib.server_reset_accept_stats.restype = None
+        self.lib.server_compression_stats.argtypes = [ctypes.POINTER(CompressionStats)]
+        self.lib.server_compression_stats.restype = None
+        
+        # Metrics (lock-free, callable from any thread)
+        self.lib.server_message_metrics.argtypes = [ctypes.POINTER(MessageMetrics), ctypes.c_int]
+        self.lib.server_message_metrics.restype = ctypes.c_int
+        self.lib.server_shard_metrics.argtypes = [ctypes.c_int, ctypes.POINTER(ShardMetrics)]
+        self.lib.server_shard_metrics.restype = ctypes.c_int
+        self.lib.server_reset_metrics_peaks.argtypes = []
+        self.lib.server_reset_metrics_peaks.restype = None
+        
         # void server_shutdown(void)
         self.lib.server_shutdown.argtypes = []
         self.lib.server_shutdown.restype = None
@@ -168,6 +392,10 @@ class NetworkManager:
         self.lib.server_poll.argtypes = [ctypes.c_int]
         self.lib.server_poll.restype = ctypes.c_int
         
+        # const char* server_backend_name(void)
+        self.lib.server_backend_name.argtypes = []
+        self.lib.server_backend_name.restype = ctypes.c_char_p
+        
         # int send_message(int client_fd, uint16_t message_id, const uint8_t* payload, uint32_t payload_length)
         self.lib.send_message.argtypes = [
             ctypes.c_int,
@@ -177,6 +405,16 @@ class NetworkManager:
         ]
         self.lib.send_message.restype = ctypes.c_int
         
+        # int send_broadcast(const int* client_fds, int count, uint16_t message_id, const uint8_t* payload, uint32_t payload_length)
+        self.lib.send_broadcast.argtypes = [
+            ctypes.POINTER(ctypes.c_int),
+            ctypes.c_int,
+            ctypes.c_uint16,
+            ctypes.POINTER(ctypes.c_uint8),
+            ctypes.c_uint32
+        ]
+        self.lib.send_broadcast.restype = ctypes.c_int
+        
         # NetworkEvent* get_next_event(void)
         self.lib.get_next_event.argtypes = []
         self.lib.get_next_event.restype = ctypes.POINTER(NetworkEvent)
@@ -185,6 +423,20 @@ class NetworkManager:
         self.lib.free_event.argtypes = [ctypes.POINTER(NetworkEvent)]
         self.lib.free_event.restype = None
         
+        # int server_poll_batch(NetworkEvent* out, int max)
+        self.lib.server_poll_batch.argtypes = [ctypes.POINTER(NetworkEvent), ctypes.c_int]
+        self.lib.server_poll_batch.restype = ctypes.c_int
+        
+        # void free_event_batch(NetworkEvent* events, int count)
+        self.lib.free_event_batch.argtypes = [ctypes.POINTER(NetworkEvent), ctypes.c_int]
+        self.lib.free_event_batch.restype = None
+        
+        # int server_start_thread(int timeout_ms) / void server_stop_thread(void)
+        self.lib.server_start_thread.argtypes = [ctypes.c_int]
+        self.lib.server_start_thread.restype = ctypes.c_int
+        self.lib.server_stop_thread.argtypes = []
+        self.lib.server_stop_thread.restype = None
+        
         # ClientSession* get_client_session(int client_fd)
         self.lib.get_client_session.argtypes = [ctypes.c_int]
         self.lib.get_client_session.restype = ctypes.POINTER(ClientSession)
@@ -200,20 +452,57 @@ class NetworkManager:
         # const char* get_message_type_name(uint16_t message_id)
         self.lib.get_message_type_name.argtypes = [ctypes.c_uint16]
         self.lib.get_message_type_name.restype = ctypes.c_char_p
+        
+        # Binary payload codec
+        self.lib.move_from_uci.argtypes = [ctypes.c_char_p]
+        self.lib.move_from_uci.restype = ctypes.c_uint16
+        self.lib.move_to_uci.argtypes = [ctypes.c_uint16, ctypes.c_char_p]
+        self.lib.move_to_uci.restype = ctypes.c_int
+        self.lib.decode_move_payload.argtypes = [
+            ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint32, ctypes.POINTER(MovePayload)
+        ]
+        self.lib.decode_move_payload.restype = ctypes.c_int
+        self.lib.encode_game_state_payload.argtypes = [
+            ctypes.POINTER(GameStatePayload), ctypes.POINTER(ctypes.c_uint8), ctypes.c_size_t
+        ]
+        self.lib.encode_game_state_payload.restype = ctypes.c_int
+        
+        # Spectator streams
+        self.lib.server_stream_keyframe.argtypes = [
+            ctypes.c_char_p, ctypes.c_uint16, ctypes.POINTER(GameStatePayload)
+        ]
+        self.lib.server_stream_keyframe.restype = ctypes.c_int
+        self.lib.server_stream_move.argtypes = [
+            ctypes.c_char_p, ctypes.c_uint16, ctypes.c_uint16, ctypes.c_uint8,
+            ctypes.c_uint32, ctypes.c_uint32
+        ]
+        self.lib.server_stream_move.restype = ctypes.c_int
+        self.lib.server_stream_close.argtypes = [ctypes.c_char_p]
+        self.lib.server_stream_close.restype = None
+        self.lib.server_stream_watchers.argtypes = [ctypes.c_char_p]
+        self.lib.server_stream_watchers.restype = ctypes.c_int
+        self.lib.server_spectate.argtypes = [ctypes.c_int, ctypes.c_char_p]
+        self.lib.server_spectate.restype = ctypes.c_int
+        self.lib.server_unspectate.argtypes = [ctypes.c_int, ctypes.c_char_p]
+        self.lib.server_unspectate.restype = ctypes.c_int
     
-    def start(self, port: int) -> bool:
+    def start(self, port: int, shards: int = 1, backlog: int = 0) -> bool:
         """
         Start the TCP server on the specified port.
         
         Args:
             port: Port number to listen on
+            shards: Number of reactors sharing the port (SO_REUSEPORT)
+            backlog: Pending connections queued per listener (0: SOMAXCONN)
             
         Returns:
             True if server started successfully, False otherwise
         """
-        result = self.lib.server_init(port)
+        self.lib.server_set_backlog(backlog)
+        result = self.lib.server_init_shards(port, shards)
         if result == 0:
-            print(f"✓ TCP Server started on port {port}")
+            backend = self.lib.server_backend_name().decode('utf-8')
+            print(f"✓ TCP Server started on port {port} ({backend} backend, {shards} shard(s))")
             return True
         else:
             print(f"✗ Failed to start TCP server on port {port}")
@@ -266,6 +555,160 @@ class NetworkManager:
         
         return result > 0
     
+    def broadcast_to_clients(self, client_fds, message_type: int, data: Dict[str, Any]) -> int:
+        """
+        Send the same message to several clients.
+        
+        The payload is JSON encoded and framed once, however many
+        recipients there are.
+        
+        Args:
+            client_fds: Iterable of client file descriptors
+            message_type: Message type ID (from MessageTypeS2C)
+            data: Dictionary containing message data (will be JSON encoded)
+            
+        Returns:
+            Number of clients the message was delivered or queued to
+        """
+        fds = list(client_fds)
+        if not fds:
+            return 0
+        
+        payload_bytes = json.dumps(data).encode('utf-8')
+        payload_length = len(payload_bytes)
+        payload_array = (ctypes.c_uint8 * payload_length).from_buffer_copy(payload_bytes)
+        fd_array = (ctypes.c_int * len(fds))(*fds)
+        
+        result = self.lib.send_broadcast(
+            fd_array,
+            len(fds),
+            message_type,
+            payload_array,
+            payload_length
+        )
+        
+        return max(result, 0)
+    
+    def broadcast_game_state(self, client_fds, state: Dict[str, Any]) -> int:
+        """
+        Send a GAME_STATE_UPDATE to several clients.
+        
+        Clients that talk binary get the compact encoding, the rest get
+        JSON; each form is framed once.
+        
+        Args:
+            client_fds: Iterable of client file descriptors
+            state: game_id, fen, last_move, turn, in_check, game_over and
+                   optionally white_time_ms / black_time_ms
+            
+        Returns:
+            Number of clients the update was delivered or queued to
+        """
+        binary_fds, json_fds = [], []
+        for fd in client_fds:
+            session = self.client_sessions.get(fd, {})
+            (binary_fds if session.get('binary_payloads') else json_fds).append(fd)
+        
+        delivered = self.broadcast_to_clients(json_fds, MessageTypeS2C.GAME_STATE_UPDATE, state)
+        if not binary_fds:
+            return delivered
+        
+        payload = self._game_state_payload(state)
+        buffer = (ctypes.c_uint8 * ctypes.sizeof(GameStatePayload))()
+        length = self.lib.encode_game_state_payload(ctypes.byref(payload), buffer, len(buffer))
+        if length < 0:
+            return delivered
+        
+        fd_array = (ctypes.c_int * len(binary_fds))(*binary_fds)
+        result = self.lib.send_broadcast(
+            fd_array,
+            len(binary_fds),
+            MessageTypeS2C.GAME_STATE_UPDATE | MSG_FLAG_BINARY,
+            buffer,
+            length
+        )
+        return delivered + max(result, 0)
+    
+    def _state_flags(self, state: Dict[str, Any]) -> int:
+        flags = 0
+        fields = state.get('fen', '').split()
+        if len(fields) > 1 and fields[1] == 'b':
+            flags |= STATE_FLAG_BLACK_TO_MOVE
+        if state.get('in_check'):
+            flags |= STATE_FLAG_IN_CHECK
+        if state.get('game_over'):
+            flags |= STATE_FLAG_GAME_OVER
+        return flags
+    
+    def _game_state_payload(self, state: Dict[str, Any]) -> GameStatePayload:
+        return GameStatePayload(
+            last_move=self.lib.move_from_uci(state.get('last_move', '').encode('utf-8')),
+            flags=self._state_flags(state),
+            white_ms=int(state.get('white_time_ms', 0)),
+            black_ms=int(state.get('black_time_ms', 0)),
+            game_id=str(state.get('game_id', '')).encode('utf-8')[:BINARY_GAME_ID_MAX - 1],
+            fen=state.get('fen', '').encode('utf-8')[:BINARY_FEN_MAX - 1]
+        )
+    
+    # ---------- Spectator streams ----------
+    
+    def stream_keyframe(self, game_id: str, ply: int, state: Dict[str, Any]) -> int:
+        """
+        Open a game's spectator stream or publish a fresh keyframe for it.
+        
+        The full position is cached for late joiners and only sent to the
+        watchers that need one. Publish at least every
+        SPECTATOR_KEYFRAME_PLIES plies so joins can resync.
+        
+        Args:
+            game_id: Game the stream belongs to
+            ply: Half-moves played in the position
+            state: Same dict as broadcast_game_state()
+            
+        Returns:
+            Watchers the keyframe went to, or -1
+        """
+        payload = self._game_state_payload(dict(state, game_id=game_id))
+        return self.lib.server_stream_keyframe(game_id.encode('utf-8'), ply, ctypes.byref(payload))
+    
+    def stream_move(self, game_id: str, ply: int, state: Dict[str, Any]) -> int:
+        """
+        Send a validated move to the game's watchers as a delta: ply, the
+        16-bit move, state flags and both clocks.
+        
+        Args:
+            game_id: Game the stream belongs to
+            ply: Half-moves played after the move
+            state: Same dict as broadcast_game_state(), last_move in UCI
+            
+        Returns:
+            Watchers reached, or -1 without a stream
+        """
+        return self.lib.server_stream_move(
+            game_id.encode('utf-8'),
+            ply,
+            self.lib.move_from_uci(state.get('last_move', '').encode('utf-8')),
+            self._state_flags(state),
+            int(state.get('white_time_ms', 0)),
+            int(state.get('black_time_ms', 0))
+        )
+    
+    def stream_close(self, game_id: str):
+        """Drop a game's spectator stream and its watchers"""
+        self.lib.server_stream_close(game_id.encode('utf-8'))
+    
+    def stream_watchers(self, game_id: str) -> int:
+        """Watchers of a game, or -1 if it has no stream"""
+        return self.lib.server_stream_watchers(game_id.encode('utf-8'))
+    
+    def spectate(self, client_fd: int, game_id: str) -> bool:
+        """Subscribe a client to a game's stream; it gets the keyframe and logged deltas"""
+        return self.lib.server_spectate(client_fd, game_id.encode('utf-8')) == 0
+    
+    def unspectate(self, client_fd: int, game_id: str) -> bool:
+        """Unsubscribe a client from a game's stream"""
+        return self.lib.server_unspectate(client_fd, game_id.encode('utf-8')) == 0
+    
     def process_events(self) -> bool:
         """
         Process all pending network events.
@@ -276,30 +719,35 @@ class NetworkManager:
         had_events = False
         
         while True:
-            # Get next event
-            event_ptr = self.lib.get_next_event()
-            if not event_ptr:
+            # Drain a batch of events in one call
+            count = self.lib.server_poll_batch(self.event_batch, EVENT_BATCH_SIZE)
+            if count <= 0:
                 break
             
             had_events = True
-            event = event_ptr.contents
-            
             try:
-                if event.type == EventType.NEW_CONNECTION:
-                    self._handle_new_connection(event)
-                
-                elif event.type == EventType.CLIENT_DISCONNECTED:
-                    self._handle_client_disconnected(event)
-                
-                elif event.type == EventType.MESSAGE_RECEIVED:
-                    self._handle_message_received(event)
-                
-                elif event.type == EventType.ERROR:
-                    self._handle_error(event)
+                for i in range(count):
+                    event = self.event_batch[i]
+                    
+                    if event.type == EventType.NEW_CONNECTION:
+                        self._handle_new_connection(event)
+                    
+                    elif event.type == EventType.CLIENT_DISCONNECTED:
+                        self._handle_client_disconnected(event)
+                    
+                    elif event.type == EventType.MESSAGE_RECEIVED:
+                        self._handle_message_received(event)
+                    
+                    elif event.type == EventType.ERROR:
+                        self._handle_error(event)
+                    
+                    elif event.type in self.event_handlers:
+                        # FLAG_FALL, IDLE_TIMEOUT, HEARTBEAT
+                        self._handle_timer_event(event)
             
             finally:
-                # Free the event
-                self.lib.free_event(event_ptr)
+                # Free the batch
+                self.lib.free_event_batch(self.event_batch, count)
         
         return had_events
     
@@ -331,7 +779,12 @@ class NetworkManager:
         
         # Extract payload
         payload_data = None
-        if event.payload_length > 0 and event.payload_data:
+        if event.flags & EVENT_FLAG_BINARY:
+            # The peer speaks binary: answer it in kind from now on
+            if client_fd in self.client_sessions:
+                self.client_sessions[client_fd]['binary_payloads'] = True
+            payload_data = self._decode_binary_payload(message_id, event)
+        elif event.payload_length > 0 and event.payload_data:
             payload_bytes = bytes(event.payload_data[:event.payload_length])
             try:
                 payload_str = payload_bytes.decode('utf-8')
@@ -342,6 +795,14 @@ class NetworkManager:
         else:
             payload_data = {}
         
+        if event.flags & EVENT_FLAG_RELAYED and isinstance(payload_data, dict):
+            # The opponent already has it; the handler validates and persists
+            payload_data['relayed'] = True
+        
+        if event.flags & EVENT_FLAG_CLOCK_SWITCHED and isinstance(payload_data, dict):
+            # The reactor already stopped the mover's clock and started the opponent's
+            payload_data['clock_switched'] = True
+        
         # Get message type name
         msg_name = self.lib.get_message_type_name(message_id).decode('utf-8')
         print(f"← Message from fd={client_fd}: {msg_name} (0x{message_id:04x})")
@@ -355,10 +816,112 @@ class NetworkManager:
         else:
             print(f"⚠ No handler registered for message type: {msg_name}")
     
+    def _decode_binary_payload(self, message_id: int, event: NetworkEvent) -> Dict[str, Any]:
+        """Decode a binary payload into the same dict its JSON form produces"""
+        if message_id == MessageTypeC2S.MAKE_MOVE:
+            move = MovePayload()
+            if self.lib.decode_move_payload(event.payload_data, event.payload_length, ctypes.byref(move)) == 0:
+                uci = ctypes.create_string_buffer(6)
+                self.lib.move_to_uci(move.move, uci)
+                return {
+                    'game_id': move.game_id.decode('utf-8', 'replace'),
+                    'move': uci.value.decode('ascii'),
+                    'clock_ms': move.clock_ms
+                }
+        print(f"✗ Failed to decode binary payload: 0x{message_id:04x}")
+        return {}
+    
     def _handle_error(self, event: NetworkEvent):
         """Handle error event"""
         print(f"✗ Network error: fd={event.client_fd}")
     
+    def _handle_timer_event(self, event: NetworkEvent):
+        """Handle a timer wheel event"""
+        try:
+            self.event_handlers[event.type](event.client_fd)
+        except Exception as e:
+            print(f"✗ Error in {EventType(event.type).name} handler: {e}")
+    
+    def register_event_handler(self, event_type: int, handler: Callable):
+        """
+        Register a handler for a timer event.
+        
+        Args:
+            event_type: EventType.FLAG_FALL, IDLE_TIMEOUT or HEARTBEAT
+            handler: Callable with signature: handler(client_fd: int)
+        """
+        self.event_handlers[event_type] = handler
+    
+    def set_timeouts(self, idle_ms: int, heartbeat_ms: int):
+        """
+        Disconnect clients silent for idle_ms (after an IDLE_TIMEOUT event)
+        and raise HEARTBEAT every heartbeat_ms of silence. 0 disables either.
+        """
+        self.lib.server_set_timeouts(idle_ms, heartbeat_ms)
+    
+    def set_clock(self, client_fd: int, remaining_ms: int, increment_ms: int = 0) -> bool:
+        """Set a player's stopped game clock; FLAG_FALL fires when a running one hits zero"""
+        return self.lib.server_set_clock(client_fd, remaining_ms, increment_ms) == 0
+    
+    def start_clock(self, client_fd: int) -> bool:
+        """Start a player's clock"""
+        return self.lib.server_start_clock(client_fd) == 0
+    
+    def stop_clock(self, client_fd: int) -> int:
+        """Stop a player's clock; returns the remaining ms, or -1"""
+        return self.lib.server_stop_clock(client_fd)
+    
+    def clock_remaining(self, client_fd: int) -> int:
+        """Remaining ms on a player's clock, or -1"""
+        return self.lib.server_clock_remaining(client_fd)
+    
+    def switch_clock(self, mover_fd: int, opponent_fd: int) -> bool:
+        """
+        End the mover's turn: stop their clock, add the increment and start
+        the opponent's. Routed games are switched by the reactor itself.
+        """
+        return self.lib.server_switch_clock(mover_fd, opponent_fd) == 0
+    
+    def undo_switch(self, mover_fd: int, opponent_fd: int) -> bool:
+        """
+        Take back the switch of a move found illegal: the opponent's clock
+        stops where it was and the mover's runs on without the increment.
+        """
+        return self.lib.server_undo_switch(mover_fd, opponent_fd) == 0
+    
+    def accept_stats(self, reset: bool = False) -> Dict[str, Any]:
+        """
+        Accept counters over all shards: connections accepted and refused,
+        accept batches, and how long connections waited in the backlog.
+        """
+        stats = AcceptStats()
+        self.lib.server_accept_stats(ctypes.byref(stats))
+        if reset:
+            self.lib.server_reset_accept_stats()
+        return {
+            'accepted': stats.accepted,
+            'rejected': stats.rejected,
+            'batches': stats.batches,
+            'max_batch': stats.max_batch,
+            'latency_max_ms': stats.latency_max_ms,
+            'latency_avg_ms': stats.latency_total_ms / stats.accepted if stats.accepted else 0.0,
+            'latency_buckets': list(stats.latency_buckets)
+        }
+    
+    def compression_stats(self) -> Dict[str, Any]:
+        """
+        Replies sent deflated to clients that asked for compression: their
+        count, bytes before and after, and the resulting ratio.
+        """
+        stats = CompressionStats()
+        self.lib.server_compression_stats(ctypes.byref(stats))
+        return {
+            'messages': stats.messages,
+            'bytes_in': stats.bytes_in,
+            'bytes_out': stats.bytes_out,
+            'ratio': stats.bytes_in / stats.bytes_out if stats.bytes_out else 0.0
+        }
+    
     def register_handler(self, message_type: int, handler: Callable):
         """
         Register a message handler.
@@ -401,6 +964,41 @@ class NetworkManager:
         """
         self.lib.disconnect_client(client_fd)
     
+    def pin_clients(self, client_fds) -> int:
+        """
+        Move clients onto one shard so their traffic is handled together.
+        
+        Args:
+            client_fds: File descriptors; all join the first one's shard
+            
+        Returns:
+            Shard index, or -1 on failure
+        """
+        fds = list(client_fds)
+        if len(fds) < 2 or self.lib.server_shard_count() < 2:
+            return self.lib.server_client_shard(fds[0]) if fds else -1
+        fd_array = (ctypes.c_int * len(fds))(*fds)
+        return self.lib.server_pin_clients(fd_array, len(fds))
+    
+    def route_game(self, white_fd: int, black_fd: int) -> bool:
+        """
+        Let the C layer relay moves between two players directly.
+        
+        Moves still reach the MAKE_MOVE handler, with data['relayed'] set.
+        
+        Args:
+            white_fd: White player's file descriptor
+            black_fd: Black player's file descriptor
+            
+        Returns:
+            True if the route was installed
+        """
+        return self.lib.server_route_game(white_fd, black_fd) == 0
+    
+    def unroute_game(self, client_fd: int):
+        """Stop relaying moves for a player and their opponent"""
+        self.lib.server_unroute_game(client_fd)
+    
     def get_client_count(self) -> int:
         """
         Get number of connected clients.
@@ -410,13 +1008,61 @@ class NetworkManager:
         """
         return self.lib.get_client_count()
     
-    def run_forever(self, poll_timeout_ms: int = 100):
+    def metrics(self, reset_peaks: bool = False) -> Dict[str, Any]:
+        """
+        Snapshot of the native metrics: per message type traffic and
+        request latency (queued to reply), and per shard event queue,
+        send queue and poll iteration figures. Latency buckets follow
+        METRICS_LATENCY_BOUNDS_US and are not cumulative. Safe to call from
+        another thread; reset_peaks restarts the maxima afterwards.
+        """
+        entries = (MessageMetrics * (METRICS_MESSAGE_SLOTS + 1))()
+        count = self.lib.server_message_metrics(entries, len(entries))
+        messages = []
+        for entry in entries[:count]:
+            name = self.lib.get_message_type_name(entry.message_id).decode('utf-8')
+            messages.append({
+                'message_id': entry.message_id,
+                'name': 'OTHER' if entry.message_id == METRICS_OTHER_ID else name,
+                'received': entry.received,
+                'received_bytes': entry.received_bytes,
+                'sent': entry.sent,
+                'sent_bytes': entry.sent_bytes,
+                'latency': _histogram(entry.latency)
+            })
+        
+        shards = []
+        shard = ShardMetrics()
+        for index in range(self.lib.server_shard_count()):
+            if self.lib.server_shard_metrics(index, ctypes.byref(shard)) == 0:
+                shards.append({
+                    'events_queued': shard.events_queued,
+                    'events_queued_max': shard.events_queued_max,
+                    'events_pushed': shard.events_pushed,
+                    'events_dropped': shard.events_dropped,
+                    'send_queue_max': shard.send_queue_max,
+                    'slow_consumers': shard.slow_consumers,
+                    'iteration': _histogram(shard.iteration)
+                })
+        
+        if reset_peaks:
+            self.lib.server_reset_metrics_peaks()
+        return {'messages': messages, 'shards': shards,
+                'latency_bounds_us': list(METRICS_LATENCY_BOUNDS_US)}
+    
+    def run_forever(self, poll_timeout_ms: int = 100, native_thread: bool = False):
         """
         Run the server event loop forever.
         
         Args:
             poll_timeout_ms: Poll timeout in milliseconds
+            native_thread: Run socket I/O on a native thread; poll() then
+                only waits for queued events. Always on with several shards.
         """
+        if self.lib.server_shard_count() > 1:
+            native_thread = True
+        if native_thread and self.lib.server_start_thread(poll_timeout_ms) != 0:
+            print("⚠ Native poll thread unavailable, polling inline")
         print("✓ Server event loop started")
         try:
             while True:
@@ -441,6 +1087,7 @@ if __name__ == "__main__":
     print("=" * 60)
     try:
         init_db()
+        init_game_store()
         print("✓ Database ready\n")
     except Exception as e:
         print(f"✗ Database connection failed: {e}")
@@ -453,6 +1100,7 @@ if __name__ == "__main__":
     # Store active games and matchmaking queue
     active_games = {}
     matchmaking_queue = []
+    game_counter = itertools.count(1)  # Several matches can start within one second
     
     # Define message handlers with database integration
     
@@ -506,6 +1154,16 @@ if __name__ == "__main__":
                 'losses': 0,
                 'draws': 0
             })
+            
+            # Tell the rest of the lobby (0x1003 - USER_STATUS_UPDATE)
+            lobby_fds = [
+                fd for fd, other in manager.client_sessions.items()
+                if fd != client_fd and other.get('authenticated')
+            ]
+            manager.broadcast_to_clients(lobby_fds, MessageTypeS2C.USER_STATUS_UPDATE, {
+                'username': user['username'],
+                'status': 'online'
+            })
         else:
             # Send login failure
             manager.send_to_client(client_fd, MessageTypeS2C.LOGIN_RESULT, {
@@ -588,7 +1246,7 @@ if __name__ == "__main__":
             player1_session = manager.client_sessions.get(player1_fd, {})
             player2_session = manager.client_sessions.get(player2_fd, {})
             
-            game_id = f'pvp_{int(time.time())}'
+            game_id = f'pvp_{int(time.time())}_{next(game_counter)}'
             
             # Create game in database
             game_result = create_game(
@@ -602,6 +1260,18 @@ if __name__ == "__main__":
             
             if game_result['success']:
                 active_games[game_id] = game_result['game']
+                active_games[game_id]['white_fd'] = player1_fd
+                active_games[game_id]['black_fd'] = player2_fd
+                
+                # Both players on one reactor: game traffic stays on one core,
+                # and moves are relayed natively when enabled
+                if not (NATIVE_MOVE_RELAY and manager.route_game(player1_fd, player2_fd)):
+                    manager.pin_clients([player1_fd, player2_fd])
+                
+                # Clocks run in the C server; white's starts now
+                for fd in (player1_fd, player2_fd):
+                    manager.set_clock(fd, 600 * 1000, 5 * 1000)
+                manager.start_clock(player1_fd)
                 
                 # Send to both players
                 for fd, color in [(player1_fd, 'white'), (player2_fd, 'black')]:
@@ -682,23 +1352,50 @@ if __name__ == "__main__":
         # Validate move with chess engine
         validation = validate_move(game_id, move)
         
+        # Send game state updates to everyone in the game
+        game_info = active_games.get(game_id, {})
+        recipients = {client_fd}
+        for key in ('white_fd', 'black_fd'):
+            if game_info.get(key) is not None:
+                recipients.add(game_info[key])
+        opponent_fd = next((fd for fd in recipients if fd != client_fd), None)
+        
         if validation['valid']:
-            # Update game state in database
-            update_game_state(game_id, move, validation['fen'])
+            # Routed games had their clocks switched by the reactor
+            if opponent_fd is not None and not data.get('clock_switched'):
+                manager.switch_clock(client_fd, opponent_fd)
+            
+            # Update game state in database, with the mover's clock for the game store
+            remaining = manager.clock_remaining(client_fd)
+            update_game_state(game_id, move, validation['fen'], remaining if remaining >= 0 else None)
             
-            # Send game state update (0x1200 - GAME_STATE_UPDATE)
-            manager.send_to_client(client_fd, MessageTypeS2C.GAME_STATE_UPDATE, {
+            # Authoritative state (0x1200 - GAME_STATE_UPDATE), also for relayed moves
+            state = {
                 'game_id': game_id,
                 'fen': validation['fen'],
                 'last_move': move,
-                'turn': 'black' if 'w' in validation['fen'] else 'white',
+                'turn': 'black' if validation['fen'].split()[1] == 'b' else 'white',
                 'in_check': validation.get('in_check', False),
                 'game_over': validation['game_over']
-            })
+            }
+            for key, color in (('white_time_ms', 'white_fd'), ('black_time_ms', 'black_fd')):
+                remaining = manager.clock_remaining(game_info.get(color, -1))
+                if remaining >= 0:
+                    state[key] = remaining
+            manager.broadcast_game_state(recipients, state)
+            
+            # Watchers get a delta, plus a keyframe now and then for late joiners
+            ply = ply_from_fen(validation['fen'])
+            if manager.stream_move(game_id, ply, state) >= 0 and ply % SPECTATOR_KEYFRAME_PLIES == 0:
+                manager.stream_keyframe(game_id, ply, state)
             
             # If game over, end game and update ELO
             if validation['game_over']:
                 end_game(game_id, validation['result'], 'completed')
+                manager.stream_close(game_id)
+                manager.unroute_game(client_fd)
+                for fd in recipients:
+                    manager.stop_clock(fd)
                 
                 manager.send_to_client(client_fd, MessageTypeS2C.GAME_OVER, {
                     'game_id': game_id,
@@ -710,6 +1407,22 @@ if __name__ == "__main__":
             manager.send_to_client(client_fd, MessageTypeS2C.INVALID_MOVE, {
                 'reason': validation.get('reason', 'Invalid move')
             })
+            
+            # The turn stays with the mover
+            if opponent_fd is not None and data.get('clock_switched'):
+                manager.undo_switch(client_fd, opponent_fd)
+            
+            # A relayed move already reached the opponent: roll both back
+            game = get_game(game_id) if data.get('relayed') else None
+            if game and game.get('fen'):
+                manager.broadcast_game_state(recipients, {
+                    'game_id': game_id,
+                    'fen': game['fen'],
+                    'last_move': '',
+                    'turn': 'white' if ' w ' in game['fen'] else 'black',
+                    'in_check': False,
+                    'game_over': False
+                })
     
     # 0x0021 - RESIGN: Điều khiển trận: Xin đầu hàng
     def handle_resign(client_fd: int, data: Dict):
@@ -741,6 +1454,8 @@ if __name__ == "__main__":
             })
             
             # Cleanup
+            manager.unroute_game(client_fd)
+            stop_game_clocks(game_id)
             if game_id in active_games:
                 del active_games[game_id]
     
@@ -774,6 +1489,8 @@ if __name__ == "__main__":
         })
         
         # Cleanup
+        manager.unroute_game(client_fd)
+        stop_game_clocks(game_id)
         if game_id in active_games:
             del active_games[game_id]
     
@@ -821,7 +1538,7 @@ if __name__ == "__main__":
         
         if user_id:
             # Get game history from database
-            history = get_user_game_history(user_id, limit=20)
+            history = get_user_game_history(user_id, limit=20, offset=int(data.get('offset', 0)))
             
             # Send history response (0x1301 - HISTORY_RESPONSE)
             manager.send_to_client(client_fd, MessageTypeS2C.HISTORY_RESPONSE, {
@@ -860,7 +1577,80 @@ if __name__ == "__main__":
                 'error': 'Game not found'
             })
     
+    def stop_game_clocks(game_id: str):
+        game_info = active_games.get(game_id, {})
+        for key in ('white_fd', 'black_fd'):
+            if game_info.get(key) is not None:
+                manager.stop_clock(game_info[key])
+        manager.stream_close(game_id)
+    
+    # 0x0040 - SPECTATE: Khán giả: Theo dõi một ván đang diễn ra
+    def handle_spectate(client_fd: int, data: Dict):
+        game_id = data.get('game_id', '')
+        
+        print(f"👀 Spectate from fd={client_fd} for game {game_id}")
+        
+        # The stream opens with the first watcher, from the stored position
+        if manager.stream_watchers(game_id) < 0:
+            game = get_game(game_id) if game_id in active_games else None
+            if not game or not game.get('fen'):
+                manager.send_to_client(client_fd, MessageTypeS2C.GAME_OVER, {
+                    'game_id': game_id,
+                    'error': 'Game not found'
+                })
+                return
+            game_info = active_games[game_id]
+            state = {
+                'fen': game['fen'],
+                'last_move': '',
+                'turn': 'white' if ' w ' in game['fen'] else 'black',
+                'in_check': False,
+                'game_over': False
+            }
+            for key, color in (('white_time_ms', 'white_fd'), ('black_time_ms', 'black_fd')):
+                remaining = manager.clock_remaining(game_info.get(color, -1))
+                if remaining >= 0:
+                    state[key] = remaining
+            manager.stream_keyframe(game_id, ply_from_fen(game['fen']), state)
+        
+        manager.spectate(client_fd, game_id)
+    
+    # 0x0041 - STOP_SPECTATING: Khán giả: Ngừng theo dõi
+    def handle_stop_spectating(client_fd: int, data: Dict):
+        manager.unspectate(client_fd, data.get('game_id', ''))
+    
+    # Timer wheel events
+    def handle_flag_fall(client_fd: int):
+        for game_id, game_info in list(active_games.items()):
+            if client_fd not in (game_info.get('white_fd'), game_info.get('black_fd')):
+                continue
+            
+            print(f"⏱️  Flag fall for fd={client_fd} in game {game_id}")
+            result = 'black_win' if client_fd == game_info['white_fd'] else 'white_win'
+            end_game(game_id, result, 'timeout')
+            
+            recipients = [game_info['white_fd'], game_info['black_fd']]
+            manager.broadcast_to_clients(recipients, MessageTypeS2C.GAME_OVER, {
+                'game_id': game_id,
+                'result': result,
+                'reason': 'Time forfeit'
+            })
+            manager.unroute_game(client_fd)
+            stop_game_clocks(game_id)
+            del active_games[game_id]
+            return
+    
+    def handle_idle_timeout(client_fd: int):
+        # The disconnect event follows
+        print(f"💤 Idle timeout: fd={client_fd}")
+    
+    def handle_heartbeat(client_fd: int):
+        print(f"💓 No traffic from fd={client_fd} for a heartbeat interval")
+    
     # Register all handlers
+    manager.register_event_handler(EventType.FLAG_FALL, handle_flag_fall)
+    manager.register_event_handler(EventType.IDLE_TIMEOUT, handle_idle_timeout)
+    manager.register_event_handler(EventType.HEARTBEAT, handle_heartbeat)
     manager.register_handler(MessageTypeC2S.REGISTER, handle_register)
     manager.register_handler(MessageTypeC2S.LOGIN, handle_login)
     manager.register_handler(MessageTypeC2S.GET_ONLINE_USERS, handle_get_online_users)
@@ -875,6 +1665,8 @@ if __name__ == "__main__":
     manager.register_handler(MessageTypeC2S.GET_STATS, handle_get_stats)
     manager.register_handler(MessageTypeC2S.GET_HISTORY, handle_get_history)
     manager.register_handler(MessageTypeC2S.GET_REPLAY, handle_get_replay)
+    manager.register_handler(MessageTypeC2S.SPECTATE, handle_spectate)
+    manager.register_handler(MessageTypeC2S.STOP_SPECTATING, handle_stop_spectating)
     
     print("=" * 60)
     print("✓ All message handlers registered:")
@@ -893,14 +1685,18 @@ if __name__ == "__main__":
     print("  📊 0x0030 GET_STATS - Get user stats")
     print("  📜 0x0031 GET_HISTORY - Get game history")
     print("  🎬 0x0032 GET_REPLAY - Get game replay")
+    print("  👀 0x0040 SPECTATE - Watch a game")
+    print("  🙈 0x0041 STOP_SPECTATING - Stop watching")
     print("=" * 60)
     
-    # Import config for SERVER_PORT
+    # Import config for SERVER_PORT / SERVER_SHARDS
     import sys
     sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
-    from config import SERVER_PORT
+    from config import (SERVER_PORT, SERVER_SHARDS, LISTEN_BACKLOG, NATIVE_MOVE_RELAY,
+                        IDLE_TIMEOUT_MS, HEARTBEAT_MS)
     
     # Start server
-    if manager.start(port=SERVER_PORT):
+    if manager.start(port=SERVER_PORT, shards=SERVER_SHARDS, backlog=LISTEN_BACKLOG):
+        manager.set_timeouts(IDLE_TIMEOUT_MS, HEARTBEAT_MS)
         # Run event loop
         manager.run_forever()
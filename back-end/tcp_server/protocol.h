@@ -30,7 +30,14 @@ typedef enum {
     
     /* Statistics & History */
     MSG_C2S_GET_STATS           = 0x0030,
-    MSG_C2S_GET_HISTORY         = 0x0031
+    MSG_C2S_GET_HISTORY         = 0x0031,
+    
+    /* Spectating */
+    MSG_C2S_SPECTATE            = 0x0040,
+    MSG_C2S_STOP_SPECTATING     = 0x0041,
+    
+    /* Transport (handled natively, no event) */
+    MSG_C2S_SET_COMPRESSION     = 0x0050
 } MessageTypeC2S;
 
 /* Server to Client (S2C) Message Types */
@@ -54,10 +61,15 @@ typedef enum {
     MSG_S2C_CHALLENGE_RECEIVED  = 0x1205,
     MSG_S2C_CHALLENGE_ACCEPTED  = 0x1206,
     MSG_S2C_CHALLENGE_DECLINED  = 0x1207,
+    MSG_S2C_OPPONENT_MOVE       = 0x1208,  /* Opponent's MAKE_MOVE, relayed natively */
     
     /* Statistics & History Responses */
     MSG_S2C_STATS_RESPONSE      = 0x1300,
-    MSG_S2C_HISTORY_RESPONSE    = 0x1301
+    MSG_S2C_HISTORY_RESPONSE    = 0x1301,
+    
+    /* Spectator Stream (always binary) */
+    MSG_S2C_SPECTATE_KEYFRAME   = 0x1400,
+    MSG_S2C_SPECTATE_DELTA      = 0x1401
 } MessageTypeS2C;
 
 /* ========== Protocol Header Structure ========== */
@@ -79,6 +91,15 @@ typedef struct {
 #define MAX_CLIENTS 1024
 #define BUFFER_SIZE 65536
 #define HEADER_SIZE sizeof(MessageHeader)
+#define SEND_HIGH_WATER (16 * BUFFER_SIZE)   /* Queued outbound bytes before a slow client is dropped */
+#define MAX_SHARDS 64                        /* Reactors accepted by server_init_shards() */
+
+/* I/O multiplexing backend, chosen once by server_init().
+ * Set CHESS_IO_BACKEND=poll|epoll in the environment to override. */
+typedef enum {
+    IO_BACKEND_POLL = 0,
+    IO_BACKEND_EPOLL
+} IoBackend;
 
 /* Client connection state */
 typedef enum {
@@ -88,18 +109,52 @@ typedef enum {
     CLIENT_IN_GAME
 } ClientState;
 
+/* Per-connection outbound queue (nodes are managed by send_queue.c) */
+typedef struct {
+    struct SendNode* head;
+    struct SendNode* tail;
+    size_t bytes;                    /* Bytes waiting to be written */
+} SendQueue;
+
+/* Per-connection timer (filed and fired by timer_wheel.c) */
+typedef struct Timer {
+    struct Timer* next;
+    struct Timer** pprev;            /* NULL while not armed */
+    uint64_t deadline;               /* Monotonic milliseconds */
+    uint8_t level;                   /* Wheel position while armed */
+    uint8_t slot;
+} Timer;
+
 /* Client session information */
 typedef struct {
     int fd;                          /* Socket file descriptor */
     ClientState state;               /* Connection state */
-    uint8_t recv_buffer[BUFFER_SIZE]; /* Receive buffer */
-    size_t recv_offset;              /* Current offset in receive buffer */
-    uint8_t send_buffer[BUFFER_SIZE]; /* Send buffer */
-    size_t send_offset;              /* Current offset in send buffer */
-    size_t send_length;              /* Total bytes to send */
+    uint8_t* recv_buffer;            /* Receive buffer (pool block, grows on demand) */
+    size_t recv_capacity;            /* Size of recv_buffer */
+    size_t recv_start;               /* First unparsed byte (read cursor) */
+    size_t recv_offset;              /* End of received data (write cursor) */
+    int views_pending;               /* Events this poll cycle point into recv_buffer */
+    int read_deferred;               /* Reading paused until views are released */
+    SendQueue send_queue;            /* Data the socket has not accepted yet */
+    int want_write;                  /* Write readiness requested from the backend */
     char username[64];               /* Authenticated username */
     uint32_t user_id;                /* User ID from database */
     int game_id;                     /* Current game ID (-1 if not in game) */
+    int peer_fd;                     /* Opponent moves are relayed to (-1 if not routed) */
+    int speaks_binary;               /* Client has sent MSG_FLAG_BINARY frames */
+    uint64_t last_active_ms;         /* Last data received */
+    uint64_t heartbeat_due_ms;       /* Earliest next EVENT_HEARTBEAT */
+    Timer activity_timer;            /* Next idle or heartbeat check */
+    Timer clock_timer;               /* Flag fall, armed while the clock runs */
+    uint32_t clock_ms;               /* Remaining time while the clock is stopped */
+    uint32_t increment_ms;           /* Added to the mover's clock on a switch */
+    uint64_t switched_at_ms;         /* Last switch that ended this player's turn, 0 once undone */
+    int has_clock;                   /* server_set_clock() was called */
+    uint32_t serial;                 /* Tells apart sessions that reuse an fd */
+    int compression;                 /* COMPRESSION_* the client asked for */
+    void* deflater;                  /* Its z_stream, made by the first compressed frame */
+    uint64_t request_us;             /* Oldest unanswered request queued (metrics), 0 if none */
+    uint16_t request_id;             /* Its message id */
 } ClientSession;
 
 /* ========== Event Structure for Python Bridge ========== */
@@ -108,30 +163,274 @@ typedef enum {
     EVENT_NEW_CONNECTION = 1,
     EVENT_CLIENT_DISCONNECTED,
     EVENT_MESSAGE_RECEIVED,
-    EVENT_ERROR
+    EVENT_ERROR,
+    EVENT_FLAG_FALL,                 /* client_fd's running clock reached zero */
+    EVENT_IDLE_TIMEOUT,              /* Silent for the idle timeout, then disconnected */
+    EVENT_HEARTBEAT                  /* Silent for a heartbeat interval */
 } EventType;
 
-/* Event structure passed to Python */
+/* Event flags */
+#define EVENT_FLAG_PAYLOAD_VIEW 0x0001  /* payload_data points into the session buffer */
+#define EVENT_FLAG_BINARY       0x0002  /* Binary payload (MSG_FLAG_BINARY stripped from message_id) */
+#define EVENT_FLAG_RELAYED      0x0004  /* MAKE_MOVE already forwarded to the opponent */
+#define EVENT_FLAG_CLOCK_SWITCHED 0x0008 /* MAKE_MOVE stopped the mover's clock and started the opponent's */
+
+/* Event structure passed to Python.
+ * Payloads flagged EVENT_FLAG_PAYLOAD_VIEW are not copied: they stay valid
+ * until the next server_poll() call, after which undelivered views are
+ * converted to owned copies automatically. */
 typedef struct {
     EventType type;
     int client_fd;
     uint16_t message_id;
     uint32_t payload_length;
     uint8_t* payload_data;
+    uint32_t flags;
 } NetworkEvent;
 
+/* ========== Binary Payload Encoding ========== */
+
+/* Setting MSG_FLAG_BINARY in a header's message_id marks the payload as
+ * the compact binary form of that message instead of JSON. A peer that
+ * sends binary frames is answered in kind; everyone else keeps JSON.
+ * Multi-byte fields are big-endian, strings are length-prefixed.
+ * MSG_FLAG_COMPRESSED is described with send_message(). */
+#define MSG_FLAG_BINARY     0x8000
+#define MSG_FLAG_COMPRESSED 0x4000
+#define MSG_ID_MASK         0x3FFF
+
+/* Moves use Stockfish's 16-bit layout: bits 0-5 destination square,
+ * 6-11 origin square (a1 = 0 ... h8 = 63), 12-13 promotion piece
+ * (knight..queen), 14-15 move type. */
+#define MOVE_NONE           0
+#define MOVE_TYPE_MASK      0xC000
+#define MOVE_TYPE_PROMOTION 0xC000
+
+/* GameStatePayload flags */
+#define STATE_FLAG_BLACK_TO_MOVE 0x01
+#define STATE_FLAG_IN_CHECK      0x02
+#define STATE_FLAG_GAME_OVER     0x04
+
+#define BINARY_GAME_ID_MAX 64
+#define BINARY_FEN_MAX     100
+
+/* MAKE_MOVE wire form: move u16, clock_ms u32, game_id */
+typedef struct {
+    uint16_t move;
+    uint32_t clock_ms;                   /* Mover's remaining time (0 if untimed) */
+    char game_id[BINARY_GAME_ID_MAX];
+} MovePayload;
+
+/* GAME_STATE_UPDATE wire form: last_move u16, flags u8, white_ms u32,
+ * black_ms u32, game_id, fen */
+typedef struct {
+    uint16_t last_move;
+    uint8_t flags;                       /* STATE_FLAG_* */
+    uint32_t white_ms;                   /* Clocks in milliseconds */
+    uint32_t black_ms;
+    char game_id[BINARY_GAME_ID_MAX];
+    char fen[BINARY_FEN_MAX];
+} GameStatePayload;
+
+/* Spectator streams: a keyframe carries the whole position, each move
+ * after it only a delta. ply counts the half-moves played; a watcher
+ * applies the delta for ply + 1 and waits for a keyframe after a gap.
+ * stream numbers the game on this connection's frames. */
+
+/* SPECTATE_KEYFRAME wire form: stream u32, ply u16, then the
+ * GAME_STATE_UPDATE wire form of the position */
+typedef struct {
+    uint32_t stream;
+    uint16_t ply;
+    GameStatePayload state;
+} SpectatorKeyframe;
+
+/* SPECTATE_DELTA wire form: stream u32, ply u16, move u16, flags u8,
+ * white_ms u32, black_ms u32 (17 bytes) */
+typedef struct {
+    uint32_t stream;
+    uint16_t ply;                        /* Half-moves played including this one */
+    uint16_t move;
+    uint8_t flags;                       /* STATE_FLAG_* after the move */
+    uint32_t white_ms;
+    uint32_t black_ms;
+} SpectatorDelta;
+
+#define SPECTATOR_DELTA_SIZE 17
+
 /* ========== Function Declarations ========== */
 
 /* Server initialization and main loop */
 int server_init(int port);
 void server_shutdown(void);
+
+/* Sharded server: one reactor (listener, backend, sessions, event queue)
+ * per shard, all bound to the same port with SO_REUSEPORT so the kernel
+ * spreads new connections. server_init(port) is server_init_shards(port, 1).
+ * Run the shards with server_start_thread(); events from every shard are
+ * drained by server_poll_batch(). */
+int server_init_shards(int port, int shards);
+int server_shard_count(void);
+int server_client_shard(int client_fd);   /* -1 if unknown */
+
+/* Accepting: each reactor accepts until its listener's backlog is empty,
+ * so a reconnect storm is taken in one wakeup. Listeners queue up to
+ * server_set_backlog() pending connections (<= 0: SOMAXCONN, the default;
+ * the kernel caps it at net.core.somaxconn); called after server_init()
+ * it resizes the open listeners. */
+int server_set_backlog(int backlog);
+
+#define ACCEPT_LATENCY_BUCKETS 5                 /* Waits < 1, < 10, < 100, < 1000, >= 1000 ms */
+
+/* Accept counters, summed over the shards. Latency is the time a
+ * connection spent in the backlog once its handshake completed (Linux
+ * TCP_INFO; counted from the client's first data if that came earlier). */
+typedef struct {
+    uint64_t accepted;
+    uint64_t rejected;                           /* Accepted then closed: no free slot or setup failed */
+    uint64_t batches;                            /* Wakeups that accepted at least one connection */
+    uint32_t max_batch;                          /* Most connections taken by one wakeup */
+    uint32_t latency_max_ms;
+    uint64_t latency_total_ms;
+    uint64_t latency_buckets[ACCEPT_LATENCY_BUCKETS];
+} AcceptStats;
+
+void server_accept_stats(AcceptStats* stats);
+void server_reset_accept_stats(void);
+
+/* Move every listed client onto the shard of the first one, keeping their
+ * undelivered events in order. Call from the thread consuming events.
+ * Returns the shard index, or -1 on failure. */
+int server_pin_clients(const int* client_fds, int count);
+
+/* Native move relay: once routed, MAKE_MOVE frames from either player are
+ * forwarded by the reactor to the other as OPPONENT_MOVE (binary or JSON,
+ * whichever the opponent speaks) and still queued for Python with
+ * EVENT_FLAG_RELAYED set. Routing pins both players to one shard and sets
+ * them CLIENT_IN_GAME; disconnecting either player drops the route.
+ * Returns 0, or -1 if either client is unknown. */
+int server_route_game(int white_fd, int black_fd);
+void server_unroute_game(int client_fd);
 int server_poll(int timeout_ms);
+const char* server_backend_name(void);
+
+/* Native poll threads (one per shard): run server_poll() off the caller's
+ * thread. While they run, server_poll() only waits (up to timeout_ms) for queued events, and
+ * server_event_fd() becomes readable whenever new events arrive. */
+int server_start_thread(int timeout_ms);
+void server_stop_thread(void);
+int server_event_fd(void);
+
+/* Timers: each reactor runs a hierarchical timer wheel (timer_wheel.h)
+ * whose next deadline bounds its poll/epoll wait, so timer events are
+ * queued on time however loaded the server or long the poll timeout.
+ *
+ * Idle detection: a client that sent nothing for heartbeat_ms gets an
+ * EVENT_HEARTBEAT, again every heartbeat_ms while it stays silent (e.g.
+ * to ping it); one silent for idle_ms gets EVENT_IDLE_TIMEOUT and is
+ * disconnected. 0 disables either. Applies to connected clients too. */
+void server_set_timeouts(int idle_ms, int heartbeat_ms);
 
-/* Message handling */
+/* Game clocks, one per player session. server_set_clock() sets a stopped
+ * clock; a running clock that reaches zero stops there and queues
+ * EVENT_FLAG_FALL for its player. When a routed player's MAKE_MOVE arrives
+ * while their clock runs, the reactor itself stops it, adds the increment
+ * and starts the opponent's, flagging the event EVENT_FLAG_CLOCK_SWITCHED;
+ * server_switch_clock() does the same for other games. A move that comes
+ * in after the flag fell switches nothing. server_undo_switch() takes back
+ * the last switch of a move found illegal: the opponent's clock stops with
+ * the time it had, the mover loses the increment and is charged the time
+ * since the switch. The clock functions return 0,
+ * or the remaining milliseconds, and -1 if the client is unknown or has
+ * no clock. */
+int server_set_clock(int client_fd, uint32_t remaining_ms, uint32_t increment_ms);
+int server_start_clock(int client_fd);
+int64_t server_stop_clock(int client_fd);
+int64_t server_clock_remaining(int client_fd);
+int server_switch_clock(int mover_fd, int opponent_fd);
+int server_undo_switch(int mover_fd, int opponent_fd);
+
+/* Spectator streams, one per watched game, fanned out with the broadcast
+ * path. server_stream_keyframe() opens the stream and caches the position
+ * for late joiners; it only goes out to watchers that need it (new ones,
+ * or everyone when ply doesn't follow the last move). server_stream_move()
+ * sends the delta of each validated move and logs it after the keyframe.
+ * A join gets the cached keyframe plus the logged deltas, so publish a
+ * keyframe at least every SPECTATOR_DELTA_LOG plies; without a usable one
+ * new watchers wait for the next. server_spectate() on a watcher already
+ * subscribed resends the resync. Closed watchers drop out by themselves.
+ * Publishers return the watchers reached, spectate/unspectate 0; all
+ * return -1 for an unknown game (or a full stream table). */
+#define MAX_STREAMS 256
+#define SPECTATOR_DELTA_LOG 64
+
+int server_stream_keyframe(const char* game_id, uint16_t ply, const GameStatePayload* state);
+int server_stream_move(const char* game_id, uint16_t ply, uint16_t move, uint8_t flags,
+                       uint32_t white_ms, uint32_t black_ms);
+void server_stream_close(const char* game_id);
+int server_stream_watchers(const char* game_id);   /* -1 without a stream */
+int server_spectate(int client_fd, const char* game_id);
+int server_unspectate(int client_fd, const char* game_id);
+
+/* Compression: a client sends SET_COMPRESSION with one byte, the
+ * COMPRESSION_* it can inflate, and from then on send_message() deflates
+ * payloads of at least COMPRESS_MIN_PAYLOAD bytes. Such frames carry
+ * MSG_FLAG_COMPRESSED (server to client only); their payload is the
+ * original length (u32) and a raw deflate block ended by a sync flush.
+ * Every connection keeps one deflate stream, primed with
+ * COMPRESSION_DICTIONARY, so each frame also draws on the ones before it:
+ * the client must inflate all of them, in order, with one stream. With
+ * compression on, payloads may grow to COMPRESS_MAX_PAYLOAD as long as
+ * the compressed frame fits BUFFER_SIZE; a client whose frame doesn't is
+ * closed, since its stream can't skip data. Broadcasts stay plain. */
+#define COMPRESSION_NONE        0
+#define COMPRESSION_DEFLATE     1
+#define COMPRESS_MIN_PAYLOAD    1024
+#define COMPRESS_MAX_PAYLOAD    (4 * BUFFER_SIZE)
+#define COMPRESS_WINDOW_BITS    14           /* 16 KB history; inflate with 15 */
+#define COMPRESS_MEM_LEVEL      6            /* With the window, ~96 KB per stream */
+#define COMPRESS_LEVEL          6
+
+/* Common substrings of the JSON replies; both ends must use the same */
+#define COMPRESSION_DICTIONARY \
+    "{\"game_id\": \"\", \"opponent\": \"\", \"result\": \"white_win\", \"result\": \"black_win\", " \
+    "\"user_result\": \"win\", \"user_result\": \"loss\", \"user_result\": \"draw\", " \
+    "\"my_color\": \"white\", \"my_color\": \"black\", \"date\": \"20\", \"created_at\": \"20\", " \
+    "\"moves_count\": , \"is_ai_game\": false, \"is_ai_game\": true, " \
+    "\"white_username\": \"\", \"black_username\": \"\"}, {\"games\": [" \
+    "{\"user_id\": \"\", \"username\": \"\", \"fullname\": \"\", \"elo\": 1200, \"rating\": 1200, " \
+    "\"status\": \"available\", \"status\": \"in_game\"}, {\"users\": ["
+
+/* Frames deflated and their payload bytes before and after, summed over
+ * the shards */
+typedef struct {
+    uint64_t messages;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} CompressionStats;
+
+void server_compression_stats(CompressionStats* stats);
+
+/* Message handling.
+ * send_message() never blocks: whatever the socket does not take right away
+ * is queued and flushed when it becomes writable. Returns the frame size on
+ * success, or -1 if the client is unknown, the frame is too large, or the
+ * client was dropped for exceeding SEND_HIGH_WATER. */
 int send_message(int client_fd, uint16_t message_id, const uint8_t* payload, uint32_t payload_length);
+
+/* Fan-out: frames the payload once and sends or queues it to every listed
+ * client. Unknown fds are skipped. Returns how many clients accepted it,
+ * or -1 if the frame is too large or can't be allocated. */
+int send_broadcast(const int* client_fds, int count, uint16_t message_id,
+                   const uint8_t* payload, uint32_t payload_length);
 NetworkEvent* get_next_event(void);
 void free_event(NetworkEvent* event);
 
+/* Batched event draining: copies up to max queued events into out[] and
+ * returns how many were copied. Release them with free_event_batch(). */
+int server_poll_batch(NetworkEvent* out, int max);
+void free_event_batch(NetworkEvent* events, int count);
+
 /* Client management */
 ClientSession* get_client_session(int client_fd);
 void disconnect_client(int client_fd);
@@ -140,4 +439,18 @@ int get_client_count(void);
 /* Utility functions */
 const char* get_message_type_name(uint16_t message_id);
 
+/* Binary payload codec. move_from_uci() returns MOVE_NONE for malformed
+ * input; move_to_uci() needs 6 bytes. Encoders return the payload size or
+ * -1 if it doesn't fit; decoders return 0, or -1 on a malformed payload. */
+uint16_t move_from_uci(const char* uci);
+int move_to_uci(uint16_t move, char* out);
+int encode_move_payload(const MovePayload* move, uint8_t* out, size_t capacity);
+int decode_move_payload(const uint8_t* payload, uint32_t length, MovePayload* move);
+int encode_game_state_payload(const GameStatePayload* state, uint8_t* out, size_t capacity);
+int decode_game_state_payload(const uint8_t* payload, uint32_t length, GameStatePayload* state);
+int encode_spectator_keyframe(const SpectatorKeyframe* keyframe, uint8_t* out, size_t capacity);
+int decode_spectator_keyframe(const uint8_t* payload, uint32_t length, SpectatorKeyframe* keyframe);
+int encode_spectator_delta(const SpectatorDelta* delta, uint8_t* out, size_t capacity);
+int decode_spectator_delta(const uint8_t* payload, uint32_t length, SpectatorDelta* delta);
+
 #endif /* PROTOCOL_H */
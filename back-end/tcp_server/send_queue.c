@@ -0,0 +1,178 @@
+#include "send_queue.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+
+/* ========== Queue State ========== */
+
+#define NODE_CACHE_LIMIT 4096
+
+typedef struct SendNode {
+    SharedFrame* frame;
+    size_t offset;                   /* Bytes of frame already written */
+    struct SendNode* next;
+} SendNode;
+
+/* Released nodes are recycled instead of going back to malloc; every
+ * reactor thread shares the cache */
+static SendNode* free_nodes = NULL;
+static int free_node_count = 0;
+static pthread_mutex_t node_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static SendNode* node_alloc(void) {
+    pthread_mutex_lock(&node_lock);
+    SendNode* node = free_nodes;
+    if (node) {
+        free_nodes = node->next;
+        free_node_count--;
+    }
+    pthread_mutex_unlock(&node_lock);
+    return node ? node : malloc(sizeof(SendNode));
+}
+
+static void node_free(SendNode* node) {
+    pthread_mutex_lock(&node_lock);
+    if (free_node_count < NODE_CACHE_LIMIT) {
+        node->next = free_nodes;
+        free_nodes = node;
+        free_node_count++;
+        node = NULL;
+    }
+    pthread_mutex_unlock(&node_lock);
+    free(node);
+}
+
+/* ========== Shared Frames ========== */
+
+SharedFrame* frame_create(uint16_t message_id, const uint8_t* payload, uint32_t payload_length) {
+    SharedFrame* frame = malloc(sizeof(SharedFrame) + HEADER_SIZE + payload_length);
+    if (!frame) {
+        return NULL;
+    }
+    
+    MessageHeader header;
+    header.message_id = htons(message_id);
+    header.payload_length = htonl(payload_length);
+    memcpy(frame->data, &header, HEADER_SIZE);
+    if (payload_length > 0 && payload) {
+        memcpy(frame->data + HEADER_SIZE, payload, payload_length);
+    }
+    
+    atomic_init(&frame->refs, 1);
+    frame->length = HEADER_SIZE + payload_length;
+    return frame;
+}
+
+void frame_retain(SharedFrame* frame) {
+    atomic_fetch_add_explicit(&frame->refs, 1, memory_order_relaxed);
+}
+
+void frame_release(SharedFrame* frame) {
+    if (frame && atomic_fetch_sub_explicit(&frame->refs, 1, memory_order_acq_rel) == 1) {
+        free(frame);
+    }
+}
+
+/* ========== Queue API ========== */
+
+int send_queue_push(SendQueue* queue, SharedFrame* frame, size_t offset) {
+    SendNode* node = node_alloc();
+    if (!node) {
+        return -1;
+    }
+    frame_retain(frame);
+    node->frame = frame;
+    node->offset = offset;
+    node->next = NULL;
+    
+    if (queue->tail) {
+        queue->tail->next = node;
+    } else {
+        queue->head = node;
+    }
+    queue->tail = node;
+    queue->bytes += frame->length - offset;
+    return 0;
+}
+
+ssize_t send_queue_flush(SendQueue* queue, int fd) {
+    ssize_t total = 0;
+    
+    while (queue->head) {
+        /* Gather the front of the queue into one scatter-gather write */
+        struct iovec iov[SEND_IOV_BATCH];
+        int iov_count = 0;
+        for (SendNode* node = queue->head; node && iov_count < SEND_IOV_BATCH; node = node->next) {
+            iov[iov_count].iov_base = node->frame->data + node->offset;
+            iov[iov_count].iov_len = node->frame->length - node->offset;
+            iov_count++;
+        }
+        
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iov_count;
+        
+        /* sendmsg() rather than writev() so a dead peer can't raise SIGPIPE */
+        ssize_t written = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        total += written;
+        queue->bytes -= (size_t)written;
+        
+        /* Retire fully written frames, then note progress in the next one */
+        size_t remaining = (size_t)written;
+        while (remaining > 0) {
+            SendNode* node = queue->head;
+            size_t left = node->frame->length - node->offset;
+            if (remaining < left) {
+                node->offset += remaining;
+                break;
+            }
+            remaining -= left;
+            queue->head = node->next;
+            frame_release(node->frame);
+            node_free(node);
+        }
+        if (!queue->head) {
+            queue->tail = NULL;
+        }
+        /* Keep going until EAGAIN: edge-triggered epoll only re-arms then */
+    }
+    return total;
+}
+
+void send_queue_clear(SendQueue* queue) {
+    SendNode* node = queue->head;
+    while (node) {
+        SendNode* next = node->next;
+        frame_release(node->frame);
+        node_free(node);
+        node = next;
+    }
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->bytes = 0;
+}
+
+void send_queue_trim(void) {
+    pthread_mutex_lock(&node_lock);
+    while (free_nodes) {
+        SendNode* next = free_nodes->next;
+        free(free_nodes);
+        free_nodes = next;
+    }
+    free_node_count = 0;
+    pthread_mutex_unlock(&node_lock);
+}
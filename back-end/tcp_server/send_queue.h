@@ -0,0 +1,48 @@
+#ifndef SEND_QUEUE_H
+#define SEND_QUEUE_H
+
+#include "protocol.h"
+#include <sys/types.h>
+#include <stdatomic.h>
+
+/* ========== Outbound Write Queue ========== */
+
+/*
+ * Bytes the kernel would not take right away are parked on the session's
+ * SendQueue and flushed with scatter-gather writes once the socket becomes
+ * writable again. Queued data lives in reference-counted frames, so one
+ * encoded frame can sit on many queues without being copied per client.
+ * Queue functions expect the caller to serialize access (the server holds
+ * its session lock); frame references are atomic, as a broadcast frame
+ * sits on queues of sessions in different shards.
+ */
+
+#define SEND_IOV_BATCH 64                /* Frames gathered per sendmsg() */
+
+/* Complete wire frame: header followed by payload */
+typedef struct SharedFrame {
+    atomic_int refs;
+    size_t length;
+    uint8_t data[];
+} SharedFrame;
+
+/* Build a frame for message_id/payload with one reference held */
+SharedFrame* frame_create(uint16_t message_id, const uint8_t* payload, uint32_t payload_length);
+void frame_retain(SharedFrame* frame);
+void frame_release(SharedFrame* frame);
+
+/* Append frame bytes from offset on; takes its own reference.
+ * Returns -1 when out of memory. */
+int send_queue_push(SendQueue* queue, SharedFrame* frame, size_t offset);
+
+/* Write as much as the socket accepts. Returns bytes written, or -1 with
+ * errno set on a socket error (EAGAIN is not an error). */
+ssize_t send_queue_flush(SendQueue* queue, int fd);
+
+/* Drop everything still queued */
+void send_queue_clear(SendQueue* queue);
+
+/* Free cached queue nodes */
+void send_queue_trim(void);
+
+#endif /* SEND_QUEUE_H */
@@ -1,4 +1,10 @@
+#define _GNU_SOURCE                              /* SO_REUSEPORT under -std=c11 */
 #include "protocol.h"
+#include "buffer_pool.h"
+#include "event_queue.h"
+#include "send_queue.h"
+#include "timer_wheel.h"
+#include "metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,24 +12,108 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <poll.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <zlib.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 /* ========== Global State ========== */
 
-static int listener_fd = -1;                     /* Listening socket */
-static struct pollfd ufds[MAX_CLIENTS + 1];      /* Poll file descriptors (+1 for listener) */
-static ClientSession clients[MAX_CLIENTS];       /* Client session array */
-static int fd_count = 0;                         /* Number of active file descriptors */
-static NetworkEvent event_queue[1024];           /* Event queue for Python */
-static int event_queue_head = 0;
-static int event_queue_tail = 0;
-static int event_queue_count = 0;
+#define LISTENER_TAG UINT32_MAX                  /* epoll data tag for the listening socket */
+#define WAKEUP_TAG (UINT32_MAX - 1)              /* epoll data tag for the reactor's wakeup pipe */
+#define LISTENER_INDEX -1                        /* Client index of the listener in ufds[] */
+#define WAKEUP_INDEX -2                          /* Client index of the wakeup pipe in ufds[] */
+#define EPOLL_BATCH 256                          /* Max events fetched per epoll_wait() */
+#define FD_MAP_LIMIT (1 << 20)                   /* Upper bound on the fd table size */
+#define EVENT_MOVED 0                            /* Queue tombstone left by a pinned session */
+
+/* One reactor per shard. Each owns a listener (SO_REUSEPORT when sharded),
+ * its backend, its session table and its event queue; the session table is
+ * guarded by the reactor's lock whenever native threads run. */
+typedef struct {
+    int index;                                   /* Shard number */
+    int listener_fd;                             /* Listening socket */
+    int epoll_fd;                                /* epoll instance (IO_BACKEND_EPOLL) */
+    struct pollfd ufds[MAX_CLIENTS + 2];         /* Poll file descriptors (+2 for listener, wakeup) */
+    int pollfd_client[MAX_CLIENTS + 2];          /* ufds index -> client index (or *_INDEX) */
+    int client_pollfd[MAX_CLIENTS];              /* client index -> ufds index */
+    struct pollfd snapshot[MAX_CLIENTS + 2];     /* Copy of ufds[] handed to poll() */
+    int snapshot_client[MAX_CLIENTS + 2];
+    int fd_count;                                /* Number of active file descriptors */
+    ClientSession clients[MAX_CLIENTS];          /* Client session array */
+    int client_count;                            /* Number of connected clients */
+    int free_slots[MAX_CLIENTS];                 /* Stack of unused session slots */
+    int free_count;
+    AcceptStats accept_stats;                    /* server_accept_stats() counters */
+    CompressionStats compression_stats;          /* server_compression_stats() counters */
+    uint8_t* deflate_buffer;                     /* Compressed frames are built here (BUFFER_SIZE) */
+    _Atomic uint64_t events_queued_max;          /* server_shard_metrics() peaks and counters */
+    _Atomic uint64_t events_dropped;
+    _Atomic uint64_t send_queue_max;
+    _Atomic uint64_t slow_consumers;
+    AtomicHistogram iteration_times;             /* Poll iterations, wait excluded */
+    uint64_t waited_us;                          /* Time the current iteration blocked */
+    EventQueue event_queue;                      /* Event queue for Python */
+    int event_queue_ready;
+    int queued_views;                            /* Queued events holding buffer views */
+    int view_clients[MAX_CLIENTS];               /* Sessions with views this poll cycle */
+    int view_client_count;
+    int deferred_clients[MAX_CLIENTS];           /* Sessions whose reads were paused */
+    int deferred_count;
+    size_t events_pushed;                        /* Producer-side event counter */
+    TimerWheel timers;                           /* Clocks and activity checks of the sessions */
+    uint64_t now_ms;                             /* When the last wait returned */
+    uint64_t wait_until;                         /* End of the current wait (UINT64_MAX if none) */
+    int wake_pipe[2];                            /* Cuts the wait short for an earlier timer */
+    int wake_pending;
+    pthread_mutex_t lock;                        /* Guards the session table and the timers */
+    pthread_t thread;
+    int thread_started;
+} Reactor;
+
+static IoBackend io_backend = IO_BACKEND_POLL;   /* Backend chosen by server_init() */
+static Reactor* reactors[MAX_SHARDS];
+static int shard_count = 0;
+static int next_drain_shard = 0;                 /* Round-robin start for server_poll_batch() */
+
+/* fd -> owner table: shard * MAX_CLIENTS + client index, -1 when unused.
+ * Sized once from RLIMIT_NOFILE so lookups never race with a resize. */
+static _Atomic int* fd_map = NULL;
+static int fd_map_size = 0;
+
+/* Threading: reactors run on native threads once started; the event
+ * queues themselves are lock-free. */
+static atomic_int poll_thread_running = 0;       /* Native reactor threads active */
+static int poll_thread_timeout_ms = 100;
+static int copy_payloads = 0;                    /* Views disabled (threaded mode) */
+static int wakeup_pipe[2] = { -1, -1 };          /* Reactors -> consumer wakeup */
+static atomic_int wakeup_pending = 0;
+static atomic_int idle_timeout_ms = 0;           /* server_set_timeouts(), 0 when off */
+static atomic_int heartbeat_interval_ms = 0;
+static int listen_backlog = SOMAXCONN;           /* server_set_backlog() */
+static atomic_uint session_serials = 0;          /* Last ClientSession.serial handed out */
+
+_Static_assert(POOL_MAX_BLOCK == BUFFER_SIZE, "largest pool class must hold a full frame");
+_Static_assert((long long)MAX_SHARDS * MAX_CLIENTS < (1LL << 31), "fd map entries must fit an int");
 
 /* ========== Helper Functions ========== */
 
+static void close_client(Reactor* r, int client_index);
+static void arm_activity_timer(Reactor* r, int client_index);
+static int deliver_frame(Reactor* r, int client_index, SharedFrame* frame);
+static void close_streams(void);
+static int relay_move(Reactor* r, int client_index, uint16_t message_id,
+                      const uint8_t* payload, uint32_t payload_length);
+
 /* Set socket to non-blocking mode */
 static int set_nonblocking(int fd) {
     int flags = fcntl(fd, F_GETFL, 0);
@@ -38,453 +128,2683 @@ static int set_nonblocking(int fd) {
     return 0;
 }
 
-/* Add event to queue */
-static void enqueue_event(NetworkEvent event) {
-    if (event_queue_count >= 1024) {
-        fprintf(stderr, "Event queue full, dropping event\n");
-        if (event.payload_data) {
+/* Raise a metrics maximum; its writers hold the reactor lock */
+static void raise_peak(_Atomic uint64_t* peak, uint64_t value) {
+    if (value > atomic_load_explicit(peak, memory_order_relaxed)) {
+        atomic_store_explicit(peak, value, memory_order_relaxed);
+    }
+}
+
+/* Add event to queue (the queue grows; it only drops when out of memory) */
+static void enqueue_event(Reactor* r, NetworkEvent event) {
+    if (!r->event_queue_ready || event_queue_push(&r->event_queue, &event) == -1) {
+        fprintf(stderr, "Event queue unavailable, dropping event\n");
+        atomic_fetch_add_explicit(&r->events_dropped, 1, memory_order_relaxed);
+        if (event.payload_data && !(event.flags & EVENT_FLAG_PAYLOAD_VIEW)) {
             free(event.payload_data);
         }
         return;
     }
-    event_queue[event_queue_tail] = event;
-    event_queue_tail = (event_queue_tail + 1) % 1024;
-    event_queue_count++;
+    if (event.flags & EVENT_FLAG_PAYLOAD_VIEW) {
+        r->queued_views++;
+    }
+    r->events_pushed++;
+    raise_peak(&r->events_queued_max, event_queue_size(&r->event_queue));
 }
 
-/* Find client index by file descriptor */
-static int find_client_index(int fd) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].fd == fd) {
-            return i;
-        }
+/* Wake a consumer blocked in server_poll() while the reactor threads run */
+static void notify_consumer(void) {
+    if (wakeup_pipe[1] == -1 || atomic_exchange(&wakeup_pending, 1)) {
+        return;
+    }
+    char byte = 1;
+    if (write(wakeup_pipe[1], &byte, 1) == -1 && errno != EAGAIN) {
+        perror("write wakeup");
     }
-    return -1;
 }
 
-/* Find pollfd index by file descriptor */
-static int find_pollfd_index(int fd) {
-    for (int i = 0; i < fd_count; i++) {
-        if (ufds[i].fd == fd) {
-            return i;
-        }
+/* Turn a view payload into an owned copy */
+static void materialize_event(Reactor* r, NetworkEvent* event) {
+    uint8_t* copy = malloc(event->payload_length);
+    if (copy) {
+        memcpy(copy, event->payload_data, event->payload_length);
     }
-    return -1;
+    event->payload_data = copy;
+    event->flags &= ~EVENT_FLAG_PAYLOAD_VIEW;
+    r->queued_views--;
 }
 
-/* Add new file descriptor to poll array */
-static int add_to_poll(int fd) {
-    if (fd_count >= MAX_CLIENTS + 1) {
-        fprintf(stderr, "Maximum clients reached\n");
-        return -1;
+typedef struct {
+    Reactor* reactor;
+    int client_fd;                               /* -1 matches every client */
+} EventFilter;
+
+static void materialize_if_owned_by(NetworkEvent* event, void* ctx) {
+    EventFilter* filter = ctx;
+    if ((event->flags & EVENT_FLAG_PAYLOAD_VIEW)
+        && (filter->client_fd == -1 || event->client_fd == filter->client_fd)) {
+        materialize_event(filter->reactor, event);
     }
-    ufds[fd_count].fd = fd;
-    ufds[fd_count].events = POLLIN;
-    fd_count++;
-    return 0;
 }
 
-/* Remove file descriptor from poll array */
-static void remove_from_poll(int fd) {
-    int index = find_pollfd_index(fd);
-    if (index == -1) {
+/* Copy out queued views of one client (client_fd) or of everyone (-1).
+ * Views only exist without reactor threads, so this runs single-threaded. */
+static void materialize_queued_views(Reactor* r, int client_fd) {
+    if (r->queued_views == 0) {
         return;
     }
-    
-    /* Move last element to this position */
-    if (index < fd_count - 1) {
-        ufds[index] = ufds[fd_count - 1];
+    EventFilter filter = { r, client_fd };
+    event_queue_for_each(&r->event_queue, materialize_if_owned_by, &filter);
+}
+
+/* Owner entry of a file descriptor (-1 if not a client) */
+static int fd_map_get(int fd) {
+    if (fd < 0 || fd >= fd_map_size) {
+        return -1;
     }
-    fd_count--;
+    return atomic_load_explicit(&fd_map[fd], memory_order_acquire);
 }
 
-/* Initialize client session */
-static void init_client_session(int index, int fd) {
-    clients[index].fd = fd;
-    clients[index].state = CLIENT_CONNECTED;
-    clients[index].recv_offset = 0;
-    clients[index].send_offset = 0;
-    clients[index].send_length = 0;
-    clients[index].username[0] = '\0';
-    clients[index].user_id = 0;
-    clients[index].game_id = -1;
-    memset(clients[index].recv_buffer, 0, BUFFER_SIZE);
-    memset(clients[index].send_buffer, 0, BUFFER_SIZE);
+/* Record (or clear with -1) the shard/client owning a file descriptor */
+static int fd_map_set(int fd, int owner) {
+    if (fd < 0 || fd >= fd_map_size) {
+        if (owner != -1) {
+            fprintf(stderr, "fd %d exceeds the fd table (%d entries)\n", fd, fd_map_size);
+            return -1;
+        }
+        return 0;
+    }
+    atomic_store_explicit(&fd_map[fd], owner, memory_order_release);
+    return 0;
 }
 
-/* ========== Server Management Functions ========== */
+/* Find client index by file descriptor within reactor r (O(1) through fd_map) */
+static int find_client_index(Reactor* r, int fd) {
+    int owner = fd_map_get(fd);
+    if (owner == -1 || owner / MAX_CLIENTS != r->index) {
+        return -1;
+    }
+    return owner % MAX_CLIENTS;
+}
 
-int server_init(int port) {
-    struct sockaddr_in server_addr;
-    
-    /* Initialize client array */
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        clients[i].fd = -1;
-        clients[i].state = CLIENT_DISCONNECTED;
+/* Lock the reactor that owns client_fd; returns NULL if the fd is unknown.
+ * Retries when a pin moves the session between lookup and locking. */
+static Reactor* lock_client(int client_fd, int* client_index) {
+    for (;;) {
+        int owner = fd_map_get(client_fd);
+        if (owner == -1) {
+            return NULL;
+        }
+        Reactor* r = reactors[owner / MAX_CLIENTS];
+        pthread_mutex_lock(&r->lock);
+        if (fd_map_get(client_fd) == owner) {
+            *client_index = owner % MAX_CLIENTS;
+            return r;
+        }
+        pthread_mutex_unlock(&r->lock);
     }
-    
-    /* Create listening socket */
-    listener_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (listener_fd == -1) {
-        perror("socket");
-        return -1;
+}
+
+/* Pick the I/O backend: CHESS_IO_BACKEND=poll|epoll overrides the default */
+static IoBackend select_backend(void) {
+    const char* requested = getenv("CHESS_IO_BACKEND");
+#ifdef __linux__
+    if (requested && strcmp(requested, "poll") == 0) {
+        return IO_BACKEND_POLL;
     }
-    
-    /* Set socket options */
-    int opt = 1;
-    if (setsockopt(listener_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
-        perror("setsockopt");
-        close(listener_fd);
-        return -1;
+    return IO_BACKEND_EPOLL;
+#else
+    if (requested && strcmp(requested, "epoll") == 0) {
+        fprintf(stderr, "epoll backend not available, using poll\n");
     }
-    
-    /* Set non-blocking */
-    if (set_nonblocking(listener_fd) == -1) {
-        close(listener_fd);
-        return -1;
+    return IO_BACKEND_POLL;
+#endif
+}
+
+/* Register a file descriptor with the reactor's backend */
+static int add_to_poll(Reactor* r, int fd, int client_index) {
+#ifdef __linux__
+    if (io_backend == IO_BACKEND_EPOLL) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        ev.data.u32 = client_index == LISTENER_INDEX ? LISTENER_TAG
+                    : client_index == WAKEUP_INDEX   ? WAKEUP_TAG
+                                                     : (uint32_t)client_index;
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            perror("epoll_ctl ADD");
+            return -1;
+        }
+        return 0;
     }
-    
-    /* Bind to port */
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(port);
-    
-    if (bind(listener_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
-        perror("bind");
-        close(listener_fd);
+#endif
+    if (r->fd_count >= MAX_CLIENTS + 2) {
+        fprintf(stderr, "Maximum clients reached\n");
         return -1;
     }
-    
-    /* Listen for connections */
-    if (listen(listener_fd, 10) == -1) {
-        perror("listen");
-        close(listener_fd);
-        return -1;
+    r->ufds[r->fd_count].fd = fd;
+    r->ufds[r->fd_count].events = POLLIN;
+    r->ufds[r->fd_count].revents = 0;
+    r->pollfd_client[r->fd_count] = client_index;
+    if (client_index >= 0) {
+        r->client_pollfd[client_index] = r->fd_count;
     }
-    
-    /* Add listener to poll array */
-    ufds[0].fd = listener_fd;
-    ufds[0].events = POLLIN;
-    fd_count = 1;
-    
-    printf("TCP Server initialized on port %d\n", port);
+    r->fd_count++;
     return 0;
 }
 
-void server_shutdown(void) {
-    /* Close all client connections */
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].fd != -1) {
-            close(clients[i].fd);
-            clients[i].fd = -1;
-        }
+/* Unregister a client's file descriptor from the reactor's backend */
+static void remove_from_poll(Reactor* r, int fd, int client_index) {
+#ifdef __linux__
+    if (io_backend == IO_BACKEND_EPOLL) {
+        epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        return;
     }
-    
-    /* Close listener socket */
-    if (listener_fd != -1) {
-        close(listener_fd);
-        listener_fd = -1;
+#endif
+    int index = r->client_pollfd[client_index];
+    if (index <= 0 || index >= r->fd_count || r->ufds[index].fd != fd) {
+        return;
     }
-    
-    fd_count = 0;
-    printf("Server shutdown complete\n");
+
+    /* Move last element to this position */
+    if (index < r->fd_count - 1) {
+        r->ufds[index] = r->ufds[r->fd_count - 1];
+        r->pollfd_client[index] = r->pollfd_client[r->fd_count - 1];
+        r->client_pollfd[r->pollfd_client[index]] = index;
+    }
+    r->fd_count--;
 }
 
-/* Handle new incoming connection */
-static void handle_new_connection(void) {
-    struct sockaddr_in client_addr;
-    socklen_t addr_len = sizeof(client_addr);
-    
-    int new_fd = accept(listener_fd, (struct sockaddr*)&client_addr, &addr_len);
-    if (new_fd == -1) {
-        if (errno != EWOULDBLOCK && errno != EAGAIN) {
-            perror("accept");
+/* Ask the backend to report (or stop reporting) write readiness */
+static void set_write_interest(Reactor* r, int client_index, int enable) {
+    ClientSession* client = &r->clients[client_index];
+    if (client->want_write == enable) {
+        return;
+    }
+    client->want_write = enable;
+#ifdef __linux__
+    if (io_backend == IO_BACKEND_EPOLL) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (enable ? EPOLLOUT : 0);
+        ev.data.u32 = (uint32_t)client_index;
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_MOD, client->fd, &ev) == -1) {
+            perror("epoll_ctl MOD");
         }
         return;
     }
-    
-    /* Set non-blocking */
-    if (set_nonblocking(new_fd) == -1) {
-        close(new_fd);
+#endif
+    int index = r->client_pollfd[client_index];
+    if (index > 0 && index < r->fd_count && r->ufds[index].fd == client->fd) {
+        r->ufds[index].events = POLLIN | (enable ? POLLOUT : 0);
+    }
+}
+
+/* Take a free slot off a reactor's freelist (-1 if full); the most
+ * recently released slot comes first, its session is still cache-warm */
+static int acquire_slot(Reactor* r) {
+    return r->free_count > 0 ? r->free_slots[--r->free_count] : -1;
+}
+
+/* Give back a slot whose session was closed or moved to another shard */
+static void release_slot(Reactor* r, int client_index) {
+    r->free_slots[r->free_count++] = client_index;
+}
+
+/* Drop a session's game route and the opponent's side of it */
+static void clear_route(Reactor* r, int client_index) {
+    ClientSession* client = &r->clients[client_index];
+    if (client->peer_fd == -1) {
         return;
     }
-    
-    /* Find free slot in client array */
-    int client_index = -1;
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].fd == -1) {
-            client_index = i;
-            break;
+    int peer_index = find_client_index(r, client->peer_fd);
+    if (peer_index != -1 && r->clients[peer_index].peer_fd == client->fd) {
+        r->clients[peer_index].peer_fd = -1;
+        if (r->clients[peer_index].state == CLIENT_IN_GAME) {
+            r->clients[peer_index].state = CLIENT_AUTHENTICATED;
         }
     }
-    
-    if (client_index == -1) {
-        fprintf(stderr, "No free client slots\n");
-        close(new_fd);
-        return;
+    client->peer_fd = -1;
+    if (client->state == CLIENT_IN_GAME) {
+        client->state = CLIENT_AUTHENTICATED;
     }
-    
-    /* Add to poll array */
-    if (add_to_poll(new_fd) == -1) {
-        close(new_fd);
-        return;
+}
+
+/* Initialize client session (buffers start at the smallest pool class) */
+static int init_client_session(Reactor* r, int index, int fd) {
+    ClientSession* client = &r->clients[index];
+    client->recv_buffer = pool_acquire(POOL_MIN_BLOCK, &client->recv_capacity);
+    if (!client->recv_buffer) {
+        fprintf(stderr, "Out of memory allocating session buffer\n");
+        return -1;
     }
-    
-    /* Initialize client session */
-    init_client_session(client_index, new_fd);
-    
-    /* Enqueue new connection event */
-    NetworkEvent event = {
-        .type = EVENT_NEW_CONNECTION,
-        .client_fd = new_fd,
-        .message_id = 0,
-        .payload_length = 0,
-        .payload_data = NULL
-    };
-    enqueue_event(event);
-    
-    printf("New connection from %s:%d (fd=%d)\n",
-           inet_ntoa(client_addr.sin_addr),
-           ntohs(client_addr.sin_port),
-           new_fd);
+    client->fd = fd;
+    client->state = CLIENT_CONNECTED;
+    client->recv_start = 0;
+    client->recv_offset = 0;
+    client->send_queue.head = NULL;
+    client->send_queue.tail = NULL;
+    client->send_queue.bytes = 0;
+    client->want_write = 0;
+    client->username[0] = '\0';
+    client->user_id = 0;
+    client->game_id = -1;
+    client->peer_fd = -1;
+    client->speaks_binary = 0;
+    client->last_active_ms = timer_now_ms();
+    client->heartbeat_due_ms = 0;
+    memset(&client->activity_timer, 0, sizeof(Timer));
+    memset(&client->clock_timer, 0, sizeof(Timer));
+    client->clock_ms = 0;
+    client->increment_ms = 0;
+    client->switched_at_ms = 0;
+    client->has_clock = 0;
+    client->serial = atomic_fetch_add(&session_serials, 1) + 1;
+    client->compression = COMPRESSION_NONE;
+    client->deflater = NULL;
+    client->request_us = 0;
+    client->request_id = 0;
+    arm_activity_timer(r, index);
+    return 0;
 }
 
-/* Process received data and extract complete messages */
-static void process_client_data(int client_index) {
-    ClientSession* client = &clients[client_index];
-    
-    while (client->recv_offset >= HEADER_SIZE) {
-        /* Parse header */
-        MessageHeader* header = (MessageHeader*)client->recv_buffer;
-        uint16_t message_id = ntohs(header->message_id);
-        uint32_t payload_length = ntohl(header->payload_length);
-        
-        /* Check if we have complete message */
-        if (client->recv_offset < HEADER_SIZE + payload_length) {
-            break; /* Need more data */
-        }
-        
-        /* Extract payload */
-        uint8_t* payload_data = NULL;
-        if (payload_length > 0) {
-            payload_data = malloc(payload_length);
-            if (payload_data) {
-                memcpy(payload_data, client->recv_buffer + HEADER_SIZE, payload_length);
-            }
-        }
-        
-        /* Enqueue message event */
-        NetworkEvent event = {
-            .type = EVENT_MESSAGE_RECEIVED,
-            .client_fd = client->fd,
-            .message_id = message_id,
-            .payload_length = payload_length,
-            .payload_data = payload_data
-        };
-        enqueue_event(event);
-        
-        /* Remove processed message from buffer */
-        size_t message_size = HEADER_SIZE + payload_length;
-        memmove(client->recv_buffer, 
-                client->recv_buffer + message_size,
-                client->recv_offset - message_size);
-        client->recv_offset -= message_size;
+/* Return a session's buffers to the pool and drop unsent data */
+static void release_client_buffers(ClientSession* client) {
+    pool_release(client->recv_buffer, client->recv_capacity);
+    client->recv_buffer = NULL;
+    client->recv_capacity = 0;
+    client->recv_start = 0;
+    client->recv_offset = 0;
+    send_queue_clear(&client->send_queue);
+    client->want_write = 0;
+    if (client->deflater) {
+        deflateEnd(client->deflater);
+        free(client->deflater);
+        client->deflater = NULL;
     }
 }
 
-/* Handle data from client */
-static void handle_client_data(int fd) {
-    int client_index = find_client_index(fd);
-    if (client_index == -1) {
-        return;
+/* Move unparsed receive data into a block of the class that fits `needed`
+ * bytes. Only legal while no views point into the current block. */
+static int resize_recv_buffer(ClientSession* client, size_t needed) {
+    size_t capacity;
+    uint8_t* block = pool_acquire(needed, &capacity);
+    if (!block) {
+        return -1;
     }
-    
-    ClientSession* client = &clients[client_index];
-    
-    /* Receive data */
-    ssize_t bytes_received = recv(fd, 
-                                   client->recv_buffer + client->recv_offset,
-                                   BUFFER_SIZE - client->recv_offset,
-                                   0);
-    
-    if (bytes_received <= 0) {
-        if (bytes_received == 0 || (errno != EWOULDBLOCK && errno != EAGAIN)) {
-            /* Connection closed or error */
-            disconnect_client(fd);
-        }
-        return;
+    size_t unparsed = client->recv_offset - client->recv_start;
+    if (unparsed > 0) {
+        memcpy(block, client->recv_buffer + client->recv_start, unparsed);
     }
-    
-    client->recv_offset += bytes_received;
-    
-    /* Process received data */
-    process_client_data(client_index);
+    pool_release(client->recv_buffer, client->recv_capacity);
+    client->recv_buffer = block;
+    client->recv_capacity = capacity;
+    client->recv_start = 0;
+    client->recv_offset = unparsed;
+    return 0;
 }
 
-/* Main poll loop */
-int server_poll(int timeout_ms) {
-    int poll_count = poll(ufds, fd_count, timeout_ms);
-    
-    if (poll_count == -1) {
-        perror("poll");
-        return -1;
+/* Slide unparsed data to the front of the receive buffer */
+static void compact_recv_buffer(ClientSession* client) {
+    size_t unparsed = client->recv_offset - client->recv_start;
+    if (client->recv_start > 0 && unparsed > 0) {
+        memmove(client->recv_buffer, client->recv_buffer + client->recv_start, unparsed);
     }
-    
-    if (poll_count == 0) {
-        return 0; /* Timeout */
+    client->recv_start = 0;
+    client->recv_offset = unparsed;
+}
+
+/* Payload bytes still missing from the frame at the read cursor (0 if unknown) */
+static size_t pending_frame_size(const ClientSession* client) {
+    if (client->recv_offset - client->recv_start < HEADER_SIZE) {
+        return 0;
     }
-    
-    /* Check for events */
-    for (int i = 0; i < fd_count; i++) {
-        if (ufds[i].revents == 0) {
-            continue;
-        }
-        
-        /* Check for errors */
-        if (ufds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-            if (ufds[i].fd != listener_fd) {
-                disconnect_client(ufds[i].fd);
-            }
+    const MessageHeader* header = (const MessageHeader*)(client->recv_buffer + client->recv_start);
+    return HEADER_SIZE + (size_t)ntohl(header->payload_length);
+}
+
+/* The previous poll cycle is over: views handed out then are no longer
+ * referenced, so their buffer space can be reclaimed. */
+static void release_buffer_views(Reactor* r) {
+    materialize_queued_views(r, -1);
+
+    for (int i = 0; i < r->view_client_count; i++) {
+        ClientSession* client = &r->clients[r->view_clients[i]];
+        client->views_pending = 0;
+        if (client->fd == -1) {
             continue;
         }
-        
-        /* Handle events */
-        if (ufds[i].revents & POLLIN) {
-            if (ufds[i].fd == listener_fd) {
-                /* New connection */
-                handle_new_connection();
-            } else {
-                /* Data from client */
-                handle_client_data(ufds[i].fd);
+        if (client->recv_start == client->recv_offset) {
+            client->recv_start = 0;
+            client->recv_offset = 0;
+            /* Hand an oversized block back once the burst has been consumed */
+            if (client->recv_capacity > POOL_MIN_BLOCK) {
+                resize_recv_buffer(client, POOL_MIN_BLOCK);
             }
         }
     }
-    
-    return poll_count;
+    r->view_client_count = 0;
 }
 
-/* ========== Message Handling Functions ========== */
+/* ========== Session Timers ========== */
 
-int send_message(int client_fd, uint16_t message_id, const uint8_t* payload, uint32_t payload_length) {
-    int client_index = find_client_index(client_fd);
-    if (client_index == -1) {
-        fprintf(stderr, "Client fd %d not found\n", client_fd);
-        return -1;
-    }
-    
-    ClientSession* client = &clients[client_index];
-    
-    /* Prepare header */
-    MessageHeader header;
-    header.message_id = htons(message_id);
-    header.payload_length = htonl(payload_length);
-    
-    /* Calculate total size */
-    size_t total_size = HEADER_SIZE + payload_length;
-    if (total_size > BUFFER_SIZE) {
-        fprintf(stderr, "Message too large: %zu bytes\n", total_size);
-        return -1;
-    }
-    
-    /* Build message in send buffer */
-    memcpy(client->send_buffer, &header, HEADER_SIZE);
-    if (payload_length > 0 && payload) {
-        memcpy(client->send_buffer + HEADER_SIZE, payload, payload_length);
+/* Wake a reactor blocked in its wait; the caller holds the reactor lock */
+static void wake_reactor(Reactor* r) {
+    if (r->wake_pipe[1] == -1 || r->wake_pending) {
+        return;
     }
-    
-    /* Send data */
-    ssize_t bytes_sent = send(client_fd, client->send_buffer, total_size, 0);
-    if (bytes_sent == -1) {
-        if (errno != EWOULDBLOCK && errno != EAGAIN) {
-            perror("send");
-            return -1;
-        }
-        return 0; /* Would block, try again later */
+    char byte = 1;
+    if (write(r->wake_pipe[1], &byte, 1) == -1 && errno != EAGAIN) {
+        perror("write reactor wakeup");
+        return;
     }
-    
-    return bytes_sent;
+    r->wake_pending = 1;
 }
 
-NetworkEvent* get_next_event(void) {
-    if (event_queue_count == 0) {
-        return NULL;
-    }
-    
-    NetworkEvent* event = malloc(sizeof(NetworkEvent));
-    if (!event) {
-        return NULL;
+static void drain_wake_pipe(Reactor* r) {
+    char drain[64];
+    while (read(r->wake_pipe[0], drain, sizeof(drain)) > 0) {
     }
-    
-    *event = event_queue[event_queue_head];
-    event_queue_head = (event_queue_head + 1) % 1024;
-    event_queue_count--;
-    
-    return event;
+    r->wake_pending = 0;
 }
 
-void free_event(NetworkEvent* event) {
-    if (event) {
-        if (event->payload_data) {
-            free(event->payload_data);
-        }
-        free(event);
+/* Arm a session timer; a reactor thread sleeping past the deadline is woken
+ * so that it recomputes its timeout */
+static void arm_timer(Reactor* r, Timer* timer, uint64_t deadline) {
+    timer_arm(&r->timers, timer, deadline);
+    if (deadline < r->wait_until) {
+        wake_reactor(r);
     }
 }
 
-/* ========== Client Management Functions ========== */
+/* Schedule the next idle or heartbeat check of a session. Received data
+ * only moves last_active_ms; the check re-arms itself from it. */
+static void arm_activity_timer(Reactor* r, int client_index) {
+    ClientSession* client = &r->clients[client_index];
+    int idle = atomic_load(&idle_timeout_ms);
+    int heartbeat = atomic_load(&heartbeat_interval_ms);
+    uint64_t next = UINT64_MAX;
 
-ClientSession* get_client_session(int client_fd) {
-    int client_index = find_client_index(client_fd);
-    if (client_index == -1) {
-        return NULL;
+    if (idle > 0) {
+        next = client->last_active_ms + (uint64_t)idle;
+    }
+    if (heartbeat > 0) {
+        uint64_t due = client->last_active_ms + (uint64_t)heartbeat;
+        if (due < client->heartbeat_due_ms) {
+            due = client->heartbeat_due_ms;
+        }
+        if (due < next) {
+            next = due;
+        }
     }
-    return &clients[client_index];
-}
 
-void disconnect_client(int client_fd) {
-    int client_index = find_client_index(client_fd);
-    if (client_index == -1) {
-        return;
+    if (next == UINT64_MAX) {
+        timer_cancel(&r->timers, &client->activity_timer);
+    } else {
+        arm_timer(r, &client->activity_timer, next);
     }
-    
-    /* Enqueue disconnect event */
+}
+
+static void queue_timer_event(Reactor* r, EventType type, int client_fd) {
     NetworkEvent event = {
-        .type = EVENT_CLIENT_DISCONNECTED,
+        .type = type,
         .client_fd = client_fd,
         .message_id = 0,
         .payload_length = 0,
         .payload_data = NULL
     };
-    enqueue_event(event);
-    
-    /* Remove from poll array */
-    remove_from_poll(client_fd);
-    
-    /* Close socket */
-    close(client_fd);
-    
-    /* Reset client session */
-    clients[client_index].fd = -1;
-    clients[client_index].state = CLIENT_DISCONNECTED;
-    
-    printf("Client disconnected (fd=%d)\n", client_fd);
+    enqueue_event(r, event);
 }
 
-int get_client_count(void) {
-    int count = 0;
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].fd != -1) {
-            count++;
-        }
+static void check_activity(Reactor* r, int client_index, uint64_t now) {
+    ClientSession* client = &r->clients[client_index];
+    int idle = atomic_load(&idle_timeout_ms);
+    int heartbeat = atomic_load(&heartbeat_interval_ms);
+
+    if (idle > 0 && now >= client->last_active_ms + (uint64_t)idle) {
+        printf("Idle timeout (fd=%d)\n", client->fd);
+        queue_timer_event(r, EVENT_IDLE_TIMEOUT, client->fd);
+        close_client(r, client_index);
+        return;
+    }
+    if (heartbeat > 0 && now >= client->last_active_ms + (uint64_t)heartbeat
+        && now >= client->heartbeat_due_ms) {
+        queue_timer_event(r, EVENT_HEARTBEAT, client->fd);
+        client->heartbeat_due_ms = now + (uint64_t)heartbeat;
+    }
+    arm_activity_timer(r, client_index);
+}
+
+/* Time left on a session's clock */
+static uint32_t clock_remaining(const ClientSession* client, uint64_t now) {
+    if (!timer_armed(&client->clock_timer)) {
+        return client->clock_ms;
+    }
+    return client->clock_timer.deadline > now ? (uint32_t)(client->clock_timer.deadline - now) : 0;
+}
+
+static void stop_clock(Reactor* r, int client_index, uint64_t now) {
+    ClientSession* client = &r->clients[client_index];
+    client->clock_ms = clock_remaining(client, now);
+    timer_cancel(&r->timers, &client->clock_timer);
+}
+
+static void start_clock(Reactor* r, int client_index, uint64_t now) {
+    ClientSession* client = &r->clients[client_index];
+    if (!timer_armed(&client->clock_timer)) {
+        arm_timer(r, &client->clock_timer, now + client->clock_ms);
+    }
+}
+
+/* A routed player moved: stop their running clock, add the increment and
+ * start the opponent's. Returns 1 if the clocks were switched; a move made
+ * after the flag fell is left to the pending EVENT_FLAG_FALL. */
+static int switch_clocks(Reactor* r, int client_index) {
+    ClientSession* client = &r->clients[client_index];
+    if (client->state != CLIENT_IN_GAME || !timer_armed(&client->clock_timer)) {
+        return 0;
+    }
+    int peer_index = find_client_index(r, client->peer_fd);
+    if (peer_index == -1 || !r->clients[peer_index].has_clock) {
+        return 0;
+    }
+    uint64_t now = timer_now_ms();
+    if (clock_remaining(client, now) == 0) {
+        return 0;
+    }
+    stop_clock(r, client_index, now);
+    client->clock_ms += client->increment_ms;
+    client->switched_at_ms = now;
+    start_clock(r, peer_index, now);
+    return 1;
+}
+
+/* Run the timers that are due; the caller holds the reactor lock. Timers
+ * are members of the sessions, their offset tells which one fired. */
+static void expire_timers(Reactor* r) {
+    uint64_t now = timer_now_ms();
+    Timer* timer;
+
+    while ((timer = timer_wheel_expire(&r->timers, now)) != NULL) {
+        size_t offset = (size_t)((char*)timer - (char*)r->clients);
+        int client_index = (int)(offset / sizeof(ClientSession));
+        ClientSession* client = &r->clients[client_index];
+
+        if (offset % sizeof(ClientSession) == offsetof(ClientSession, clock_timer)) {
+            client->clock_ms = 0;
+            printf("Flag fall (fd=%d)\n", client->fd);
+            queue_timer_event(r, EVENT_FLAG_FALL, client->fd);
+        } else {
+            check_activity(r, client_index, now);
+        }
+    }
+}
+
+/* ========== Server Management Functions ========== */
+
+/* Create a non-blocking listening socket; SO_REUSEPORT lets shards share the port */
+static int open_listener(int port, int reuse_port) {
+    struct sockaddr_in server_addr;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+
+    /* Set socket options */
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
+        perror("setsockopt");
+        close(fd);
+        return -1;
+    }
+#ifdef SO_REUSEPORT
+    if (reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
+        perror("setsockopt SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
+#else
+    if (reuse_port) {
+        fprintf(stderr, "SO_REUSEPORT not available\n");
+        close(fd);
+        return -1;
+    }
+#endif
+
+    /* Set non-blocking */
+    if (set_nonblocking(fd) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    /* Bind to port */
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    /* Listen for connections */
+    if (listen(fd, listen_backlog) == -1) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Allocate and set up one shard */
+static Reactor* reactor_create(int index, int port, int reuse_port) {
+    Reactor* r = calloc(1, sizeof(Reactor));
+    if (!r) {
+        fprintf(stderr, "Out of memory creating reactor\n");
+        return NULL;
+    }
+    r->index = index;
+    r->listener_fd = -1;
+    r->epoll_fd = -1;
+    r->wake_pipe[0] = r->wake_pipe[1] = -1;
+    r->wait_until = UINT64_MAX;
+    timer_wheel_init(&r->timers, timer_now_ms());
+    pthread_mutex_init(&r->lock, NULL);
+
+    /* Initialize client array; views_pending/read_deferred track list
+     * membership, so they are only reset here and when the lists are
+     * drained, never on accept */
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        r->clients[i].fd = -1;
+        r->clients[i].state = CLIENT_DISCONNECTED;
+        r->free_slots[i] = MAX_CLIENTS - 1 - i;  /* Slot 0 on top */
+    }
+    r->free_count = MAX_CLIENTS;
+
+    if (event_queue_init(&r->event_queue) == -1) {
+        fprintf(stderr, "Out of memory creating event queue\n");
+        free(r);
+        return NULL;
+    }
+    r->event_queue_ready = 1;
+
+#ifdef __linux__
+    if (io_backend == IO_BACKEND_EPOLL) {
+        r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (r->epoll_fd == -1) {
+            perror("epoll_create1");
+            event_queue_destroy(&r->event_queue);
+            free(r);
+            return NULL;
+        }
+    }
+#endif
+
+    /* Create listening socket and wakeup pipe, register both with the backend */
+    r->listener_fd = open_listener(port, reuse_port);
+    int wake_ok = pipe(r->wake_pipe) == 0;
+    if (!wake_ok) {
+        perror("pipe");
+        r->wake_pipe[0] = r->wake_pipe[1] = -1;
+    }
+    if (r->listener_fd == -1 || add_to_poll(r, r->listener_fd, LISTENER_INDEX) == -1
+        || !wake_ok || set_nonblocking(r->wake_pipe[0]) == -1 || set_nonblocking(r->wake_pipe[1]) == -1
+        || add_to_poll(r, r->wake_pipe[0], WAKEUP_INDEX) == -1) {
+        if (r->listener_fd != -1) {
+            close(r->listener_fd);
+        }
+        for (int i = 0; i < 2; i++) {
+            if (r->wake_pipe[i] != -1) {
+                close(r->wake_pipe[i]);
+            }
+        }
+        if (r->epoll_fd != -1) {
+            close(r->epoll_fd);
+        }
+        event_queue_destroy(&r->event_queue);
+        free(r);
+        return NULL;
+    }
+    return r;
+}
+
+/* Close a shard's sockets and free it */
+static void reactor_destroy(Reactor* r) {
+    /* Close all client connections */
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (r->clients[i].fd != -1) {
+            fd_map_set(r->clients[i].fd, -1);
+            close(r->clients[i].fd);
+            r->clients[i].fd = -1;
+            release_client_buffers(&r->clients[i]);
+        }
+    }
+
+    /* Close listener socket */
+    if (r->listener_fd != -1) {
+        close(r->listener_fd);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (r->wake_pipe[i] != -1) {
+            close(r->wake_pipe[i]);
+        }
+    }
+    if (r->epoll_fd != -1) {
+        close(r->epoll_fd);
+    }
+    if (r->event_queue_ready) {
+        event_queue_destroy(&r->event_queue);
+    }
+    free(r->deflate_buffer);
+    pthread_mutex_destroy(&r->lock);
+    free(r);
+}
+
+int server_init(int port) {
+    return server_init_shards(port, 1);
+}
+
+int server_init_shards(int port, int shards) {
+    if (shard_count > 0) {
+        fprintf(stderr, "Server already initialized\n");
+        return -1;
+    }
+    if (shards < 1 || shards > MAX_SHARDS) {
+        fprintf(stderr, "Shard count must be between 1 and %d\n", MAX_SHARDS);
+        return -1;
+    }
+
+    /* Size the fd table once: descriptors never exceed RLIMIT_NOFILE */
+    struct rlimit limit;
+    int map_size = 65536;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        map_size = limit.rlim_cur > FD_MAP_LIMIT ? FD_MAP_LIMIT : (int)limit.rlim_cur;
+    }
+    fd_map = malloc((size_t)map_size * sizeof(*fd_map));
+    if (!fd_map) {
+        fprintf(stderr, "Out of memory creating fd map\n");
+        return -1;
+    }
+    for (int i = 0; i < map_size; i++) {
+        atomic_init(&fd_map[i], -1);
+    }
+    fd_map_size = map_size;
+
+    /* Choose the I/O backend */
+    io_backend = select_backend();
+
+    for (int i = 0; i < shards; i++) {
+        reactors[i] = reactor_create(i, port, shards > 1);
+        if (!reactors[i]) {
+            shard_count = i;
+            server_shutdown();
+            return -1;
+        }
+    }
+    shard_count = shards;
+    next_drain_shard = 0;
+
+    if (shards > 1) {
+        printf("TCP Server initialized on port %d (%s backend, %d shards)\n",
+               port, server_backend_name(), shards);
+    } else {
+        printf("TCP Server initialized on port %d (%s backend)\n", port, server_backend_name());
+    }
+    return 0;
+}
+
+void server_shutdown(void) {
+    server_stop_thread();
+    close_streams();
+
+    for (int i = 0; i < shard_count; i++) {
+        reactor_destroy(reactors[i]);
+        reactors[i] = NULL;
+    }
+    shard_count = 0;
+    pool_trim();
+    send_queue_trim();
+
+    free(fd_map);
+    fd_map = NULL;
+    fd_map_size = 0;
+
+    for (int i = 0; i < 2; i++) {
+        if (wakeup_pipe[i] != -1) {
+            close(wakeup_pipe[i]);
+            wakeup_pipe[i] = -1;
+        }
+    }
+    printf("Server shutdown complete\n");
+}
+
+/* Time a connection waited in the backlog. A fresh socket's last ACK is
+ * the one that completed the handshake, unless the client already sent
+ * data; TCP_INFO is Linux only, elsewhere nothing is recorded. */
+static void record_accept_latency(Reactor* r, int fd) {
+#if defined(__linux__) && defined(TCP_INFO)
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &length) == -1) {
+        return;
+    }
+    AcceptStats* stats = &r->accept_stats;
+    uint32_t waited = info.tcpi_last_ack_recv;
+    int bucket = 0;
+    for (uint32_t bound = 1; bucket < ACCEPT_LATENCY_BUCKETS - 1 && waited >= bound; bound *= 10) {
+        bucket++;
+    }
+    stats->latency_buckets[bucket]++;
+    stats->latency_total_ms += waited;
+    if (waited > stats->latency_max_ms) {
+        stats->latency_max_ms = waited;
+    }
+#else
+    (void)r;
+    (void)fd;
+#endif
+}
+
+int server_set_backlog(int backlog) {
+    listen_backlog = backlog > 0 ? backlog : SOMAXCONN;
+
+    /* listen() again on an open listener only resizes its queue */
+    for (int i = 0; i < shard_count; i++) {
+        if (listen(reactors[i]->listener_fd, listen_backlog) == -1) {
+            perror("listen");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void server_accept_stats(AcceptStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < shard_count; i++) {
+        pthread_mutex_lock(&reactors[i]->lock);
+        const AcceptStats* shard = &reactors[i]->accept_stats;
+        stats->accepted += shard->accepted;
+        stats->rejected += shard->rejected;
+        stats->batches += shard->batches;
+        if (shard->max_batch > stats->max_batch) {
+            stats->max_batch = shard->max_batch;
+        }
+        if (shard->latency_max_ms > stats->latency_max_ms) {
+            stats->latency_max_ms = shard->latency_max_ms;
+        }
+        stats->latency_total_ms += shard->latency_total_ms;
+        for (int b = 0; b < ACCEPT_LATENCY_BUCKETS; b++) {
+            stats->latency_buckets[b] += shard->latency_buckets[b];
+        }
+        pthread_mutex_unlock(&reactors[i]->lock);
+    }
+}
+
+void server_reset_accept_stats(void) {
+    for (int i = 0; i < shard_count; i++) {
+        pthread_mutex_lock(&reactors[i]->lock);
+        memset(&reactors[i]->accept_stats, 0, sizeof(AcceptStats));
+        pthread_mutex_unlock(&reactors[i]->lock);
+    }
+}
+
+void server_compression_stats(CompressionStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < shard_count; i++) {
+        pthread_mutex_lock(&reactors[i]->lock);
+        const CompressionStats* shard = &reactors[i]->compression_stats;
+        stats->messages += shard->messages;
+        stats->bytes_in += shard->bytes_in;
+        stats->bytes_out += shard->bytes_out;
+        pthread_mutex_unlock(&reactors[i]->lock);
+    }
+}
+
+/* Reads atomics only, so scrapers never wait on a busy reactor */
+int server_shard_metrics(int shard, ShardMetrics* out) {
+    if (shard < 0 || shard >= shard_count) {
+        return -1;
+    }
+    Reactor* r = reactors[shard];
+    out->events_queued = event_queue_size(&r->event_queue);
+    out->events_queued_max = atomic_load_explicit(&r->events_queued_max, memory_order_relaxed);
+    out->events_pushed = atomic_load_explicit(&r->event_queue.enqueued, memory_order_relaxed);
+    out->events_dropped = atomic_load_explicit(&r->events_dropped, memory_order_relaxed);
+    out->send_queue_max = atomic_load_explicit(&r->send_queue_max, memory_order_relaxed);
+    out->slow_consumers = atomic_load_explicit(&r->slow_consumers, memory_order_relaxed);
+    histogram_read(&r->iteration_times, &out->iteration);
+    return 0;
+}
+
+void server_reset_metrics_peaks(void) {
+    metrics_reset_message_peaks();
+    for (int i = 0; i < shard_count; i++) {
+        atomic_store_explicit(&reactors[i]->events_queued_max, 0, memory_order_relaxed);
+        atomic_store_explicit(&reactors[i]->send_queue_max, 0, memory_order_relaxed);
+        histogram_reset_peak(&reactors[i]->iteration_times);
+    }
+}
+
+/* Hook an accepted socket into the fd map, the backend and a session */
+static int register_connection(Reactor* r, int client_index, int fd) {
+    if (fd_map_set(fd, r->index * MAX_CLIENTS + client_index) == -1) {
+        return -1;
+    }
+    if (add_to_poll(r, fd, client_index) == -1) {
+        fd_map_set(fd, -1);
+        return -1;
+    }
+    if (init_client_session(r, client_index, fd) == -1) {
+        remove_from_poll(r, fd, client_index);
+        fd_map_set(fd, -1);
+        return -1;
+    }
+    return 0;
+}
+
+/* Accept one pending connection; returns 0 when the backlog is drained */
+static int accept_one_connection(Reactor* r) {
+    struct sockaddr_in client_addr;
+    socklen_t addr_len = sizeof(client_addr);
+
+#ifdef __linux__
+    int new_fd = accept4(r->listener_fd, (struct sockaddr*)&client_addr, &addr_len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    int new_fd = accept(r->listener_fd, (struct sockaddr*)&client_addr, &addr_len);
+#endif
+    if (new_fd == -1) {
+        if (errno == EINTR || errno == ECONNABORTED) {
+            return 1;
+        }
+        if (errno != EWOULDBLOCK && errno != EAGAIN) {
+            perror("accept");
+        }
+        return 0;
+    }
+
+#ifndef __linux__
+    /* Set non-blocking */
+    if (set_nonblocking(new_fd) == -1) {
+        close(new_fd);
+        r->accept_stats.rejected++;
+        return 1;
+    }
+#endif
+
+    /* Take a free slot; a full shard still drains its backlog, refusing
+     * connections instead of leaving them queued */
+    int client_index = acquire_slot(r);
+    if (client_index == -1) {
+        fprintf(stderr, "No free client slots\n");
+        close(new_fd);
+        r->accept_stats.rejected++;
+        return 1;
+    }
+
+    if (register_connection(r, client_index, new_fd) == -1) {
+        release_slot(r, client_index);
+        close(new_fd);
+        r->accept_stats.rejected++;
+        return 1;
+    }
+    r->client_count++;
+    r->accept_stats.accepted++;
+    record_accept_latency(r, new_fd);
+
+    /* Enqueue new connection event */
+    NetworkEvent event = {
+        .type = EVENT_NEW_CONNECTION,
+        .client_fd = new_fd,
+        .message_id = 0,
+        .payload_length = 0,
+        .payload_data = NULL
+    };
+    enqueue_event(r, event);
+
+    printf("New connection from %s:%d (fd=%d)\n",
+           inet_ntoa(client_addr.sin_addr),
+           ntohs(client_addr.sin_port),
+           new_fd);
+    return 1;
+}
+
+/* Handle new incoming connections: accept until the backlog is empty, as
+ * edge-triggered epoll will not report the rest again */
+static void handle_new_connection(Reactor* r) {
+    AcceptStats* stats = &r->accept_stats;
+    uint64_t before = stats->accepted;
+    while (accept_one_connection(r)) {
+    }
+    uint64_t batch = stats->accepted - before;
+    if (batch > 0) {
+        stats->batches++;
+        if (batch > stats->max_batch) {
+            stats->max_batch = (uint32_t)batch;
+        }
+    }
+}
+
+/* Process received data and extract complete messages.
+ * Payloads are handed out as views into recv_buffer; the read cursor
+ * advances past each frame and nothing is moved. */
+static void process_client_data(Reactor* r, int client_index) {
+    ClientSession* client = &r->clients[client_index];
+
+    while (client->recv_offset - client->recv_start >= HEADER_SIZE) {
+        /* Parse header */
+        uint8_t* frame = client->recv_buffer + client->recv_start;
+        MessageHeader* header = (MessageHeader*)frame;
+        uint16_t message_id = ntohs(header->message_id);
+        uint32_t payload_length = ntohl(header->payload_length);
+
+        /* Check if we have complete message */
+        size_t message_size = HEADER_SIZE + (size_t)payload_length;
+        if (client->recv_offset - client->recv_start < message_size) {
+            break; /* Need more data */
+        }
+        metrics_count_received(message_id & MSG_ID_MASK, (uint32_t)message_size);
+
+        /* Enqueue message event */
+        NetworkEvent event = {
+            .type = EVENT_MESSAGE_RECEIVED,
+            .client_fd = client->fd,
+            .message_id = message_id & MSG_ID_MASK,
+            .payload_length = payload_length,
+            .payload_data = payload_length > 0 ? frame + HEADER_SIZE : NULL,
+            .flags = (payload_length > 0 ? EVENT_FLAG_PAYLOAD_VIEW : 0)
+                   | ((message_id & MSG_FLAG_BINARY) ? EVENT_FLAG_BINARY : 0)
+        };
+        if (message_id & MSG_FLAG_BINARY) {
+            client->speaks_binary = 1;
+        }
+        if ((message_id & MSG_ID_MASK) == MSG_C2S_SET_COMPRESSION) {
+            /* Transport setting: applied here, Python never sees it */
+            uint8_t method = payload_length > 0 ? frame[HEADER_SIZE] : COMPRESSION_NONE;
+            client->compression = method == COMPRESSION_DEFLATE ? method : COMPRESSION_NONE;
+            client->recv_start += message_size;
+            continue;
+        }
+        if ((message_id & MSG_ID_MASK) == MSG_C2S_MAKE_MOVE && switch_clocks(r, client_index)) {
+            event.flags |= EVENT_FLAG_CLOCK_SWITCHED;
+        }
+        if (relay_move(r, client_index, message_id, event.payload_data, payload_length)) {
+            event.flags |= EVENT_FLAG_RELAYED;
+        }
+        if (payload_length > 0 && copy_payloads) {
+            /* The consumer runs concurrently, so it gets its own copy */
+            event.payload_data = malloc(payload_length);
+            if (event.payload_data) {
+                memcpy(event.payload_data, frame + HEADER_SIZE, payload_length);
+            }
+            event.flags &= ~EVENT_FLAG_PAYLOAD_VIEW;
+        } else if (payload_length > 0 && !client->views_pending) {
+            client->views_pending = 1;
+            r->view_clients[r->view_client_count++] = client_index;
+        }
+        if (!client->request_us) {
+            /* Timed until the next send_message() to this client */
+            client->request_us = metrics_now_us();
+            client->request_id = event.message_id;
+        }
+        enqueue_event(r, event);
+
+        /* Advance the read cursor past the processed message */
+        client->recv_start += message_size;
+    }
+
+    /* Nothing left and nothing referenced: rewind for free */
+    if (client->recv_start == client->recv_offset && !client->views_pending) {
+        client->recv_start = 0;
+        client->recv_offset = 0;
+    }
+}
+
+/* Make room at the tail of the receive buffer.
+ * Returns 1 if reading can go on, 0 if it must wait for the next poll
+ * cycle (views still reference the buffer), -1 if the frame can't fit. */
+static int reserve_recv_space(Reactor* r, int client_index) {
+    ClientSession* client = &r->clients[client_index];
+    size_t frame_size = pending_frame_size(client);
+    int frame_fits = frame_size == 0 || client->recv_start + frame_size <= client->recv_capacity;
+
+    if (client->recv_offset < client->recv_capacity && frame_fits) {
+        return 1;
+    }
+    if (frame_size > BUFFER_SIZE) {
+        return -1;
+    }
+    if (client->views_pending) {
+        if (!client->read_deferred) {
+            client->read_deferred = 1;
+            r->deferred_clients[r->deferred_count++] = client_index;
+        }
+        return 0;
+    }
+
+    /* Compact only when the pending frame can't fit in place */
+    if (frame_size > client->recv_capacity) {
+        if (resize_recv_buffer(client, frame_size) == -1) {
+            fprintf(stderr, "Out of memory growing receive buffer\n");
+            return -1;
+        }
+    } else {
+        compact_recv_buffer(client);
+    }
+    return client->recv_offset < client->recv_capacity ? 1 : -1;
+}
+
+/* Handle data from client: reads until the socket would block */
+static void handle_client_data(Reactor* r, int client_index) {
+    ClientSession* client = &r->clients[client_index];
+    int fd = client->fd;
+
+    for (;;) {
+        int room = reserve_recv_space(r, client_index);
+        if (room == 0) {
+            return; /* Resumed by the next server_poll() */
+        }
+        if (room == -1) {
+            /* A single frame larger than the buffer can never complete */
+            fprintf(stderr, "Receive buffer overflow (fd=%d)\n", fd);
+            close_client(r, client_index);
+            return;
+        }
+        size_t space = client->recv_capacity - client->recv_offset;
+
+        /* Receive data */
+        ssize_t bytes_received = recv(fd,
+                                       client->recv_buffer + client->recv_offset,
+                                       space,
+                                       0);
+
+        if (bytes_received > 0) {
+            client->recv_offset += bytes_received;
+            client->last_active_ms = r->now_ms;
+
+            /* Process received data */
+            process_client_data(r, client_index);
+            continue;
+        }
+
+        if (bytes_received == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_received == -1 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+            return;
+        }
+
+        /* Connection closed or error */
+        close_client(r, client_index);
+        return;
+    }
+}
+
+/* Socket became writable: push out queued data */
+static void handle_client_writable(Reactor* r, int client_index) {
+    ClientSession* client = &r->clients[client_index];
+
+    if (send_queue_flush(&client->send_queue, client->fd) == -1) {
+        perror("sendmsg");
+        close_client(r, client_index);
+        return;
+    }
+    set_write_interest(r, client_index, client->send_queue.head != NULL);
+}
+
+#ifdef __linux__
+/* epoll dispatch: the client index travels in the event data, so no lookup.
+ * The wait runs unlocked; dispatch holds the reactor lock. */
+static int server_poll_epoll(Reactor* r, int timeout_ms) {
+    struct epoll_event events[EPOLL_BATCH];
+    uint64_t wait_start = metrics_now_us();
+    int event_count = epoll_wait(r->epoll_fd, events, EPOLL_BATCH, timeout_ms);
+    r->waited_us = metrics_now_us() - wait_start;
+
+    if (event_count == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        perror("epoll_wait");
+        return -1;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    r->now_ms = timer_now_ms();
+    for (int i = 0; i < event_count; i++) {
+        uint32_t tag = events[i].data.u32;
+        uint32_t flags = events[i].events;
+
+        if (tag == LISTENER_TAG) {
+            handle_new_connection(r);
+            continue;
+        }
+        if (tag == WAKEUP_TAG) {
+            drain_wake_pipe(r);
+            continue;
+        }
+
+        int client_index = (int)tag;
+        if (r->clients[client_index].fd == -1) {
+            continue; /* Closed earlier in this batch */
+        }
+
+        /* Drain readable data first so a final message before FIN is kept */
+        if (flags & (EPOLLIN | EPOLLRDHUP)) {
+            handle_client_data(r, client_index);
+        }
+        if (r->clients[client_index].fd != -1 && (flags & (EPOLLERR | EPOLLHUP))) {
+            close_client(r, client_index);
+            continue;
+        }
+        if (r->clients[client_index].fd != -1 && (flags & EPOLLOUT)) {
+            handle_client_writable(r, client_index);
+        }
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return event_count;
+}
+#endif
+
+/* poll dispatch. poll() works on a snapshot of ufds[] so other threads may
+ * add or remove sessions while it blocks; stale entries are skipped. */
+static int server_poll_poll(Reactor* r, int timeout_ms) {
+    pthread_mutex_lock(&r->lock);
+    int count = r->fd_count;
+    memcpy(r->snapshot, r->ufds, (size_t)count * sizeof(struct pollfd));
+    memcpy(r->snapshot_client, r->pollfd_client, (size_t)count * sizeof(int));
+    pthread_mutex_unlock(&r->lock);
+
+    uint64_t wait_start = metrics_now_us();
+    int poll_count = poll(r->snapshot, count, timeout_ms);
+    r->waited_us = metrics_now_us() - wait_start;
+
+    if (poll_count == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        perror("poll");
+        return -1;
+    }
+
+    if (poll_count == 0) {
+        return 0; /* Timeout */
+    }
+
+    /* Check for events */
+    pthread_mutex_lock(&r->lock);
+    r->now_ms = timer_now_ms();
+    for (int i = 0; i < count; i++) {
+        short revents = r->snapshot[i].revents;
+        if (revents == 0) {
+            continue;
+        }
+
+        if (r->snapshot_client[i] == WAKEUP_INDEX) {
+            drain_wake_pipe(r);
+            continue;
+        }
+        if (r->snapshot_client[i] == LISTENER_INDEX) {
+            /* New connection */
+            if (revents & POLLIN) {
+                handle_new_connection(r);
+            }
+            continue;
+        }
+
+        int client_index = r->snapshot_client[i];
+        if (r->clients[client_index].fd != r->snapshot[i].fd) {
+            continue; /* Session closed or slot reused meanwhile */
+        }
+
+        /* Check for errors */
+        if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            close_client(r, client_index);
+            continue;
+        }
+
+        /* Data from client */
+        if (revents & POLLIN) {
+            handle_client_data(r, client_index);
+        }
+
+        /* Room to send queued data */
+        if ((revents & POLLOUT) && r->clients[client_index].fd != -1) {
+            handle_client_writable(r, client_index);
+        }
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return poll_count;
+}
+
+/* Resume sessions whose reads were paused by outstanding views */
+static int resume_deferred_reads(Reactor* r) {
+    int resumed = r->deferred_count;
+    int pending[MAX_CLIENTS];
+    memcpy(pending, r->deferred_clients, (size_t)r->deferred_count * sizeof(int));
+    r->deferred_count = 0;
+
+    for (int i = 0; i < resumed; i++) {
+        ClientSession* client = &r->clients[pending[i]];
+        client->read_deferred = 0;
+        if (client->fd != -1) {
+            handle_client_data(r, pending[i]);
+        }
+    }
+    return resumed;
+}
+
+/* One reactor iteration: reclaim views, wait for I/O (no longer than the
+ * next timer), dispatch, run due timers */
+static int run_poll_cycle(Reactor* r, int timeout_ms) {
+    uint64_t started = metrics_now_us();
+    r->waited_us = 0;
+    pthread_mutex_lock(&r->lock);
+    size_t pushed_before = r->events_pushed;
+    release_buffer_views(r);
+    if (resume_deferred_reads(r) > 0) {
+        timeout_ms = 0; /* Already have work, don't block */
+    }
+    uint64_t now = timer_now_ms();
+    timeout_ms = timer_wheel_timeout(&r->timers, now, timeout_ms);
+    r->wait_until = timeout_ms < 0 ? UINT64_MAX - 1 : now + (uint64_t)timeout_ms;
+    pthread_mutex_unlock(&r->lock);
+
+    int result;
+#ifdef __linux__
+    if (io_backend == IO_BACKEND_EPOLL) {
+        result = server_poll_epoll(r, timeout_ms);
+    } else
+#endif
+    result = server_poll_poll(r, timeout_ms);
+
+    pthread_mutex_lock(&r->lock);
+    r->wait_until = UINT64_MAX;
+    expire_timers(r);
+    pthread_mutex_unlock(&r->lock);
+
+    uint64_t elapsed = metrics_now_us() - started;
+    histogram_record(&r->iteration_times, elapsed > r->waited_us ? elapsed - r->waited_us : 0);
+
+    if (r->events_pushed != pushed_before) {
+        notify_consumer();
+    }
+    return result;
+}
+
+/* Events waiting in every shard's queue */
+static size_t queued_event_count(void) {
+    size_t total = 0;
+    for (int i = 0; i < shard_count; i++) {
+        total += event_queue_size(&reactors[i]->event_queue);
+    }
+    return total;
+}
+
+/* Threaded mode: block until a reactor thread has queued something */
+static int wait_for_events(int timeout_ms) {
+    size_t queued = queued_event_count();
+    if (queued > 0) {
+        return (int)queued;
+    }
+
+    struct pollfd pfd = { .fd = wakeup_pipe[0], .events = POLLIN, .revents = 0 };
+    if (poll(&pfd, 1, timeout_ms) == -1 && errno != EINTR) {
+        perror("poll wakeup");
+        return -1;
+    }
+
+    char drain[64];
+    while (read(wakeup_pipe[0], drain, sizeof(drain)) > 0) {
+    }
+    atomic_store(&wakeup_pending, 0);
+    return (int)queued_event_count();
+}
+
+/* Main poll loop. Inline polling of several shards splits the timeout
+ * between them; sharded servers normally run server_start_thread(). */
+int server_poll(int timeout_ms) {
+    if (shard_count == 0) {
+        return -1;
+    }
+    if (atomic_load(&poll_thread_running)) {
+        return wait_for_events(timeout_ms);
+    }
+    if (shard_count == 1) {
+        return run_poll_cycle(reactors[0], timeout_ms);
+    }
+
+    int total = 0;
+    for (int i = 0; i < shard_count; i++) {
+        int result = run_poll_cycle(reactors[i], timeout_ms / shard_count);
+        if (result == -1) {
+            return -1;
+        }
+        total += result;
+    }
+    return total;
+}
+
+const char* server_backend_name(void) {
+    switch (io_backend) {
+        case IO_BACKEND_EPOLL: return "epoll";
+        case IO_BACKEND_POLL: return "poll";
+        default: return "unknown";
+    }
+}
+
+/* ========== Native Reactor Threads ========== */
+
+static void* reactor_thread_main(void* arg) {
+    Reactor* r = arg;
+    while (atomic_load(&poll_thread_running)) {
+        if (run_poll_cycle(r, poll_thread_timeout_ms) == -1) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+int server_start_thread(int timeout_ms) {
+    if (atomic_load(&poll_thread_running)) {
+        return 0;
+    }
+    if (shard_count == 0) {
+        fprintf(stderr, "server_start_thread: server not initialized\n");
+        return -1;
+    }
+
+    if (wakeup_pipe[0] == -1) {
+        if (pipe(wakeup_pipe) == -1) {
+            perror("pipe");
+            return -1;
+        }
+        set_nonblocking(wakeup_pipe[0]);
+        set_nonblocking(wakeup_pipe[1]);
+    }
+
+    /* From now on the consumer runs concurrently: no more buffer views */
+    for (int i = 0; i < shard_count; i++) {
+        pthread_mutex_lock(&reactors[i]->lock);
+        materialize_queued_views(reactors[i], -1);
+        pthread_mutex_unlock(&reactors[i]->lock);
+    }
+    copy_payloads = 1;
+
+    poll_thread_timeout_ms = timeout_ms > 0 ? timeout_ms : 100;
+    atomic_store(&poll_thread_running, 1);
+    for (int i = 0; i < shard_count; i++) {
+        Reactor* r = reactors[i];
+        if (pthread_create(&r->thread, NULL, reactor_thread_main, r) != 0) {
+            perror("pthread_create");
+            server_stop_thread();
+            return -1;
+        }
+        r->thread_started = 1;
+    }
+    return 0;
+}
+
+void server_stop_thread(void) {
+    if (!atomic_exchange(&poll_thread_running, 0)) {
+        return;
+    }
+    for (int i = 0; i < shard_count; i++) {
+        if (reactors[i]->thread_started) {
+            pthread_join(reactors[i]->thread, NULL);
+            reactors[i]->thread_started = 0;
+        }
+    }
+    copy_payloads = 0;
+}
+
+int server_event_fd(void) {
+    return wakeup_pipe[0];
+}
+
+/* ========== Shard Management Functions ========== */
+
+int server_shard_count(void) {
+    return shard_count;
+}
+
+int server_client_shard(int client_fd) {
+    int owner = fd_map_get(client_fd);
+    return owner == -1 ? -1 : owner / MAX_CLIENTS;
+}
+
+typedef struct {
+    Reactor* target;
+    int client_fd;
+} EventMove;
+
+/* Re-queue a pinned session's undelivered events on its new shard so the
+ * consumer still sees them in order; the old entry becomes a tombstone */
+static void move_event_if_owned_by(NetworkEvent* event, void* ctx) {
+    EventMove* move = ctx;
+    if (event->type == EVENT_MOVED || event->client_fd != move->client_fd) {
+        return;
+    }
+    if (event_queue_push(&move->target->event_queue, event) == 0) {
+        move->target->events_pushed++;
+        event->type = EVENT_MOVED;
+        event->payload_data = NULL;
+        event->flags = 0;
+    }
+}
+
+/* Move one session to another shard; both reactor locks are held */
+static int migrate_client(Reactor* source, int client_index, Reactor* target) {
+    ClientSession* from = &source->clients[client_index];
+    int fd = from->fd;
+
+    int slot = acquire_slot(target);
+    if (slot == -1) {
+        fprintf(stderr, "Shard %d full, cannot pin fd=%d\n", target->index, fd);
+        return -1;
+    }
+
+    /* Views point into recv_buffer, which travels with the session */
+    if (from->views_pending) {
+        materialize_queued_views(source, fd);
+    }
+    EventMove move = { target, fd };
+    event_queue_for_each(&source->event_queue, move_event_if_owned_by, &move);
+
+    /* A route only survives if the opponent ends up on the same shard */
+    if (from->peer_fd != -1 && find_client_index(target, from->peer_fd) == -1) {
+        clear_route(source, client_index);
+    }
+
+    remove_from_poll(source, fd, client_index);
+
+    /* Timers are linked into the source wheel; the deadlines travel along */
+    int activity_armed = timer_armed(&from->activity_timer);
+    int clock_armed = timer_armed(&from->clock_timer);
+    timer_cancel(&source->timers, &from->activity_timer);
+    timer_cancel(&source->timers, &from->clock_timer);
+
+    /* Copy the session; the list-membership flags stay with each slot */
+    ClientSession* to = &target->clients[slot];
+    int views_pending = to->views_pending, read_deferred = to->read_deferred;
+    *to = *from;
+    to->views_pending = views_pending;
+    to->read_deferred = read_deferred;
+    to->want_write = 0;
+
+    from->fd = -1;
+    from->state = CLIENT_DISCONNECTED;
+    from->recv_buffer = NULL;
+    from->recv_capacity = 0;
+    from->recv_start = 0;
+    from->recv_offset = 0;
+    from->send_queue.head = NULL;
+    from->send_queue.tail = NULL;
+    from->send_queue.bytes = 0;
+    from->want_write = 0;
+    from->deflater = NULL;
+    source->client_count--;
+    release_slot(source, client_index);
+
+    fd_map_set(fd, target->index * MAX_CLIENTS + slot);
+    target->client_count++;
+    if (activity_armed) {
+        arm_timer(target, &to->activity_timer, to->activity_timer.deadline);
+    }
+    if (clock_armed) {
+        arm_timer(target, &to->clock_timer, to->clock_timer.deadline);
+    }
+    if (add_to_poll(target, fd, slot) == -1) {
+        close_client(target, slot);
+        return -1;
+    }
+    /* Newly registered: edge-triggered epoll reports pending input by itself */
+    set_write_interest(target, slot, to->send_queue.head != NULL);
+    return 0;
+}
+
+int server_pin_clients(const int* client_fds, int count) {
+    if (count <= 0 || shard_count == 0) {
+        return -1;
+    }
+    int shard = server_client_shard(client_fds[0]);
+    if (shard == -1) {
+        return -1;
+    }
+    Reactor* target = reactors[shard];
+
+    for (int i = 1; i < count; i++) {
+        int client_index;
+        Reactor* source = lock_client(client_fds[i], &client_index);
+        if (!source) {
+            continue;
+        }
+        if (source == target) {
+            pthread_mutex_unlock(&source->lock);
+            continue;
+        }
+
+        /* Take both locks in shard order to avoid deadlock */
+        if (source->index < target->index) {
+            pthread_mutex_lock(&target->lock);
+        } else {
+            pthread_mutex_unlock(&source->lock);
+            pthread_mutex_lock(&target->lock);
+            pthread_mutex_lock(&source->lock);
+            if (find_client_index(source, client_fds[i]) == -1) {
+                /* Closed or moved while unlocked */
+                pthread_mutex_unlock(&source->lock);
+                pthread_mutex_unlock(&target->lock);
+                continue;
+            }
+            client_index = find_client_index(source, client_fds[i]);
+        }
+
+        int moved = migrate_client(source, client_index, target);
+        pthread_mutex_unlock(&source->lock);
+        pthread_mutex_unlock(&target->lock);
+        if (moved == -1) {
+            return -1;
+        }
+    }
+    notify_consumer();
+    return shard;
+}
+
+/* ========== Message Handling Functions ========== */
+
+/* Write straight to the socket when nothing is queued ahead.
+ * Returns bytes written (0 if it must queue), or -1 if the client was closed. */
+static ssize_t try_send_now(Reactor* r, int client_index, struct iovec* iov, int iov_count) {
+    ClientSession* client = &r->clients[client_index];
+    if (client->send_queue.head) {
+        return 0; /* Keep ordering behind queued data */
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+
+    ssize_t bytes_sent;
+    do {
+        bytes_sent = sendmsg(client->fd, &msg, MSG_NOSIGNAL);
+    } while (bytes_sent == -1 && errno == EINTR);
+
+    if (bytes_sent == -1) {
+        if (errno == EWOULDBLOCK || errno == EAGAIN) {
+            return 0;
+        }
+        perror("send");
+        close_client(r, client_index);
+        return -1;
+    }
+    return bytes_sent;
+}
+
+/* Queue the unsent part of a frame and watch for writability.
+ * Returns -1 if the client was closed (out of memory or slow consumer). */
+static int queue_frame(Reactor* r, int client_index, SharedFrame* frame, size_t offset) {
+    ClientSession* client = &r->clients[client_index];
+
+    if (send_queue_push(&client->send_queue, frame, offset) == -1) {
+        fprintf(stderr, "Out of memory queueing message (fd=%d)\n", client->fd);
+        close_client(r, client_index);
+        return -1;
+    }
+    raise_peak(&r->send_queue_max, client->send_queue.bytes);
+    if (client->send_queue.bytes > SEND_HIGH_WATER) {
+        fprintf(stderr, "Slow consumer, %zu bytes unsent (fd=%d)\n",
+                client->send_queue.bytes, client->fd);
+        atomic_fetch_add_explicit(&r->slow_consumers, 1, memory_order_relaxed);
+        close_client(r, client_index);
+        return -1;
+    }
+    set_write_interest(r, client_index, 1);
+    return 0;
+}
+
+/* Frame and send (or queue) one message to a session; the caller holds the
+ * reactor lock. Returns the frame size, or -1 if the client was closed. */
+static int send_frame(Reactor* r, int client_index, uint16_t message_id,
+                      const uint8_t* payload, uint32_t payload_length) {
+    size_t total_size = HEADER_SIZE + (size_t)payload_length;
+
+    /* Write header and payload straight from the caller's memory, copying
+     * only what the socket doesn't take */
+    MessageHeader header;
+    header.message_id = htons(message_id);
+    header.payload_length = htonl(payload_length);
+    struct iovec iov[2] = {
+        { .iov_base = &header, .iov_len = HEADER_SIZE },
+        { .iov_base = (void*)payload, .iov_len = payload ? payload_length : 0 }
+    };
+
+    ssize_t sent = try_send_now(r, client_index, iov, 2);
+    int result = sent == -1 ? -1 : (int)total_size;
+    if (sent >= 0) {
+        metrics_count_sent(message_id & MSG_ID_MASK, (uint32_t)total_size);
+    }
+
+    if (sent >= 0 && (size_t)sent < total_size) {
+        SharedFrame* frame = frame_create(message_id, payload, payload_length);
+        if (!frame) {
+            fprintf(stderr, "Out of memory queueing message (fd=%d)\n", r->clients[client_index].fd);
+            close_client(r, client_index);
+            result = -1;
+        } else {
+            if (queue_frame(r, client_index, frame, (size_t)sent) == -1) {
+                result = -1;
+            }
+            frame_release(frame);
+        }
+    }
+    return result;
+}
+
+/* Send a shared frame, queueing what the socket doesn't take; the caller
+ * holds the reactor lock. -1 if the session was closed. */
+static int deliver_frame(Reactor* r, int client_index, SharedFrame* frame) {
+    struct iovec iov = { .iov_base = frame->data, .iov_len = frame->length };
+    ssize_t sent = try_send_now(r, client_index, &iov, 1);
+    if (sent == -1) {
+        return -1;
+    }
+    const MessageHeader* header = (const MessageHeader*)frame->data;
+    metrics_count_sent(ntohs(header->message_id) & MSG_ID_MASK, (uint32_t)frame->length);
+    if ((size_t)sent < frame->length) {
+        return queue_frame(r, client_index, frame, (size_t)sent);
+    }
+    return 0;
+}
+
+/* Deflate a payload into the session's stream and send it flagged; the
+ * caller holds the reactor lock. Returns the frame size, or -1 if the
+ * client was closed. */
+static int send_compressed(Reactor* r, int client_index, uint16_t message_id,
+                           const uint8_t* payload, uint32_t payload_length) {
+    ClientSession* client = &r->clients[client_index];
+
+    if (!client->deflater) {
+        z_stream* stream = calloc(1, sizeof(z_stream));
+        if (!stream || deflateInit2(stream, COMPRESS_LEVEL, Z_DEFLATED, -COMPRESS_WINDOW_BITS,
+                                    COMPRESS_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+            free(stream);
+            fprintf(stderr, "Out of memory creating deflate stream (fd=%d)\n", client->fd);
+            close_client(r, client_index);
+            return -1;
+        }
+        deflateSetDictionary(stream, (const Bytef*)COMPRESSION_DICTIONARY,
+                             sizeof(COMPRESSION_DICTIONARY) - 1);
+        client->deflater = stream;
+    }
+    if (!r->deflate_buffer && !(r->deflate_buffer = malloc(BUFFER_SIZE))) {
+        fprintf(stderr, "Out of memory compressing message (fd=%d)\n", client->fd);
+        close_client(r, client_index);
+        return -1;
+    }
+
+    /* Original length, then the deflate output up to the sync flush */
+    uint8_t* out = r->deflate_buffer;
+    size_t capacity = BUFFER_SIZE - HEADER_SIZE;
+    out[0] = (uint8_t)(payload_length >> 24);
+    out[1] = (uint8_t)(payload_length >> 16);
+    out[2] = (uint8_t)(payload_length >> 8);
+    out[3] = (uint8_t)payload_length;
+
+    z_stream* stream = client->deflater;
+    stream->next_in = (Bytef*)payload;
+    stream->avail_in = payload_length;
+    stream->next_out = out + 4;
+    stream->avail_out = (uInt)(capacity - 4);
+    int status = deflate(stream, Z_SYNC_FLUSH);
+    if (status != Z_OK || stream->avail_in > 0 || stream->avail_out == 0) {
+        /* Part of the payload is in the stream already: the client can't follow */
+        fprintf(stderr, "Compressed message too large (fd=%d, %u bytes)\n",
+                client->fd, payload_length);
+        close_client(r, client_index);
+        return -1;
+    }
+    size_t length = capacity - stream->avail_out;
+
+    r->compression_stats.messages++;
+    r->compression_stats.bytes_in += payload_length;
+    r->compression_stats.bytes_out += length;
+    return send_frame(r, client_index, message_id | MSG_FLAG_COMPRESSED, out, (uint32_t)length);
+}
+
+int send_message(int client_fd, uint16_t message_id, const uint8_t* payload, uint32_t payload_length) {
+    /* Check size; compression may bring larger payloads under BUFFER_SIZE */
+    size_t total_size = HEADER_SIZE + (size_t)payload_length;
+    if (total_size > BUFFER_SIZE && payload_length > COMPRESS_MAX_PAYLOAD) {
+        fprintf(stderr, "Message too large: %zu bytes\n", total_size);
+        return -1;
+    }
+
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (!r) {
+        fprintf(stderr, "Client fd %d not found\n", client_fd);
+        return -1;
+    }
+
+    ClientSession* client = &r->clients[client_index];
+    if (client->request_us) {
+        metrics_record_reply(client->request_id, metrics_now_us() - client->request_us);
+        client->request_us = 0;
+    }
+
+    int result;
+    if (client->compression == COMPRESSION_DEFLATE &&
+        payload_length >= COMPRESS_MIN_PAYLOAD) {
+        result = send_compressed(r, client_index, message_id, payload, payload_length);
+    } else if (total_size > BUFFER_SIZE) {
+        fprintf(stderr, "Message too large: %zu bytes\n", total_size);
+        result = -1;
+    } else {
+        result = send_frame(r, client_index, message_id, payload, payload_length);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return result;
+}
+
+int send_broadcast(const int* client_fds, int count, uint16_t message_id,
+                   const uint8_t* payload, uint32_t payload_length) {
+    size_t total_size = HEADER_SIZE + (size_t)payload_length;
+    if (total_size > BUFFER_SIZE) {
+        fprintf(stderr, "Message too large: %zu bytes\n", total_size);
+        return -1;
+    }
+
+    /* Framed once; recipients that can't take it now share this copy */
+    SharedFrame* frame = frame_create(message_id, payload, payload_length);
+    if (!frame) {
+        fprintf(stderr, "Out of memory framing broadcast\n");
+        return -1;
+    }
+
+    int delivered = 0;
+    for (int i = 0; i < count; i++) {
+        int client_index;
+        Reactor* r = lock_client(client_fds[i], &client_index);
+        if (!r) {
+            continue;
+        }
+        if (deliver_frame(r, client_index, frame) == 0) {
+            delivered++;
+        }
+        pthread_mutex_unlock(&r->lock);
+    }
+
+    frame_release(frame);
+    return delivered;
+}
+
+int server_poll_batch(NetworkEvent* out, int max) {
+    if (shard_count == 0 || !out || max <= 0) {
+        return 0;
+    }
+
+    /* Drain shards round-robin so a busy shard can't starve the others */
+    int count = 0;
+    for (int n = 0; n < shard_count && count < max; n++) {
+        Reactor* r = reactors[(next_drain_shard + n) % shard_count];
+        int popped = event_queue_pop(&r->event_queue, out + count, max - count);
+        for (int i = count; i < count + popped; i++) {
+            if (out[i].flags & EVENT_FLAG_PAYLOAD_VIEW) {
+                r->queued_views--;
+            }
+        }
+
+        /* Skip tombstones left behind by pinned sessions */
+        int kept = count;
+        for (int i = count; i < count + popped; i++) {
+            if (out[i].type != EVENT_MOVED) {
+                out[kept++] = out[i];
+            }
+        }
+        count = kept;
+    }
+    next_drain_shard = (next_drain_shard + 1) % shard_count;
+    return count;
+}
+
+void free_event_batch(NetworkEvent* events, int count) {
+    for (int i = 0; i < count; i++) {
+        if (events[i].payload_data && !(events[i].flags & EVENT_FLAG_PAYLOAD_VIEW)) {
+            free(events[i].payload_data);
+        }
+        events[i].payload_data = NULL;
+    }
+}
+
+NetworkEvent* get_next_event(void) {
+    NetworkEvent next;
+    if (server_poll_batch(&next, 1) == 0) {
+        return NULL;
+    }
+
+    NetworkEvent* event = malloc(sizeof(NetworkEvent));
+    if (!event) {
+        free_event_batch(&next, 1);
+        return NULL;
+    }
+    *event = next;
+
+    return event;
+}
+
+void free_event(NetworkEvent* event) {
+    if (event) {
+        if (event->payload_data && !(event->flags & EVENT_FLAG_PAYLOAD_VIEW)) {
+            free(event->payload_data);
+        }
+        free(event);
+    }
+}
+
+/* ========== Game Routing Functions ========== */
+
+/* Moves can go into a JSON string without escaping */
+static int json_safe(const char* text) {
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\' || (unsigned char)*text < 0x20) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Native fast path: forward a routed player's MAKE_MOVE to the opponent as
+ * OPPONENT_MOVE without a round trip through Python. The move is still
+ * queued for Python (flagged EVENT_FLAG_RELAYED) to validate and persist.
+ * Returns 1 if the opponent got the move. */
+static int relay_move(Reactor* r, int client_index, uint16_t message_id,
+                      const uint8_t* payload, uint32_t payload_length) {
+    ClientSession* client = &r->clients[client_index];
+    if ((message_id & MSG_ID_MASK) != MSG_C2S_MAKE_MOVE || client->state != CLIENT_IN_GAME
+        || payload_length == 0) {
+        return 0;
+    }
+    int peer_index = find_client_index(r, client->peer_fd);
+    if (peer_index == -1) {
+        return 0;
+    }
+
+    /* JSON moves are forwarded verbatim */
+    if (!(message_id & MSG_FLAG_BINARY)) {
+        return send_frame(r, peer_index, MSG_S2C_OPPONENT_MOVE, payload, payload_length) != -1;
+    }
+
+    /* Binary moves must decode; malformed ones are left to Python to reject */
+    MovePayload move;
+    if (decode_move_payload(payload, payload_length, &move) == -1) {
+        return 0;
+    }
+    if (r->clients[peer_index].speaks_binary) {
+        return send_frame(r, peer_index, MSG_S2C_OPPONENT_MOVE | MSG_FLAG_BINARY,
+                          payload, payload_length) != -1;
+    }
+
+    /* The opponent only speaks JSON: re-encode */
+    char uci[6];
+    char json[2 * BINARY_GAME_ID_MAX];
+    if (!json_safe(move.game_id)) {
+        return 0;
+    }
+    move_to_uci(move.move, uci);
+    int length = snprintf(json, sizeof(json), "{\"game_id\":\"%s\",\"move\":\"%s\",\"clock_ms\":%u}",
+                          move.game_id, uci, move.clock_ms);
+    if (length < 0 || (size_t)length >= sizeof(json)) {
+        return 0;
+    }
+    return send_frame(r, peer_index, MSG_S2C_OPPONENT_MOVE, (const uint8_t*)json, (uint32_t)length) != -1;
+}
+
+int server_route_game(int white_fd, int black_fd) {
+    if (white_fd == black_fd) {
+        return -1;
+    }
+
+    /* Relaying needs both sessions under one reactor lock */
+    int fds[2] = { white_fd, black_fd };
+    if (server_pin_clients(fds, 2) == -1) {
+        return -1;
+    }
+
+    int white_index;
+    Reactor* r = lock_client(white_fd, &white_index);
+    if (!r) {
+        return -1;
+    }
+    int black_index = find_client_index(r, black_fd);
+    if (black_index == -1) {
+        pthread_mutex_unlock(&r->lock);
+        return -1;
+    }
+
+    clear_route(r, white_index);
+    clear_route(r, black_index);
+    r->clients[white_index].peer_fd = black_fd;
+    r->clients[white_index].state = CLIENT_IN_GAME;
+    r->clients[black_index].peer_fd = white_fd;
+    r->clients[black_index].state = CLIENT_IN_GAME;
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+void server_unroute_game(int client_fd) {
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (r) {
+        clear_route(r, client_index);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+/* ========== Spectator Streams ========== */
+
+/* Watchers are remembered by fd and session serial, so a closed watcher
+ * whose fd was handed to a new connection is recognized and dropped on
+ * the next send instead of needing a hook in close_client(). */
+typedef struct {
+    int fd;
+    uint32_t serial;
+    int synced;                                  /* Has a keyframe this stream's deltas apply to */
+} Watcher;
+
+typedef struct {
+    char game_id[BINARY_GAME_ID_MAX];            /* Empty when the slot is free */
+    uint32_t id;                                 /* Stream number on the wire */
+    uint16_t ply;                                /* Half-moves covered so far */
+    SharedFrame* keyframe;                       /* Latest keyframe, NULL when it can't resync */
+    SharedFrame* deltas[SPECTATOR_DELTA_LOG];    /* Moves since the keyframe */
+    int delta_count;
+    Watcher* watchers;
+    int watcher_count;
+    int watcher_capacity;
+} SpectatorStream;
+
+/* Guards the streams. Taken before reactor locks, never while holding one */
+static pthread_mutex_t stream_lock = PTHREAD_MUTEX_INITIALIZER;
+static SpectatorStream streams[MAX_STREAMS];
+static uint32_t next_stream_id = 1;
+
+static SpectatorStream* find_stream(const char* game_id) {
+    if (!game_id || !game_id[0]) {
+        return NULL;
+    }
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (strncmp(streams[i].game_id, game_id, BINARY_GAME_ID_MAX) == 0) {
+            return &streams[i];
+        }
+    }
+    return NULL;
+}
+
+static SpectatorStream* find_stream_slot(void) {
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (!streams[i].game_id[0]) {
+            return &streams[i];
+        }
+    }
+    return NULL;
+}
+
+/* Forget the keyframe and the moves logged after it */
+static void drop_resync(SpectatorStream* stream) {
+    frame_release(stream->keyframe);
+    stream->keyframe = NULL;
+    for (int i = 0; i < stream->delta_count; i++) {
+        frame_release(stream->deltas[i]);
+    }
+    stream->delta_count = 0;
+}
+
+static void free_stream(SpectatorStream* stream) {
+    drop_resync(stream);
+    free(stream->watchers);
+    memset(stream, 0, sizeof(*stream));
+}
+
+/* Send one frame to a watcher; 0 once it is gone */
+static int send_to_watcher(const Watcher* watcher, SharedFrame* frame) {
+    int client_index;
+    Reactor* r = lock_client(watcher->fd, &client_index);
+    if (!r) {
+        return 0;
+    }
+    int alive = r->clients[client_index].serial == watcher->serial
+             && deliver_frame(r, client_index, frame) == 0;
+    pthread_mutex_unlock(&r->lock);
+    return alive;
+}
+
+/* Bring a watcher up to date: keyframe, then every move logged after it */
+static int resync_watcher(SpectatorStream* stream, Watcher* watcher) {
+    if (!send_to_watcher(watcher, stream->keyframe)) {
+        return 0;
+    }
+    for (int i = 0; i < stream->delta_count; i++) {
+        if (!send_to_watcher(watcher, stream->deltas[i])) {
+            return 0;
+        }
+    }
+    watcher->synced = 1;
+    return 1;
+}
+
+/* Deliver to the synced watchers (or resync the others); watchers that
+ * are gone are removed. Returns how many were reached. */
+static int stream_fanout(SpectatorStream* stream, SharedFrame* frame, int resync_all) {
+    int kept = 0;
+    int reached = 0;
+    for (int i = 0; i < stream->watcher_count; i++) {
+        Watcher watcher = stream->watchers[i];
+        int alive = 1;
+        if (resync_all || !watcher.synced) {
+            if (stream->keyframe) {
+                alive = resync_watcher(stream, &watcher);
+                reached += alive;
+            }
+        } else if (frame) {
+            alive = send_to_watcher(&watcher, frame);
+            reached += alive;
+        }
+        if (alive) {
+            stream->watchers[kept++] = watcher;
+        }
+    }
+    stream->watcher_count = kept;
+    return reached;
+}
+
+/* server_shutdown(): watchers are gone with their reactors */
+static void close_streams(void) {
+    pthread_mutex_lock(&stream_lock);
+    for (int i = 0; i < MAX_STREAMS; i++) {
+        if (streams[i].game_id[0]) {
+            free_stream(&streams[i]);
+        }
+    }
+    pthread_mutex_unlock(&stream_lock);
+}
+
+int server_stream_keyframe(const char* game_id, uint16_t ply, const GameStatePayload* state) {
+    if (!game_id || !game_id[0] || !state) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&stream_lock);
+    SpectatorStream* stream = find_stream(game_id);
+    if (!stream) {
+        stream = find_stream_slot();
+        if (!stream) {
+            pthread_mutex_unlock(&stream_lock);
+            fprintf(stderr, "No free spectator streams\n");
+            return -1;
+        }
+        snprintf(stream->game_id, sizeof(stream->game_id), "%s", game_id);
+        stream->id = next_stream_id++;
+        stream->ply = ply;
+    }
+
+    SpectatorKeyframe keyframe = { .stream = stream->id, .ply = ply, .state = *state };
+    uint8_t payload[4 + 2 + sizeof(GameStatePayload)];
+    int length = encode_spectator_keyframe(&keyframe, payload, sizeof(payload));
+    SharedFrame* frame = length == -1 ? NULL
+                       : frame_create(MSG_S2C_SPECTATE_KEYFRAME | MSG_FLAG_BINARY, payload, (uint32_t)length);
+    if (!frame) {
+        pthread_mutex_unlock(&stream_lock);
+        return -1;
+    }
+
+    /* The keyframe replaces the resync data; watchers that followed the
+     * moves up to this ply already have the position */
+    int resync_all = ply != stream->ply;
+    drop_resync(stream);
+    stream->keyframe = frame;
+    stream->ply = ply;
+    int reached = stream_fanout(stream, NULL, resync_all);
+    pthread_mutex_unlock(&stream_lock);
+    return reached;
+}
+
+int server_stream_move(const char* game_id, uint16_t ply, uint16_t move, uint8_t flags,
+                       uint32_t white_ms, uint32_t black_ms) {
+    pthread_mutex_lock(&stream_lock);
+    SpectatorStream* stream = find_stream(game_id);
+    if (!stream) {
+        pthread_mutex_unlock(&stream_lock);
+        return -1;
+    }
+
+    /* A gap leaves everyone waiting for the next keyframe */
+    if (ply != (uint16_t)(stream->ply + 1)) {
+        drop_resync(stream);
+        stream->ply = ply;
+        for (int i = 0; i < stream->watcher_count; i++) {
+            stream->watchers[i].synced = 0;
+        }
+        pthread_mutex_unlock(&stream_lock);
+        return 0;
+    }
+
+    SpectatorDelta delta = {
+        .stream = stream->id, .ply = ply, .move = move, .flags = flags,
+        .white_ms = white_ms, .black_ms = black_ms
+    };
+    uint8_t payload[SPECTATOR_DELTA_SIZE];
+    encode_spectator_delta(&delta, payload, sizeof(payload));
+    SharedFrame* frame = frame_create(MSG_S2C_SPECTATE_DELTA | MSG_FLAG_BINARY, payload, sizeof(payload));
+    if (!frame) {
+        pthread_mutex_unlock(&stream_lock);
+        return -1;
+    }
+    stream->ply = ply;
+
+    /* Log it for late joiners; past the log's end joins wait for a keyframe */
+    if (stream->keyframe && stream->delta_count < SPECTATOR_DELTA_LOG) {
+        frame_retain(frame);
+        stream->deltas[stream->delta_count++] = frame;
+    } else {
+        drop_resync(stream);
+    }
+
+    int reached = stream_fanout(stream, frame, 0);
+    frame_release(frame);
+    pthread_mutex_unlock(&stream_lock);
+    return reached;
+}
+
+void server_stream_close(const char* game_id) {
+    pthread_mutex_lock(&stream_lock);
+    SpectatorStream* stream = find_stream(game_id);
+    if (stream) {
+        free_stream(stream);
+    }
+    pthread_mutex_unlock(&stream_lock);
+}
+
+int server_stream_watchers(const char* game_id) {
+    pthread_mutex_lock(&stream_lock);
+    SpectatorStream* stream = find_stream(game_id);
+    int count = stream ? stream->watcher_count : -1;
+    pthread_mutex_unlock(&stream_lock);
+    return count;
+}
+
+int server_spectate(int client_fd, const char* game_id) {
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (!r) {
+        return -1;
+    }
+    Watcher watcher = { .fd = client_fd, .serial = r->clients[client_index].serial, .synced = 0 };
+    pthread_mutex_unlock(&r->lock);
+
+    pthread_mutex_lock(&stream_lock);
+    SpectatorStream* stream = find_stream(game_id);
+    if (!stream) {
+        pthread_mutex_unlock(&stream_lock);
+        return -1;
+    }
+
+    /* Already watching: resend the resync */
+    Watcher* slot = NULL;
+    for (int i = 0; i < stream->watcher_count; i++) {
+        if (stream->watchers[i].fd == client_fd && stream->watchers[i].serial == watcher.serial) {
+            slot = &stream->watchers[i];
+        }
+    }
+    if (!slot) {
+        if (stream->watcher_count == stream->watcher_capacity) {
+            int capacity = stream->watcher_capacity ? stream->watcher_capacity * 2 : 16;
+            Watcher* grown = realloc(stream->watchers, (size_t)capacity * sizeof(Watcher));
+            if (!grown) {
+                pthread_mutex_unlock(&stream_lock);
+                fprintf(stderr, "Out of memory adding a spectator\n");
+                return -1;
+            }
+            stream->watchers = grown;
+            stream->watcher_capacity = capacity;
+        }
+        slot = &stream->watchers[stream->watcher_count++];
+        *slot = watcher;
+    }
+
+    int result = 0;
+    if (stream->keyframe && !resync_watcher(stream, slot)) {
+        *slot = stream->watchers[--stream->watcher_count];
+        result = -1;
+    }
+    pthread_mutex_unlock(&stream_lock);
+    return result;
+}
+
+int server_unspectate(int client_fd, const char* game_id) {
+    /* Match the serial too, an entry of a closed session may share the fd */
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (!r) {
+        return -1;
+    }
+    uint32_t serial = r->clients[client_index].serial;
+    pthread_mutex_unlock(&r->lock);
+
+    pthread_mutex_lock(&stream_lock);
+    SpectatorStream* stream = find_stream(game_id);
+    int result = -1;
+    for (int i = 0; stream && i < stream->watcher_count; i++) {
+        if (stream->watchers[i].fd == client_fd && stream->watchers[i].serial == serial) {
+            stream->watchers[i] = stream->watchers[--stream->watcher_count];
+            result = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&stream_lock);
+    return result;
+}
+
+/* ========== Client Management Functions ========== */
+
+ClientSession* get_client_session(int client_fd) {
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (!r) {
+        return NULL;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return &r->clients[client_index];
+}
+
+/* Tear down a session; the caller holds the reactor lock */
+static void close_client(Reactor* r, int client_index) {
+    int client_fd = r->clients[client_index].fd;
+    if (client_fd == -1) {
+        return;
+    }
+
+    /* Enqueue disconnect event */
+    NetworkEvent event = {
+        .type = EVENT_CLIENT_DISCONNECTED,
+        .client_fd = client_fd,
+        .message_id = 0,
+        .payload_length = 0,
+        .payload_data = NULL
+    };
+    enqueue_event(r, event);
+
+    /* Queued payloads must outlive the buffers they point into */
+    if (r->clients[client_index].views_pending) {
+        materialize_queued_views(r, client_fd);
+    }
+
+    /* The opponent's route must not outlive this fd (it may be reused) */
+    clear_route(r, client_index);
+    timer_cancel(&r->timers, &r->clients[client_index].activity_timer);
+    timer_cancel(&r->timers, &r->clients[client_index].clock_timer);
+
+    /* Remove from the backend and the fd map */
+    remove_from_poll(r, client_fd, client_index);
+    fd_map_set(client_fd, -1);
+
+    /* Close socket */
+    close(client_fd);
+
+    /* Reset client session */
+    r->clients[client_index].fd = -1;
+    r->clients[client_index].state = CLIENT_DISCONNECTED;
+    release_client_buffers(&r->clients[client_index]);
+    r->client_count--;
+    release_slot(r, client_index);
+
+    printf("Client disconnected (fd=%d)\n", client_fd);
+}
+
+void disconnect_client(int client_fd) {
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (r) {
+        close_client(r, client_index);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+int get_client_count(void) {
+    int count = 0;
+    for (int i = 0; i < shard_count; i++) {
+        pthread_mutex_lock(&reactors[i]->lock);
+        count += reactors[i]->client_count;
+        pthread_mutex_unlock(&reactors[i]->lock);
     }
     return count;
 }
 
+/* ========== Timeouts and Game Clocks ========== */
+
+void server_set_timeouts(int idle_ms, int heartbeat_ms) {
+    atomic_store(&idle_timeout_ms, idle_ms > 0 ? idle_ms : 0);
+    atomic_store(&heartbeat_interval_ms, heartbeat_ms > 0 ? heartbeat_ms : 0);
+
+    for (int i = 0; i < shard_count; i++) {
+        Reactor* r = reactors[i];
+        pthread_mutex_lock(&r->lock);
+        for (int c = 0; c < MAX_CLIENTS; c++) {
+            if (r->clients[c].fd != -1) {
+                arm_activity_timer(r, c);
+            }
+        }
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+int server_set_clock(int client_fd, uint32_t remaining_ms, uint32_t increment_ms) {
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (!r) {
+        return -1;
+    }
+    ClientSession* client = &r->clients[client_index];
+    timer_cancel(&r->timers, &client->clock_timer);
+    client->clock_ms = remaining_ms;
+    client->increment_ms = increment_ms;
+    client->has_clock = 1;
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+int server_start_clock(int client_fd) {
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (!r) {
+        return -1;
+    }
+    int result = -1;
+    if (r->clients[client_index].has_clock) {
+        start_clock(r, client_index, timer_now_ms());
+        result = 0;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return result;
+}
+
+int64_t server_stop_clock(int client_fd) {
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (!r) {
+        return -1;
+    }
+    int64_t remaining = -1;
+    if (r->clients[client_index].has_clock) {
+        stop_clock(r, client_index, timer_now_ms());
+        remaining = r->clients[client_index].clock_ms;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return remaining;
+}
+
+int64_t server_clock_remaining(int client_fd) {
+    int client_index;
+    Reactor* r = lock_client(client_fd, &client_index);
+    if (!r) {
+        return -1;
+    }
+    ClientSession* client = &r->clients[client_index];
+    int64_t remaining = client->has_clock ? (int64_t)clock_remaining(client, timer_now_ms()) : -1;
+    pthread_mutex_unlock(&r->lock);
+    return remaining;
+}
+
+int server_switch_clock(int mover_fd, int opponent_fd) {
+    int client_index;
+    Reactor* r = lock_client(mover_fd, &client_index);
+    if (!r) {
+        return -1;
+    }
+    ClientSession* mover = &r->clients[client_index];
+    uint64_t now = timer_now_ms();
+    int running = mover->has_clock && timer_armed(&mover->clock_timer)
+               && clock_remaining(mover, now) > 0;
+    if (running) {
+        stop_clock(r, client_index, now);
+        mover->clock_ms += mover->increment_ms;
+        mover->switched_at_ms = now;
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    /* The opponent may live on another shard */
+    return running && server_start_clock(opponent_fd) == 0 ? 0 : -1;
+}
+
+int server_undo_switch(int mover_fd, int opponent_fd) {
+    int client_index;
+    Reactor* r = lock_client(mover_fd, &client_index);
+    if (!r) {
+        return -1;
+    }
+    ClientSession* mover = &r->clients[client_index];
+    int undone = mover->has_clock && mover->switched_at_ms && !timer_armed(&mover->clock_timer);
+    if (undone) {
+        /* Running again since the switch, as if it never happened */
+        uint32_t credit = mover->clock_ms < mover->increment_ms ? mover->clock_ms : mover->increment_ms;
+        mover->clock_ms -= credit;
+        arm_timer(r, &mover->clock_timer, mover->switched_at_ms + mover->clock_ms);
+        mover->switched_at_ms = 0;
+    }
+    pthread_mutex_unlock(&r->lock);
+    if (!undone) {
+        return -1;
+    }
+
+    /* start_clock() left the opponent's stopped time as it was */
+    r = lock_client(opponent_fd, &client_index);
+    if (!r) {
+        return -1;
+    }
+    timer_cancel(&r->timers, &r->clients[client_index].clock_timer);
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+/* ========== Binary Payload Codec ========== */
+
+static const char promotion_pieces[] = "nbrq";   /* Knight..queen, as in bits 12-13 */
+
+static void put_u16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)(value >> 8);
+    out[1] = (uint8_t)value;
+}
+
+static void put_u32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static uint16_t get_u16(const uint8_t* in) {
+    return (uint16_t)((in[0] << 8) | in[1]);
+}
+
+static uint32_t get_u32(const uint8_t* in) {
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+/* Copy a length-prefixed string out of a payload; returns bytes consumed or -1 */
+static int get_string(const uint8_t* in, size_t available, char* out, size_t out_size) {
+    if (available < 1) {
+        return -1;
+    }
+    size_t length = in[0];
+    if (length >= out_size || 1 + length > available) {
+        return -1;
+    }
+    memcpy(out, in + 1, length);
+    out[length] = '\0';
+    return (int)(1 + length);
+}
+
+/* Length of a NUL-terminated field, capped to what the wire form allows */
+static size_t field_length(const char* field, size_t max) {
+    size_t length = 0;
+    while (length < max && field[length]) {
+        length++;
+    }
+    return length;
+}
+
+uint16_t move_from_uci(const char* uci) {
+    if (!uci || strlen(uci) < 4 || strlen(uci) > 5) {
+        return MOVE_NONE;
+    }
+    int from_file = uci[0] - 'a', from_rank = uci[1] - '1';
+    int to_file = uci[2] - 'a', to_rank = uci[3] - '1';
+    if (from_file < 0 || from_file > 7 || from_rank < 0 || from_rank > 7
+        || to_file < 0 || to_file > 7 || to_rank < 0 || to_rank > 7) {
+        return MOVE_NONE;
+    }
+    
+    uint16_t move = (uint16_t)(((from_rank * 8 + from_file) << 6) | (to_rank * 8 + to_file));
+    if (uci[4]) {
+        const char* piece = strchr(promotion_pieces, uci[4] | 0x20);
+        if (!piece) {
+            return MOVE_NONE;
+        }
+        move |= (uint16_t)(MOVE_TYPE_PROMOTION | ((piece - promotion_pieces) << 12));
+    }
+    return move;
+}
+
+int move_to_uci(uint16_t move, char* out) {
+    if (move == MOVE_NONE) {
+        strcpy(out, "0000");
+        return 4;
+    }
+    int from = (move >> 6) & 0x3F, to = move & 0x3F;
+    out[0] = (char)('a' + (from & 7));
+    out[1] = (char)('1' + (from >> 3));
+    out[2] = (char)('a' + (to & 7));
+    out[3] = (char)('1' + (to >> 3));
+    int length = 4;
+    if ((move & MOVE_TYPE_MASK) == MOVE_TYPE_PROMOTION) {
+        out[length++] = promotion_pieces[(move >> 12) & 3];
+    }
+    out[length] = '\0';
+    return length;
+}
+
+int encode_move_payload(const MovePayload* move, uint8_t* out, size_t capacity) {
+    size_t id_length = field_length(move->game_id, BINARY_GAME_ID_MAX - 1);
+    size_t size = 2 + 4 + 1 + id_length;
+    if (size > capacity) {
+        return -1;
+    }
+    put_u16(out, move->move);
+    put_u32(out + 2, move->clock_ms);
+    out[6] = (uint8_t)id_length;
+    memcpy(out + 7, move->game_id, id_length);
+    return (int)size;
+}
+
+int decode_move_payload(const uint8_t* payload, uint32_t length, MovePayload* move) {
+    if (!payload || length < 7) {
+        return -1;
+    }
+    move->move = get_u16(payload);
+    move->clock_ms = get_u32(payload + 2);
+    return get_string(payload + 6, length - 6, move->game_id, sizeof(move->game_id)) == -1 ? -1 : 0;
+}
+
+int encode_game_state_payload(const GameStatePayload* state, uint8_t* out, size_t capacity) {
+    size_t id_length = field_length(state->game_id, BINARY_GAME_ID_MAX - 1);
+    size_t fen_length = field_length(state->fen, BINARY_FEN_MAX - 1);
+    size_t size = 2 + 1 + 4 + 4 + 1 + id_length + 1 + fen_length;
+    if (size > capacity) {
+        return -1;
+    }
+    put_u16(out, state->last_move);
+    out[2] = state->flags;
+    put_u32(out + 3, state->white_ms);
+    put_u32(out + 7, state->black_ms);
+    out[11] = (uint8_t)id_length;
+    memcpy(out + 12, state->game_id, id_length);
+    out[12 + id_length] = (uint8_t)fen_length;
+    memcpy(out + 13 + id_length, state->fen, fen_length);
+    return (int)size;
+}
+
+int decode_game_state_payload(const uint8_t* payload, uint32_t length, GameStatePayload* state) {
+    if (!payload || length < 11) {
+        return -1;
+    }
+    state->last_move = get_u16(payload);
+    state->flags = payload[2];
+    state->white_ms = get_u32(payload + 3);
+    state->black_ms = get_u32(payload + 7);
+    int used = get_string(payload + 11, length - 11, state->game_id, sizeof(state->game_id));
+    if (used == -1) {
+        return -1;
+    }
+    size_t offset = 11 + (size_t)used;
+    return get_string(payload + offset, length - offset, state->fen, sizeof(state->fen)) == -1 ? -1 : 0;
+}
+
+int encode_spectator_keyframe(const SpectatorKeyframe* keyframe, uint8_t* out, size_t capacity) {
+    if (capacity < 6) {
+        return -1;
+    }
+    put_u32(out, keyframe->stream);
+    put_u16(out + 4, keyframe->ply);
+    int length = encode_game_state_payload(&keyframe->state, out + 6, capacity - 6);
+    return length == -1 ? -1 : 6 + length;
+}
+
+int decode_spectator_keyframe(const uint8_t* payload, uint32_t length, SpectatorKeyframe* keyframe) {
+    if (!payload || length < 6) {
+        return -1;
+    }
+    keyframe->stream = get_u32(payload);
+    keyframe->ply = get_u16(payload + 4);
+    return decode_game_state_payload(payload + 6, length - 6, &keyframe->state);
+}
+
+int encode_spectator_delta(const SpectatorDelta* delta, uint8_t* out, size_t capacity) {
+    if (capacity < SPECTATOR_DELTA_SIZE) {
+        return -1;
+    }
+    put_u32(out, delta->stream);
+    put_u16(out + 4, delta->ply);
+    put_u16(out + 6, delta->move);
+    out[8] = delta->flags;
+    put_u32(out + 9, delta->white_ms);
+    put_u32(out + 13, delta->black_ms);
+    return SPECTATOR_DELTA_SIZE;
+}
+
+int decode_spectator_delta(const uint8_t* payload, uint32_t length, SpectatorDelta* delta) {
+    if (!payload || length < SPECTATOR_DELTA_SIZE) {
+        return -1;
+    }
+    delta->stream = get_u32(payload);
+    delta->ply = get_u16(payload + 4);
+    delta->move = get_u16(payload + 6);
+    delta->flags = payload[8];
+    delta->white_ms = get_u32(payload + 9);
+    delta->black_ms = get_u32(payload + 13);
+    return 0;
+}
+
 /* ========== Utility Functions ========== */
 
 const char* get_message_type_name(uint16_t message_id) {
-    switch (message_id) {
+    switch (message_id & MSG_ID_MASK) {
         /* C2S */
         case MSG_C2S_REGISTER: return "REGISTER";
         case MSG_C2S_LOGIN: return "LOGIN";
@@ -502,6 +2822,9 @@ const char* get_message_type_name(uint16_t message_id) {
         case MSG_C2S_DECLINE_CHALLENGE: return "DECLINE_CHALLENGE";
         case MSG_C2S_GET_STATS: return "GET_STATS";
         case MSG_C2S_GET_HISTORY: return "GET_HISTORY";
+        case MSG_C2S_SPECTATE: return "SPECTATE";
+        case MSG_C2S_STOP_SPECTATING: return "STOP_SPECTATING";
+        case MSG_C2S_SET_COMPRESSION: return "SET_COMPRESSION";
         
         /* S2C */
         case MSG_S2C_REGISTER_RESULT: return "REGISTER_RESULT";
@@ -518,8 +2841,11 @@ const char* get_message_type_name(uint16_t message_id) {
         case MSG_S2C_CHALLENGE_RECEIVED: return "CHALLENGE_RECEIVED";
         case MSG_S2C_CHALLENGE_ACCEPTED: return "CHALLENGE_ACCEPTED";
         case MSG_S2C_CHALLENGE_DECLINED: return "CHALLENGE_DECLINED";
+        case MSG_S2C_OPPONENT_MOVE: return "OPPONENT_MOVE";
         case MSG_S2C_STATS_RESPONSE: return "STATS_RESPONSE";
         case MSG_S2C_HISTORY_RESPONSE: return "HISTORY_RESPONSE";
+        case MSG_S2C_SPECTATE_KEYFRAME: return "SPECTATE_KEYFRAME";
+        case MSG_S2C_SPECTATE_DELTA: return "SPECTATE_DELTA";
         
         default: return "UNKNOWN";
     }
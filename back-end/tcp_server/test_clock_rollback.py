@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+Test script: an illegal move must not add time to the mover's clock.
+Two players in a routed game with an increment send moves the handler
+rejects; the reactor switches the clocks, the handler takes the switch
+back, and the mover's remaining time may only go down. Run from
+tcp_server/ after `make`.
+"""
+
+import socket
+import struct
+import json
+import time
+
+from network_bridge import NetworkManager, MessageTypeC2S
+
+PORT = 18766
+CLOCK_MS = 5000
+INCREMENT_MS = 2000
+ATTEMPTS = 5
+
+manager = NetworkManager('./libchess_server.so')
+assert manager.start(PORT)
+
+
+def pump(seconds):
+    end = time.monotonic() + seconds
+    while time.monotonic() < end:
+        manager.poll(10)
+        manager.process_events()
+
+
+white = socket.create_connection(('127.0.0.1', PORT))
+black = socket.create_connection(('127.0.0.1', PORT))
+pump(0.2)
+white_fd, black_fd = sorted(manager.client_sessions)
+
+rejected = []
+
+
+def reject_move(client_fd, data):
+    """The invalid branch of handle_make_move"""
+    rejected.append(data.get('clock_switched', False))
+    if data.get('clock_switched'):
+        manager.undo_switch(client_fd, black_fd)
+
+
+manager.register_handler(MessageTypeC2S.MAKE_MOVE, reject_move)
+assert manager.route_game(white_fd, black_fd)
+manager.set_clock(white_fd, CLOCK_MS, INCREMENT_MS)
+manager.set_clock(black_fd, CLOCK_MS, INCREMENT_MS)
+manager.start_clock(white_fd)
+
+payload = json.dumps({'game_id': 'g', 'move': 'e2e5'}).encode()
+previous = manager.clock_remaining(white_fd)
+for attempt in range(ATTEMPTS):
+    white.sendall(struct.pack('!HI', MessageTypeC2S.MAKE_MOVE, len(payload)) + payload)
+    pump(0.05)
+    remaining = manager.clock_remaining(white_fd)
+    print(f"  attempt {attempt + 1}: white {remaining} ms, black {manager.clock_remaining(black_fd)} ms")
+    assert remaining <= previous, f"white gained {remaining - previous} ms"
+    assert manager.clock_remaining(black_fd) == CLOCK_MS, "black's clock ran"
+    previous = remaining
+
+assert rejected == [True] * ATTEMPTS, rejected
+assert not manager.undo_switch(white_fd, black_fd), "nothing left to undo"
+
+white.close()
+black.close()
+manager.stop()
+print(f"✓ {ATTEMPTS} illegal moves, no time gained")
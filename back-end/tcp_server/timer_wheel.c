@@ -0,0 +1,186 @@
+#define _POSIX_C_SOURCE 200809L                  /* clock_gettime() under -std=c11 */
+#include "timer_wheel.h"
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+
+/* ========== Wheel State ========== */
+
+#define SLOT_MASK ((uint64_t)WHEEL_SLOTS - 1)
+#define DUE_LEVEL WHEEL_LEVELS                   /* Level tag of timers on the due list */
+#define WHEEL_SPAN ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+uint64_t timer_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+void timer_wheel_init(TimerWheel* wheel, uint64_t now) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now = now;
+}
+
+static void link_timer(Timer** head, Timer* timer) {
+    timer->next = *head;
+    if (*head) {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+static void unlink_timer(Timer* timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/* File a timer in the slot its distance from wheel->now calls for, or on
+ * the due list if that time has come */
+static void place(TimerWheel* wheel, Timer* timer) {
+    if (timer->deadline <= wheel->now) {
+        timer->level = DUE_LEVEL;
+        link_timer(&wheel->due, timer);
+        return;
+    }
+    uint64_t at = timer->deadline;
+    if (at - wheel->now >= WHEEL_SPAN) {
+        at = wheel->now + WHEEL_SPAN - 1;        /* Placed again when that slot comes down */
+    }
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && at - wheel->now >= (uint64_t)1 << (WHEEL_BITS * (level + 1))) {
+        level++;
+    }
+    int slot = (int)((at >> (WHEEL_BITS * level)) & SLOT_MASK);
+
+    timer->level = (uint8_t)level;
+    timer->slot = (uint8_t)slot;
+    link_timer(&wheel->slots[level][slot], timer);
+    wheel->occupied[level] |= 1ULL << slot;
+}
+
+/* Move a whole slot onto the caller's list head, leaving it empty */
+static void take_slot(TimerWheel* wheel, int level, int slot, Timer** head) {
+    *head = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ULL << slot);
+    if (*head) {
+        (*head)->pprev = head;
+    }
+}
+
+/* Advance one millisecond: upper slots whose time has come are pushed down
+ * (top level first, as it may refill a lower one), then level 0's slot for
+ * the new time moves to the due list */
+static void tick(TimerWheel* wheel) {
+    uint64_t now = ++wheel->now;
+
+    for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+        int shift = WHEEL_BITS * level;
+        if (now & (((uint64_t)1 << shift) - 1)) {
+            continue;
+        }
+        Timer* list;
+        take_slot(wheel, level, (int)((now >> shift) & SLOT_MASK), &list);
+        while (list) {
+            Timer* timer = list;
+            unlink_timer(timer);
+            place(wheel, timer);
+        }
+    }
+
+    Timer* list;
+    take_slot(wheel, 0, (int)(now & SLOT_MASK), &list);
+    while (list) {
+        Timer* timer = list;
+        unlink_timer(timer);
+        timer->level = DUE_LEVEL;
+        link_timer(&wheel->due, timer);
+    }
+}
+
+/* First millisecond after wheel->now at which tick() has work: the next
+ * occupied slot of each level, which for upper levels is when it comes
+ * down. Slots at or behind a level's current one belong to its next round. */
+static uint64_t next_work(const TimerWheel* wheel) {
+    uint64_t best = UINT64_MAX;
+
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        uint64_t bits = wheel->occupied[level];
+        if (!bits) {
+            continue;
+        }
+        int shift = WHEEL_BITS * level;
+        uint64_t position = wheel->now >> shift;
+        uint64_t round = position & ~SLOT_MASK;
+        unsigned current = (unsigned)(position & SLOT_MASK);
+        uint64_t ahead = current == SLOT_MASK ? 0 : bits & (~0ULL << (current + 1));
+
+        uint64_t at = (ahead ? round + (uint64_t)__builtin_ctzll(ahead)
+                             : round + WHEEL_SLOTS + (uint64_t)__builtin_ctzll(bits)) << shift;
+        if (at < best) {
+            best = at;
+        }
+    }
+    return best;
+}
+
+/* ========== Public Interface ========== */
+
+void timer_arm(TimerWheel* wheel, Timer* timer, uint64_t deadline) {
+    timer_cancel(wheel, timer);
+    timer->deadline = deadline;
+    place(wheel, timer);
+    wheel->count++;
+}
+
+void timer_cancel(TimerWheel* wheel, Timer* timer) {
+    if (!timer_armed(timer)) {
+        return;
+    }
+    int level = timer->level, slot = timer->slot;
+    unlink_timer(timer);
+    if (level != DUE_LEVEL && !wheel->slots[level][slot]) {
+        wheel->occupied[level] &= ~(1ULL << slot);
+    }
+    wheel->count--;
+}
+
+Timer* timer_wheel_expire(TimerWheel* wheel, uint64_t now) {
+    while (!wheel->due && wheel->now < now) {
+        uint64_t next = next_work(wheel);
+        if (next > now) {
+            wheel->now = now;                    /* Nothing in between: jump */
+            break;
+        }
+        wheel->now = next - 1;
+        tick(wheel);
+    }
+
+    Timer* timer = wheel->due;
+    if (timer) {
+        unlink_timer(timer);
+        wheel->count--;
+    }
+    return timer;
+}
+
+int timer_wheel_timeout(const TimerWheel* wheel, uint64_t now, int limit_ms) {
+    if (wheel->due) {
+        return 0;
+    }
+    uint64_t next = next_work(wheel);
+    if (next == UINT64_MAX) {
+        return limit_ms < 0 ? -1 : limit_ms;
+    }
+    uint64_t wait = next > now ? next - now : 0;
+    if (limit_ms >= 0 && wait > (uint64_t)limit_ms) {
+        return limit_ms;
+    }
+    return wait > INT_MAX ? INT_MAX : (int)wait;
+}
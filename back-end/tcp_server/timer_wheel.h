@@ -0,0 +1,55 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "protocol.h"
+
+/* ========== Hierarchical Timer Wheel ========== */
+
+/*
+ * Millisecond timers in four levels of 64 slots: level n holds the timers
+ * due within 64^(n+1) ms, in the slot of their deadline's n-th base-64
+ * digit. Arming and cancelling are O(1) list operations; a level's slot is
+ * pushed down one level when the time reaches it, so every timer moves at
+ * most three times before it fires. Deadlines beyond the top level (about
+ * 4.6 hours) wait in its farthest slot and are placed again from there.
+ * Per-level occupancy bitmaps let the wheel skip empty slots and tell how
+ * long the owner may sleep. All functions expect the caller to serialize
+ * access (the server holds the reactor lock).
+ */
+
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+
+typedef struct {
+    uint64_t now;                        /* Time up to which timers were expired */
+    Timer* slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t occupied[WHEEL_LEVELS];     /* Bit per non-empty slot */
+    Timer* due;                          /* Expired, not yet handed out */
+    size_t count;                        /* Armed timers, due ones included */
+} TimerWheel;
+
+/* Milliseconds on the monotonic clock */
+uint64_t timer_now_ms(void);
+
+void timer_wheel_init(TimerWheel* wheel, uint64_t now);
+
+/* Arm (or re-arm) a timer for an absolute deadline; past deadlines fire on
+ * the next expiry */
+void timer_arm(TimerWheel* wheel, Timer* timer, uint64_t deadline);
+void timer_cancel(TimerWheel* wheel, Timer* timer);
+
+static inline int timer_armed(const Timer* timer) {
+    return timer->pprev != NULL;
+}
+
+/* Advance to now and hand out one expired timer, already disarmed; NULL
+ * when none is left. Timers armed by the caller meanwhile are honoured. */
+Timer* timer_wheel_expire(TimerWheel* wheel, uint64_t now);
+
+/* Milliseconds the owner may wait before calling timer_wheel_expire()
+ * again, at most limit_ms (a negative limit means no limit; -1 is returned
+ * if nothing is armed then) */
+int timer_wheel_timeout(const TimerWheel* wheel, uint64_t now, int limit_ms);
+
+#endif /* TIMER_WHEEL_H */
@@ -17,6 +17,15 @@ if env_path.exists():
 SERVER_HOST = os.getenv('SERVER_HOST', 'localhost')
 SERVER_PORT = int(os.getenv('SERVER_PORT', '8765'))
 
+# Send moves with the compact binary encoding (server replies in kind)
+BINARY_PAYLOADS = os.getenv('BINARY_PAYLOADS', 'true').lower() == 'true'
+
+# Read the socket on a native thread; the UI dispatches when its event fd fires
+NETWORK_THREAD = os.getenv('NETWORK_THREAD', 'true').lower() == 'true'
+
+# Ask the server to deflate large replies (history pages, game lists)
+COMPRESSION = os.getenv('COMPRESSION', 'true').lower() == 'true'
+
 # Application settings
 APP_TITLE = "Chess Desktop App"
 
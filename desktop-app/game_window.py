@@ -501,6 +501,8 @@ class GameWindow(QWidget):
         """Handle incoming network messages"""
         if message_id == MessageTypeS2C.GAME_STATE_UPDATE:
             self.handle_game_state_update(data)
+        elif message_id == MessageTypeS2C.OPPONENT_MOVE:
+            self.handle_opponent_move(data)
         elif message_id == MessageTypeS2C.INVALID_MOVE:
             self.handle_invalid_move(data)
         elif message_id == MessageTypeS2C.GAME_OVER:
@@ -579,6 +581,24 @@ class GameWindow(QWidget):
         # Reset timer on turn change
         self.reset_timer()
     
+    def handle_opponent_move(self, data: dict):
+        """
+        Handle opponent move relayed by the server before validation
+        Receives MSG_S2C_OPPONENT_MOVE (0x1208); the GAME_STATE_UPDATE that
+        follows stays authoritative
+        """
+        if data.get('game_id') not in (None, self.game_id):
+            return
+        board = chess.Board(self.chess_board.get_fen())
+        try:
+            move = chess.Move.from_uci(data.get('move', ''))
+        except ValueError:
+            return
+        if move not in board.legal_moves:
+            return
+        board.push(move)
+        self.handle_game_state_update({'fen': board.fen(), 'is_check': board.is_check()})
+    
     def update_timer(self):
         """Update countdown timer"""
         if self.current_time_left > 0:
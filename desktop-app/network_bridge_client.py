@@ -31,6 +31,9 @@ class MessageTypeC2S(IntEnum):
     DECLINE_CHALLENGE = 0x0027
     GET_STATS = 0x0030
     GET_HISTORY = 0x0031
+    SPECTATE = 0x0040
+    STOP_SPECTATING = 0x0041
+    SET_COMPRESSION = 0x0050
 
 
 class MessageTypeS2C(IntEnum):
@@ -49,8 +52,11 @@ class MessageTypeS2C(IntEnum):
     CHALLENGE_RECEIVED = 0x1205
     CHALLENGE_ACCEPTED = 0x1206
     CHALLENGE_DECLINED = 0x1207
+    OPPONENT_MOVE = 0x1208
     STATS_RESPONSE = 0x1300
     HISTORY_RESPONSE = 0x1301
+    SPECTATE_KEYFRAME = 0x1400
+    SPECTATE_DELTA = 0x1401
 
 
 class EventType(IntEnum):
@@ -63,13 +69,68 @@ class EventType(IntEnum):
 
 # ========== C Structure Definitions ==========
 
+# Events drained per client_poll_batch() call
+EVENT_BATCH_SIZE = 64
+
+# Binary payload encoding (see tcp_client/protocol.h)
+EVENT_FLAG_BINARY = 0x0002
+STATE_FLAG_BLACK_TO_MOVE = 0x01
+STATE_FLAG_IN_CHECK = 0x02
+STATE_FLAG_GAME_OVER = 0x04
+BINARY_GAME_ID_MAX = 64
+BINARY_FEN_MAX = 100
+
+
 class NetworkEvent(ctypes.Structure):
     """Network event structure"""
     _fields_ = [
         ("type", ctypes.c_int),
         ("message_id", ctypes.c_uint16),
         ("payload_length", ctypes.c_uint32),
-        ("payload_data", ctypes.POINTER(ctypes.c_uint8))
+        ("payload_data", ctypes.POINTER(ctypes.c_uint8)),
+        ("flags", ctypes.c_uint32)
+    ]
+
+
+class MovePayload(ctypes.Structure):
+    """Decoded binary OPPONENT_MOVE payload (MAKE_MOVE wire form)"""
+    _fields_ = [
+        ("move", ctypes.c_uint16),
+        ("clock_ms", ctypes.c_uint32),
+        ("game_id", ctypes.c_char * BINARY_GAME_ID_MAX)
+    ]
+
+
+class GameStatePayload(ctypes.Structure):
+    """Decoded binary GAME_STATE_UPDATE payload"""
+    _fields_ = [
+        ("last_move", ctypes.c_uint16),
+        ("flags", ctypes.c_uint8),
+        ("white_ms", ctypes.c_uint32),
+        ("black_ms", ctypes.c_uint32),
+        ("game_id", ctypes.c_char * BINARY_GAME_ID_MAX),
+        ("fen", ctypes.c_char * BINARY_FEN_MAX)
+    ]
+
+
+class SpectatorKeyframe(ctypes.Structure):
+    """Decoded SPECTATE_KEYFRAME payload"""
+    _fields_ = [
+        ("stream", ctypes.c_uint32),
+        ("ply", ctypes.c_uint16),
+        ("state", GameStatePayload)
+    ]
+
+
+class SpectatorDelta(ctypes.Structure):
+    """Decoded SPECTATE_DELTA payload"""
+    _fields_ = [
+        ("stream", ctypes.c_uint32),
+        ("ply", ctypes.c_uint16),
+        ("move", ctypes.c_uint16),
+        ("flags", ctypes.c_uint8),
+        ("white_ms", ctypes.c_uint32),
+        ("black_ms", ctypes.c_uint32)
     ]
 
 
@@ -107,6 +168,9 @@ class NetworkBridge:
         # Connection info
         self.host = None
         self.port = None
+        
+        # Spectator stream number -> game_id, learned from keyframes
+        self.spectator_streams: Dict[int, str] = {}
     
     def _setup_function_signatures(self):
         """Setup ctypes function signatures for C library"""
@@ -123,6 +187,20 @@ class NetworkBridge:
         self.lib.client_poll.argtypes = [ctypes.c_int]
         self.lib.client_poll.restype = ctypes.c_int
         
+        # Native I/O thread: int client_start_thread(void) / void client_stop_thread(void)
+        self.lib.client_start_thread.argtypes = []
+        self.lib.client_start_thread.restype = ctypes.c_int
+        self.lib.client_stop_thread.argtypes = []
+        self.lib.client_stop_thread.restype = None
+        
+        # int client_event_fd(void)
+        self.lib.client_event_fd.argtypes = []
+        self.lib.client_event_fd.restype = ctypes.c_int
+        
+        # int client_enable_compression(void)
+        self.lib.client_enable_compression.argtypes = []
+        self.lib.client_enable_compression.restype = ctypes.c_int
+        
         # int client_send_message(uint16_t message_id, const uint8_t* payload, uint32_t payload_length)
         self.lib.client_send_message.argtypes = [
             ctypes.c_uint16,
@@ -131,6 +209,30 @@ class NetworkBridge:
         ]
         self.lib.client_send_message.restype = ctypes.c_int
         
+        # int client_send_move(const char* game_id, const char* uci, uint32_t clock_ms)
+        self.lib.client_send_move.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_uint32]
+        self.lib.client_send_move.restype = ctypes.c_int
+        
+        # Binary payload codec
+        self.lib.move_to_uci.argtypes = [ctypes.c_uint16, ctypes.c_char_p]
+        self.lib.move_to_uci.restype = ctypes.c_int
+        self.lib.decode_game_state_payload.argtypes = [
+            ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint32, ctypes.POINTER(GameStatePayload)
+        ]
+        self.lib.decode_game_state_payload.restype = ctypes.c_int
+        self.lib.decode_spectator_keyframe.argtypes = [
+            ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint32, ctypes.POINTER(SpectatorKeyframe)
+        ]
+        self.lib.decode_spectator_keyframe.restype = ctypes.c_int
+        self.lib.decode_spectator_delta.argtypes = [
+            ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint32, ctypes.POINTER(SpectatorDelta)
+        ]
+        self.lib.decode_spectator_delta.restype = ctypes.c_int
+        self.lib.decode_move_payload.argtypes = [
+            ctypes.POINTER(ctypes.c_uint8), ctypes.c_uint32, ctypes.POINTER(MovePayload)
+        ]
+        self.lib.decode_move_payload.restype = ctypes.c_int
+        
         # NetworkEvent* get_next_event(void)
         self.lib.get_next_event.argtypes = []
         self.lib.get_next_event.restype = ctypes.POINTER(NetworkEvent)
@@ -139,6 +241,14 @@ class NetworkBridge:
         self.lib.free_event.argtypes = [ctypes.POINTER(NetworkEvent)]
         self.lib.free_event.restype = None
         
+        # int client_poll_batch(NetworkEvent* out, int max)
+        self.lib.client_poll_batch.argtypes = [ctypes.POINTER(NetworkEvent), ctypes.c_int]
+        self.lib.client_poll_batch.restype = ctypes.c_int
+        
+        # void free_event_batch(NetworkEvent* events, int count)
+        self.lib.free_event_batch.argtypes = [ctypes.POINTER(NetworkEvent), ctypes.c_int]
+        self.lib.free_event_batch.restype = None
+        
         # int is_connected(void)
         self.lib.is_connected.argtypes = []
         self.lib.is_connected.restype = ctypes.c_int
@@ -185,6 +295,35 @@ class NetworkBridge:
         """
         return self.lib.client_poll(timeout_ms)
     
+    def start_io_thread(self) -> bool:
+        """
+        Move socket reads onto a native thread. Events are then queued in
+        the background; watch event_fd() and call process_events() when it
+        becomes readable instead of polling.
+        
+        Returns:
+            True if the thread is running
+        """
+        return self.lib.client_start_thread() == 0
+    
+    def stop_io_thread(self):
+        """Stop the I/O thread; poll() reads the socket again"""
+        self.lib.client_stop_thread()
+    
+    def event_fd(self) -> int:
+        """File descriptor readable while events are queued (-1 without the I/O thread)"""
+        return self.lib.client_event_fd()
+    
+    def enable_compression(self) -> bool:
+        """
+        Ask the server to deflate large replies on this connection. They
+        are inflated natively and arrive as ordinary events.
+        
+        Returns:
+            True if the request was sent
+        """
+        return self.lib.client_enable_compression() == 0
+    
     def send_message(self, message_id: int, data: Dict[str, Any]) -> bool:
         """
         Send a message to the server.
@@ -219,6 +358,34 @@ class NetworkBridge:
             print(f"✗ Failed to send message: 0x{message_id:04x}")
             return False
     
+    def send_move(self, game_id: str, uci_move: str, clock_ms: int = 0) -> bool:
+        """
+        Send a move using the binary MAKE_MOVE encoding.
+        
+        The server switches this connection's game state updates to
+        binary once it sees the first binary frame.
+        
+        Args:
+            game_id: Game identifier
+            uci_move: Move in UCI format (e2e4, e7e8q)
+            clock_ms: Mover's remaining time in milliseconds (0 if untimed)
+            
+        Returns:
+            True if message sent successfully, False otherwise
+        """
+        result = self.lib.client_send_move(
+            game_id.encode('utf-8'),
+            uci_move.encode('utf-8'),
+            clock_ms
+        )
+        
+        if result > 0:
+            print(f"→ Sent: MAKE_MOVE (binary) {uci_move}")
+            return True
+        else:
+            print(f"✗ Failed to send move: {uci_move}")
+            return False
+    
     def process_events(self) -> bool:
         """
         Process all pending network events.
@@ -227,32 +394,36 @@ class NetworkBridge:
             True if events were processed, False if no events
         """
         had_events = False
+        # Per call: a handler's modal dialog may re-enter process_events()
+        batch = (NetworkEvent * EVENT_BATCH_SIZE)()
         
         while True:
-            # Get next event
-            event_ptr = self.lib.get_next_event()
-            if not event_ptr:
+            # Drain queued events in batches
+            count = self.lib.client_poll_batch(batch, EVENT_BATCH_SIZE)
+            if count == 0:
                 break
             
             had_events = True
-            event = event_ptr.contents
-            
             try:
-                if event.type == EventType.CONNECTED:
-                    self._handle_connected(event)
-                
-                elif event.type == EventType.DISCONNECTED:
-                    self._handle_disconnected(event)
-                
-                elif event.type == EventType.MESSAGE_RECEIVED:
-                    self._handle_message_received(event)
-                
-                elif event.type == EventType.ERROR:
-                    self._handle_error(event)
-            
+                for i in range(count):
+                    event = batch[i]
+                    try:
+                        if event.type == EventType.CONNECTED:
+                            self._handle_connected(event)
+                        
+                        elif event.type == EventType.DISCONNECTED:
+                            self._handle_disconnected(event)
+                        
+                        elif event.type == EventType.MESSAGE_RECEIVED:
+                            self._handle_message_received(event)
+                        
+                        elif event.type == EventType.ERROR:
+                            self._handle_error(event)
+                    except Exception as e:
+                        print(f"✗ Error handling event {event.type}: {e}")
             finally:
-                # Free the event
-                self.lib.free_event(event_ptr)
+                # Free the payloads
+                self.lib.free_event_batch(batch, count)
         
         return had_events
     
@@ -274,7 +445,9 @@ class NetworkBridge:
         
         # Extract payload
         payload_data = None
-        if event.payload_length > 0 and event.payload_data:
+        if event.flags & EVENT_FLAG_BINARY:
+            payload_data = self._decode_binary_payload(message_id, event)
+        elif event.payload_length > 0 and event.payload_data:
             payload_bytes = bytes(event.payload_data[:event.payload_length])
             try:
                 payload_str = payload_bytes.decode('utf-8')
@@ -298,6 +471,63 @@ class NetworkBridge:
         else:
             print(f"⚠ No handler registered for message type: {msg_name}")
     
+    def _decode_binary_payload(self, message_id: int, event: NetworkEvent) -> Dict[str, Any]:
+        """Decode a binary payload into the same dict its JSON form produces"""
+        if message_id == MessageTypeS2C.GAME_STATE_UPDATE:
+            state = GameStatePayload()
+            if self.lib.decode_game_state_payload(event.payload_data, event.payload_length, ctypes.byref(state)) == 0:
+                return self._game_state_dict(state)
+        elif message_id == MessageTypeS2C.SPECTATE_KEYFRAME:
+            keyframe = SpectatorKeyframe()
+            if self.lib.decode_spectator_keyframe(event.payload_data, event.payload_length, ctypes.byref(keyframe)) == 0:
+                data = self._game_state_dict(keyframe.state)
+                self.spectator_streams[keyframe.stream] = data['game_id']
+                data.update(stream=keyframe.stream, ply=keyframe.ply)
+                return data
+        elif message_id == MessageTypeS2C.SPECTATE_DELTA:
+            delta = SpectatorDelta()
+            if self.lib.decode_spectator_delta(event.payload_data, event.payload_length, ctypes.byref(delta)) == 0:
+                uci = ctypes.create_string_buffer(6)
+                self.lib.move_to_uci(delta.move, uci)
+                # Deltas only name the stream; its keyframe named the game
+                return {
+                    'game_id': self.spectator_streams.get(delta.stream, ''),
+                    'stream': delta.stream,
+                    'ply': delta.ply,
+                    'last_move': uci.value.decode('ascii'),
+                    'turn': 'black' if delta.flags & STATE_FLAG_BLACK_TO_MOVE else 'white',
+                    'in_check': bool(delta.flags & STATE_FLAG_IN_CHECK),
+                    'game_over': bool(delta.flags & STATE_FLAG_GAME_OVER),
+                    'white_time_ms': delta.white_ms,
+                    'black_time_ms': delta.black_ms
+                }
+        elif message_id == MessageTypeS2C.OPPONENT_MOVE:
+            move = MovePayload()
+            if self.lib.decode_move_payload(event.payload_data, event.payload_length, ctypes.byref(move)) == 0:
+                uci = ctypes.create_string_buffer(6)
+                self.lib.move_to_uci(move.move, uci)
+                return {
+                    'game_id': move.game_id.decode('utf-8', 'replace'),
+                    'move': uci.value.decode('ascii'),
+                    'clock_ms': move.clock_ms
+                }
+        print(f"✗ Failed to decode binary payload: 0x{message_id:04x}")
+        return {}
+    
+    def _game_state_dict(self, state: GameStatePayload) -> Dict[str, Any]:
+        uci = ctypes.create_string_buffer(6)
+        self.lib.move_to_uci(state.last_move, uci)
+        return {
+            'game_id': state.game_id.decode('utf-8', 'replace'),
+            'fen': state.fen.decode('ascii', 'replace'),
+            'last_move': uci.value.decode('ascii'),
+            'turn': 'black' if state.flags & STATE_FLAG_BLACK_TO_MOVE else 'white',
+            'in_check': bool(state.flags & STATE_FLAG_IN_CHECK),
+            'game_over': bool(state.flags & STATE_FLAG_GAME_OVER),
+            'white_time_ms': state.white_ms,
+            'black_time_ms': state.black_ms
+        }
+    
     def _handle_error(self, event: NetworkEvent):
         """Handle error event"""
         print(f"✗ Network error event")
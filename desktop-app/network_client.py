@@ -4,10 +4,10 @@ Qt wrapper around NetworkBridge for UI integration
 """
 
 from typing import Optional, Dict, Any, Callable
-from PyQt6.QtCore import QObject, pyqtSignal, QTimer
+from PyQt6.QtCore import QObject, pyqtSignal, QTimer, QSocketNotifier
 
 from network_bridge_client import NetworkBridge, MessageTypeC2S, MessageTypeS2C, EventType
-from config import SERVER_HOST, SERVER_PORT
+from config import SERVER_HOST, SERVER_PORT, BINARY_PAYLOADS, NETWORK_THREAD, COMPRESSION
 
 
 class NetworkClient(QObject):
@@ -36,6 +36,9 @@ class NetworkClient(QObject):
         # Timer for polling events
         self.poll_timer = QTimer()
         self.poll_timer.timeout.connect(self._poll_events)
+        
+        # With the native I/O thread: dispatch when its event fd is readable
+        self.event_notifier = None
     
     def _register_bridge_handlers(self):
         """Register handlers with the bridge to convert to Qt signals"""
@@ -63,6 +66,7 @@ class NetworkClient(QObject):
         """Bridge callback: disconnected"""
         self.disconnected.emit()
         self.poll_timer.stop()
+        self._stop_notifier()
     
     def _on_error(self):
         """Bridge callback: error occurred"""
@@ -73,8 +77,16 @@ class NetworkClient(QObject):
         try:
             result = self.bridge.connect(self.host, self.port)
             if result:
-                # Start polling for events
-                self.poll_timer.start(50)  # Poll every 50ms
+                if COMPRESSION:
+                    self.bridge.enable_compression()
+                if NETWORK_THREAD and self.bridge.start_io_thread():
+                    # Reads run off the UI thread; dispatch as events arrive
+                    self.event_notifier = QSocketNotifier(
+                        self.bridge.event_fd(), QSocketNotifier.Type.Read, self)
+                    self.event_notifier.activated.connect(self._dispatch_events)
+                else:
+                    # Start polling for events
+                    self.poll_timer.start(50)  # Poll every 50ms
             return result
         except Exception as e:
             self.error_occurred.emit(f"Connection failed: {e}")
@@ -83,6 +95,7 @@ class NetworkClient(QObject):
     def disconnect_from_server(self):
         """Disconnect from server"""
         self.poll_timer.stop()
+        self._stop_notifier()
         self.bridge.disconnect()
     
     def is_connected(self) -> bool:
@@ -102,6 +115,17 @@ class NetworkClient(QObject):
         # Process all pending events
         self.bridge.process_events()
     
+    def _dispatch_events(self):
+        """Run the handlers of everything the I/O thread queued (called by QSocketNotifier)"""
+        self.bridge.process_events()
+    
+    def _stop_notifier(self):
+        """Stop watching the I/O thread's event fd"""
+        if self.event_notifier is not None:
+            self.event_notifier.setEnabled(False)
+            self.event_notifier.deleteLater()  # May be inside its own activated signal
+            self.event_notifier = None
+    
     def send_message(self, message_id: int, data: Dict[str, Any]) -> bool:
         """
         Send a message to the server.
@@ -177,6 +201,9 @@ class NetworkClient(QObject):
         
         print(f"📤 Sending move to server: {uci_move} (game: {game_id})")
         
+        if BINARY_PAYLOADS:
+            return self.bridge.send_move(game_id, uci_move)
+        
         move_data = {
             'game_id': game_id,
             'move': uci_move
@@ -223,6 +250,14 @@ class NetworkClient(QObject):
         """Request user statistics"""
         return self.send_message(MessageTypeC2S.GET_STATS, {})
     
-    def get_history(self):
-        """Request game history"""
-        return self.send_message(MessageTypeC2S.GET_HISTORY, {})
+    def get_history(self, offset: int = 0):
+        """Request a page of game history, skipping the newest 'offset' games"""
+        return self.send_message(MessageTypeC2S.GET_HISTORY, {'offset': offset} if offset else {})
+    
+    def spectate(self, game_id: str):
+        """Watch a game: SPECTATE_KEYFRAME, then SPECTATE_DELTA per move"""
+        return self.send_message(MessageTypeC2S.SPECTATE, {'game_id': game_id})
+    
+    def stop_spectating(self, game_id: str):
+        """Stop watching a game"""
+        return self.send_message(MessageTypeC2S.STOP_SPECTATING, {'game_id': game_id})
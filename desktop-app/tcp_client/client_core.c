@@ -11,18 +11,39 @@
 #include <netdb.h>
 #include <poll.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <zlib.h>
 
 /* ========== Global State ========== */
 
+#define EVENT_RING_SIZE 1024                        /* Power of two */
+#define STALL_RETRY_MS 1                            /* I/O thread retry while the ring is full */
+
 static int client_fd = -1;                          /* Client socket descriptor */
 static uint8_t recv_buffer[BUFFER_SIZE];            /* Receive buffer */
+static size_t recv_start = 0;                       /* First byte not yet parsed */
 static size_t recv_offset = 0;                      /* Current offset in recv buffer */
 static uint8_t send_buffer[BUFFER_SIZE];            /* Send buffer */
-static int connected_flag = 0;                      /* Connection status */
-static NetworkEvent event_queue[1024];              /* Event queue */
-static int event_queue_head = 0;
-static int event_queue_tail = 0;
-static int event_queue_count = 0;
+static atomic_int connected_flag = 0;               /* Connection status */
+
+/* Event ring: single producer (the I/O thread while it runs, otherwise
+ * the caller of client_poll()), single consumer (the UI thread) */
+static NetworkEvent event_ring[EVENT_RING_SIZE];
+static atomic_size_t ring_head = 0;                 /* Next event to hand out */
+static atomic_size_t ring_tail = 0;                 /* Next free slot */
+static int ring_stalled = 0;                        /* Complete frames wait for ring space */
+
+/* Native I/O thread */
+static atomic_int io_thread_running = 0;
+static pthread_t io_thread;
+static int event_pipe[2] = { -1, -1 };              /* I/O thread -> UI wakeup */
+static atomic_int event_pending = 0;
+static int stop_pipe[2] = { -1, -1 };               /* UI -> I/O thread stop request */
+
+/* Compressed frames form one deflate stream per connection */
+static z_stream inflater;
+static atomic_int inflater_ready = 0;
 
 /* ========== Helper Functions ========== */
 
@@ -40,58 +61,251 @@ static int set_nonblocking(int fd) {
     return 0;
 }
 
+/* Drop the connection's inflate stream; the I/O thread must be stopped */
+static void reset_inflater(void) {
+    if (atomic_exchange(&inflater_ready, 0)) {
+        inflateEnd(&inflater);
+    }
+}
+
+/* Inflate a compressed frame into a new buffer. NULL if the stream is
+ * broken, in which case nothing later on the connection can be read. */
+static uint8_t* inflate_payload(const uint8_t* data, uint32_t length, uint32_t* inflated_length) {
+    if (!atomic_load_explicit(&inflater_ready, memory_order_acquire) || length < 4) {
+        return NULL;
+    }
+    uint32_t original = (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+                        (uint32_t)data[2] << 8 | data[3];
+    if (original > COMPRESS_MAX_PAYLOAD) {
+        return NULL;
+    }
+    
+    /* One spare byte lets inflate() run through the sync flush marker */
+    uint8_t* out = malloc((size_t)original + 1);
+    if (!out) {
+        return NULL;
+    }
+    inflater.next_in = (Bytef*)data + 4;
+    inflater.avail_in = length - 4;
+    inflater.next_out = out;
+    inflater.avail_out = original + 1;
+    int status = inflate(&inflater, Z_SYNC_FLUSH);
+    if (status != Z_OK || inflater.avail_in > 0 || inflater.avail_out != 1) {
+        fprintf(stderr, "Corrupt compressed frame\n");
+        free(out);
+        return NULL;
+    }
+    *inflated_length = original;
+    return out;
+}
+
+/* Free slots in the event ring (producer side) */
+static size_t ring_space(void) {
+    size_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    return EVENT_RING_SIZE - (tail - head);
+}
+
 /* Add event to queue */
 static void enqueue_event(NetworkEvent event) {
-    if (event_queue_count >= 1024) {
+    if (ring_space() == 0) {
         fprintf(stderr, "Event queue full, dropping event\n");
         if (event.payload_data) {
             free(event.payload_data);
         }
         return;
     }
-    event_queue[event_queue_tail] = event;
-    event_queue_tail = (event_queue_tail + 1) % 1024;
-    event_queue_count++;
+    size_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    event_ring[tail & (EVENT_RING_SIZE - 1)] = event;
+    atomic_store_explicit(&ring_tail, tail + 1, memory_order_release);
+}
+
+/* Take up to max events off the ring (consumer side) */
+static int dequeue_events(NetworkEvent* out, int max) {
+    size_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    int count = 0;
+    while (head != tail && count < max) {
+        out[count++] = event_ring[head & (EVENT_RING_SIZE - 1)];
+        head++;
+    }
+    atomic_store_explicit(&ring_head, head, memory_order_release);
+    return count;
+}
+
+/* Events waiting in the ring */
+static size_t queued_event_count(void) {
+    return atomic_load_explicit(&ring_tail, memory_order_acquire)
+         - atomic_load_explicit(&ring_head, memory_order_acquire);
 }
 
-/* Process received data and extract complete messages */
-static void process_received_data(void) {
-    while (recv_offset >= HEADER_SIZE) {
+/* Wake the UI: make the event fd readable (once until it is drained) */
+static void notify_ui(void) {
+    if (event_pipe[1] == -1 || atomic_exchange(&event_pending, 1)) {
+        return;
+    }
+    char byte = 1;
+    if (write(event_pipe[1], &byte, 1) == -1 && errno != EAGAIN) {
+        perror("write wakeup");
+    }
+}
+
+/* Drain the event fd; anything queued afterwards writes it again */
+static void clear_ui_wakeup(void) {
+    char drain[64];
+    while (read(event_pipe[0], drain, sizeof(drain)) > 0) {
+    }
+    atomic_store(&event_pending, 0);
+}
+
+/* Process received data and extract complete messages. Frames are parsed
+ * in place; the unparsed tail is moved to the front once per call. A full
+ * ring leaves the remaining frames in the buffer (ring_stalled) instead of
+ * dropping them. Returns -1 on a frame that can never fit. */
+static int process_received_data(void) {
+    ring_stalled = 0;
+    while (recv_offset - recv_start >= HEADER_SIZE) {
         /* Parse header */
-        MessageHeader* header = (MessageHeader*)recv_buffer;
+        MessageHeader* header = (MessageHeader*)(recv_buffer + recv_start);
         uint16_t message_id = ntohs(header->message_id);
         uint32_t payload_length = ntohl(header->payload_length);
+        size_t message_size = HEADER_SIZE + (size_t)payload_length;
+        
+        if (message_size > BUFFER_SIZE) {
+            fprintf(stderr, "Message too large: %zu bytes\n", message_size);
+            return -1;
+        }
         
         /* Check if we have complete message */
-        if (recv_offset < HEADER_SIZE + payload_length) {
+        if (recv_offset - recv_start < message_size) {
             break; /* Need more data */
         }
+        if (ring_space() == 0) {
+            ring_stalled = 1;
+            break; /* UI is behind; TCP flow control does the rest */
+        }
         
         /* Extract payload */
         uint8_t* payload_data = NULL;
-        if (payload_length > 0) {
+        uint32_t flags = (message_id & MSG_FLAG_BINARY) ? EVENT_FLAG_BINARY : 0;
+        if (message_id & MSG_FLAG_COMPRESSED) {
+            payload_data = inflate_payload(recv_buffer + recv_start + HEADER_SIZE,
+                                           payload_length, &payload_length);
+            if (!payload_data) {
+                return -1;
+            }
+            flags |= EVENT_FLAG_COMPRESSED;
+        } else if (payload_length > 0) {
             payload_data = malloc(payload_length);
             if (payload_data) {
-                memcpy(payload_data, recv_buffer + HEADER_SIZE, payload_length);
+                memcpy(payload_data, recv_buffer + recv_start + HEADER_SIZE, payload_length);
             }
         }
         
         /* Enqueue message event */
         NetworkEvent event = {
             .type = EVENT_MESSAGE_RECEIVED,
-            .message_id = message_id,
+            .message_id = message_id & MSG_ID_MASK,
             .payload_length = payload_length,
-            .payload_data = payload_data
+            .payload_data = payload_data,
+            .flags = flags
         };
         enqueue_event(event);
+        recv_start += message_size;
+    }
+    
+    /* Keep only the unparsed bytes */
+    if (recv_start > 0) {
+        memmove(recv_buffer, recv_buffer + recv_start, recv_offset - recv_start);
+        recv_offset -= recv_start;
+        recv_start = 0;
+    }
+    return 0;
+}
+
+/* Handle the socket's poll() result; -1 once the connection is gone */
+static int service_socket(short revents) {
+    /* Check for errors */
+    if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        fprintf(stderr, "Connection error\n");
+        return -1;
+    }
+    if (!(revents & POLLIN)) {
+        return 0;
+    }
+    
+    /* Frames parked by a full ring fill the buffer: parse before reading more */
+    if (recv_offset == BUFFER_SIZE) {
+        return process_received_data();
+    }
+    ssize_t bytes_received = recv(client_fd,
+                                  recv_buffer + recv_offset,
+                                  BUFFER_SIZE - recv_offset,
+                                  0);
+    if (bytes_received <= 0) {
+        if (bytes_received == 0 || (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR)) {
+            return -1; /* Connection closed or error */
+        }
+        return 0;
+    }
+    recv_offset += bytes_received;
+    return process_received_data();
+}
+
+/* I/O thread: read and frame everything the server sends, queue the
+ * events and wake the UI. The socket stays open after a disconnect until
+ * client_shutdown(); only the DISCONNECTED event is queued here. */
+static void* io_thread_main(void* arg) {
+    (void)arg;
+    while (atomic_load(&io_thread_running)) {
+        size_t queued_before = atomic_load_explicit(&ring_tail, memory_order_relaxed);
         
-        /* Remove processed message from buffer */
-        size_t message_size = HEADER_SIZE + payload_length;
-        memmove(recv_buffer, 
-                recv_buffer + message_size,
-                recv_offset - message_size);
-        recv_offset -= message_size;
+        /* While stalled, only wait for the UI to make room */
+        struct pollfd fds[2] = {
+            { .fd = ring_stalled ? -1 : client_fd, .events = POLLIN, .revents = 0 },
+            { .fd = stop_pipe[0], .events = POLLIN, .revents = 0 }
+        };
+        int poll_count = poll(fds, 2, ring_stalled ? STALL_RETRY_MS : -1);
+        if (poll_count == -1 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        if (fds[1].revents) {
+            break; /* client_stop_thread() */
+        }
+        
+        int lost = ring_stalled ? process_received_data() : poll_count > 0 ? service_socket(fds[0].revents) : 0;
+        if (lost == -1) {
+            atomic_store(&connected_flag, 0);
+            NetworkEvent event = {
+                .type = EVENT_DISCONNECTED,
+                .message_id = 0,
+                .payload_length = 0,
+                .payload_data = NULL
+            };
+            enqueue_event(event);
+            notify_ui();
+            break;
+        }
+        if (atomic_load_explicit(&ring_tail, memory_order_relaxed) != queued_before) {
+            notify_ui();
+        }
     }
+    return NULL;
+}
+
+/* Create a non-blocking pipe once */
+static int open_pipe(int fds[2]) {
+    if (fds[0] != -1) {
+        return 0;
+    }
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        return -1;
+    }
+    set_nonblocking(fds[0]);
+    set_nonblocking(fds[1]);
+    return 0;
 }
 
 /* ========== Client API Implementation ========== */
@@ -100,6 +314,14 @@ int client_init(const char* host, int port) {
     struct sockaddr_in server_addr;
     struct hostent* server;
     
+    /* A connection the I/O thread saw drop stays open until now */
+    client_stop_thread();
+    if (client_fd != -1) {
+        close(client_fd);
+        client_fd = -1;
+    }
+    reset_inflater();
+    
     /* Create socket */
     client_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (client_fd == -1) {
@@ -138,8 +360,10 @@ int client_init(const char* host, int port) {
     }
     
     /* Initialize state */
+    recv_start = 0;
     recv_offset = 0;
-    connected_flag = 1;
+    ring_stalled = 0;
+    atomic_store(&connected_flag, 1);
     
     /* Enqueue connected event */
     NetworkEvent event = {
@@ -155,28 +379,60 @@ int client_init(const char* host, int port) {
 }
 
 void client_shutdown(void) {
+    client_stop_thread();
+    
     if (client_fd != -1) {
         close(client_fd);
         client_fd = -1;
     }
+    reset_inflater();
     
-    connected_flag = 0;
+    recv_start = 0;
     recv_offset = 0;
+    ring_stalled = 0;
     
-    /* Enqueue disconnected event */
-    NetworkEvent event = {
-        .type = EVENT_DISCONNECTED,
-        .message_id = 0,
-        .payload_length = 0,
-        .payload_data = NULL
-    };
-    enqueue_event(event);
+    /* Enqueue disconnected event, unless the I/O thread already did */
+    if (atomic_exchange(&connected_flag, 0)) {
+        NetworkEvent event = {
+            .type = EVENT_DISCONNECTED,
+            .message_id = 0,
+            .payload_length = 0,
+            .payload_data = NULL
+        };
+        enqueue_event(event);
+        notify_ui();
+    }
     
     printf("Disconnected from server\n");
 }
 
+/* Threaded mode: block until the I/O thread has queued something */
+static int wait_for_events(int timeout_ms) {
+    size_t queued = queued_event_count();
+    if (queued > 0) {
+        return (int)queued;
+    }
+    
+    struct pollfd pfd = { .fd = event_pipe[0], .events = POLLIN, .revents = 0 };
+    if (poll(&pfd, 1, timeout_ms) == -1 && errno != EINTR) {
+        perror("poll wakeup");
+        return -1;
+    }
+    clear_ui_wakeup();
+    return (int)queued_event_count();
+}
+
 int client_poll(int timeout_ms) {
-    if (!connected_flag || client_fd == -1) {
+    if (!atomic_load(&connected_flag) || client_fd == -1) {
+        return -1;
+    }
+    if (atomic_load(&io_thread_running)) {
+        return wait_for_events(timeout_ms);
+    }
+    
+    /* Frames held back by a full ring go first */
+    if (ring_stalled && process_received_data() == -1) {
+        client_shutdown();
         return -1;
     }
     
@@ -196,33 +452,58 @@ int client_poll(int timeout_ms) {
         return 0; /* Timeout */
     }
     
-    /* Check for errors */
-    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
-        fprintf(stderr, "Connection error\n");
+    /* Handle incoming data */
+    if (service_socket(pfd.revents) == -1) {
         client_shutdown();
         return -1;
     }
     
-    /* Handle incoming data */
-    if (pfd.revents & POLLIN) {
-        ssize_t bytes_received = recv(client_fd, 
-                                       recv_buffer + recv_offset,
-                                       BUFFER_SIZE - recv_offset,
-                                       0);
-        
-        if (bytes_received <= 0) {
-            if (bytes_received == 0 || (errno != EWOULDBLOCK && errno != EAGAIN)) {
-                /* Connection closed or error */
-                client_shutdown();
-                return -1;
-            }
-        } else {
-            recv_offset += bytes_received;
-            process_received_data();
-        }
+    return poll_count;
+}
+
+int client_start_thread(void) {
+    if (atomic_load(&io_thread_running)) {
+        return 0;
+    }
+    if (!atomic_load(&connected_flag) || client_fd == -1) {
+        fprintf(stderr, "client_start_thread: not connected\n");
+        return -1;
+    }
+    if (open_pipe(event_pipe) == -1 || open_pipe(stop_pipe) == -1) {
+        return -1;
     }
     
-    return poll_count;
+    atomic_store(&io_thread_running, 1);
+    if (pthread_create(&io_thread, NULL, io_thread_main, NULL) != 0) {
+        perror("pthread_create");
+        atomic_store(&io_thread_running, 0);
+        return -1;
+    }
+    
+    /* Events queued before the thread started (CONNECTED) */
+    if (queued_event_count() > 0) {
+        notify_ui();
+    }
+    return 0;
+}
+
+void client_stop_thread(void) {
+    if (!atomic_exchange(&io_thread_running, 0)) {
+        return;
+    }
+    char byte = 1;
+    if (write(stop_pipe[1], &byte, 1) == -1 && errno != EAGAIN) {
+        perror("write stop");
+    }
+    pthread_join(io_thread, NULL);
+    
+    char drain[64];
+    while (read(stop_pipe[0], drain, sizeof(drain)) > 0) {
+    }
+}
+
+int client_event_fd(void) {
+    return event_pipe[0];
 }
 
 int client_send_message(uint16_t message_id, const uint8_t* payload, uint32_t payload_length) {
@@ -263,23 +544,90 @@ int client_send_message(uint16_t message_id, const uint8_t* payload, uint32_t pa
     return bytes_sent;
 }
 
+int client_enable_compression(void) {
+    if (!connected_flag || client_fd == -1) {
+        fprintf(stderr, "Not connected to server\n");
+        return -1;
+    }
+    
+    /* Ready before the request goes out: the first reply may follow at once */
+    if (!atomic_load(&inflater_ready)) {
+        memset(&inflater, 0, sizeof(inflater));
+        if (inflateInit2(&inflater, -MAX_WBITS) != Z_OK) {
+            fprintf(stderr, "inflateInit2 failed\n");
+            return -1;
+        }
+        inflateSetDictionary(&inflater, (const Bytef*)COMPRESSION_DICTIONARY,
+                             sizeof(COMPRESSION_DICTIONARY) - 1);
+        atomic_store_explicit(&inflater_ready, 1, memory_order_release);
+    }
+    
+    uint8_t method = COMPRESSION_DEFLATE;
+    return client_send_message(MSG_C2S_SET_COMPRESSION, &method, 1) > 0 ? 0 : -1;
+}
+
+int client_send_move(const char* game_id, const char* uci, uint32_t clock_ms) {
+    MovePayload move;
+    move.move = move_from_uci(uci);
+    if (move.move == MOVE_NONE) {
+        fprintf(stderr, "Invalid UCI move: %s\n", uci ? uci : "(null)");
+        return -1;
+    }
+    move.clock_ms = clock_ms;
+    snprintf(move.game_id, sizeof(move.game_id), "%s", game_id ? game_id : "");
+    
+    uint8_t payload[sizeof(MovePayload)];
+    int length = encode_move_payload(&move, payload, sizeof(payload));
+    if (length == -1) {
+        return -1;
+    }
+    return client_send_message(MSG_C2S_MAKE_MOVE | MSG_FLAG_BINARY, payload, (uint32_t)length);
+}
+
+/* Pop up to max events (consumer side). Finding the ring empty
+ * acknowledges the wakeup first, then looks again, so an event queued in
+ * between either gets returned or leaves the event fd readable. */
+static int take_events(NetworkEvent* out, int max) {
+    int count = dequeue_events(out, max);
+    if (count < max && event_pipe[0] != -1) {
+        clear_ui_wakeup();
+        count += dequeue_events(out + count, max - count);
+    }
+    return count;
+}
+
 NetworkEvent* get_next_event(void) {
-    if (event_queue_count == 0) {
+    NetworkEvent next;
+    if (take_events(&next, 1) == 0) {
         return NULL;
     }
     
     NetworkEvent* event = malloc(sizeof(NetworkEvent));
     if (!event) {
+        free(next.payload_data);
         return NULL;
     }
     
-    *event = event_queue[event_queue_head];
-    event_queue_head = (event_queue_head + 1) % 1024;
-    event_queue_count--;
-    
+    *event = next;
     return event;
 }
 
+int client_poll_batch(NetworkEvent* out, int max) {
+    if (!out || max <= 0) {
+        return 0;
+    }
+    return take_events(out, max);
+}
+
+void free_event_batch(NetworkEvent* events, int count) {
+    for (int i = 0; i < count; i++) {
+        if (events[i].payload_data) {
+            free(events[i].payload_data);
+        }
+        events[i].payload_data = NULL;
+    }
+}
+
 void free_event(NetworkEvent* event) {
     if (event) {
         if (event->payload_data) {
@@ -289,12 +637,200 @@ void free_event(NetworkEvent* event) {
     }
 }
 
+/* ========== Binary Payload Codec ========== */
+
+static const char promotion_pieces[] = "nbrq";   /* Knight..queen, as in bits 12-13 */
+
+static void put_u16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)(value >> 8);
+    out[1] = (uint8_t)value;
+}
+
+static void put_u32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static uint16_t get_u16(const uint8_t* in) {
+    return (uint16_t)((in[0] << 8) | in[1]);
+}
+
+static uint32_t get_u32(const uint8_t* in) {
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+/* Copy a length-prefixed string out of a payload; returns bytes consumed or -1 */
+static int get_string(const uint8_t* in, size_t available, char* out, size_t out_size) {
+    if (available < 1) {
+        return -1;
+    }
+    size_t length = in[0];
+    if (length >= out_size || 1 + length > available) {
+        return -1;
+    }
+    memcpy(out, in + 1, length);
+    out[length] = '\0';
+    return (int)(1 + length);
+}
+
+/* Length of a NUL-terminated field, capped to what the wire form allows */
+static size_t field_length(const char* field, size_t max) {
+    size_t length = 0;
+    while (length < max && field[length]) {
+        length++;
+    }
+    return length;
+}
+
+uint16_t move_from_uci(const char* uci) {
+    if (!uci || strlen(uci) < 4 || strlen(uci) > 5) {
+        return MOVE_NONE;
+    }
+    int from_file = uci[0] - 'a', from_rank = uci[1] - '1';
+    int to_file = uci[2] - 'a', to_rank = uci[3] - '1';
+    if (from_file < 0 || from_file > 7 || from_rank < 0 || from_rank > 7
+        || to_file < 0 || to_file > 7 || to_rank < 0 || to_rank > 7) {
+        return MOVE_NONE;
+    }
+    
+    uint16_t move = (uint16_t)(((from_rank * 8 + from_file) << 6) | (to_rank * 8 + to_file));
+    if (uci[4]) {
+        const char* piece = strchr(promotion_pieces, uci[4] | 0x20);
+        if (!piece) {
+            return MOVE_NONE;
+        }
+        move |= (uint16_t)(MOVE_TYPE_PROMOTION | ((piece - promotion_pieces) << 12));
+    }
+    return move;
+}
+
+int move_to_uci(uint16_t move, char* out) {
+    if (move == MOVE_NONE) {
+        strcpy(out, "0000");
+        return 4;
+    }
+    int from = (move >> 6) & 0x3F, to = move & 0x3F;
+    out[0] = (char)('a' + (from & 7));
+    out[1] = (char)('1' + (from >> 3));
+    out[2] = (char)('a' + (to & 7));
+    out[3] = (char)('1' + (to >> 3));
+    int length = 4;
+    if ((move & MOVE_TYPE_MASK) == MOVE_TYPE_PROMOTION) {
+        out[length++] = promotion_pieces[(move >> 12) & 3];
+    }
+    out[length] = '\0';
+    return length;
+}
+
+int encode_move_payload(const MovePayload* move, uint8_t* out, size_t capacity) {
+    size_t id_length = field_length(move->game_id, BINARY_GAME_ID_MAX - 1);
+    size_t size = 2 + 4 + 1 + id_length;
+    if (size > capacity) {
+        return -1;
+    }
+    put_u16(out, move->move);
+    put_u32(out + 2, move->clock_ms);
+    out[6] = (uint8_t)id_length;
+    memcpy(out + 7, move->game_id, id_length);
+    return (int)size;
+}
+
+int decode_move_payload(const uint8_t* payload, uint32_t length, MovePayload* move) {
+    if (!payload || length < 7) {
+        return -1;
+    }
+    move->move = get_u16(payload);
+    move->clock_ms = get_u32(payload + 2);
+    return get_string(payload + 6, length - 6, move->game_id, sizeof(move->game_id)) == -1 ? -1 : 0;
+}
+
+int encode_game_state_payload(const GameStatePayload* state, uint8_t* out, size_t capacity) {
+    size_t id_length = field_length(state->game_id, BINARY_GAME_ID_MAX - 1);
+    size_t fen_length = field_length(state->fen, BINARY_FEN_MAX - 1);
+    size_t size = 2 + 1 + 4 + 4 + 1 + id_length + 1 + fen_length;
+    if (size > capacity) {
+        return -1;
+    }
+    put_u16(out, state->last_move);
+    out[2] = state->flags;
+    put_u32(out + 3, state->white_ms);
+    put_u32(out + 7, state->black_ms);
+    out[11] = (uint8_t)id_length;
+    memcpy(out + 12, state->game_id, id_length);
+    out[12 + id_length] = (uint8_t)fen_length;
+    memcpy(out + 13 + id_length, state->fen, fen_length);
+    return (int)size;
+}
+
+int decode_game_state_payload(const uint8_t* payload, uint32_t length, GameStatePayload* state) {
+    if (!payload || length < 11) {
+        return -1;
+    }
+    state->last_move = get_u16(payload);
+    state->flags = payload[2];
+    state->white_ms = get_u32(payload + 3);
+    state->black_ms = get_u32(payload + 7);
+    int used = get_string(payload + 11, length - 11, state->game_id, sizeof(state->game_id));
+    if (used == -1) {
+        return -1;
+    }
+    size_t offset = 11 + (size_t)used;
+    return get_string(payload + offset, length - offset, state->fen, sizeof(state->fen)) == -1 ? -1 : 0;
+}
+
+int encode_spectator_keyframe(const SpectatorKeyframe* keyframe, uint8_t* out, size_t capacity) {
+    if (capacity < 6) {
+        return -1;
+    }
+    put_u32(out, keyframe->stream);
+    put_u16(out + 4, keyframe->ply);
+    int length = encode_game_state_payload(&keyframe->state, out + 6, capacity - 6);
+    return length == -1 ? -1 : 6 + length;
+}
+
+int decode_spectator_keyframe(const uint8_t* payload, uint32_t length, SpectatorKeyframe* keyframe) {
+    if (!payload || length < 6) {
+        return -1;
+    }
+    keyframe->stream = get_u32(payload);
+    keyframe->ply = get_u16(payload + 4);
+    return decode_game_state_payload(payload + 6, length - 6, &keyframe->state);
+}
+
+int encode_spectator_delta(const SpectatorDelta* delta, uint8_t* out, size_t capacity) {
+    if (capacity < SPECTATOR_DELTA_SIZE) {
+        return -1;
+    }
+    put_u32(out, delta->stream);
+    put_u16(out + 4, delta->ply);
+    put_u16(out + 6, delta->move);
+    out[8] = delta->flags;
+    put_u32(out + 9, delta->white_ms);
+    put_u32(out + 13, delta->black_ms);
+    return SPECTATOR_DELTA_SIZE;
+}
+
+int decode_spectator_delta(const uint8_t* payload, uint32_t length, SpectatorDelta* delta) {
+    if (!payload || length < SPECTATOR_DELTA_SIZE) {
+        return -1;
+    }
+    delta->stream = get_u32(payload);
+    delta->ply = get_u16(payload + 4);
+    delta->move = get_u16(payload + 6);
+    delta->flags = payload[8];
+    delta->white_ms = get_u32(payload + 9);
+    delta->black_ms = get_u32(payload + 13);
+    return 0;
+}
+
 int is_connected(void) {
     return connected_flag;
 }
 
 const char* get_message_type_name(uint16_t message_id) {
-    switch (message_id) {
+    switch (message_id & MSG_ID_MASK) {
         /* C2S */
         case MSG_C2S_REGISTER: return "REGISTER";
         case MSG_C2S_LOGIN: return "LOGIN";
@@ -312,6 +848,9 @@ const char* get_message_type_name(uint16_t message_id) {
         case MSG_C2S_DECLINE_CHALLENGE: return "DECLINE_CHALLENGE";
         case MSG_C2S_GET_STATS: return "GET_STATS";
         case MSG_C2S_GET_HISTORY: return "GET_HISTORY";
+        case MSG_C2S_SPECTATE: return "SPECTATE";
+        case MSG_C2S_STOP_SPECTATING: return "STOP_SPECTATING";
+        case MSG_C2S_SET_COMPRESSION: return "SET_COMPRESSION";
         
         /* S2C */
         case MSG_S2C_REGISTER_RESULT: return "REGISTER_RESULT";
@@ -328,8 +867,11 @@ const char* get_message_type_name(uint16_t message_id) {
         case MSG_S2C_CHALLENGE_RECEIVED: return "CHALLENGE_RECEIVED";
         case MSG_S2C_CHALLENGE_ACCEPTED: return "CHALLENGE_ACCEPTED";
         case MSG_S2C_CHALLENGE_DECLINED: return "CHALLENGE_DECLINED";
+        case MSG_S2C_OPPONENT_MOVE: return "OPPONENT_MOVE";
         case MSG_S2C_STATS_RESPONSE: return "STATS_RESPONSE";
         case MSG_S2C_HISTORY_RESPONSE: return "HISTORY_RESPONSE";
+        case MSG_S2C_SPECTATE_KEYFRAME: return "SPECTATE_KEYFRAME";
+        case MSG_S2C_SPECTATE_DELTA: return "SPECTATE_DELTA";
         
         default: return "UNKNOWN";
     }
@@ -2,6 +2,7 @@
 #define PROTOCOL_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 /* ========== Constants ========== */
 
@@ -27,6 +28,9 @@
 #define MSG_C2S_DECLINE_CHALLENGE   0x0027
 #define MSG_C2S_GET_STATS           0x0030
 #define MSG_C2S_GET_HISTORY         0x0031
+#define MSG_C2S_SPECTATE            0x0040
+#define MSG_C2S_STOP_SPECTATING     0x0041
+#define MSG_C2S_SET_COMPRESSION     0x0050  /* Transport, see client_enable_compression() */
 
 /* Server to Client Messages */
 #define MSG_S2C_REGISTER_RESULT     0x1001
@@ -43,8 +47,11 @@
 #define MSG_S2C_CHALLENGE_RECEIVED  0x1205
 #define MSG_S2C_CHALLENGE_ACCEPTED  0x1206
 #define MSG_S2C_CHALLENGE_DECLINED  0x1207
+#define MSG_S2C_OPPONENT_MOVE       0x1208  /* Opponent's MAKE_MOVE, relayed natively */
 #define MSG_S2C_STATS_RESPONSE      0x1300
 #define MSG_S2C_HISTORY_RESPONSE    0x1301
+#define MSG_S2C_SPECTATE_KEYFRAME   0x1400  /* Spectator stream, always binary */
+#define MSG_S2C_SPECTATE_DELTA      0x1401
 
 /* ========== Event Types ========== */
 
@@ -53,6 +60,10 @@
 #define EVENT_MESSAGE_RECEIVED      3
 #define EVENT_ERROR                 4
 
+/* Event flags */
+#define EVENT_FLAG_BINARY           0x0002  /* Binary payload (MSG_FLAG_BINARY stripped from message_id) */
+#define EVENT_FLAG_COMPRESSED       0x0004  /* Arrived compressed, payload_data is inflated */
+
 /* ========== Structure Definitions ========== */
 
 /* Message header structure (6 bytes) */
@@ -67,8 +78,96 @@ typedef struct {
     uint16_t message_id;
     uint32_t payload_length;
     uint8_t* payload_data;
+    uint32_t flags;
 } NetworkEvent;
 
+/* ========== Binary Payload Encoding ========== */
+
+/* Setting MSG_FLAG_BINARY in a header's message_id marks the payload as
+ * the compact binary form of that message instead of JSON. A peer that
+ * sends binary frames is answered in kind; everyone else keeps JSON.
+ * Multi-byte fields are big-endian, strings are length-prefixed. */
+#define MSG_FLAG_BINARY     0x8000
+#define MSG_FLAG_COMPRESSED 0x4000
+#define MSG_ID_MASK         0x3FFF
+
+/* Compressed frames (server to client, once asked for): the original
+ * payload length (u32), then a raw deflate block ended by a sync flush.
+ * All of a connection's frames are one deflate stream, primed with
+ * COMPRESSION_DICTIONARY, so they must be inflated in order. */
+#define COMPRESSION_NONE        0
+#define COMPRESSION_DEFLATE     1
+#define COMPRESS_MAX_PAYLOAD    (4 * BUFFER_SIZE)
+
+/* Common substrings of the JSON replies; both ends must use the same */
+#define COMPRESSION_DICTIONARY \
+    "{\"game_id\": \"\", \"opponent\": \"\", \"result\": \"white_win\", \"result\": \"black_win\", " \
+    "\"user_result\": \"win\", \"user_result\": \"loss\", \"user_result\": \"draw\", " \
+    "\"my_color\": \"white\", \"my_color\": \"black\", \"date\": \"20\", \"created_at\": \"20\", " \
+    "\"moves_count\": , \"is_ai_game\": false, \"is_ai_game\": true, " \
+    "\"white_username\": \"\", \"black_username\": \"\"}, {\"games\": [" \
+    "{\"user_id\": \"\", \"username\": \"\", \"fullname\": \"\", \"elo\": 1200, \"rating\": 1200, " \
+    "\"status\": \"available\", \"status\": \"in_game\"}, {\"users\": ["
+
+/* Moves use Stockfish's 16-bit layout: bits 0-5 destination square,
+ * 6-11 origin square (a1 = 0 ... h8 = 63), 12-13 promotion piece
+ * (knight..queen), 14-15 move type. */
+#define MOVE_NONE           0
+#define MOVE_TYPE_MASK      0xC000
+#define MOVE_TYPE_PROMOTION 0xC000
+
+/* GameStatePayload flags */
+#define STATE_FLAG_BLACK_TO_MOVE 0x01
+#define STATE_FLAG_IN_CHECK      0x02
+#define STATE_FLAG_GAME_OVER     0x04
+
+#define BINARY_GAME_ID_MAX 64
+#define BINARY_FEN_MAX     100
+
+/* MAKE_MOVE wire form: move u16, clock_ms u32, game_id */
+typedef struct {
+    uint16_t move;
+    uint32_t clock_ms;                   /* Mover's remaining time (0 if untimed) */
+    char game_id[BINARY_GAME_ID_MAX];
+} MovePayload;
+
+/* GAME_STATE_UPDATE wire form: last_move u16, flags u8, white_ms u32,
+ * black_ms u32, game_id, fen */
+typedef struct {
+    uint16_t last_move;
+    uint8_t flags;                       /* STATE_FLAG_* */
+    uint32_t white_ms;                   /* Clocks in milliseconds */
+    uint32_t black_ms;
+    char game_id[BINARY_GAME_ID_MAX];
+    char fen[BINARY_FEN_MAX];
+} GameStatePayload;
+
+/* Spectator streams: a keyframe carries the whole position, each move
+ * after it only a delta. ply counts the half-moves played; apply the
+ * delta for ply + 1 and wait for a keyframe after a gap (or send
+ * MSG_C2S_SPECTATE again to resync). */
+
+/* SPECTATE_KEYFRAME wire form: stream u32, ply u16, then the
+ * GAME_STATE_UPDATE wire form of the position */
+typedef struct {
+    uint32_t stream;
+    uint16_t ply;
+    GameStatePayload state;
+} SpectatorKeyframe;
+
+/* SPECTATE_DELTA wire form: stream u32, ply u16, move u16, flags u8,
+ * white_ms u32, black_ms u32 (17 bytes) */
+typedef struct {
+    uint32_t stream;
+    uint16_t ply;                        /* Half-moves played including this one */
+    uint16_t move;
+    uint8_t flags;                       /* STATE_FLAG_* after the move */
+    uint32_t white_ms;
+    uint32_t black_ms;
+} SpectatorDelta;
+
+#define SPECTATOR_DELTA_SIZE 17
+
 /* ========== Client API Functions ========== */
 
 /* Initialize and connect to server */
@@ -77,22 +176,61 @@ int client_init(const char* host, int port);
 /* Disconnect and cleanup */
 void client_shutdown(void);
 
-/* Check for events (non-blocking) */
+/* Check for events (non-blocking). While the I/O thread runs this only
+ * waits up to timeout_ms for it to queue something. */
 int client_poll(int timeout_ms);
 
+/* Native I/O thread: reads and frames the server's messages off the UI
+ * thread into a lock-free event ring. client_event_fd() becomes readable
+ * whenever events are queued; watch it from the UI toolkit (a
+ * QSocketNotifier, Tk's createfilehandler) and drain with
+ * client_poll_batch() until it returns 0. A full ring pauses reading
+ * rather than dropping messages. Calls other than draining stay on the
+ * UI thread; client_shutdown() stops the thread. */
+int client_start_thread(void);
+void client_stop_thread(void);
+int client_event_fd(void);        /* -1 until client_start_thread() */
+
 /* Send message to server */
 int client_send_message(uint16_t message_id, const uint8_t* payload, uint32_t payload_length);
 
+/* Ask the server to deflate large payloads (history, user lists). They
+ * arrive inflated, with EVENT_FLAG_COMPRESSED set. Call after
+ * client_init(); a new connection starts uncompressed again. */
+int client_enable_compression(void);
+
+/* Send a binary MSG_C2S_MAKE_MOVE for a UCI move */
+int client_send_move(const char* game_id, const char* uci, uint32_t clock_ms);
+
 /* Get next event from queue */
 NetworkEvent* get_next_event(void);
 
 /* Free event memory */
 void free_event(NetworkEvent* event);
 
+/* Batched draining: copies up to max queued events into out[]; release
+ * their payloads with free_event_batch() */
+int client_poll_batch(NetworkEvent* out, int max);
+void free_event_batch(NetworkEvent* events, int count);
+
 /* Get connection status */
 int is_connected(void);
 
 /* Get message type name for debugging */
 const char* get_message_type_name(uint16_t message_id);
 
+/* Binary payload codec. move_from_uci() returns MOVE_NONE for malformed
+ * input; move_to_uci() needs 6 bytes. Encoders return the payload size or
+ * -1 if it doesn't fit; decoders return 0, or -1 on a malformed payload. */
+uint16_t move_from_uci(const char* uci);
+int move_to_uci(uint16_t move, char* out);
+int encode_move_payload(const MovePayload* move, uint8_t* out, size_t capacity);
+int decode_move_payload(const uint8_t* payload, uint32_t length, MovePayload* move);
+int encode_game_state_payload(const GameStatePayload* state, uint8_t* out, size_t capacity);
+int decode_game_state_payload(const uint8_t* payload, uint32_t length, GameStatePayload* state);
+int encode_spectator_keyframe(const SpectatorKeyframe* keyframe, uint8_t* out, size_t capacity);
+int decode_spectator_keyframe(const uint8_t* payload, uint32_t length, SpectatorKeyframe* keyframe);
+int encode_spectator_delta(const SpectatorDelta* delta, uint8_t* out, size_t capacity);
+int decode_spectator_delta(const uint8_t* payload, uint32_t length, SpectatorDelta* delta);
+
 #endif /* PROTOCOL_H */